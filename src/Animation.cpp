@@ -0,0 +1,290 @@
+// Sh: A GPU metaprogramming language.
+//
+// Copyright 2003-2005 Serious Hack Inc.
+// 
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, 
+// MA  02110-1301, USA
+//////////////////////////////////////////////////////////////////////////////
+#include "Animation.hpp"
+#include <cmath>
+#include <algorithm>
+#include "ShrikeCanvas.hpp"
+
+using namespace SH;
+
+namespace {
+
+// Catmull-Rom spline through p1 and p2, at t in [0, 1].
+float catmull_rom(float p0, float p1, float p2, float p3, float t)
+{
+  float t2 = t*t;
+  float t3 = t2*t;
+  return 0.5f*((2.0f*p1)
+               + (p2 - p0)*t
+               + (2.0f*p0 - 5.0f*p1 + 4.0f*p2 - p3)*t2
+               + (3.0f*p1 - p0 - 3.0f*p2 + p3)*t3);
+}
+
+}
+
+AnimationTrack::AnimationTrack(const ShVariableNodePtr& var)
+  : m_var(var),
+    m_size(std::min(var->size(), (int)MAX_SIZE)),
+    m_enabled(false),
+    m_mode(ANIMATION_LOOP),
+    m_period(4.0f),
+    m_dirty(false),
+    m_time(0.0f),
+    m_value(new ShDataVariant<float, SH_HOST>(var->size(), 0.0f)),
+    m_observer(0)
+{
+  ShPointer<ShDataVariant<float, SH_HOST> > low =
+    variant_convert<float, SH_HOST>(var->lowBoundVariant());
+  ShPointer<ShDataVariant<float, SH_HOST> > high =
+    variant_convert<float, SH_HOST>(var->highBoundVariant());
+  for (int i = 0; i < m_size; i++) {
+    m_low[i] = (*low)[i];
+    m_high[i] = (*high)[i];
+  }
+  reload();
+}
+
+void AnimationTrack::enabled(bool enabled)
+{
+  if (enabled && !m_enabled) reload();
+  m_enabled = enabled;
+}
+
+void AnimationTrack::mode(AnimationMode mode)
+{
+  m_mode = mode;
+  m_time = 0.0f;
+  reload();
+}
+
+void AnimationTrack::period(float seconds)
+{
+  if (seconds > 0.0f) m_period = seconds;
+}
+
+void AnimationTrack::add_key()
+{
+  ShPointer<ShDataVariant<float, SH_HOST> > value =
+    variant_convert<float, SH_HOST>(m_var->getVariant());
+  Key key;
+  for (int i = 0; i < MAX_SIZE; i++) {
+    key.value[i] = i < m_size ? (*value)[i] : 0.0f;
+  }
+  m_keys.push_back(key);
+}
+
+void AnimationTrack::clear_keys()
+{
+  m_keys.clear();
+  m_time = 0.0f;
+  m_dirty = false;
+}
+
+void AnimationTrack::reload()
+{
+  ShPointer<ShDataVariant<float, SH_HOST> > value =
+    variant_convert<float, SH_HOST>(m_var->getVariant());
+  for (int i = 0; i < m_size; i++) {
+    float range = m_high[i] - m_low[i];
+    m_phase[i] = range != 0.0f ? ((*value)[i] - m_low[i])/range : 0.0f;
+  }
+  // Components past MAX_SIZE aren't animated, but write() sends them
+  // all, so they have to keep the uniform's value.
+  for (int i = 0; i < m_var->size(); i++) {
+    (*m_value)[i] = (*value)[i];
+  }
+  m_dirty = false;
+}
+
+void AnimationTrack::step(float dt)
+{
+  if (!m_enabled) return;
+
+  float d = dt/m_period;
+  switch (m_mode) {
+  case ANIMATION_LOOP:
+    for (int i = 0; i < m_size; i++) {
+      m_phase[i] += d;
+      m_phase[i] -= std::floor(m_phase[i]);
+    }
+    m_dirty = true;
+    break;
+  case ANIMATION_PING_PONG:
+    // Phases in [1, 2) are on the way back down.
+    for (int i = 0; i < m_size; i++) {
+      m_phase[i] = std::fmod(m_phase[i] + d, 2.0f);
+    }
+    m_dirty = true;
+    break;
+  case ANIMATION_ONCE:
+    for (int i = 0; i < m_size; i++) {
+      if (m_phase[i] < 1.0f) {
+        m_phase[i] = std::min(m_phase[i] + d, 1.0f);
+        m_dirty = true;
+      }
+    }
+    break;
+  case ANIMATION_KEYFRAMES:
+    if (m_keys.size() > 1) {
+      m_time = std::fmod(m_time + d, (float)m_keys.size());
+      m_dirty = true;
+    }
+    break;
+  }
+}
+
+float AnimationTrack::keyframe(int i) const
+{
+  int n = m_keys.size();
+  // Nothing to move between yet
+  if (n < 2) return (*m_value)[i];
+  int k = (int)m_time;
+  float t = m_time - k;
+  float v = catmull_rom(m_keys[(k + n - 1) % n].value[i],
+                        m_keys[k % n].value[i],
+                        m_keys[(k + 1) % n].value[i],
+                        m_keys[(k + 2) % n].value[i], t);
+  // The spline overshoots near sharp turns.
+  return std::max(m_low[i], std::min(m_high[i], v));
+}
+
+float AnimationTrack::evaluate(int i) const
+{
+  float phase = m_phase[i];
+  switch (m_mode) {
+  case ANIMATION_PING_PONG:
+    if (phase > 1.0f) phase = 2.0f - phase;
+    break;
+  case ANIMATION_KEYFRAMES:
+    return keyframe(i);
+  default:
+    break;
+  }
+  return m_low[i] + phase*(m_high[i] - m_low[i]);
+}
+
+bool AnimationTrack::write()
+{
+  if (!m_dirty) return false;
+
+  for (int i = 0; i < m_size; i++) {
+    (*m_value)[i] = evaluate(i);
+  }
+  m_var->setVariant(m_value);
+  m_dirty = false;
+
+  if (m_observer) m_observer->animated();
+  return true;
+}
+
+const float Animator::STEP = 0.01f;
+
+Animator* Animator::m_instance = 0;
+
+Animator* Animator::instance()
+{
+  if (!m_instance) m_instance = new Animator();
+  return m_instance;
+}
+
+Animator::Animator()
+  : m_pending(0.0f)
+{
+}
+
+Animator::~Animator()
+{
+  clear();
+}
+
+AnimationTrack* Animator::find(const ShVariableNodePtr& var)
+{
+  for (std::size_t i = 0; i < m_tracks.size(); i++) {
+    if (m_tracks[i]->var() == var) return m_tracks[i];
+  }
+  return 0;
+}
+
+AnimationTrack* Animator::track(const ShVariableNodePtr& var)
+{
+  AnimationTrack* track = find(var);
+  if (!track) {
+    track = new AnimationTrack(var);
+    m_tracks.push_back(track);
+  }
+  return track;
+}
+
+void Animator::clear()
+{
+  for (std::size_t i = 0; i < m_tracks.size(); i++) {
+    delete m_tracks[i];
+  }
+  m_tracks.clear();
+  Stop();
+}
+
+void Animator::update()
+{
+  bool enabled = false;
+  for (std::size_t i = 0; i < m_tracks.size(); i++) {
+    enabled = enabled || m_tracks[i]->enabled();
+  }
+
+  if (enabled && !IsRunning()) {
+    m_last = ShTimer::now();
+    m_pending = 0.0f;
+    Start((int)(STEP*1000.0f));
+  } else if (!enabled && IsRunning()) {
+    Stop();
+  }
+}
+
+bool Animator::write()
+{
+  bool wrote = false;
+  for (std::size_t i = 0; i < m_tracks.size(); i++) {
+    AnimationTrack* track = m_tracks[i];
+    if (track->enabled() && track->write()) wrote = true;
+  }
+  return wrote;
+}
+
+void Animator::Notify()
+{
+  ShTimer now = ShTimer::now();
+  m_pending += (now - m_last).value()/1000.0f;
+  m_last = now;
+
+  // After a stall (a modal dialog, a slow compile) skip ahead rather
+  // than replaying every missed step at once.
+  m_pending = std::min(m_pending, 10.0f*STEP);
+
+  int steps = 0;
+  for (; m_pending >= STEP; m_pending -= STEP, steps++) {
+    for (std::size_t i = 0; i < m_tracks.size(); i++) {
+      m_tracks[i]->step(STEP);
+    }
+  }
+
+  // The values are written by the canvas, once for each frame it
+  // actually draws.
+  if (steps) ShrikeCanvas::instance()->invalidate();
+}
@@ -0,0 +1,159 @@
+// Sh: A GPU metaprogramming language.
+//
+// Copyright 2003-2005 Serious Hack Inc.
+// 
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, 
+// MA  02110-1301, USA
+//////////////////////////////////////////////////////////////////////////////
+#ifndef ANIMATION_HPP
+#define ANIMATION_HPP
+
+#include <vector>
+#include <wx/wx.h>
+#include <sh/sh.hpp>
+#include "Timer.hpp"
+
+/// How an AnimationTrack moves its uniform.
+enum AnimationMode {
+  ANIMATION_LOOP, // from low to high, then start over
+  ANIMATION_PING_PONG, // from low to high and back again
+  ANIMATION_ONCE, // from low to high, then stop
+  ANIMATION_KEYFRAMES // through the keys on a smooth curve, then start over
+};
+
+/// Told when an animated uniform has been written, e.g. to move the
+/// sliders along.
+class AnimationObserver {
+public:
+  virtual ~AnimationObserver() {}
+  virtual void animated() = 0;
+};
+
+/** Moves one uniform between its bounds, each component on its own
+ * phase.  A full sweep takes period() seconds; for keyframes that is
+ * the time from one key to the next.
+ *
+ * The bounds and values are kept as floats, and the variant written
+ * to the uniform is allocated up front, so stepping and writing don't
+ * touch the heap.
+ */
+class AnimationTrack {
+public:
+  AnimationTrack(const SH::ShVariableNodePtr& var);
+
+  const SH::ShVariableNodePtr& var() const { return m_var; }
+
+  bool enabled() const { return m_enabled; }
+  void enabled(bool enabled);
+
+  AnimationMode mode() const { return m_mode; }
+  void mode(AnimationMode mode);
+
+  float period() const { return m_period; }
+  void period(float seconds);
+
+  /// Append the uniform's current value as the next key.
+  void add_key();
+  void clear_keys();
+  std::size_t key_count() const { return m_keys.size(); }
+
+  /// Take over the uniform's current value, e.g. after it was set by
+  /// hand.
+  void reload();
+
+  /// Advance by dt seconds.
+  void step(float dt);
+
+  /// Write the value to the uniform if it changed since the last
+  /// write.  Returns whether it did.
+  bool write();
+
+  void observer(AnimationObserver* observer) { m_observer = observer; }
+
+private:
+  float evaluate(int component) const;
+  float keyframe(int component) const;
+
+  enum { MAX_SIZE = 4 };
+
+  struct Key {
+    float value[MAX_SIZE];
+  };
+
+  SH::ShVariableNodePtr m_var;
+  int m_size;
+  bool m_enabled;
+  AnimationMode m_mode;
+  float m_period;
+  bool m_dirty; // stepped since the last write
+
+  float m_low[MAX_SIZE];
+  float m_high[MAX_SIZE];
+  float m_phase[MAX_SIZE]; // in periods
+  float m_time; // for keyframes, in periods
+
+  std::vector<Key> m_keys;
+  SH::ShPointer< SH::ShDataVariant<float, SH::SH_HOST> > m_value;
+  AnimationObserver* m_observer;
+
+  // NOT IMPLEMENTED
+  AnimationTrack(const AnimationTrack&);
+  AnimationTrack& operator=(const AnimationTrack&);
+};
+
+/** Runs the AnimationTracks on a fixed time step, independent of how
+ * fast the canvas draws.  The timer only advances the tracks; the
+ * canvas calls write() once per frame, just before it draws, to send
+ * all the animated values to Sh in one go.
+ */
+class Animator : public wxTimer {
+public:
+  static Animator* instance();
+
+  /// Length of one step in seconds.
+  static const float STEP;
+
+  /// The track for var, made (disabled) if there isn't one yet.
+  AnimationTrack* track(const SH::ShVariableNodePtr& var);
+  /// The track for var, or 0.
+  AnimationTrack* find(const SH::ShVariableNodePtr& var);
+
+  /// Drop all tracks, e.g. when the shader changes.
+  void clear();
+
+  /// Start or stop the clock to match the enabled tracks.
+  void update();
+
+  /// Write the values of tracks that moved.  Returns whether any did.
+  bool write();
+
+  void Notify();
+
+private:
+  Animator();
+  ~Animator();
+
+  static Animator* m_instance;
+
+  std::vector<AnimationTrack*> m_tracks;
+  ShTimer m_last; // when the clock last ran
+  float m_pending; // seconds not stepped yet
+
+  // NOT IMPLEMENTED
+  Animator(const Animator& other);
+  Animator& operator=(const Animator& other);
+};
+
+#endif
@@ -0,0 +1,541 @@
+// Sh: A GPU metaprogramming language.
+//
+// Copyright 2003-2005 Serious Hack Inc.
+// 
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, 
+// MA  02110-1301, USA
+//////////////////////////////////////////////////////////////////////////////
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+#include <algorithm>
+#include <cstdlib>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <sh/sh.hpp>
+#include <shutil/shutil.hpp>
+#include "ShrikeGl.hpp"
+#include "Bench.hpp"
+#include "Camera.hpp"
+#include "CompareView.hpp"
+#include "Globals.hpp"
+#include "MeshView.hpp"
+#include "MeshOptimize.hpp"
+#include "OffscreenContext.hpp"
+#include "OptimizationSweep.hpp"
+#include "ProgramCost.hpp"
+#include "Shader.hpp"
+
+using namespace SH;
+using namespace ShUtil;
+
+BenchOptions::BenchOptions()
+  : width(512), height(512),
+    warmup(5), frames(100),
+    model(SHMEDIA_DIR "/objs/plane1.obj"),
+    output("shrike-bench.csv"),
+    tolerance(0.25f),
+    sweep_output("shrike-sweep.csv"),
+    sweep_tolerance(2)
+{
+  for (int level = 0; level <= 3; ++level) sweep_levels.push_back(level);
+}
+
+BenchResult::BenchResult()
+  : ok(false), init_ms(0), bind_ms(0),
+    vertex_instructions(0), fragment_instructions(0)
+{
+}
+
+namespace {
+
+bool result_name_less(const BenchResult& a, const BenchResult& b)
+{
+  return a.name < b.name;
+}
+
+// Same view setup as ShrikeCanvas::setupView, minus the split.
+void setup_view(Camera& camera, int width, int height)
+{
+  glViewport(0, 0, width, height);
+  glMatrixMode(GL_PROJECTION);
+  glLoadIdentity();
+  camera.glProjection((float)width/height);
+  glMatrixMode(GL_MODELVIEW);
+  glLoadIdentity();
+  camera.glModelView();
+
+  GetGlobals().width = (float)width;
+  GetGlobals().height = (float)height;
+  GetGlobals().mv = camera.shModelView();
+  GetGlobals().mv_inverse = inverse(GetGlobals().mv);
+  GetGlobals().mvp = camera.shModelViewProjection(ShMatrix4x4f());
+  GetGlobals().lightPos = GetGlobals().mv | ShPoint3f(GetGlobals().lightDirW * GetGlobals().lightLenW);
+}
+
+void draw_frame(Shader* shader, const MeshView& mesh)
+{
+  glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+  shader->bind();
+  if (!shader->render(mesh)) mesh.drawTriangles();
+  Shader::unbind();
+  glFinish();
+}
+
+/// The offscreen context and model that shaders are drawn with.
+class BenchScene : public ViewportRenderer {
+public:
+  BenchScene(const BenchOptions& options)
+    : m_context(options.width, options.height)
+  {
+    m_camera.move(0, 0.0, -7.0);
+  }
+
+  ~BenchScene()
+  {
+    m_mesh.release();
+  }
+
+  /// Make the context current and load the model.  If that fails,
+  /// says why on std::cerr and returns false.
+  bool open(const BenchOptions& options)
+  {
+    if (!m_context.valid()) {
+      std::cerr << "Could not create an offscreen GL context.";
+      if (!OffscreenContext::available()) {
+        std::cerr << " shrike was built without OSMesa.";
+      }
+      std::cerr << std::endl;
+      return false;
+    }
+    shrikeGlInit();
+
+    glEnable(GL_DEPTH_TEST);
+    glClearColor(0.2, 0.2, 0.2, 1.0);
+
+    std::ifstream infile(options.model.c_str());
+    if (!infile) {
+      std::cerr << "Failed to open " << options.model << std::endl;
+      return false;
+    }
+    MeshData data;
+    try {
+      ShObjMesh model(infile);
+      data.flatten(model);
+    } catch (const ShException& e) {
+      std::cerr << "Failed to load " << options.model << ": " << e.message() << std::endl;
+      return false;
+    }
+
+    weld_vertices(data);
+    optimize_vertex_cache(data);
+    reorder_vertices(data);
+    m_mesh.assign(data);
+
+    setup_view(m_camera, options.width, options.height);
+    return true;
+  }
+
+  void renderViewport(Shader* shader, int w, int h)
+  {
+    setup_view(m_camera, w, h);
+    draw_frame(shader, m_mesh);
+  }
+
+  const MeshView& mesh() const { return m_mesh; }
+
+private:
+  OffscreenContext m_context;
+  MeshView m_mesh;
+  Camera m_camera;
+};
+
+bool selected(const Shader* shader, const BenchOptions& options)
+{
+  return options.filter.empty() || shader->name().find(options.filter) != std::string::npos;
+}
+
+void bench_shader(Shader* shader, const BenchOptions& options,
+                  const MeshView& mesh,
+                  BenchResult& result)
+{
+  result.name = shader->name();
+  if (shader->failed()) {
+    result.error = "shader previously failed";
+    return;
+  }
+
+  try {
+    ShTimer start = ShTimer::now();
+    bool success = shader->firstTimeInit();
+    result.init_ms = (ShTimer::now() - start).value();
+    if (!success) {
+      shader->set_failed(true);
+      result.error = "init failed";
+      return;
+    }
+
+    start = ShTimer::now();
+    shader->bind();
+    glFinish();
+    result.bind_ms = (ShTimer::now() - start).value();
+
+    ProgramCost cost;
+    if (cost.measure(GL_VERTEX_PROGRAM_ARB)) {
+      result.vertex_instructions = cost.used[ProgramCost::INSTRUCTIONS];
+    }
+    if (cost.measure(GL_FRAGMENT_PROGRAM_ARB)) {
+      result.fragment_instructions = cost.used[ProgramCost::INSTRUCTIONS];
+    }
+
+    for (int i = 0; i < options.warmup; ++i) draw_frame(shader, mesh);
+
+    std::vector<float> samples;
+    samples.reserve(options.frames);
+    for (int i = 0; i < options.frames; ++i) {
+      start = ShTimer::now();
+      draw_frame(shader, mesh);
+      samples.push_back((ShTimer::now() - start).value());
+    }
+    result.frame_ms.compute(samples);
+    result.ok = true;
+  } catch (const ShException& e) {
+    shader->set_failed(true);
+    result.error = e.message();
+  } catch (...) {
+    shader->set_failed(true);
+    result.error = "unknown exception";
+  }
+  Shader::unbind();
+}
+
+/// Split a line of CSV as written by csv_quote.
+std::vector<std::string> csv_split(const std::string& line)
+{
+  std::vector<std::string> fields(1);
+  bool quoted = false;
+  for (std::string::size_type i = 0; i < line.size(); ++i) {
+    char c = line[i];
+    if (quoted) {
+      if (c != '"') {
+        fields.back() += c;
+      } else if (i + 1 < line.size() && line[i + 1] == '"') {
+        fields.back() += c;
+        ++i;
+      } else {
+        quoted = false;
+      }
+    } else if (c == '"') {
+      quoted = true;
+    } else if (c == ',') {
+      fields.push_back("");
+    } else if (c != '\r') {
+      fields.back() += c;
+    }
+  }
+  return fields;
+}
+
+/// One line of a comparison.  Returns whether it is a regression.
+bool compare_value(std::ostream& report, const std::string& shader, bool& named,
+                   const char* what, float before, float after,
+                   float tolerance, float noise, const char* unit)
+{
+  bool worse = after > before*(1.0f + tolerance) && after - before > noise;
+  bool better = after < before/(1.0f + tolerance) && before - after > noise;
+  if (!worse && !better) return false;
+
+  if (!named) {
+    report << shader << std::endl;
+    named = true;
+  }
+  // Counts have no unit and no fractions
+  int decimals = *unit ? 2 : 0;
+  char line[160];
+  std::sprintf(line, "  %-22s %9.*f%-3s -> %9.*f%-3s %+5.0f%%  %s",
+               what, decimals, before, unit, decimals, after, unit,
+               before > 0.0f ? 100.0f*(after - before)/before : 100.0f,
+               worse ? "REGRESSION" : "better");
+  report << line << std::endl;
+  return worse;
+}
+
+std::string json_quote(const std::string& s)
+{
+  std::string ret = "\"";
+  for (std::string::size_type i = 0; i < s.size(); ++i) {
+    switch (s[i]) {
+    case '"': ret += "\\\""; break;
+    case '\\': ret += "\\\\"; break;
+    case '\n': ret += "\\n"; break;
+    case '\t': ret += "\\t"; break;
+    default:
+      if ((unsigned char)s[i] < 0x20) ret += ' ';
+      else ret += s[i];
+    }
+  }
+  return ret + "\"";
+}
+
+}
+
+std::string csv_quote(const std::string& s)
+{
+  std::string ret = "\"";
+  for (std::string::size_type i = 0; i < s.size(); ++i) {
+    if (s[i] == '"') ret += '"';
+    ret += s[i];
+  }
+  return ret + "\"";
+}
+
+void write_bench_csv(std::ostream& out, const BenchResultList& results)
+{
+  out << "shader,status,init_ms,bind_ms,vertex_instructions,fragment_instructions,"
+      << "frames,mean_ms,min_ms,max_ms,p50_ms,p95_ms,p99_ms,error" << std::endl;
+  for (BenchResultList::const_iterator I = results.begin(); I != results.end(); ++I) {
+    out << csv_quote(I->name) << ','
+        << (I->ok ? "ok" : "failed") << ','
+        << I->init_ms << ','
+        << I->bind_ms << ','
+        << I->vertex_instructions << ','
+        << I->fragment_instructions << ','
+        << I->frame_ms.count << ','
+        << I->frame_ms.mean << ','
+        << I->frame_ms.min << ','
+        << I->frame_ms.max << ','
+        << I->frame_ms.p50 << ','
+        << I->frame_ms.p95 << ','
+        << I->frame_ms.p99 << ','
+        << csv_quote(I->error) << std::endl;
+  }
+}
+
+void write_bench_json(std::ostream& out, const BenchResultList& results)
+{
+  out << "[" << std::endl;
+  for (BenchResultList::const_iterator I = results.begin(); I != results.end(); ++I) {
+    if (I != results.begin()) out << "," << std::endl;
+    out << "  {\"shader\": " << json_quote(I->name)
+        << ", \"status\": " << (I->ok ? "\"ok\"" : "\"failed\"")
+        << ", \"init_ms\": " << I->init_ms
+        << ", \"bind_ms\": " << I->bind_ms
+        << ", \"vertex_instructions\": " << I->vertex_instructions
+        << ", \"fragment_instructions\": " << I->fragment_instructions
+        << ", \"frames\": " << I->frame_ms.count
+        << ", \"mean_ms\": " << I->frame_ms.mean
+        << ", \"min_ms\": " << I->frame_ms.min
+        << ", \"max_ms\": " << I->frame_ms.max
+        << ", \"p50_ms\": " << I->frame_ms.p50
+        << ", \"p95_ms\": " << I->frame_ms.p95
+        << ", \"p99_ms\": " << I->frame_ms.p99
+        << ", \"error\": " << json_quote(I->error)
+        << "}";
+  }
+  out << std::endl << "]" << std::endl;
+}
+
+bool read_bench_csv(std::istream& in, BenchResultList& results)
+{
+  std::string line;
+  if (!std::getline(in, line)) return false;
+  std::vector<std::string> header = csv_split(line);
+  std::map<std::string, std::size_t> column;
+  for (std::size_t i = 0; i < header.size(); ++i) column[header[i]] = i;
+  if (!column.count("shader") || !column.count("status")) return false;
+
+  while (std::getline(in, line)) {
+    if (line.empty()) continue;
+    std::vector<std::string> fields = csv_split(line);
+    fields.resize(header.size());
+    std::map<std::string, double> number;
+    for (std::size_t i = 0; i < fields.size(); ++i) {
+      number[header[i]] = std::atof(fields[i].c_str());
+    }
+
+    BenchResult result;
+    result.name = fields[column["shader"]];
+    result.ok = fields[column["status"]] == "ok";
+    if (column.count("error")) result.error = fields[column["error"]];
+    result.init_ms = number["init_ms"];
+    result.bind_ms = number["bind_ms"];
+    result.vertex_instructions = (int)number["vertex_instructions"];
+    result.fragment_instructions = (int)number["fragment_instructions"];
+    result.frame_ms.count = (std::size_t)number["frames"];
+    result.frame_ms.mean = number["mean_ms"];
+    result.frame_ms.min = number["min_ms"];
+    result.frame_ms.max = number["max_ms"];
+    result.frame_ms.p50 = number["p50_ms"];
+    result.frame_ms.p95 = number["p95_ms"];
+    result.frame_ms.p99 = number["p99_ms"];
+    results.push_back(result);
+  }
+  return true;
+}
+
+int compare_bench(const BenchResultList& baseline, const BenchResultList& results,
+                  float tolerance, std::ostream& report)
+{
+  // Below this a change in time is taken to be noise
+  const float NOISE_MS = 0.5f;
+
+  std::map<std::string, const BenchResult*> before;
+  for (BenchResultList::const_iterator I = baseline.begin(); I != baseline.end(); ++I) {
+    before[I->name] = &*I;
+  }
+
+  int regressions = 0;
+  int shaders = 0;
+  std::vector<std::string> added;
+  for (BenchResultList::const_iterator I = results.begin(); I != results.end(); ++I) {
+    std::map<std::string, const BenchResult*>::iterator B = before.find(I->name);
+    if (B == before.end()) {
+      added.push_back(I->name);
+      continue;
+    }
+    const BenchResult& old = *B->second;
+    before.erase(B);
+
+    int found = regressions;
+    bool named = false;
+    if (old.ok && !I->ok) {
+      report << I->name << std::endl
+             << "  stopped working: " << I->error << "  REGRESSION" << std::endl;
+      named = true;
+      ++regressions;
+    } else if (!old.ok && I->ok) {
+      report << I->name << std::endl << "  works now" << std::endl;
+      named = true;
+    }
+    if (old.ok && I->ok) {
+      regressions += compare_value(report, I->name, named, "init",
+                                   old.init_ms, I->init_ms, tolerance, NOISE_MS, " ms");
+      regressions += compare_value(report, I->name, named, "compile (first bind)",
+                                   old.bind_ms, I->bind_ms, tolerance, NOISE_MS, " ms");
+      regressions += compare_value(report, I->name, named, "frame (median)",
+                                   old.frame_ms.p50, I->frame_ms.p50, tolerance, NOISE_MS, " ms");
+      regressions += compare_value(report, I->name, named, "vertex instructions",
+                                   old.vertex_instructions, I->vertex_instructions,
+                                   tolerance, 0.0f, "");
+      regressions += compare_value(report, I->name, named, "fragment instructions",
+                                   old.fragment_instructions, I->fragment_instructions,
+                                   tolerance, 0.0f, "");
+    }
+    if (regressions != found) ++shaders;
+  }
+
+  for (std::size_t i = 0; i < added.size(); ++i) {
+    report << added[i] << std::endl << "  not in the baseline" << std::endl;
+  }
+  for (std::map<std::string, const BenchResult*>::iterator I = before.begin();
+       I != before.end(); ++I) {
+    report << I->first << std::endl << "  in the baseline but not run" << std::endl;
+  }
+
+  char line[120];
+  std::sprintf(line, "%d regression%s in %d of %lu shaders (tolerance %.0f%%)",
+               regressions, regressions == 1 ? "" : "s", shaders,
+               (unsigned long)results.size(), 100.0f*tolerance);
+  report << line << std::endl;
+  return regressions;
+}
+
+int run_benchmark(const BenchOptions& options)
+{
+  BenchScene scene(options);
+  if (!scene.open(options)) return 1;
+
+  BenchResultList results;
+  for (ShaderList::iterator I = GetShaders().begin(); I != GetShaders().end(); ++I) {
+    Shader* shader = *I;
+    if (!selected(shader, options)) continue;
+
+    std::cerr << "Benchmarking " << shader->name() << std::endl;
+    results.push_back(BenchResult());
+    bench_shader(shader, options, scene.mesh(), results.back());
+  }
+  std::sort(results.begin(), results.end(), result_name_less);
+
+  std::ofstream out(options.output.c_str());
+  if (!out) {
+    std::cerr << "Failed to open " << options.output << " for writing" << std::endl;
+    return 1;
+  }
+  std::string::size_type dot = options.output.rfind('.');
+  if (dot != std::string::npos && options.output.substr(dot) == ".json") {
+    write_bench_json(out, results);
+  } else {
+    write_bench_csv(out, results);
+  }
+  std::cerr << "Wrote " << results.size() << " results to " << options.output << std::endl;
+
+  if (options.baseline.empty()) return 0;
+
+  std::ifstream in(options.baseline.c_str());
+  BenchResultList baseline;
+  if (!in || !read_bench_csv(in, baseline)) {
+    std::cerr << "Could not read the baseline " << options.baseline
+              << "; copy " << options.output << " there to start one" << std::endl;
+    return 1;
+  }
+  std::cerr << "Compared with " << options.baseline << ":" << std::endl;
+  return compare_bench(baseline, results, options.tolerance, std::cerr) ? 1 : 0;
+}
+
+int run_optimization_sweep(const BenchOptions& options)
+{
+  BenchScene scene(options);
+  if (!scene.open(options)) return 1;
+
+  OptimizationSweep sweep(scene, options.width, options.height);
+  sweep.levels(options.sweep_levels);
+  sweep.frames(options.frames);
+  sweep.tolerance(options.sweep_tolerance);
+
+  SweepResultList results;
+  for (ShaderList::iterator I = GetShaders().begin(); I != GetShaders().end(); ++I) {
+    Shader* shader = *I;
+    if (!selected(shader, options) || shader->failed()) continue;
+
+    std::cerr << "Sweeping " << shader->name() << std::endl;
+    try {
+      if (!shader->firstTimeInit()) continue;
+    } catch (const ShException& e) {
+      std::cerr << "  init failed: " << e.message() << std::endl;
+      continue;
+    }
+    sweep.run(shader, results);
+  }
+
+  write_sweep_table(std::cout, results);
+
+  std::ofstream out(options.sweep_output.c_str());
+  if (!out) {
+    std::cerr << "Failed to open " << options.sweep_output << " for writing" << std::endl;
+    return 1;
+  }
+  write_sweep_csv(out, results);
+  std::cerr << "Wrote " << results.size() << " results to " << options.sweep_output << std::endl;
+
+  // A level that breaks a shader, or changes its picture, is a bug in
+  // the optimizer
+  for (SweepResultList::const_iterator I = results.begin(); I != results.end(); ++I) {
+    if (!I->ok || !I->matches) return 1;
+  }
+  return 0;
+}
@@ -0,0 +1,96 @@
+// Sh: A GPU metaprogramming language.
+//
+// Copyright 2003-2005 Serious Hack Inc.
+// 
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, 
+// MA  02110-1301, USA
+//////////////////////////////////////////////////////////////////////////////
+#ifndef BENCH_HPP
+#define BENCH_HPP
+
+#include <string>
+#include <vector>
+#include <iosfwd>
+#include "Timer.hpp"
+
+struct BenchOptions {
+  BenchOptions();
+
+  int width, height; // size of the offscreen framebuffer
+  int warmup; // frames rendered before timing starts
+  int frames; // timed frames per shader
+  std::string model; // OBJ file every shader is drawn on
+  std::string filter; // only run shaders whose name contains this
+  std::string output; // .json writes JSON, anything else CSV
+  std::string baseline; // CSV results to compare with, if not empty
+  float tolerance; // allowed slowdown or growth, as a fraction
+
+  std::vector<int> sweep_levels; // for run_optimization_sweep
+  std::string sweep_output; // CSV
+  int sweep_tolerance; // channel difference, out of 255, that still matches
+};
+
+struct BenchResult {
+  BenchResult();
+
+  std::string name;
+  bool ok;
+  std::string error;
+
+  float init_ms; // Shader::firstTimeInit
+  float bind_ms; // first Shader::bind, i.e. program compilation
+  int vertex_instructions; // native, see ProgramCost
+  int fragment_instructions;
+  TimingStats frame_ms; // steady-state frames
+};
+
+typedef std::vector<BenchResult> BenchResultList;
+
+/// Quote s as a CSV field.
+std::string csv_quote(const std::string& s);
+
+void write_bench_csv(std::ostream& out, const BenchResultList& results);
+void write_bench_json(std::ostream& out, const BenchResultList& results);
+
+/// Read what write_bench_csv() wrote.  Columns are found by name, so
+/// files from older versions can be read; missing ones are left at 0.
+/// Returns false if in doesn't look like a results file.
+bool read_bench_csv(std::istream& in, BenchResultList& results);
+
+/** Compare results with baseline and write what changed, shader by
+ * shader, to report.  Init, compile (first bind) and median frame
+ * times and instruction counts regress when they grow by more than
+ * tolerance (times also by more than half a millisecond, to ride out
+ * timer noise), and a shader regresses when it stops working.
+ * Returns the number of regressions.
+ */
+int compare_bench(const BenchResultList& baseline, const BenchResultList& results,
+                  float tolerance, std::ostream& report);
+
+/** Run every registered shader on an offscreen context and write the
+ * timings to options.output.  If options.baseline is set, compare with
+ * it too.  Returns a process exit status, which is 1 if anything
+ * regressed.
+ */
+int run_benchmark(const BenchOptions& options);
+
+/** Rebuild every registered shader at each of options.sweep_levels on
+ * an offscreen context, see OptimizationSweep.  The table goes to
+ * std::cout and the CSV to options.sweep_output.  Returns 1 if any
+ * level fails or changes what a shader draws.
+ */
+int run_optimization_sweep(const BenchOptions& options);
+
+#endif
@@ -1,7 +1,11 @@
 #include "Build.hpp"
+#include "LineReader.hpp"
+#include "Trace.hpp"
 #include <wx/wx.h>
 #include <wx/config.h>
+#include <wx/ffile.h>
 #include <wx/propdlg.h>
+#include <wx/spinctrl.h>
 #include <wx/tokenzr.h>
 
 enum ShrikeBuildPanelId{
@@ -19,6 +23,7 @@ BuildPanel::BuildPanel(wxWindow* parent) : wxPanel(parent, -1)
   sizer->Add(create_includes(),1, wxEXPAND);
   sizer->Add(create_libraries(),1, wxEXPAND);
   sizer->Add(create_flags(),1, wxEXPAND);
+  sizer->Add(create_jobs(),0, wxEXPAND);
 
   open_config();
     
@@ -43,6 +48,7 @@ void BuildPanel::open_config()
 
     m_compiler->SetValue(wxT("g++"));
     m_flags->SetValue(wxT("-shared -lsh -lshutil -lshrike"));
+    m_jobs->SetValue(0);
     return;
   }
   
@@ -63,6 +69,10 @@ void BuildPanel::open_config()
   if (config.Read(wxT("Build/Flags"), &value)) {
     m_flags->SetValue(value);
   }
+  long jobs;
+  if (config.Read(wxT("Build/Jobs"), &jobs)) {
+    m_jobs->SetValue((int)jobs);
+  }
 }
  
 void BuildPanel::save_config()
@@ -82,6 +92,7 @@ void BuildPanel::save_config()
   config.Write(wxT("Build/LibraryPaths"), value);
 
   config.Write(wxT("Build/Flags"), m_flags->GetValue());
+  config.Write(wxT("Build/Jobs"), (long)m_jobs->GetValue());
 }
 
 void BuildPanel::on_compiler_change(wxCommandEvent& e)
@@ -164,6 +175,16 @@ wxSizer* BuildPanel::create_flags()
   return sbs;
 }
 
+wxSizer* BuildPanel::create_jobs()
+{
+  wxStaticBox* sb = new wxStaticBox(this, -1, wxT("Parallel jobs (0 is one per processor)"));
+  wxStaticBoxSizer* sbs = new wxStaticBoxSizer(sb, wxHORIZONTAL);
+  m_jobs = new wxSpinCtrl(this, -1, wxT("0"), wxDefaultPosition, wxDefaultSize,
+                          wxSP_ARROW_KEYS, 0, 64, 0);
+  sbs->Add(m_jobs, 1, wxEXPAND);
+  return sbs;
+}
+
 BEGIN_EVENT_TABLE(BuildPanel, wxPanel)
   EVT_BUTTON(SHRIKE_BUILD_PANEL_COMPILER_CHANGE, BuildPanel::on_compiler_change)
   EVT_BUTTON(SHRIKE_BUILD_PANEL_INCLUDE_ADD, BuildPanel::on_include_add)
@@ -172,39 +193,346 @@ BEGIN_EVENT_TABLE(BuildPanel, wxPanel)
   EVT_BUTTON(SHRIKE_BUILD_PANEL_LIBRARY_REM, BuildPanel::on_library_rem)
 END_EVENT_TABLE()
 
-BuildProcess* build_project(const Project& project)
+class BuildProcess : public wxProcess {
+public:
+  BuildProcess(ProjectBuild* build, const ProjectBuild::Job& job)
+    : m_build(build), m_job(job), m_pid(0)
+  {
+    Redirect();
+  }
+
+  void OnTerminate(int pid, int status)
+  {
+    if (m_build) m_build->finished(this, status);
+    delete this;
+  }
+
+  /// Forget the build, which is going away before this process.
+  void detach() { m_build = 0; }
+
+  const ProjectBuild::Job& job() const { return m_job; }
+  long pid() const { return m_pid; }
+  void pid(long pid) { m_pid = pid; }
+
+  LineReader& output() { return m_output; }
+  LineReader& errors() { return m_errors; }
+
+private:
+  ProjectBuild* m_build;
+  ProjectBuild::Job m_job;
+  long m_pid;
+  LineReader m_output;
+  LineReader m_errors;
+};
+
+namespace {
+
+/// file, which may be relative to workspace, as a full path.
+wxString in_workspace(const wxString& workspace, const wxString& file)
 {
-  wxConfig config(wxT("shrike"));
+  wxFileName name(file);
+  name.MakeAbsolute(workspace);
+  return name.GetFullPath();
+}
 
-  wxString value;
-  if (!config.Read(wxT("Build/Compiler"), &value)) 
+wxString read_file(const wxString& path)
+{
+  wxString text;
+  if (wxFileExists(path)) {
+    wxFFile file(path);
+    if (file.IsOpened()) file.ReadAll(&text);
+  }
+  return text;
+}
+
+void write_file(const wxString& path, const wxString& text)
+{
+  wxFFile file(path, wxT("w"));
+  if (file.IsOpened()) file.Write(text);
+}
+
+/// The prerequisites of the make rule the compiler writes for -MD.
+void read_dependencies(const wxString& rule, wxArrayString& files)
+{
+  int colon = rule.Find(wxT(": "));
+  if (colon == wxNOT_FOUND) return;
+
+  wxString file;
+  for (size_t i = colon + 2; i < rule.Len(); ++i) {
+    wxChar c = rule[i];
+    wxChar next = i + 1 < rule.Len() ? rule[i + 1] : wxT('\0');
+    if (c == wxT('\\') && (next == wxT(' ') || next == wxT('#'))) {
+      file += next;
+      ++i;
+    } else if (c == wxT('$') && next == wxT('$')) {
+      file += c;
+      ++i;
+    } else if (c == wxT(' ') || c == wxT('\t') || c == wxT('\r') || c == wxT('\n')
+               || (c == wxT('\\') && (next == wxT('\r') || next == wxT('\n')))) {
+      if (!file.IsEmpty()) files.Add(file);
+      file.Clear();
+    } else {
+      file += c;
+    }
+  }
+  if (!file.IsEmpty()) files.Add(file);
+}
+
+/// Whether output was made by command (as recorded in record) and is
+/// newer than every one of inputs.
+bool up_to_date(const wxString& workspace, const wxString& output,
+                const wxArrayString& inputs, const wxString& record,
+                const wxString& command)
+{
+  wxString path = in_workspace(workspace, output);
+  if (inputs.IsEmpty() || !wxFileExists(path)) return false;
+  if (read_file(in_workspace(workspace, record)) != command) return false;
+
+  time_t built = wxFileModificationTime(path);
+  for (size_t i = 0; i < inputs.GetCount(); ++i) {
+    wxString input = in_workspace(workspace, inputs[i]);
+    if (!wxFileExists(input) || wxFileModificationTime(input) > built) return false;
+  }
+  return true;
+}
+
+/// The name, without extension, of source's object: its path in
+/// workspace with the directories joined by _, so sources with the same
+/// name in different directories get objects of their own.
+wxString object_name(const wxString& workspace, const wxString& source)
+{
+  wxFileName name(source);
+  if (name.IsAbsolute()) name.MakeRelativeTo(workspace);
+  wxString path = name.GetPath(wxPATH_GET_SEPARATOR, wxPATH_UNIX) + name.GetName();
+  path.Replace(wxT("/"), wxT("_"));
+  path.Replace(wxT(":"), wxT("_"));
+  return path;
+}
+
+/// Whether a flag only matters to the linker, and so is left off
+/// compiler command lines.
+bool link_only(const wxString& flag)
+{
+  return flag.StartsWith(wxT("-l")) || flag.StartsWith(wxT("-L"))
+    || flag.StartsWith(wxT("-Wl,")) || flag == wxT("-shared") || flag == wxT("-static");
+}
+
+}
+
+BEGIN_EVENT_TABLE(ProjectBuild, wxEvtHandler)
+  EVT_TIMER(-1, ProjectBuild::on_timer)
+END_EVENT_TABLE()
+
+ProjectBuild::ProjectBuild(wxListBox* output, BuildListener* listener)
+  : m_output(output),
+    m_listener(listener),
+    m_timer(this),
+    m_project(0),
+    m_link_needed(false), m_linking(false), m_failed(false),
+    m_jobs(1), m_compiled(0), m_sources(0)
+{
+}
+
+ProjectBuild::~ProjectBuild()
+{
+  kill();
+}
+
+bool ProjectBuild::start(Project* project)
+{
+  SHRIKE_TRACE_ZONE("ProjectBuild::start");
+  if (running()) return false;
+
+  wxConfig config(wxT("shrike"));
+  wxString compiler;
+  if (!config.Read(wxT("Build/Compiler"), &compiler)) {
+    message(wxT("There are no build settings yet, see Project > Build Settings"));
     return false;
-  wxString cmd = value + wxT(" -o ") + project.target()+wxDynamicLibrary::GetDllExt();
-  // add sources
-  for (Project::FileList::const_iterator I = project.begin_sources(); I != project.end_sources(); ++I) {
-    wxFileName fn(*I);
-    if (fn.GetExt() == wxT("cpp"))
-      cmd += wxT(" ")+*I;
   }
-  // add include paths
+
+  wxString value, includes, libraries, compile_flags, link_flags;
   if (config.Read(wxT("Build/IncludePaths"), &value)) {
     wxStringTokenizer tok(value, wxT(";"));
     while (tok.HasMoreTokens())
-      cmd += wxT(" -I")+tok.GetNextToken();
+      includes += wxT(" -I")+tok.GetNextToken();
   }
-  // add library paths 
   if (config.Read(wxT("Build/LibraryPaths"), &value)) {
     wxStringTokenizer tok(value, wxT(";"));
     while (tok.HasMoreTokens())
-      cmd += wxT(" -L")+tok.GetNextToken();
+      libraries += wxT(" -L")+tok.GetNextToken();
+  }
+  if (config.Read(wxT("Build/Flags"), &value)) {
+    wxStringTokenizer tok(value, wxT(" \t\r\n"));
+    while (tok.HasMoreTokens()) {
+      wxString flag = tok.GetNextToken();
+      if (!link_only(flag)) compile_flags += wxT(" ") + flag;
+      link_flags += wxT(" ") + flag;
+    }
+  }
+  long jobs = 0;
+  config.Read(wxT("Build/Jobs"), &jobs);
+  if (jobs <= 0) jobs = wxThread::GetCPUCount();
+  if (jobs <= 0) jobs = 2;
+
+  // Objects of different projects in one workspace are kept apart
+  wxString objects = wxString(wxT("obj")) + wxFILE_SEP_PATH + project->target() + wxFILE_SEP_PATH;
+  wxFileName dir(in_workspace(project->workspace(), objects));
+  if (!dir.DirExists() && !dir.Mkdir(0777, wxPATH_MKDIR_FULL)) {
+    message(wxT("Could not make ") + dir.GetPath());
+    return false;
+  }
+
+  m_pending.clear();
+  m_sources = 0;
+  wxArrayString linked;
+  wxString link_objects;
+  for (Project::FileList::const_iterator I = project->begin_sources(); I != project->end_sources(); ++I) {
+    wxFileName fn(*I);
+    if (fn.GetExt() != wxT("cpp")) continue;
+    ++m_sources;
+
+    wxString name = objects + object_name(project->workspace(), *I);
+    wxString object = name + wxT(".o");
+    wxString depends = name + wxT(".d");
+    Job job;
+    job.description = wxT("Compiling ") + *I;
+    job.command = compiler + wxT(" -c -MD -MF ") + depends + wxT(" -o ") + object
+      + wxT(" ") + *I + includes + compile_flags;
+    job.record = object + wxT(".cmd");
+
+    wxArrayString headers;
+    read_dependencies(read_file(in_workspace(project->workspace(), depends)), headers);
+    if (!up_to_date(project->workspace(), object, headers, job.record, job.command)) {
+      m_pending.push_back(job);
+    }
+    linked.Add(object);
+    link_objects += wxT(" ") + object;
   }
-  if (config.Read(wxT("Build/Flags"), &value))
-    cmd += wxT(" ") + value;
+
+  wxString target = project->target() + wxDynamicLibrary::GetDllExt();
+  m_link.description = wxT("Linking ") + target;
+  m_link.command = compiler + wxT(" -o ") + target + link_objects + libraries + link_flags;
+  m_link.record = objects + wxT("link.cmd");
+  m_link_needed = !up_to_date(project->workspace(), target, linked, m_link.record, m_link.command);
+
+  m_project = project;
+  m_jobs = jobs;
+  m_compiled = 0;
+  m_linking = false;
+  m_failed = false;
+  m_start = ShTimer::now();
+  message(wxString::Format(wxT("Building %s: %lu of %u sources out of date, %ld jobs at once..."),
+                           project->name().c_str(), (unsigned long)m_pending.size(),
+                           m_sources, jobs));
+  m_timer.Start(100);
+  schedule();
+  return true;
+}
+
+void ProjectBuild::cancel()
+{
+  if (!running()) return;
+  kill();
+  message(wxT("Build cancelled"));
+}
+
+void ProjectBuild::kill()
+{
+  m_timer.Stop();
+  for (std::list<BuildProcess*>::iterator I = m_running.begin(); I != m_running.end(); ++I) {
+    (*I)->detach();
+    wxProcess::Kill((*I)->pid(), wxSIGKILL, wxKILL_CHILDREN);
+  }
+  m_running.clear();
+  m_pending.clear();
+  m_project = 0;
+}
+
+void ProjectBuild::on_timer(wxTimerEvent& event)
+{
+  for (std::list<BuildProcess*>::iterator I = m_running.begin(); I != m_running.end(); ++I) {
+    drain(*I);
+  }
+}
+
+void ProjectBuild::schedule()
+{
+  while (!m_failed && !m_pending.empty() && m_running.size() < m_jobs) {
+    Job job = m_pending.front();
+    m_pending.pop_front();
+    if (launch(job)) ++m_compiled;
+    else m_failed = true;
+  }
+  if (!m_running.empty()) return;
+
+  if (m_failed || m_linking) {
+    done(!m_failed);
+  } else if (m_link_needed || m_compiled > 0) {
+    m_linking = true;
+    if (!launch(m_link)) done(false);
+  } else {
+    done(true);
+  }
+}
+
+bool ProjectBuild::launch(const Job& job)
+{
+  message(job.description);
+  BuildProcess* process = new BuildProcess(this, job);
 
   wxString cwd = wxFileName::GetCwd();
-  wxFileName::SetCwd(project.workspace()); 
-  BuildProcess* process = new BuildProcess();
-  process->status(wxExecute(cmd, wxEXEC_SYNC, process));
+  wxFileName::SetCwd(m_project->workspace());
+  long pid = wxExecute(job.command, wxEXEC_ASYNC, process);
   wxFileName::SetCwd(cwd);
-  return process;
+  if (!pid) {
+    delete process;
+    message(wxT("Could not run ") + job.command);
+    return false;
+  }
+  process->pid(pid);
+  m_running.push_back(process);
+  return true;
+}
+
+void ProjectBuild::drain(BuildProcess* process, bool end)
+{
+  std::vector<wxString> lines;
+  process->output().read(process->GetInputStream(), lines, end);
+  process->errors().read(process->GetErrorStream(), lines, end);
+  for (std::size_t i = 0; i < lines.size(); ++i) message(lines[i]);
+}
+
+void ProjectBuild::finished(BuildProcess* process, int status)
+{
+  drain(process, true);
+  m_running.remove(process);
+  if (status == 0) {
+    write_file(in_workspace(m_project->workspace(), process->job().record),
+               process->job().command);
+  } else {
+    m_failed = true;
+  }
+  schedule();
+}
+
+void ProjectBuild::done(bool success)
+{
+  m_timer.Stop();
+  m_pending.clear();
+  double seconds = (ShTimer::now() - m_start).value() / 1000.0;
+  if (success) {
+    message(wxString::Format(wxT("Build successful in %.1f s, %u of %u sources compiled"),
+                             seconds, m_compiled, m_sources));
+  } else {
+    message(wxString::Format(wxT("Build failed after %.1f s"), seconds));
+  }
+
+  Project* project = m_project;
+  m_project = 0;
+  m_listener->build_finished(project, success);
+}
+
+void ProjectBuild::message(const wxString& text)
+{
+  m_output->Insert(text, m_output->GetCount());
 }
@@ -20,9 +20,13 @@
 #ifndef BUILD_HPP
 #define BUILD_HPP
 
+#include <list>
 #include <wx/wx.h>
 #include <wx/process.h>
 #include "Project.hpp"
+#include "Timer.hpp"
+
+class wxSpinCtrl;
 
 class BuildPanel : public wxPanel
 {
@@ -43,36 +47,91 @@ private:
   wxSizer* create_includes();
   wxSizer* create_libraries();
   wxSizer* create_flags();
+  wxSizer* create_jobs();
 
   wxTextCtrl* m_compiler;
   wxListBox* m_includes;
   wxListBox* m_libraries;
   wxTextCtrl* m_flags;
+  wxSpinCtrl* m_jobs;
 
   DECLARE_EVENT_TABLE();
 };
 
-class BuildProcess : public wxProcess
-{
+class BuildProcess;
+
+/// Told when a ProjectBuild is done.
+class BuildListener {
 public:
-  BuildProcess() : wxProcess()
-  {
-    Redirect();
-  }
-
-  void OnTerminate(int pid, int status)
-  {
-    m_pid = pid;
-    m_status = status;
-  }
-
-  int pid() const { return m_pid; }
-  int status() const { return m_status; }
-  void status(int status) { m_status = status; }
-private:
-  int m_pid, m_status;
+  virtual ~BuildListener() {}
+  /// project was built, successfully or not.  Not called if the build
+  /// was cancelled.
+  virtual void build_finished(Project* project, bool success) = 0;
 };
 
-BuildProcess* build_project(const Project& project);
+/** Builds a project's shader library in the background.  Each source
+ * is compiled to its own object under obj/TARGET in the workspace,
+ * with the compiler writing the headers it read to a .d file next to
+ * it.  A source is only compiled again when it, one of those headers
+ * or its command line has changed, and the library only linked again
+ * when an object or the link command has.
+ *
+ * Up to Build/Jobs compilers run at once (one per processor if that is
+ * 0).  Their output goes to the output list box as it comes, and the
+ * GUI keeps running meanwhile.  Deleting the build kills any compilers
+ * still running.
+ */
+class ProjectBuild : public wxEvtHandler {
+public:
+  ProjectBuild(wxListBox* output, BuildListener* listener);
+  ~ProjectBuild();
+
+  /// Start building project with the settings in the Build config
+  /// group.  Returns false if a build is already running or there are
+  /// no settings; otherwise the listener hears how it went, possibly
+  /// before this returns if everything is up to date.
+  bool start(Project* project);
+  /// Kill the running compilers, without telling the listener.
+  void cancel();
+
+  bool running() const { return m_project != 0; }
+  /// The project being built, or null.
+  Project* project() const { return m_project; }
+
+private:
+  struct Job {
+    wxString description;
+    wxString command;
+    wxString record; // command is written here once it succeeds
+  };
+
+  void on_timer(wxTimerEvent& event);
+  void schedule();
+  void kill();
+  bool launch(const Job& job);
+  void drain(BuildProcess* process, bool end = false);
+  void finished(BuildProcess* process, int status);
+  void done(bool success);
+  void message(const wxString& text);
+
+  wxListBox* m_output;
+  BuildListener* m_listener;
+  wxTimer m_timer;
+
+  Project* m_project;
+  std::list<Job> m_pending;
+  std::list<BuildProcess*> m_running;
+  Job m_link;
+  bool m_link_needed;
+  bool m_linking;
+  bool m_failed;
+  unsigned int m_jobs;
+  unsigned int m_compiled;
+  unsigned int m_sources;
+  ShTimer m_start;
+
+  friend class BuildProcess;
+  DECLARE_EVENT_TABLE()
+};
 
 #endif
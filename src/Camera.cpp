@@ -33,7 +33,7 @@ using namespace SH;
 
 Camera::Camera()
 {
-  proj = perspective(45, 1, 1, 3000);
+  proj = perspective(fov(), 1, 1, 3000);
 }
 
 void printMatrix(std::ostream& out, const ShMatrix4x4f& mat)
@@ -77,7 +77,7 @@ void Camera::glModelView()
 
 void Camera::glProjection(float aspect)
 {
-  proj = perspective(45, aspect, 1, 3000);
+  proj = perspective(fov(), aspect, 1, 3000);
   float values[16];
   for (int i = 0; i < 16; i++) proj[i%4](i/4).getValues(&values[i]);
   glMultMatrixf(values);
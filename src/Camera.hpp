@@ -33,6 +33,9 @@ public:
   void glModelView();
   void glProjection(float aspect);
 
+  /// Vertical field of view, in degrees.
+  float fov() const { return 45; }
+
   SH::ShMatrix4x4f shModelView();
   SH::ShMatrix4x4f shModelViewProjection(SH::ShMatrix4x4f viewport);
 
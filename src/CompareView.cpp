@@ -0,0 +1,225 @@
+// Sh: A GPU metaprogramming language.
+//
+// Copyright 2003-2005 Serious Hack Inc.
+// 
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, 
+// MA  02110-1301, USA
+//////////////////////////////////////////////////////////////////////////////
+#include <cmath>
+#include "ShrikeGl.hpp"
+#include "Trace.hpp"
+#include "CompareView.hpp"
+
+namespace {
+
+// Differences are scaled up by 2^DIFFERENCE_DOUBLINGS.
+const int DIFFERENCE_DOUBLINGS = 3;
+
+int next_power_of_two(int n)
+{
+  int p = 1;
+  while (p < n) p *= 2;
+  return p;
+}
+
+}
+
+CompareView::CompareView()
+  : m_difference(false),
+    m_supported(-1),
+    m_texture_w(0), m_texture_h(0),
+    m_columns(1), m_rows(1),
+    m_cell_w(0), m_cell_h(0),
+    m_height(0)
+{
+  for (int i = 0; i < 3; i++) m_textures[i] = 0;
+}
+
+CompareView::~CompareView()
+{
+  for (std::size_t i = 0; i < m_timers.size(); i++) {
+    delete m_timers[i];
+  }
+}
+
+void CompareView::set_shaders(const std::vector<Shader*>& shaders)
+{
+  m_shaders = shaders;
+  if (m_shaders.size() > MAX_SHADERS) m_shaders.resize(MAX_SHADERS);
+  if (m_shaders.size() < 2) m_shaders.clear();
+
+  // Timings are per shader, so start over
+  for (std::size_t i = 0; i < m_timers.size(); i++) {
+    m_timers[i]->reset();
+  }
+  while (m_timers.size() < m_shaders.size()) {
+    m_timers.push_back(new FrameTimer());
+  }
+}
+
+bool CompareView::difference() const
+{
+  return m_difference && m_supported != 0;
+}
+
+int CompareView::viewports() const
+{
+  return m_shaders.size() + (difference() ? 1 : 0);
+}
+
+void CompareView::layout(int width, int height)
+{
+  int n = viewports();
+  m_columns = (int)std::ceil(std::sqrt((float)n));
+  m_rows = (n + m_columns - 1) / m_columns;
+  m_cell_w = width / m_columns;
+  m_cell_h = height / m_rows;
+  m_height = height;
+}
+
+void CompareView::viewport(int i, int& x, int& y, int& w, int& h) const
+{
+  // Left to right, top to bottom
+  x = (i % m_columns) * m_cell_w;
+  y = m_height - (i / m_columns + 1) * m_cell_h;
+  w = m_cell_w;
+  h = m_cell_h;
+}
+
+void CompareView::render(ViewportRenderer& renderer, int width, int height)
+{
+  SHRIKE_TRACE_ZONE("CompareView::render");
+
+  if (m_difference && m_supported < 0) {
+    m_supported = shrikeGlHasExtension("GL_EXT_blend_subtract")
+      && shrikeGlHasExtension("GL_EXT_blend_minmax");
+  }
+
+  layout(width, height);
+  if (m_cell_w <= 0 || m_cell_h <= 0) return;
+
+  // The grid may not cover the window exactly
+  glViewport(0, 0, width, height);
+  glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+  glEnable(GL_SCISSOR_TEST);
+  for (std::size_t i = 0; i < m_shaders.size(); i++) {
+    int x, y, w, h;
+    viewport(i, x, y, w, h);
+    glViewport(x, y, w, h);
+    glScissor(x, y, w, h);
+
+    m_timers[i]->begin();
+    renderer.renderViewport(m_shaders[i], w, h);
+    m_timers[i]->end();
+
+    if (i < 2 && difference()) copy(i);
+  }
+  if (difference()) render_difference();
+  glDisable(GL_SCISSOR_TEST);
+}
+
+void CompareView::copy(int i)
+{
+  int w = next_power_of_two(m_cell_w);
+  int h = next_power_of_two(m_cell_h);
+  if (!m_textures[0] || w != m_texture_w || h != m_texture_h) {
+    if (!m_textures[0]) glGenTextures(3, m_textures);
+    for (int t = 0; t < 3; t++) {
+      glBindTexture(GL_TEXTURE_2D, m_textures[t]);
+      glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+      glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+      glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB8, w, h, 0, GL_RGB, GL_UNSIGNED_BYTE, 0);
+    }
+    m_texture_w = w;
+    m_texture_h = h;
+  }
+
+  int x, y;
+  viewport(i, x, y, w, h);
+  glBindTexture(GL_TEXTURE_2D, m_textures[i]);
+  glCopyTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, x, y, w, h);
+}
+
+void CompareView::draw_quad(unsigned int texture)
+{
+  float s = (float)m_cell_w/m_texture_w;
+  float t = (float)m_cell_h/m_texture_h;
+  if (texture) glBindTexture(GL_TEXTURE_2D, texture);
+  glBegin(GL_QUADS); {
+    glTexCoord2f(0.0, 0.0);
+    glVertex2f(-1.0, -1.0);
+    glTexCoord2f(s, 0.0);
+    glVertex2f(1.0, -1.0);
+    glTexCoord2f(s, t);
+    glVertex2f(1.0, 1.0);
+    glTexCoord2f(0.0, t);
+    glVertex2f(-1.0, 1.0);
+  } glEnd();
+}
+
+void CompareView::render_difference()
+{
+  int x, y, w, h;
+  viewport(m_shaders.size(), x, y, w, h);
+  glViewport(x, y, w, h);
+  glScissor(x, y, w, h);
+
+  glPushAttrib(GL_ENABLE_BIT | GL_COLOR_BUFFER_BIT | GL_POLYGON_BIT
+               | GL_TEXTURE_BIT | GL_CURRENT_BIT);
+  glMatrixMode(GL_PROJECTION);
+  glPushMatrix();
+  glLoadIdentity();
+  glMatrixMode(GL_MODELVIEW);
+  glPushMatrix();
+  glLoadIdentity();
+
+  glActiveTextureARB(GL_TEXTURE0_ARB);
+  glDisable(GL_DEPTH_TEST);
+  glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
+  glEnable(GL_TEXTURE_2D);
+  glTexEnvi(GL_TEXTURE_ENV, GL_TEXTURE_ENV_MODE, GL_REPLACE);
+  glBlendFunc(GL_ONE, GL_ONE);
+
+  // Blending clamps at 0, so each way round gives half of |a - b|.
+  // a - b goes to a texture while b - a is drawn.
+  glDisable(GL_BLEND);
+  draw_quad(m_textures[0]);
+  glEnable(GL_BLEND);
+  glBlendEquationEXT(GL_FUNC_REVERSE_SUBTRACT_EXT);
+  draw_quad(m_textures[1]);
+  glBindTexture(GL_TEXTURE_2D, m_textures[2]);
+  glCopyTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, x, y, w, h);
+
+  glDisable(GL_BLEND);
+  draw_quad(m_textures[1]);
+  glEnable(GL_BLEND);
+  draw_quad(m_textures[0]);
+
+  glBlendEquationEXT(GL_FUNC_ADD_EXT);
+  draw_quad(m_textures[2]);
+
+  // Drawing white with (dst, 1) doubles what is there
+  glDisable(GL_TEXTURE_2D);
+  glBlendFunc(GL_DST_COLOR, GL_ONE);
+  glColor3f(1.0, 1.0, 1.0);
+  for (int i = 0; i < DIFFERENCE_DOUBLINGS; i++) draw_quad(0);
+
+  glPopMatrix();
+  glMatrixMode(GL_PROJECTION);
+  glPopMatrix();
+  glMatrixMode(GL_MODELVIEW);
+  glPopAttrib();
+}
@@ -0,0 +1,103 @@
+// Sh: A GPU metaprogramming language.
+//
+// Copyright 2003-2005 Serious Hack Inc.
+// 
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, 
+// MA  02110-1301, USA
+//////////////////////////////////////////////////////////////////////////////
+#ifndef COMPAREVIEW_HPP
+#define COMPAREVIEW_HPP
+
+#include <vector>
+#include "FrameTimer.hpp"
+
+class Shader;
+
+/// Something that can draw the scene under a given shader.
+class ViewportRenderer {
+public:
+  virtual ~ViewportRenderer() {}
+
+  /// Draw the scene with shader into the current w by h viewport.
+  virtual void renderViewport(Shader* shader, int w, int h) = 0;
+};
+
+/** Draws the scene under several shaders side by side, in a grid of
+ * viewports in one frame, to compare them.  Each viewport is timed
+ * with its own FrameTimer.
+ *
+ * An extra viewport can show the difference between the first two
+ * shaders: both viewports are copied to textures, and |a - b| is
+ * worked out with subtractive blending and scaled up so that small
+ * differences show.  That needs EXT_blend_subtract.
+ *
+ * Needs the GL context to be current for everything except
+ * construction and set_shaders().
+ */
+class CompareView {
+public:
+  CompareView();
+  ~CompareView();
+
+  enum { MAX_SHADERS = 16 };
+
+  /// Compare shaders, which must be compiled already.  Fewer than two
+  /// turns comparing off.
+  void set_shaders(const std::vector<Shader*>& shaders);
+  const std::vector<Shader*>& shaders() const { return m_shaders; }
+
+  /// Whether there is anything to compare.
+  bool active() const { return m_shaders.size() > 1; }
+
+  void show_difference(bool show) { m_difference = show; }
+  /// Whether the difference viewport is shown.  False if the GL can't
+  /// draw it.
+  bool difference() const;
+
+  /// Draw every viewport into the width by height framebuffer.
+  /// Leaves the viewport and the view uniforms set for the last one.
+  void render(ViewportRenderer& renderer, int width, int height);
+
+  /// Number of viewports drawn by the last render(), and where they
+  /// are.  The difference viewport, if any, is the last.
+  int viewports() const;
+  void viewport(int i, int& x, int& y, int& w, int& h) const;
+
+  const FrameTimer& timer(int i) const { return *m_timers[i]; }
+
+private:
+  void layout(int width, int height);
+  void copy(int i);
+  void render_difference();
+  void draw_quad(unsigned int texture);
+
+  std::vector<Shader*> m_shaders;
+  std::vector<FrameTimer*> m_timers;
+
+  bool m_difference;
+  int m_supported; // -1 until checked
+  unsigned int m_textures[3]; // a, b and a - b
+  int m_texture_w, m_texture_h;
+
+  int m_columns, m_rows;
+  int m_cell_w, m_cell_h;
+  int m_height;
+
+  // NOT IMPLEMENTED
+  CompareView(const CompareView&);
+  CompareView& operator=(const CompareView&);
+};
+
+#endif
@@ -0,0 +1,123 @@
+// Sh: A GPU metaprogramming language.
+//
+// Copyright 2003-2005 Serious Hack Inc.
+// 
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, 
+// MA  02110-1301, USA
+//////////////////////////////////////////////////////////////////////////////
+#include "ShrikeGl.hpp"
+#include "Shader.hpp"
+#include "CostPanel.hpp"
+
+namespace {
+
+enum Row {
+  ROW_INSTRUCTIONS,
+  ROW_ALU,
+  ROW_TEX,
+  ROW_TEMPORARIES,
+  ROW_PARAMETERS,
+  ROW_ATTRIBUTES,
+  ROW_UNIFORMS,
+  ROW_CONSTANTS,
+  ROW_BRANCHES,
+  ROW_LOOPS,
+  ROW_NATIVE,
+  ROW_COUNT
+};
+
+const wxChar* row_names[ROW_COUNT] = {
+  wxT("Instructions"),
+  wxT("ALU instructions"),
+  wxT("Texture instructions"),
+  wxT("Temporaries"),
+  wxT("Parameters"),
+  wxT("Attributes"),
+  wxT("Uniforms"),
+  wxT("Constants"),
+  wxT("Branches"),
+  wxT("Loops"),
+  wxT("Fits the hardware")
+};
+
+wxString format(const ProgramCost& cost, ProgramCost::Counter counter)
+{
+  if (!cost.valid) return wxT("");
+  if (!cost.limit[counter]) return wxString::Format(wxT("%d"), cost.used[counter]);
+  return wxString::Format(wxT("%d / %d"), cost.used[counter], cost.limit[counter]);
+}
+
+}
+
+CostPanel::CostPanel(wxWindow* parent)
+  : wxListCtrl(parent, -1, wxDefaultPosition, wxDefaultSize,
+               wxLC_REPORT | wxLC_SINGLE_SEL)
+{
+  InsertColumn(0, wxT("Cost"));
+  InsertColumn(1, wxT("Vertex"));
+  InsertColumn(2, wxT("Fragment"));
+  for (int row = 0; row < ROW_COUNT; row++) {
+    InsertItem(row, row_names[row]);
+  }
+  SetColumnWidth(0, wxLIST_AUTOSIZE);
+}
+
+void CostPanel::setShader(Shader* shader)
+{
+  m_vertex = ProgramCost();
+  m_fragment = ProgramCost();
+  if (shader) {
+    m_vertex.measure(GL_VERTEX_PROGRAM_ARB);
+    m_fragment.measure(GL_FRAGMENT_PROGRAM_ARB);
+  }
+
+  show(ROW_INSTRUCTIONS, ProgramCost::INSTRUCTIONS);
+  show(ROW_ALU, ProgramCost::ALU_INSTRUCTIONS);
+  show(ROW_TEX, ProgramCost::TEX_INSTRUCTIONS);
+  show(ROW_TEMPORARIES, ProgramCost::TEMPORARIES);
+  show(ROW_PARAMETERS, ProgramCost::PARAMETERS);
+  show(ROW_ATTRIBUTES, ProgramCost::ATTRIBUTES);
+  show(ROW_UNIFORMS, m_vertex.uniforms, m_fragment.uniforms);
+  show(ROW_CONSTANTS, m_vertex.constants, m_fragment.constants);
+  show(ROW_BRANCHES, m_vertex.branches, m_fragment.branches);
+  show(ROW_LOOPS, m_vertex.loops, m_fragment.loops);
+
+  const ProgramCost* costs[] = { &m_vertex, &m_fragment };
+  bool native = true;
+  for (int i = 0; i < 2; i++) {
+    wxString text;
+    if (costs[i]->valid) text = costs[i]->native ? wxT("yes") : wxT("no");
+    SetItem(ROW_NATIVE, i + 1, text);
+    native = native && (!costs[i]->valid || costs[i]->native);
+  }
+  SetItemTextColour(ROW_NATIVE, native ? GetTextColour() : *wxRED);
+
+  SetColumnWidth(1, wxLIST_AUTOSIZE_USEHEADER);
+  SetColumnWidth(2, wxLIST_AUTOSIZE_USEHEADER);
+}
+
+void CostPanel::show(int row, ProgramCost::Counter counter)
+{
+  SetItem(row, 1, format(m_vertex, counter));
+  SetItem(row, 2, format(m_fragment, counter));
+  bool near = m_vertex.near_limit(counter) || m_fragment.near_limit(counter);
+  SetItemTextColour(row, near ? *wxRED : GetTextColour());
+}
+
+void CostPanel::show(int row, int vertex, int fragment)
+{
+  SetItem(row, 1, m_vertex.valid ? wxString::Format(wxT("%d"), vertex) : wxString());
+  SetItem(row, 2, m_fragment.valid ? wxString::Format(wxT("%d"), fragment) : wxString());
+}
@@ -0,0 +1,52 @@
+// Sh: A GPU metaprogramming language.
+//
+// Copyright 2003-2005 Serious Hack Inc.
+// 
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, 
+// MA  02110-1301, USA
+//////////////////////////////////////////////////////////////////////////////
+#ifndef COSTPANEL_HPP
+#define COSTPANEL_HPP
+
+#include <wx/wx.h>
+#include <wx/listctrl.h>
+#include "ProgramCost.hpp"
+
+class Shader;
+
+/// A table of what the bound vertex and fragment programs cost, see
+/// ProgramCost.  Rows close to a hardware limit are shown in red.
+class CostPanel : public wxListCtrl {
+public:
+  CostPanel(wxWindow* parent);
+
+  /// Show the cost of shader, or nothing if it's 0.  Measures the
+  /// programs bound in the current context, so call it right after
+  /// binding shader.
+  void setShader(Shader* shader);
+
+private:
+  void show(int row, ProgramCost::Counter counter);
+  void show(int row, int vertex, int fragment);
+
+  ProgramCost m_vertex;
+  ProgramCost m_fragment;
+
+  // NOT IMPLEMENTED
+  CostPanel(const CostPanel&);
+  CostPanel& operator=(const CostPanel&);
+};
+
+#endif
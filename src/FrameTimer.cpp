@@ -0,0 +1,155 @@
+// Sh: A GPU metaprogramming language.
+//
+// Copyright 2003-2005 Serious Hack Inc.
+// 
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, 
+// MA  02110-1301, USA
+//////////////////////////////////////////////////////////////////////////////
+#include "ShrikeGl.hpp"
+#include "FrameTimer.hpp"
+
+FrameTimer::FrameTimer(std::size_t window)
+  : m_init(false),
+    m_supported(false),
+    m_next(0),
+    m_oldest(0),
+    m_stale(0),
+    m_active(false),
+    m_window(window)
+{
+  for (int i = 0; i < RING_SIZE; ++i) {
+    m_queries[i] = 0;
+    m_pending[i] = false;
+  }
+}
+
+FrameTimer::~FrameTimer()
+{
+  // The context may be gone by now, so the queries are left to
+  // release().
+}
+
+void FrameTimer::init()
+{
+  if (m_init) return;
+  m_init = true;
+
+#ifdef GL_EXT_timer_query
+  m_supported = (shrikeGlHasExtension("GL_EXT_timer_query") || shrikeGlHasExtension("GL_ARB_timer_query"))
+#ifdef WIN32
+    && glGenQueriesARB && glGetQueryObjectui64vEXT
+#endif
+    ;
+  if (m_supported) {
+    glGenQueriesARB(RING_SIZE, m_queries);
+  }
+#endif
+}
+
+void FrameTimer::begin()
+{
+  init();
+  collect();
+
+  m_active = false;
+#ifdef GL_EXT_timer_query
+  // If every query is still in flight the GPU is more than RING_SIZE
+  // frames behind; skip this frame rather than wait for it.
+  if (m_supported && !m_pending[m_next]) {
+    glBeginQueryARB(GL_TIME_ELAPSED_EXT, m_queries[m_next]);
+    m_active = true;
+  }
+#endif
+
+  m_start = ShTimer::now();
+}
+
+void FrameTimer::end()
+{
+  ShTimer elapsed = ShTimer::now() - m_start;
+
+#ifdef GL_EXT_timer_query
+  if (m_active) {
+    glEndQueryARB(GL_TIME_ELAPSED_EXT);
+    m_pending[m_next] = true;
+    m_next = (m_next + 1) % RING_SIZE;
+    m_active = false;
+  }
+#endif
+
+  add(m_cpu_samples, m_cpu, elapsed.value());
+}
+
+void FrameTimer::collect()
+{
+#ifdef GL_EXT_timer_query
+  // Queries finish in the order they were issued, so stop at the
+  // first one that is not ready yet.
+  while (m_pending[m_oldest]) {
+    GLint available = 0;
+    glGetQueryObjectivARB(m_queries[m_oldest], GL_QUERY_RESULT_AVAILABLE_ARB, &available);
+    if (!available) break;
+
+    GLuint64EXT ns = 0;
+    glGetQueryObjectui64vEXT(m_queries[m_oldest], GL_QUERY_RESULT_ARB, &ns);
+    if (m_stale > 0) {
+      --m_stale;
+    } else {
+      add(m_gpu_samples, m_gpu, ns / 1.0e6);
+    }
+
+    m_pending[m_oldest] = false;
+    m_oldest = (m_oldest + 1) % RING_SIZE;
+  }
+#endif
+}
+
+void FrameTimer::add(std::deque<float>& samples, TimingStats& stats, float ms)
+{
+  samples.push_back(ms);
+  while (samples.size() > m_window) samples.pop_front();
+  stats.compute(std::vector<float>(samples.begin(), samples.end()));
+}
+
+void FrameTimer::reset()
+{
+  // Queries still in flight belong to the old samples; drop them as
+  // they come back instead of waiting for them here.
+  m_stale = 0;
+  for (int i = 0; i < RING_SIZE; ++i) {
+    if (m_pending[i]) ++m_stale;
+  }
+
+  m_cpu_samples.clear();
+  m_gpu_samples.clear();
+  m_cpu = TimingStats();
+  m_gpu = TimingStats();
+}
+
+void FrameTimer::release()
+{
+#ifdef GL_EXT_timer_query
+  if (m_supported) {
+    glDeleteQueriesARB(RING_SIZE, m_queries);
+  }
+#endif
+  for (int i = 0; i < RING_SIZE; ++i) {
+    m_queries[i] = 0;
+    m_pending[i] = false;
+  }
+  m_next = m_oldest = m_stale = 0;
+  m_init = false;
+  m_supported = false;
+}
@@ -0,0 +1,85 @@
+// Sh: A GPU metaprogramming language.
+//
+// Copyright 2003-2005 Serious Hack Inc.
+// 
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, 
+// MA  02110-1301, USA
+//////////////////////////////////////////////////////////////////////////////
+#ifndef FRAMETIMER_HPP
+#define FRAMETIMER_HPP
+
+#include <deque>
+#include "Timer.hpp"
+
+/** Times frames without stalling the pipeline.
+ * CPU time is the time spent submitting a frame, between begin() and
+ * end().  GPU time comes from GL_TIME_ELAPSED queries kept in a small
+ * ring; a query is only read back once the GL reports its result as
+ * available, which is usually a couple of frames later.
+ *
+ * Both are kept over a rolling window of the last few frames, in
+ * milliseconds.  Needs a current GL context for everything except
+ * construction.
+ */
+class FrameTimer {
+public:
+  FrameTimer(std::size_t window = 120);
+  ~FrameTimer();
+
+  void begin();
+  void end();
+
+  /// Forget all samples, e.g. when the shader changes.
+  void reset();
+
+  /// Delete the query objects.
+  void release();
+
+  /// False if the GL has no timer queries.  gpu() stays empty then.
+  bool gpuTimed() const { return m_supported; }
+
+  const TimingStats& cpu() const { return m_cpu; }
+  const TimingStats& gpu() const { return m_gpu; }
+
+private:
+  void init();
+  void collect();
+  void add(std::deque<float>& samples, TimingStats& stats, float ms);
+
+  enum { RING_SIZE = 4 };
+
+  bool m_init;
+  bool m_supported;
+  unsigned int m_queries[RING_SIZE];
+  bool m_pending[RING_SIZE];
+  unsigned int m_next; // slot of the next query to issue
+  unsigned int m_oldest; // oldest slot that may still be pending
+  unsigned int m_stale; // pending queries issued before the last reset()
+  bool m_active; // a query was started by the current begin()
+
+  ShTimer m_start;
+
+  std::size_t m_window;
+  std::deque<float> m_cpu_samples;
+  std::deque<float> m_gpu_samples;
+  TimingStats m_cpu;
+  TimingStats m_gpu;
+
+  // NOT IMPLEMENTED
+  FrameTimer(const FrameTimer& other);
+  FrameTimer& operator=(const FrameTimer& other);
+};
+
+#endif
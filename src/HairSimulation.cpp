@@ -0,0 +1,406 @@
+// Sh: A GPU metaprogramming language.
+//
+// Copyright 2003-2005 Serious Hack Inc.
+// 
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, 
+// MA  02110-1301, USA
+//////////////////////////////////////////////////////////////////////////////
+#include <algorithm>
+#include <cmath>
+#if defined(__AVX__)
+#include <immintrin.h>
+#elif defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#define SHRIKE_HAIR_SSE 1
+#include <xmmintrin.h>
+#endif
+#include "ShrikeGl.hpp"
+#include "HairSimulation.hpp"
+#include "HairStrands.hpp"
+#include "Parallel.hpp"
+
+#define SHRIKE_BUFFER_OFFSET(floats) ((char*)0 + (floats)*sizeof(float))
+
+namespace {
+
+const std::size_t grain = 16; // blocks per chunk of work
+const float damping = 0.98f; // of velocity, each step
+const float correction = 0.9f; // of a particle's correction, taken off the one above
+const float epsilon = 1e-6f;
+
+const std::size_t lanes = HairSimulation::LANES;
+const std::size_t particle_floats = 3 * lanes;
+const std::size_t block_floats = HairSimulation::PARTICLES * particle_floats;
+
+/// A float for each strand in a block.
+#if defined(__AVX__)
+struct Lanes {
+  __m256 v;
+};
+
+#define SHRIKE_LANES_OP(name, op) \
+  inline Lanes name(Lanes a, Lanes b) { Lanes r; r.v = op(a.v, b.v); return r; }
+SHRIKE_LANES_OP(operator+, _mm256_add_ps)
+SHRIKE_LANES_OP(operator-, _mm256_sub_ps)
+SHRIKE_LANES_OP(operator*, _mm256_mul_ps)
+SHRIKE_LANES_OP(operator/, _mm256_div_ps)
+SHRIKE_LANES_OP(max, _mm256_max_ps)
+
+inline Lanes load(const float* p) { Lanes r; r.v = _mm256_loadu_ps(p); return r; }
+inline void store(float* p, Lanes a) { _mm256_storeu_ps(p, a.v); }
+inline Lanes splat(float f) { Lanes r; r.v = _mm256_set1_ps(f); return r; }
+inline Lanes sqrt(Lanes a) { Lanes r; r.v = _mm256_sqrt_ps(a.v); return r; }
+
+#elif defined(SHRIKE_HAIR_SSE)
+struct Lanes {
+  __m128 lo, hi;
+};
+
+#define SHRIKE_LANES_OP(name, op) \
+  inline Lanes name(Lanes a, Lanes b) \
+  { Lanes r; r.lo = op(a.lo, b.lo); r.hi = op(a.hi, b.hi); return r; }
+SHRIKE_LANES_OP(operator+, _mm_add_ps)
+SHRIKE_LANES_OP(operator-, _mm_sub_ps)
+SHRIKE_LANES_OP(operator*, _mm_mul_ps)
+SHRIKE_LANES_OP(operator/, _mm_div_ps)
+SHRIKE_LANES_OP(max, _mm_max_ps)
+
+inline Lanes load(const float* p)
+{
+  Lanes r; r.lo = _mm_loadu_ps(p); r.hi = _mm_loadu_ps(p + 4); return r;
+}
+inline void store(float* p, Lanes a) { _mm_storeu_ps(p, a.lo); _mm_storeu_ps(p + 4, a.hi); }
+inline Lanes splat(float f) { Lanes r; r.lo = r.hi = _mm_set1_ps(f); return r; }
+inline Lanes sqrt(Lanes a) { Lanes r; r.lo = _mm_sqrt_ps(a.lo); r.hi = _mm_sqrt_ps(a.hi); return r; }
+
+#else
+struct Lanes {
+  float v[HairSimulation::LANES];
+};
+
+#define SHRIKE_LANES_OP(name, expr) \
+  inline Lanes name(Lanes a, Lanes b) \
+  { Lanes r; for (std::size_t i = 0; i < lanes; ++i) r.v[i] = expr; return r; }
+SHRIKE_LANES_OP(operator+, a.v[i] + b.v[i])
+SHRIKE_LANES_OP(operator-, a.v[i] - b.v[i])
+SHRIKE_LANES_OP(operator*, a.v[i] * b.v[i])
+SHRIKE_LANES_OP(operator/, a.v[i] / b.v[i])
+SHRIKE_LANES_OP(max, std::max(a.v[i], b.v[i]))
+
+inline Lanes load(const float* p) { Lanes r; std::copy(p, p + lanes, r.v); return r; }
+inline void store(float* p, Lanes a) { std::copy(a.v, a.v + lanes, p); }
+inline Lanes splat(float f) { Lanes r; std::fill(r.v, r.v + lanes, f); return r; }
+inline Lanes sqrt(Lanes a)
+{
+  Lanes r; for (std::size_t i = 0; i < lanes; ++i) r.v[i] = std::sqrt(a.v[i]); return r;
+}
+#endif
+
+#undef SHRIKE_LANES_OP
+
+/// A point or vector for each strand in a block.
+struct Lanes3 {
+  Lanes x, y, z;
+};
+
+inline Lanes3 load3(const float* p)
+{
+  Lanes3 r; r.x = load(p); r.y = load(p + lanes); r.z = load(p + 2*lanes); return r;
+}
+inline void store3(float* p, const Lanes3& a)
+{
+  store(p, a.x); store(p + lanes, a.y); store(p + 2*lanes, a.z);
+}
+inline Lanes3 splat3(const float* f)
+{
+  Lanes3 r; r.x = splat(f[0]); r.y = splat(f[1]); r.z = splat(f[2]); return r;
+}
+inline Lanes3 operator+(const Lanes3& a, const Lanes3& b)
+{
+  Lanes3 r; r.x = a.x + b.x; r.y = a.y + b.y; r.z = a.z + b.z; return r;
+}
+inline Lanes3 operator-(const Lanes3& a, const Lanes3& b)
+{
+  Lanes3 r; r.x = a.x - b.x; r.y = a.y - b.y; r.z = a.z - b.z; return r;
+}
+inline Lanes3 operator*(const Lanes3& a, Lanes b)
+{
+  Lanes3 r; r.x = a.x * b; r.y = a.y * b; r.z = a.z * b; return r;
+}
+inline Lanes dot(const Lanes3& a, const Lanes3& b)
+{
+  return a.x*b.x + a.y*b.y + a.z*b.z;
+}
+
+}
+
+struct HairSimulation::StepTask : public ParallelTask {
+  HairSimulation* simulation;
+  float dt;
+  const HairForces* forces;
+  std::vector<float>* moved; // furthest squared, per block
+
+  void run(std::size_t begin, std::size_t end)
+  {
+    float accel[3];
+    for (int c = 0; c < 3; ++c) {
+      accel[c] = (forces->gravity[c] + forces->wind[c]) * dt * dt;
+    }
+    Lanes3 a = splat3(accel);
+    Lanes3 center = splat3(forces->center);
+    Lanes radius = splat(forces->radius);
+    Lanes keep = splat(damping);
+    Lanes share = splat(correction);
+    Lanes small = splat(epsilon);
+    Lanes one = splat(1.0f);
+
+    for (std::size_t b = begin; b < end; ++b) {
+      float* x = &simulation->m_position[b * block_floats];
+      float* p = &simulation->m_previous[b * block_floats];
+      const float* rest = &simulation->m_rest[b * SEGMENTS * lanes];
+
+      Lanes3 parent = center + load3(&simulation->m_root[b * particle_floats]) * radius;
+      store3(x, parent);
+      store3(p, parent);
+
+      Lanes furthest = splat(0.0f);
+      for (int j = 1; j < PARTICLES; ++j) {
+        float* xj = x + j * particle_floats;
+        float* pj = p + j * particle_floats;
+        Lanes3 current = load3(xj);
+        Lanes3 predicted = current + (current - load3(pj)) * keep + a;
+
+        // back to its rest distance below its parent...
+        Lanes3 d = predicted - parent;
+        Lanes3 next = parent + d * (load(rest + (j - 1) * lanes) / max(sqrt(dot(d, d)), small));
+
+        // ...and out of the head
+        Lanes3 e = next - center;
+        next = center + e * max(radius / max(sqrt(dot(e, e)), small), one);
+
+        // The parent's velocity loses most of this particle's
+        // correction, which damps the stiffness following the leader
+        // gives the strand.
+        if (j > 1) {
+          float* parent_previous = pj - particle_floats;
+          store3(parent_previous, load3(parent_previous) + (next - predicted) * share);
+        }
+
+        Lanes3 step = next - current;
+        furthest = max(furthest, dot(step, step));
+        store3(pj, current);
+        store3(xj, next);
+        parent = next;
+      }
+
+      float values[LANES];
+      store(values, furthest);
+      (*moved)[b] = *std::max_element(values, values + LANES);
+    }
+  }
+};
+
+struct HairSimulation::VertexTask : public ParallelTask {
+  const HairSimulation* simulation;
+  float* vertices;
+
+  void run(std::size_t begin, std::size_t end)
+  {
+    for (std::size_t b = begin; b < end; ++b) {
+      const float* x = &simulation->m_position[b * block_floats];
+      for (std::size_t l = 0; l < lanes; ++l) {
+        std::size_t strand = b * lanes + l;
+        if (strand >= simulation->m_size) break;
+
+        float* v = vertices + strand * PARTICLES * STRIDE;
+        for (int j = 0; j < PARTICLES; ++j, v += STRIDE) {
+          // the direction of the segment below, or above at the tip
+          int from = std::min(j, SEGMENTS - 1);
+          for (int c = 0; c < 3; ++c) {
+            const float* coordinate = x + c * lanes + l;
+            v[c] = coordinate[j * particle_floats];
+            v[3 + c] = coordinate[(from + 1) * particle_floats] - coordinate[from * particle_floats];
+          }
+        }
+      }
+    }
+  }
+};
+
+HairSimulation::HairSimulation()
+  : m_size(0)
+{
+}
+
+void HairSimulation::resize(const HairStrands& strands, std::size_t count,
+                            const HairForces& forces)
+{
+  std::size_t blocks = (count + lanes - 1) / lanes;
+  m_position.resize(blocks * block_floats);
+  m_previous.resize(blocks * block_floats);
+  m_rest.resize(blocks * SEGMENTS * lanes);
+  m_root.resize(blocks * particle_floats);
+
+  for (std::size_t i = m_size; i < count; ++i) {
+    std::size_t b = i / lanes;
+    std::size_t l = i % lanes;
+
+    float dir[3] = { strands.root_x[i], strands.root_y[i], strands.root_z[i] };
+    float surface[3] = { strands.surface_x[i], strands.surface_y[i], strands.surface_z[i] };
+    float* x = &m_position[b * block_floats] + l;
+    float* p = &m_previous[b * block_floats] + l;
+    float* root = &m_root[b * particle_floats] + l;
+
+    // the curve the hair used to be drawn as
+    for (int j = 0; j < PARTICLES; ++j) {
+      float t = strands.length[i] * j / SEGMENTS;
+      for (int c = 0; c < 3; ++c) {
+        float sag = (c == 1 ? -0.25f * t * t : 0.0f);
+        x[j * particle_floats + c * lanes] = forces.center[c] + forces.radius * dir[c]
+                                             + surface[c] * t + sag;
+        p[j * particle_floats + c * lanes] = x[j * particle_floats + c * lanes];
+      }
+      if (j == 0) continue;
+
+      float length = 0.0f;
+      for (int c = 0; c < 3; ++c) {
+        float d = x[j * particle_floats + c * lanes] - x[(j - 1) * particle_floats + c * lanes];
+        length += d * d;
+      }
+      m_rest[(b * SEGMENTS + j - 1) * lanes + l] = std::sqrt(length);
+    }
+    for (int c = 0; c < 3; ++c) root[c * lanes] = dir[c];
+  }
+  m_size = count;
+}
+
+float HairSimulation::step(float dt, const HairForces& forces)
+{
+  std::size_t blocks = (m_size + lanes - 1) / lanes;
+  std::vector<float> moved(blocks, 0.0f);
+
+  StepTask task;
+  task.simulation = this;
+  task.dt = dt;
+  task.forces = &forces;
+  task.moved = &moved;
+  parallel_for(task, blocks, grain);
+
+  return moved.empty() ? 0.0f : std::sqrt(*std::max_element(moved.begin(), moved.end()));
+}
+
+void HairSimulation::fillVertices(float* vertices) const
+{
+  VertexTask task;
+  task.simulation = this;
+  task.vertices = vertices;
+  parallel_for(task, (m_size + lanes - 1) / lanes, grain);
+}
+
+HairBuffer::HairBuffer()
+  : m_index_buffer(0),
+    m_front(0),
+    m_strands(0),
+    m_count(0)
+{
+  m_vertex_buffers[0] = m_vertex_buffers[1] = 0;
+}
+
+HairBuffer::~HairBuffer()
+{
+  release();
+}
+
+bool HairBuffer::upload(const HairSimulation& simulation)
+{
+  m_count = 0;
+  if (!simulation.size()) return true;
+
+  if (!m_vertex_buffers[0]) glGenBuffersARB(2, m_vertex_buffers);
+  if (!m_index_buffer) glGenBuffersARB(1, &m_index_buffer);
+
+  bool ok = true;
+  if (m_strands != simulation.size()) {
+    m_strands = simulation.size();
+    std::size_t count = m_strands * HairSimulation::SEGMENTS * 2;
+    glBindBufferARB(GL_ELEMENT_ARRAY_BUFFER_ARB, m_index_buffer);
+    glBufferDataARB(GL_ELEMENT_ARRAY_BUFFER_ARB, count * sizeof(unsigned int), 0,
+                    GL_STATIC_DRAW_ARB);
+    unsigned int* index = (unsigned int*)glMapBufferARB(GL_ELEMENT_ARRAY_BUFFER_ARB,
+                                                        GL_WRITE_ONLY_ARB);
+    if (index) {
+      for (unsigned int s = 0; s < m_strands; ++s) {
+        for (unsigned int j = 0; j < HairSimulation::SEGMENTS; ++j) {
+          *index++ = s * HairSimulation::PARTICLES + j;
+          *index++ = s * HairSimulation::PARTICLES + j + 1;
+        }
+      }
+    }
+    ok = index && glUnmapBufferARB(GL_ELEMENT_ARRAY_BUFFER_ARB);
+    glBindBufferARB(GL_ELEMENT_ARRAY_BUFFER_ARB, 0);
+    if (!ok) m_strands = 0;
+  }
+
+  unsigned int back = 1 - m_front;
+  if (ok) {
+    glBindBufferARB(GL_ARRAY_BUFFER_ARB, m_vertex_buffers[back]);
+    // A new store each time, so the map doesn't wait for the GPU to be
+    // done with what was there.
+    glBufferDataARB(GL_ARRAY_BUFFER_ARB,
+                    simulation.vertexCount() * HairSimulation::STRIDE * sizeof(float),
+                    0, GL_STREAM_DRAW_ARB);
+    float* vertices = (float*)glMapBufferARB(GL_ARRAY_BUFFER_ARB, GL_WRITE_ONLY_ARB);
+    if (vertices) simulation.fillVertices(vertices);
+    ok = vertices && glUnmapBufferARB(GL_ARRAY_BUFFER_ARB);
+    glBindBufferARB(GL_ARRAY_BUFFER_ARB, 0);
+  }
+
+  if (!ok) return false;
+  m_front = back;
+  m_count = m_strands * HairSimulation::SEGMENTS * 2;
+  return true;
+}
+
+void HairBuffer::draw()
+{
+  if (empty()) return;
+
+  GLsizei stride = HairSimulation::STRIDE * sizeof(float);
+
+  glPushClientAttrib(GL_CLIENT_VERTEX_ARRAY_BIT);
+  glBindBufferARB(GL_ARRAY_BUFFER_ARB, m_vertex_buffers[m_front]);
+  glBindBufferARB(GL_ELEMENT_ARRAY_BUFFER_ARB, m_index_buffer);
+
+  glEnableClientState(GL_VERTEX_ARRAY);
+  glVertexPointer(3, GL_FLOAT, stride, SHRIKE_BUFFER_OFFSET(0));
+  glClientActiveTextureARB(GL_TEXTURE0);
+  glEnableClientState(GL_TEXTURE_COORD_ARRAY);
+  glTexCoordPointer(3, GL_FLOAT, stride, SHRIKE_BUFFER_OFFSET(3));
+
+  glDrawElements(GL_LINES, m_count, GL_UNSIGNED_INT, 0);
+
+  glBindBufferARB(GL_ELEMENT_ARRAY_BUFFER_ARB, 0);
+  glBindBufferARB(GL_ARRAY_BUFFER_ARB, 0);
+  glPopClientAttrib();
+}
+
+void HairBuffer::release()
+{
+  if (m_vertex_buffers[0]) glDeleteBuffersARB(2, m_vertex_buffers);
+  if (m_index_buffer) glDeleteBuffersARB(1, &m_index_buffer);
+  m_vertex_buffers[0] = m_vertex_buffers[1] = 0;
+  m_index_buffer = 0;
+  m_strands = 0;
+  m_count = 0;
+}
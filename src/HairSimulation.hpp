@@ -0,0 +1,120 @@
+// Sh: A GPU metaprogramming language.
+//
+// Copyright 2003-2005 Serious Hack Inc.
+// 
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, 
+// MA  02110-1301, USA
+//////////////////////////////////////////////////////////////////////////////
+#ifndef HAIRSIMULATION_HPP
+#define HAIRSIMULATION_HPP
+
+#include <vector>
+
+struct HairStrands;
+
+/// Everything acting on the hair, in world units and seconds.
+struct HairForces {
+  float gravity[3];
+  float wind[3];
+  float center[3]; // of the head
+  float radius;
+};
+
+/** Strands of hair simulated on the CPU.  Each strand is a chain of
+ * SEGMENTS segments, its root pinned to a sphere for the head.  A step
+ * is Verlet integration followed by a pass down each strand putting
+ * every particle back at its rest distance from the one above
+ * ("follow the leader", with the velocity correction from Mueller et
+ * al.'s "Fast Simulation of Inextensible Hair and Fur") and out of the
+ * head.
+ *
+ * Strands are kept in blocks of LANES, with each coordinate of a
+ * particle stored for the whole block together, so a step works on a
+ * block at a time with SSE or AVX.  Blocks are shared out between
+ * threads by parallel_for().
+ */
+class HairSimulation {
+public:
+  enum {
+    SEGMENTS = 16,
+    PARTICLES = SEGMENTS + 1,
+    LANES = 8,
+    STRIDE = 6 // floats per vertex: position, then direction along the strand
+  };
+
+  HairSimulation();
+
+  std::size_t size() const { return m_size; }
+  std::size_t vertexCount() const { return m_size * PARTICLES; }
+
+  /// Simulate the first count of strands.  Those that weren't being
+  /// simulated already start in the shape they have with no wind and
+  /// light gravity.
+  void resize(const HairStrands& strands, std::size_t count, const HairForces& forces);
+
+  /// Advance by dt seconds.  Returns the furthest any particle moved.
+  float step(float dt, const HairForces& forces);
+
+  /// Write vertexCount() vertices of STRIDE floats, PARTICLES for each
+  /// strand in turn.
+  void fillVertices(float* vertices) const;
+
+private:
+  std::size_t m_size;
+
+  // per block, particle, coordinate, then lane
+  std::vector<float> m_position;
+  std::vector<float> m_previous;
+  // per block, segment, then lane
+  std::vector<float> m_rest;
+  // per block, coordinate, then lane; on the unit sphere
+  std::vector<float> m_root;
+
+  struct StepTask;
+  struct VertexTask;
+};
+
+/** A HairSimulation drawn as GL_LINES.  Vertices are streamed into one
+ * of two vertex buffers each frame while the other may still be in use
+ * for the last one, and the indices, which only depend on the number
+ * of strands, into a third.  Needs a current GL context for everything
+ * except construction.
+ */
+class HairBuffer {
+public:
+  HairBuffer();
+  ~HairBuffer();
+
+  /// Returns false, leaving the buffer empty, if the vertices couldn't
+  /// be written.
+  bool upload(const HairSimulation& simulation);
+  void draw();
+  void release();
+
+  bool empty() const { return m_count == 0; }
+
+private:
+  unsigned int m_vertex_buffers[2];
+  unsigned int m_index_buffer;
+  unsigned int m_front; // which of m_vertex_buffers to draw
+  unsigned int m_strands; // strands m_index_buffer has room for
+  unsigned int m_count; // number of indices to draw
+
+  // NOT IMPLEMENTED
+  HairBuffer(const HairBuffer& other);
+  HairBuffer& operator=(const HairBuffer& other);
+};
+
+#endif
@@ -0,0 +1,102 @@
+// Sh: A GPU metaprogramming language.
+//
+// Copyright 2003-2005 Serious Hack Inc.
+// 
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, 
+// MA  02110-1301, USA
+//////////////////////////////////////////////////////////////////////////////
+#include <cmath>
+#include "HairStrands.hpp"
+#include "Parallel.hpp"
+
+namespace {
+
+const std::size_t grain = 4096; // strands per chunk of work
+
+inline unsigned int mix(unsigned int h)
+{
+  h ^= h >> 16;
+  h *= 0x7feb352du;
+  h ^= h >> 15;
+  h *= 0x846ca68bu;
+  h ^= h >> 16;
+  return h;
+}
+
+/// The n'th random number of a strand, in [0, 1).
+inline float strand_random(unsigned int seed, unsigned int strand, unsigned int n)
+{
+  unsigned int h = mix(mix(mix(seed) ^ strand) ^ n);
+  return (h >> 8) * (1.0f / 16777216.0f);
+}
+
+/// Hairs grow out of the cap within this angle of +y.
+const float crown = M_PI / 4;
+
+struct GenerateTask : public ParallelTask {
+  HairStrands* strands;
+  unsigned int seed;
+
+  void run(std::size_t begin, std::size_t end)
+  {
+    HairStrands& s = *strands;
+    float cos_crown = std::cos(crown);
+    for (std::size_t i = begin; i < end; ++i) {
+      // uniform over the area of the cap
+      float y = 1.0f - strand_random(seed, i, 0) * (1.0f - cos_crown);
+      float r = std::sqrt(1.0f - y*y);
+      float phi = 2 * M_PI * strand_random(seed, i, 1);
+      float x = r * std::cos(phi);
+      float z = r * std::sin(phi);
+
+      s.root_x[i] = x;
+      s.root_y[i] = y;
+      s.root_z[i] = z;
+      s.surface_x[i] = x * 0.5f * strand_random(seed, i, 2);
+      s.surface_y[i] = y * 0.5f * strand_random(seed, i, 3);
+      s.surface_z[i] = z * 0.5f * strand_random(seed, i, 4);
+      s.length[i] = 1.0f + strand_random(seed, i, 5);
+    }
+  }
+};
+
+}
+
+void HairStrands::clear()
+{
+  root_x.clear();
+  root_y.clear();
+  root_z.clear();
+  surface_x.clear();
+  surface_y.clear();
+  surface_z.clear();
+  length.clear();
+}
+
+void HairStrands::generate(std::size_t count, unsigned int seed)
+{
+  root_x.resize(count);
+  root_y.resize(count);
+  root_z.resize(count);
+  surface_x.resize(count);
+  surface_y.resize(count);
+  surface_z.resize(count);
+  length.resize(count);
+
+  GenerateTask task;
+  task.strands = this;
+  task.seed = seed;
+  parallel_for(task, count, grain);
+}
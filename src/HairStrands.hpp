@@ -0,0 +1,46 @@
+// Sh: A GPU metaprogramming language.
+//
+// Copyright 2003-2005 Serious Hack Inc.
+// 
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, 
+// MA  02110-1301, USA
+//////////////////////////////////////////////////////////////////////////////
+#ifndef HAIRSTRANDS_HPP
+#define HAIRSTRANDS_HPP
+
+#include <vector>
+
+/** Hair strands growing out of the crown of a unit sphere, as a struct
+ * of arrays with one entry per strand.
+ *
+ * Strand i is a function of nothing but the seed and i, so the same
+ * seed gives the same hair however generation is split between
+ * threads, and the first n strands of a bigger set are the same as a
+ * set of n.
+ */
+struct HairStrands {
+  std::vector<float> root_x, root_y, root_z; // on the unit sphere
+  std::vector<float> surface_x, surface_y, surface_z; // direction it grows in
+  std::vector<float> length; // of the curve HairSimulation starts it as
+
+  std::size_t size() const { return root_x.size(); }
+
+  void clear();
+
+  /// Replace the contents with count strands made from seed.
+  void generate(std::size_t count, unsigned int seed);
+};
+
+#endif
@@ -0,0 +1,48 @@
+// Sh: A GPU metaprogramming language.
+//
+// Copyright 2003-2005 Serious Hack Inc.
+// 
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, 
+// MA  02110-1301, USA
+//////////////////////////////////////////////////////////////////////////////
+#include "LineReader.hpp"
+
+void LineReader::read(wxInputStream* stream, std::vector<wxString>& lines, bool end)
+{
+  char buffer[4096];
+  // Read only returns early once it has something and the pipe is
+  // empty, so it mustn't be called until CanRead says there is data.
+  while (stream && stream->CanRead()) {
+    stream->Read(buffer, sizeof(buffer));
+    if (!stream->LastRead()) break;
+    m_partial.append(buffer, stream->LastRead());
+  }
+
+  std::string::size_type start = 0;
+  for (;;) {
+    std::string::size_type newline = m_partial.find('\n', start);
+    if (newline == std::string::npos) break;
+    std::string::size_type length = newline - start;
+    if (length && m_partial[newline - 1] == '\r') --length;
+    lines.push_back(wxString(m_partial.substr(start, length).c_str(), wxConvLibc));
+    start = newline + 1;
+  }
+  m_partial.erase(0, start);
+
+  if (end && !m_partial.empty()) {
+    lines.push_back(wxString(m_partial.c_str(), wxConvLibc));
+    m_partial.clear();
+  }
+}
@@ -0,0 +1,43 @@
+// Sh: A GPU metaprogramming language.
+//
+// Copyright 2003-2005 Serious Hack Inc.
+// 
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, 
+// MA  02110-1301, USA
+//////////////////////////////////////////////////////////////////////////////
+#ifndef LINEREADER_HPP
+#define LINEREADER_HPP
+
+#include <string>
+#include <vector>
+#include <wx/wx.h>
+#include <wx/stream.h>
+
+/** Splits what a child process writes to a pipe into lines without
+ * ever waiting for more.  Only the bytes already in the pipe are
+ * read; a line that isn't finished yet is kept until the next read.
+ */
+class LineReader {
+public:
+  /// Read what is waiting on stream and append each line it completes
+  /// to lines, without the line break.  With end, as once the process
+  /// is gone, an unfinished last line is appended too.
+  void read(wxInputStream* stream, std::vector<wxString>& lines, bool end = false);
+
+private:
+  std::string m_partial; // bytes after the last line break
+};
+
+#endif
@@ -0,0 +1,98 @@
+// Sh: A GPU metaprogramming language.
+//
+// Copyright 2003-2005 Serious Hack Inc.
+// 
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, 
+// MA  02110-1301, USA
+//////////////////////////////////////////////////////////////////////////////
+#ifdef WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+#include "MappedFile.hpp"
+
+MappedFile::MappedFile()
+  : m_base(0), m_size(0)
+#ifdef WIN32
+  , m_file(INVALID_HANDLE_VALUE), m_mapping(0)
+#endif
+{
+}
+
+MappedFile::~MappedFile()
+{
+  close();
+}
+
+bool MappedFile::open(const std::string& path, bool writable, std::string& error)
+{
+  close();
+#ifdef WIN32
+  m_file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, 0,
+                       OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, 0);
+  if (m_file == INVALID_HANDLE_VALUE) {
+    error = "Unable to open " + path;
+    return false;
+  }
+  m_size = GetFileSize(m_file, 0);
+  if (m_size > 0) {
+    m_mapping = CreateFileMapping(m_file, 0, writable ? PAGE_WRITECOPY : PAGE_READONLY, 0, 0, 0);
+  }
+  if (m_mapping) {
+    m_base = static_cast<unsigned char*>(MapViewOfFile(m_mapping,
+                                                       writable ? FILE_MAP_COPY : FILE_MAP_READ,
+                                                       0, 0, 0));
+  }
+#else
+  int fd = ::open(path.c_str(), O_RDONLY);
+  if (fd < 0) {
+    error = "Unable to open " + path;
+    return false;
+  }
+  struct stat status;
+  void* base = MAP_FAILED;
+  if (fstat(fd, &status) == 0 && status.st_size > 0) {
+    m_size = status.st_size;
+    base = mmap(0, m_size, writable ? PROT_READ | PROT_WRITE : PROT_READ, MAP_PRIVATE, fd, 0);
+  }
+  ::close(fd);
+  if (base != MAP_FAILED) m_base = static_cast<unsigned char*>(base);
+#endif
+  if (!m_base) {
+    close();
+    error = "Unable to map " + path;
+    return false;
+  }
+  return true;
+}
+
+void MappedFile::close()
+{
+#ifdef WIN32
+  if (m_base) UnmapViewOfFile(m_base);
+  if (m_mapping) CloseHandle(m_mapping);
+  if (m_file != INVALID_HANDLE_VALUE) CloseHandle(m_file);
+  m_mapping = 0;
+  m_file = INVALID_HANDLE_VALUE;
+#else
+  if (m_base) munmap(m_base, m_size);
+#endif
+  m_base = 0;
+  m_size = 0;
+}
@@ -0,0 +1,57 @@
+// Sh: A GPU metaprogramming language.
+//
+// Copyright 2003-2005 Serious Hack Inc.
+// 
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, 
+// MA  02110-1301, USA
+//////////////////////////////////////////////////////////////////////////////
+#ifndef MAPPEDFILE_HPP
+#define MAPPEDFILE_HPP
+
+#include <string>
+
+/** A whole file mapped into memory.  Pages are only read as they are
+ * touched.
+ */
+class MappedFile {
+public:
+  MappedFile();
+  ~MappedFile();
+
+  /// Map path.  If writable it is mapped copy on write, so the pages
+  /// can be written without the file ever changing.  Returns false,
+  /// with the reason in error, if it can't be mapped (empty files
+  /// can't).
+  bool open(const std::string& path, bool writable, std::string& error);
+  void close();
+
+  bool is_open() const { return m_base != 0; }
+  unsigned char* data() const { return m_base; }
+  std::size_t size() const { return m_size; }
+
+private:
+  unsigned char* m_base;
+  std::size_t m_size;
+#ifdef WIN32
+  void* m_file; // HANDLEs
+  void* m_mapping;
+#endif
+
+  // NOT IMPLEMENTED
+  MappedFile(const MappedFile& other);
+  MappedFile& operator=(const MappedFile& other);
+};
+
+#endif
@@ -0,0 +1,135 @@
+// Sh: A GPU metaprogramming language.
+//
+// Copyright 2003-2005 Serious Hack Inc.
+// 
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, 
+// MA  02110-1301, USA
+//////////////////////////////////////////////////////////////////////////////
+#include "ShrikeGl.hpp"
+#include "MeshBuffer.hpp"
+
+#define SHRIKE_BUFFER_OFFSET(floats) ((char*)0 + (floats)*sizeof(float))
+
+using namespace ShUtil;
+
+void MeshData::clear()
+{
+  vertices.clear();
+  indices.clear();
+}
+
+void MeshData::flatten(const ShObjMesh& mesh)
+{
+  clear();
+  vertices.reserve(mesh.faces.size() * 3 * STRIDE);
+  indices.reserve(mesh.faces.size() * 3);
+
+  float values[4];
+  for(ShObjMesh::FaceSet::const_iterator I = mesh.faces.begin();
+      I != mesh.faces.end(); ++I) {
+    unsigned int first = vertexCount();
+    unsigned int corners = 0;
+
+    ShObjMesh::Edge* e = (*I)->edge;
+    do {
+      e->start->pos.getValues(values);
+      vertices.insert(vertices.end(), values, values + 3);
+      e->normal.getValues(values);
+      vertices.insert(vertices.end(), values, values + 3);
+      e->texcoord.getValues(values);
+      vertices.insert(vertices.end(), values, values + 2);
+      e->tangent.getValues(values);
+      vertices.insert(vertices.end(), values, values + 3);
+      ++corners;
+      e = e->next;
+    } while(e != (*I)->edge);
+
+    for (unsigned int i = 2; i < corners; ++i) {
+      indices.push_back(first);
+      indices.push_back(first + i - 1);
+      indices.push_back(first + i);
+    }
+  }
+}
+
+MeshBuffer::MeshBuffer()
+  : m_vertex_buffer(0),
+    m_index_buffer(0),
+    m_count(0)
+{
+}
+
+MeshBuffer::~MeshBuffer()
+{
+  release();
+}
+
+void MeshBuffer::upload(const MeshData& data)
+{
+  if (!m_vertex_buffer) glGenBuffersARB(1, &m_vertex_buffer);
+  if (!m_index_buffer) glGenBuffersARB(1, &m_index_buffer);
+
+  glBindBufferARB(GL_ARRAY_BUFFER_ARB, m_vertex_buffer);
+  glBufferDataARB(GL_ARRAY_BUFFER_ARB, data.vertices.size() * sizeof(float),
+                  data.vertices.empty() ? 0 : &data.vertices[0], GL_STATIC_DRAW_ARB);
+  glBindBufferARB(GL_ARRAY_BUFFER_ARB, 0);
+
+  glBindBufferARB(GL_ELEMENT_ARRAY_BUFFER_ARB, m_index_buffer);
+  glBufferDataARB(GL_ELEMENT_ARRAY_BUFFER_ARB, data.indices.size() * sizeof(unsigned int),
+                  data.indices.empty() ? 0 : &data.indices[0], GL_STATIC_DRAW_ARB);
+  glBindBufferARB(GL_ELEMENT_ARRAY_BUFFER_ARB, 0);
+
+  m_count = data.indices.size();
+}
+
+void MeshBuffer::draw()
+{
+  if (empty()) return;
+
+  GLsizei stride = MeshData::STRIDE * sizeof(float);
+
+  glPushClientAttrib(GL_CLIENT_VERTEX_ARRAY_BIT);
+  glBindBufferARB(GL_ARRAY_BUFFER_ARB, m_vertex_buffer);
+  glBindBufferARB(GL_ELEMENT_ARRAY_BUFFER_ARB, m_index_buffer);
+
+  glEnableClientState(GL_VERTEX_ARRAY);
+  glVertexPointer(3, GL_FLOAT, stride, SHRIKE_BUFFER_OFFSET(MeshData::POSITION));
+  glEnableClientState(GL_NORMAL_ARRAY);
+  glNormalPointer(GL_FLOAT, stride, SHRIKE_BUFFER_OFFSET(MeshData::NORMAL));
+
+  // texcoord goes to unit 0 and the tangent to unit 1, the same
+  // bindings the immediate mode paths use.
+  glClientActiveTextureARB(GL_TEXTURE0);
+  glEnableClientState(GL_TEXTURE_COORD_ARRAY);
+  glTexCoordPointer(2, GL_FLOAT, stride, SHRIKE_BUFFER_OFFSET(MeshData::TEXCOORD));
+  glClientActiveTextureARB(GL_TEXTURE0 + 1);
+  glEnableClientState(GL_TEXTURE_COORD_ARRAY);
+  glTexCoordPointer(3, GL_FLOAT, stride, SHRIKE_BUFFER_OFFSET(MeshData::TANGENT));
+
+  glDrawElements(GL_TRIANGLES, m_count, GL_UNSIGNED_INT, 0);
+
+  glBindBufferARB(GL_ELEMENT_ARRAY_BUFFER_ARB, 0);
+  glBindBufferARB(GL_ARRAY_BUFFER_ARB, 0);
+  glPopClientAttrib();
+}
+
+void MeshBuffer::release()
+{
+  if (m_vertex_buffer) glDeleteBuffersARB(1, &m_vertex_buffer);
+  if (m_index_buffer) glDeleteBuffersARB(1, &m_index_buffer);
+  m_vertex_buffer = 0;
+  m_index_buffer = 0;
+  m_count = 0;
+}
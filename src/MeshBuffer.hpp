@@ -0,0 +1,78 @@
+// Sh: A GPU metaprogramming language.
+//
+// Copyright 2003-2005 Serious Hack Inc.
+// 
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, 
+// MA  02110-1301, USA
+//////////////////////////////////////////////////////////////////////////////
+#ifndef MESHBUFFER_HPP
+#define MESHBUFFER_HPP
+
+#include <vector>
+#include <shutil/ShObjMesh.hpp>
+
+/** Flattened, indexed copy of a mesh.
+ * Vertices are interleaved as position, normal, texcoord and tangent,
+ * which is the attribute layout every shader in shrike expects.
+ * Indices describe a plain triangle list.
+ */
+struct MeshData {
+  enum {
+    POSITION = 0,
+    NORMAL = 3,
+    TEXCOORD = 6,
+    TANGENT = 8,
+    STRIDE = 11 // floats per vertex
+  };
+
+  std::vector<float> vertices;
+  std::vector<unsigned int> indices;
+
+  std::size_t vertexCount() const { return vertices.size() / STRIDE; }
+  std::size_t triangleCount() const { return indices.size() / 3; }
+
+  void clear();
+
+  /// Replace the contents with the corners of every face in mesh.
+  /// Polygons are fanned into triangles.
+  void flatten(const ShUtil::ShObjMesh& mesh);
+};
+
+/** A MeshData uploaded into vertex buffer objects and drawn with
+ * glDrawElements.  Needs a current GL context for everything except
+ * construction.
+ */
+class MeshBuffer {
+public:
+  MeshBuffer();
+  ~MeshBuffer();
+
+  void upload(const MeshData& data);
+  void draw();
+  void release();
+
+  bool empty() const { return m_count == 0; }
+
+private:
+  unsigned int m_vertex_buffer;
+  unsigned int m_index_buffer;
+  unsigned int m_count; // number of indices
+
+  // NOT IMPLEMENTED
+  MeshBuffer(const MeshBuffer& other);
+  MeshBuffer& operator=(const MeshBuffer& other);
+};
+
+#endif
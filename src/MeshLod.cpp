@@ -0,0 +1,618 @@
+// Sh: A GPU metaprogramming language.
+//
+// Copyright 2003-2005 Serious Hack Inc.
+// 
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, 
+// MA  02110-1301, USA
+//////////////////////////////////////////////////////////////////////////////
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <sys/stat.h>
+#include "MappedFile.hpp"
+#include "MeshLod.hpp"
+#include "MeshOptimize.hpp"
+#include "Parallel.hpp"
+
+namespace {
+
+const std::size_t grain = 4096; // vertices per chunk of work
+const unsigned int none = ~0u;
+
+/// Boundary edges are held in place by a plane through them, at right
+/// angles to their triangle, weighted this much more than the
+/// triangle's own plane.
+const double boundary_weight = 10.0;
+
+/// No level is kept that is further than this from level 0, relative
+/// to the size of the model.
+const float max_error = 0.1f;
+
+inline const float* position(const MeshData& data, unsigned int v)
+{
+  return &data.vertices[v * MeshData::STRIDE + MeshData::POSITION];
+}
+
+/// Unnormalized normal of the triangle p0, p1, p2; twice its area long.
+inline void triangle_normal(const float* p0, const float* p1, const float* p2, double* n)
+{
+  double e1[3], e2[3];
+  for (int i = 0; i < 3; ++i) {
+    e1[i] = p1[i] - p0[i];
+    e2[i] = p2[i] - p0[i];
+  }
+  n[0] = e1[1]*e2[2] - e1[2]*e2[1];
+  n[1] = e1[2]*e2[0] - e1[0]*e2[2];
+  n[2] = e1[0]*e2[1] - e1[1]*e2[0];
+}
+
+inline double dot(const double* a, const double* b)
+{
+  return a[0]*b[0] + a[1]*b[1] + a[2]*b[2];
+}
+
+/** Sum of squared distances to a set of weighted planes, as a
+ * symmetric 4x4 matrix.  area is the weight of the triangle planes
+ * alone, so that error() is a mean squared distance.
+ */
+struct Quadric {
+  double a00, a01, a02, a11, a12, a22;
+  double b0, b1, b2;
+  double c;
+  double area;
+
+  void clear()
+  {
+    a00 = a01 = a02 = a11 = a12 = a22 = 0;
+    b0 = b1 = b2 = c = 0;
+    area = 0;
+  }
+
+  void add(const Quadric& q)
+  {
+    a00 += q.a00; a01 += q.a01; a02 += q.a02;
+    a11 += q.a11; a12 += q.a12; a22 += q.a22;
+    b0 += q.b0; b1 += q.b1; b2 += q.b2;
+    c += q.c;
+    area += q.area;
+  }
+
+  /// Add the plane n.x + d = 0, with n unit length.
+  void add_plane(const double* n, double d, double weight)
+  {
+    a00 += weight*n[0]*n[0]; a01 += weight*n[0]*n[1]; a02 += weight*n[0]*n[2];
+    a11 += weight*n[1]*n[1]; a12 += weight*n[1]*n[2]; a22 += weight*n[2]*n[2];
+    b0 += weight*d*n[0]; b1 += weight*d*n[1]; b2 += weight*d*n[2];
+    c += weight*d*d;
+  }
+
+  double evaluate(const float* p) const
+  {
+    double x = p[0], y = p[1], z = p[2];
+    return a00*x*x + 2*a01*x*y + 2*a02*x*z + a11*y*y + 2*a12*y*z + a22*z*z
+      + 2*(b0*x + b1*y + b2*z) + c;
+  }
+
+  double error(const float* p) const
+  {
+    double e = evaluate(p);
+    return area > 0 ? e / area : e;
+  }
+};
+
+/// The triangles around each vertex.
+struct Adjacency {
+  std::vector<unsigned int> offsets; // into triangles, one per vertex and one more
+  std::vector<unsigned int> triangles;
+
+  void build(const std::vector<unsigned int>& indices, std::size_t count)
+  {
+    offsets.assign(count + 1, 0);
+    for (std::size_t i = 0; i < indices.size(); ++i) ++offsets[indices[i] + 1];
+    for (std::size_t v = 0; v < count; ++v) offsets[v + 1] += offsets[v];
+    triangles.resize(indices.size());
+    std::vector<unsigned int> next(offsets.begin(), offsets.end() - 1);
+    for (std::size_t i = 0; i < indices.size(); ++i) {
+      triangles[next[indices[i]]++] = i / 3;
+    }
+  }
+
+  const unsigned int* begin(unsigned int v) const { return &triangles[0] + offsets[v]; }
+  const unsigned int* end(unsigned int v) const { return &triangles[0] + offsets[v + 1]; }
+};
+
+struct PositionLess {
+  PositionLess(const MeshData& data) : data(data) {}
+
+  bool operator()(unsigned int a, unsigned int b) const
+  {
+    const float* pa = position(data, a);
+    const float* pb = position(data, b);
+    return std::lexicographical_compare(pa, pa + 3, pb, pb + 3);
+  }
+
+  const MeshData& data;
+};
+
+/// Lock every vertex that shares its position with another: those are
+/// on seams, and moving one side would tear the surface open.
+void lock_seams(const MeshData& data, std::vector<char>& locked)
+{
+  std::size_t count = data.vertexCount();
+  std::vector<unsigned int> order(count);
+  for (std::size_t i = 0; i < count; ++i) order[i] = i;
+  std::sort(order.begin(), order.end(), PositionLess(data));
+
+  locked.assign(count, 0);
+  for (std::size_t i = 1; i < count; ++i) {
+    const float* p = position(data, order[i]);
+    const float* q = position(data, order[i - 1]);
+    if (std::equal(p, p + 3, q)) {
+      locked[order[i]] = 1;
+      locked[order[i - 1]] = 1;
+    }
+  }
+}
+
+/// The planes of each vertex's triangles, and of its boundary edges.
+struct QuadricTask : public ParallelTask {
+  const MeshData* data;
+  const Adjacency* adjacency;
+  std::vector<Quadric>* quadrics;
+
+  void run(std::size_t begin, std::size_t end)
+  {
+    const std::vector<unsigned int>& indices = data->indices;
+    for (std::size_t v = begin; v < end; ++v) {
+      Quadric& q = (*quadrics)[v];
+      q.clear();
+      for (const unsigned int* t = adjacency->begin(v); t != adjacency->end(v); ++t) {
+        const unsigned int* tri = &indices[*t * 3];
+        const float* p[3];
+        for (int k = 0; k < 3; ++k) p[k] = position(*data, tri[k]);
+        double n[3];
+        triangle_normal(p[0], p[1], p[2], n);
+        double length = std::sqrt(dot(n, n));
+        if (length == 0) continue;
+        for (int i = 0; i < 3; ++i) n[i] /= length;
+        double area = 0.5 * length;
+        q.add_plane(n, -(n[0]*p[0][0] + n[1]*p[0][1] + n[2]*p[0][2]), area);
+        q.area += area;
+
+        // the two edges of the triangle that end at v
+        for (int k = 0; k < 3; ++k) {
+          if (tri[k] == v) continue;
+          if (shared(v, tri[k], *t)) continue;
+          double e[3], m[3];
+          const float* pv = position(*data, v);
+          const float* pk = position(*data, tri[k]);
+          for (int i = 0; i < 3; ++i) e[i] = pk[i] - pv[i];
+          m[0] = e[1]*n[2] - e[2]*n[1];
+          m[1] = e[2]*n[0] - e[0]*n[2];
+          m[2] = e[0]*n[1] - e[1]*n[0];
+          double m_length = std::sqrt(dot(m, m));
+          if (m_length == 0) continue;
+          for (int i = 0; i < 3; ++i) m[i] /= m_length;
+          q.add_plane(m, -(m[0]*pv[0] + m[1]*pv[1] + m[2]*pv[2]),
+                      boundary_weight * area);
+        }
+      }
+    }
+  }
+
+  /// Whether a triangle other than t around v also has u.
+  bool shared(unsigned int v, unsigned int u, unsigned int t) const
+  {
+    const std::vector<unsigned int>& indices = data->indices;
+    for (const unsigned int* s = adjacency->begin(v); s != adjacency->end(v); ++s) {
+      if (*s == t) continue;
+      const unsigned int* tri = &indices[*s * 3];
+      if (tri[0] == u || tri[1] == u || tri[2] == u) return true;
+    }
+    return false;
+  }
+};
+
+/// The cheapest neighbour to move each vertex onto.
+struct CandidateTask : public ParallelTask {
+  const MeshData* data;
+  const Adjacency* adjacency;
+  const std::vector<Quadric>* quadrics;
+  const std::vector<char>* locked;
+  std::vector<unsigned int>* targets;
+  std::vector<double>* costs;
+
+  void run(std::size_t begin, std::size_t end)
+  {
+    const std::vector<unsigned int>& indices = data->indices;
+    for (std::size_t v = begin; v < end; ++v) {
+      unsigned int best = none;
+      double best_cost = 0;
+      if (!(*locked)[v]) {
+        for (const unsigned int* t = adjacency->begin(v); t != adjacency->end(v); ++t) {
+          const unsigned int* tri = &indices[*t * 3];
+          for (int k = 0; k < 3; ++k) {
+            unsigned int u = tri[k];
+            if (u == v) continue;
+            Quadric q = (*quadrics)[v];
+            q.add((*quadrics)[u]);
+            double cost = q.error(position(*data, u));
+            if (best == none || cost < best_cost) {
+              best = u;
+              best_cost = cost;
+            }
+          }
+        }
+      }
+      (*targets)[v] = best;
+      (*costs)[v] = best_cost;
+    }
+  }
+};
+
+struct CostLess {
+  CostLess(const std::vector<double>& costs) : costs(costs) {}
+
+  bool operator()(unsigned int a, unsigned int b) const
+  {
+    return costs[a] < costs[b];
+  }
+
+  const std::vector<double>& costs;
+};
+
+/// Whether moving a onto b turns any of a's remaining triangles over
+/// (or flattens it to nothing).
+bool flips(const MeshData& data, const Adjacency& adjacency, unsigned int a, unsigned int b)
+{
+  for (const unsigned int* t = adjacency.begin(a); t != adjacency.end(a); ++t) {
+    const unsigned int* tri = &data.indices[*t * 3];
+    if (tri[0] == b || tri[1] == b || tri[2] == b) continue; // goes away
+    const float* p[3];
+    const float* moved[3];
+    for (int k = 0; k < 3; ++k) {
+      p[k] = position(data, tri[k]);
+      moved[k] = (tri[k] == a ? position(data, b) : p[k]);
+    }
+    double before[3], after[3];
+    triangle_normal(p[0], p[1], p[2], before);
+    triangle_normal(moved[0], moved[1], moved[2], after);
+    if (dot(before, after) <= 0) return true;
+  }
+  return false;
+}
+
+/// Cache optimize the levels after the first, one to an item.
+struct OptimizeTask : public ParallelTask {
+  std::vector<MeshData>* levels;
+
+  void run(std::size_t begin, std::size_t end)
+  {
+    for (std::size_t i = begin; i < end; ++i) {
+      MeshData& level = (*levels)[i + 1];
+      optimize_vertex_cache(level);
+      reorder_vertices(level);
+    }
+  }
+};
+
+const char magic[8] = {'S', 'H', 'R', 'K', 'L', 'O', 'D', '1'};
+const unsigned int byte_order = 0x01020304;
+const unsigned int version = 1;
+
+struct FileHeader {
+  char magic[8];
+  unsigned int byte_order;
+  unsigned int version;
+  unsigned int levels;
+  float center[3];
+  float radius;
+};
+
+struct FileLevel {
+  unsigned int vertices; // floats
+  unsigned int indices;
+  float error;
+};
+
+}
+
+float simplify_mesh(MeshData& data, std::size_t target)
+{
+  std::size_t count = data.vertexCount();
+  if (count == 0 || data.triangleCount() <= target) return 0;
+
+  std::vector<char> locked;
+  lock_seams(data, locked);
+
+  Adjacency adjacency;
+  adjacency.build(data.indices, count);
+
+  std::vector<Quadric> quadrics(count);
+  QuadricTask quadric_task;
+  quadric_task.data = &data;
+  quadric_task.adjacency = &adjacency;
+  quadric_task.quadrics = &quadrics;
+  parallel_for(quadric_task, count, grain);
+
+  std::vector<unsigned int> targets(count);
+  std::vector<double> costs(count);
+  CandidateTask candidate_task;
+  candidate_task.data = &data;
+  candidate_task.adjacency = &adjacency;
+  candidate_task.quadrics = &quadrics;
+  candidate_task.locked = &locked;
+  candidate_task.targets = &targets;
+  candidate_task.costs = &costs;
+
+  std::vector<unsigned int> order;
+  std::vector<char> touched(count);
+  std::vector<unsigned int> remap(count);
+  double error = 0;
+
+  // Each pass collapses a set of vertices none of which share a
+  // triangle, so every collapse sees its neighbourhood as it was when
+  // it was costed and checked.
+  while (data.triangleCount() > target) {
+    parallel_for(candidate_task, count, grain);
+
+    order.clear();
+    for (std::size_t v = 0; v < count; ++v) {
+      if (targets[v] != none) order.push_back(v);
+    }
+    if (order.empty()) break;
+    std::sort(order.begin(), order.end(), CostLess(costs));
+
+    // Most collapses take two triangles with them.  Only the cheapest
+    // part of the list is used, as the next pass may well find
+    // cheaper ones than what is left.
+    std::size_t wanted = (data.triangleCount() - target + 1) / 2;
+    std::size_t scan = order.size() / 3 + 1;
+    std::fill(touched.begin(), touched.end(), 0);
+    for (std::size_t v = 0; v < count; ++v) remap[v] = v;
+    std::size_t collapsed = 0;
+    for (std::size_t i = 0; i < order.size() && collapsed < wanted; ++i) {
+      if (i >= scan && collapsed) break;
+      unsigned int a = order[i];
+      unsigned int b = targets[a];
+      if (touched[a] || flips(data, adjacency, a, b)) continue;
+
+      for (const unsigned int* t = adjacency.begin(a); t != adjacency.end(a); ++t) {
+        for (int k = 0; k < 3; ++k) touched[data.indices[*t * 3 + k]] = 1;
+      }
+      remap[a] = b;
+      quadrics[b].add(quadrics[a]);
+      error = std::max(error, costs[a]);
+      ++collapsed;
+    }
+    if (!collapsed) break;
+
+    std::vector<unsigned int>& indices = data.indices;
+    std::size_t kept = 0;
+    for (std::size_t i = 0; i < indices.size(); i += 3) {
+      unsigned int i0 = remap[indices[i]];
+      unsigned int i1 = remap[indices[i + 1]];
+      unsigned int i2 = remap[indices[i + 2]];
+      if (i0 == i1 || i1 == i2 || i2 == i0) continue;
+      indices[kept++] = i0;
+      indices[kept++] = i1;
+      indices[kept++] = i2;
+    }
+    indices.resize(kept);
+    adjacency.build(indices, count);
+  }
+
+  reorder_vertices(data); // drops the vertices that were moved away
+  return std::sqrt(error);
+}
+
+MeshLod::MeshLod()
+  : m_radius(0)
+{
+  m_center[0] = m_center[1] = m_center[2] = 0;
+}
+
+void MeshLod::build(MeshData& data)
+{
+  m_levels.clear();
+  m_errors.clear();
+  // no copies of whole levels as the list grows
+  m_levels.reserve(MAX_LEVELS);
+
+  m_levels.push_back(MeshData());
+  m_levels.back().vertices.swap(data.vertices);
+  m_levels.back().indices.swap(data.indices);
+  m_errors.push_back(0);
+  bound();
+
+  while (m_levels.size() < MAX_LEVELS) {
+    const MeshData& finer = m_levels.back();
+    std::size_t target = finer.triangleCount() / 4;
+    if (target < MIN_TRIANGLES) break;
+
+    MeshData coarser = finer;
+    float total = m_errors.back() + simplify_mesh(coarser, target);
+    // what's left is mostly seams, which stay
+    if (coarser.triangleCount() > finer.triangleCount() / 4 * 3) break;
+    // too far off to be drawn at any size worth drawing
+    if (total > max_error * m_radius) break;
+
+    m_levels.push_back(MeshData());
+    m_levels.back().vertices.swap(coarser.vertices);
+    m_levels.back().indices.swap(coarser.indices);
+    m_errors.push_back(total);
+  }
+
+  // level 0 comes optimized already
+  OptimizeTask task;
+  task.levels = &m_levels;
+  parallel_for(task, m_levels.size() - 1, 1);
+}
+
+void MeshLod::bound()
+{
+  const MeshData& data = m_levels[0];
+  std::size_t count = data.vertexCount();
+  if (count == 0) {
+    m_center[0] = m_center[1] = m_center[2] = 0;
+    m_radius = 0;
+    return;
+  }
+
+  float low[3], high[3];
+  std::copy(position(data, 0), position(data, 0) + 3, low);
+  std::copy(low, low + 3, high);
+  for (std::size_t v = 1; v < count; ++v) {
+    const float* p = position(data, v);
+    for (int i = 0; i < 3; ++i) {
+      low[i] = std::min(low[i], p[i]);
+      high[i] = std::max(high[i], p[i]);
+    }
+  }
+  for (int i = 0; i < 3; ++i) m_center[i] = 0.5f * (low[i] + high[i]);
+
+  float radius2 = 0;
+  for (std::size_t v = 0; v < count; ++v) {
+    const float* p = position(data, v);
+    float d2 = 0;
+    for (int i = 0; i < 3; ++i) d2 += (p[i] - m_center[i]) * (p[i] - m_center[i]);
+    radius2 = std::max(radius2, d2);
+  }
+  m_radius = std::sqrt(radius2);
+}
+
+std::string MeshLod::cachePath(const std::string& path)
+{
+  std::string result = path;
+  if (result.size() > 4 && result.compare(result.size() - 4, 4, ".obj") == 0) {
+    result.erase(result.size() - 4);
+  }
+  return result + ".shlod";
+}
+
+bool MeshLod::read(const std::string& path, const std::string& source, std::string& error)
+{
+  struct stat cache_status, source_status;
+  if (stat(path.c_str(), &cache_status) != 0) {
+    error = path + " doesn't exist";
+    return false;
+  }
+  if (stat(source.c_str(), &source_status) == 0
+      && source_status.st_mtime > cache_status.st_mtime) {
+    error = path + " is older than " + source;
+    return false;
+  }
+
+  MappedFile file;
+  if (!file.open(path, false, error)) return false;
+  const unsigned char* base = file.data();
+
+  FileHeader header;
+  if (file.size() < sizeof(header)) {
+    error = path + " is damaged";
+    return false;
+  }
+  std::memcpy(&header, base, sizeof(header));
+  if (std::memcmp(header.magic, magic, sizeof(magic)) != 0
+      || header.byte_order != byte_order || header.version != version
+      || header.levels == 0 || header.levels > MAX_LEVELS) {
+    error = path + " is from another version of shrike or another machine";
+    return false;
+  }
+
+  std::vector<FileLevel> table(header.levels);
+  std::size_t offset = sizeof(header) + table.size()*sizeof(FileLevel);
+  bool ok = file.size() >= offset;
+  if (ok) std::memcpy(&table[0], base + sizeof(header), table.size()*sizeof(FileLevel));
+
+  std::vector<MeshData> levels(ok ? header.levels : 0);
+  for (std::size_t l = 0; ok && l < levels.size(); ++l) {
+    MeshData& level = levels[l];
+    std::size_t vertex_bytes = (std::size_t)table[l].vertices*sizeof(float);
+    std::size_t index_bytes = (std::size_t)table[l].indices*sizeof(unsigned int);
+    ok = table[l].vertices % MeshData::STRIDE == 0 && table[l].indices % 3 == 0
+      && file.size() - offset >= vertex_bytes + index_bytes;
+    if (!ok) break;
+    const float* vertices = reinterpret_cast<const float*>(base + offset);
+    level.vertices.assign(vertices, vertices + table[l].vertices);
+    offset += vertex_bytes;
+    const unsigned int* indices = reinterpret_cast<const unsigned int*>(base + offset);
+    level.indices.assign(indices, indices + table[l].indices);
+    offset += index_bytes;
+    for (std::size_t i = 0; ok && i < level.indices.size(); ++i) {
+      ok = level.indices[i] < level.vertexCount();
+    }
+  }
+  if (!ok) {
+    error = path + " is damaged";
+    return false;
+  }
+
+  m_levels.clear();
+  m_errors.clear();
+  m_levels.reserve(MAX_LEVELS);
+  for (std::size_t l = 0; l < levels.size(); ++l) {
+    m_levels.push_back(MeshData());
+    m_levels.back().vertices.swap(levels[l].vertices);
+    m_levels.back().indices.swap(levels[l].indices);
+    m_errors.push_back(table[l].error);
+  }
+  std::copy(header.center, header.center + 3, m_center);
+  m_radius = header.radius;
+  return true;
+}
+
+bool MeshLod::write(const std::string& path, std::string& error) const
+{
+  FileHeader header;
+  std::memcpy(header.magic, magic, sizeof(magic));
+  header.byte_order = byte_order;
+  header.version = version;
+  header.levels = m_levels.size();
+  std::copy(m_center, m_center + 3, header.center);
+  header.radius = m_radius;
+
+  std::vector<FileLevel> table(m_levels.size());
+  for (std::size_t l = 0; l < m_levels.size(); ++l) {
+    table[l].vertices = m_levels[l].vertices.size();
+    table[l].indices = m_levels[l].indices.size();
+    table[l].error = m_errors[l];
+  }
+
+  std::FILE* file = std::fopen(path.c_str(), "wb");
+  if (!file) {
+    error = "Unable to write " + path;
+    return false;
+  }
+  bool ok = std::fwrite(&header, sizeof(header), 1, file) == 1
+    && (table.empty()
+        || std::fwrite(&table[0], sizeof(FileLevel), table.size(), file) == table.size());
+  for (std::size_t l = 0; ok && l < m_levels.size(); ++l) {
+    const MeshData& level = m_levels[l];
+    ok = (level.vertices.empty()
+          || std::fwrite(&level.vertices[0], sizeof(float), level.vertices.size(), file)
+             == level.vertices.size())
+      && (level.indices.empty()
+          || std::fwrite(&level.indices[0], sizeof(unsigned int), level.indices.size(), file)
+             == level.indices.size());
+  }
+  if (std::fclose(file) != 0) ok = false;
+  if (!ok) {
+    std::remove(path.c_str());
+    error = "Unable to write " + path;
+  }
+  return ok;
+}
@@ -0,0 +1,91 @@
+// Sh: A GPU metaprogramming language.
+//
+// Copyright 2003-2005 Serious Hack Inc.
+// 
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, 
+// MA  02110-1301, USA
+//////////////////////////////////////////////////////////////////////////////
+#ifndef MESHLOD_HPP
+#define MESHLOD_HPP
+
+#include <string>
+#include <vector>
+#include "MeshBuffer.hpp"
+
+/** Collapse edges of data, keeping the ones that move the surface
+ * least (Garland and Heckbert's quadric error metric), until it has
+ * no more than target triangles or nothing more can go without
+ * folding a triangle over.  Each collapse moves one vertex onto a
+ * neighbour, so the survivors keep their normals, texcoords and
+ * tangents as they were; vertices on a texture or normal seam stay
+ * put.  Returns about how far, in model units, the surface moved.
+ */
+float simplify_mesh(MeshData& data, std::size_t target);
+
+/** A model at decreasing levels of detail: the full mesh, then each
+ * level about a quarter of the triangles of the one before, down to a
+ * few hundred.  The coarser levels are cache optimized the way
+ * ShrikeFrame does the full mesh.
+ *
+ * A file of levels is kept next to the OBJ they came from, so neither
+ * the reading nor the simplifying is done again until the OBJ changes:
+ * opening it again maps the file and copies the levels out.
+ */
+class MeshLod {
+public:
+  enum {
+    MAX_LEVELS = 8,
+    MIN_TRIANGLES = 256 // no levels are made below this
+  };
+
+  MeshLod();
+
+  /// Make the levels from data, which becomes level 0 (and is left
+  /// empty).
+  void build(MeshData& data);
+
+  std::size_t levels() const { return m_levels.size(); }
+  const MeshData& level(std::size_t i) const { return m_levels[i]; }
+  /// How far level i can be from level 0, in model units.
+  float error(std::size_t i) const { return m_errors[i]; }
+
+  /// Bounding sphere of level 0.
+  const float* center() const { return m_center; }
+  float radius() const { return m_radius; }
+
+  /// Where the levels of the OBJ at path are kept.
+  static std::string cachePath(const std::string& path);
+
+  /// Read the levels from path, if it is newer than source.  Returns
+  /// false, with error saying why, if it can't.
+  bool read(const std::string& path, const std::string& source, std::string& error);
+  /// Write the levels to path.  Returns false, with error saying why,
+  /// if it can't.
+  bool write(const std::string& path, std::string& error) const;
+
+private:
+  void bound();
+
+  std::vector<MeshData> m_levels;
+  std::vector<float> m_errors;
+  float m_center[3];
+  float m_radius;
+
+  // NOT IMPLEMENTED
+  MeshLod(const MeshLod& other);
+  MeshLod& operator=(const MeshLod& other);
+};
+
+#endif
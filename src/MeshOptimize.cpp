@@ -0,0 +1,244 @@
+// Sh: A GPU metaprogramming language.
+//
+// Copyright 2003-2005 Serious Hack Inc.
+// 
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, 
+// MA  02110-1301, USA
+//////////////////////////////////////////////////////////////////////////////
+#include <algorithm>
+#include <cmath>
+#include "MeshOptimize.hpp"
+
+namespace {
+
+struct VertexLess {
+  VertexLess(const float* vertices) : vertices(vertices) {}
+
+  bool operator()(unsigned int a, unsigned int b) const
+  {
+    const float* va = vertices + a * MeshData::STRIDE;
+    const float* vb = vertices + b * MeshData::STRIDE;
+    return std::lexicographical_compare(va, va + MeshData::STRIDE,
+                                        vb, vb + MeshData::STRIDE);
+  }
+
+  const float* vertices;
+};
+
+// Score of a vertex given its position in the LRU cache (-1 if it is
+// not cached) and the number of triangles still waiting to use it.
+// Constants are the ones from Forsyth's paper.
+float vertex_score(int cache_pos, unsigned int remaining, unsigned int cache_size)
+{
+  if (remaining == 0) return -1.0f;
+
+  float score = 0.0f;
+  if (cache_pos >= 0) {
+    if (cache_pos < 3) {
+      // the last triangle's vertices get a fixed score, so the next
+      // triangle doesn't simply reuse two of them
+      score = 0.75f;
+    } else {
+      float scale = 1.0f / (cache_size - 3);
+      score = std::pow(1.0f - (cache_pos - 3) * scale, 1.5f);
+    }
+  }
+  // boost vertices with few triangles left, so we finish them off
+  score += 2.0f / std::sqrt((float)remaining);
+  return score;
+}
+
+}
+
+void weld_vertices(MeshData& data)
+{
+  std::size_t count = data.vertexCount();
+  if (count == 0) return;
+
+  const float* vertices = &data.vertices[0];
+  std::vector<unsigned int> order(count);
+  for (std::size_t i = 0; i < count; ++i) order[i] = i;
+  std::sort(order.begin(), order.end(), VertexLess(vertices));
+
+  std::vector<unsigned int> remap(count);
+  std::vector<float> welded;
+  welded.reserve(data.vertices.size());
+  unsigned int welded_count = 0;
+  for (std::size_t i = 0; i < count; ++i) {
+    const float* v = vertices + order[i] * MeshData::STRIDE;
+    if (i == 0 || !std::equal(v, v + MeshData::STRIDE,
+                              vertices + order[i - 1] * MeshData::STRIDE)) {
+      welded.insert(welded.end(), v, v + MeshData::STRIDE);
+      ++welded_count;
+    }
+    remap[order[i]] = welded_count - 1;
+  }
+
+  for (std::size_t i = 0; i < data.indices.size(); ++i) {
+    data.indices[i] = remap[data.indices[i]];
+  }
+  data.vertices.swap(welded);
+}
+
+void optimize_vertex_cache(MeshData& data, unsigned int cache_size)
+{
+  std::size_t vertex_count = data.vertexCount();
+  std::size_t triangle_count = data.triangleCount();
+  if (triangle_count == 0 || cache_size < 4) return;
+
+  const std::vector<unsigned int>& indices = data.indices;
+
+  // Triangles using each vertex.  The live triangles of vertex v are
+  // adjacency[offsets[v]] to adjacency[offsets[v] + remaining[v] - 1].
+  std::vector<unsigned int> remaining(vertex_count, 0);
+  for (std::size_t i = 0; i < indices.size(); ++i) ++remaining[indices[i]];
+
+  std::vector<unsigned int> offsets(vertex_count + 1, 0);
+  for (std::size_t v = 0; v < vertex_count; ++v) {
+    offsets[v + 1] = offsets[v] + remaining[v];
+  }
+
+  std::vector<unsigned int> adjacency(indices.size());
+  {
+    std::vector<unsigned int> fill(offsets.begin(), offsets.end() - 1);
+    for (std::size_t i = 0; i < indices.size(); ++i) {
+      adjacency[fill[indices[i]]++] = i / 3;
+    }
+  }
+
+  std::vector<int> cache_pos(vertex_count, -1);
+  std::vector<float> vscore(vertex_count);
+  for (std::size_t v = 0; v < vertex_count; ++v) {
+    vscore[v] = vertex_score(-1, remaining[v], cache_size);
+  }
+
+  std::vector<float> tscore(triangle_count);
+  int best = 0;
+  for (std::size_t t = 0; t < triangle_count; ++t) {
+    tscore[t] = vscore[indices[3*t]] + vscore[indices[3*t + 1]] + vscore[indices[3*t + 2]];
+    if (tscore[t] > tscore[best]) best = t;
+  }
+
+  std::vector<bool> emitted(triangle_count, false);
+  std::vector<unsigned int> result;
+  result.reserve(indices.size());
+
+  // cache holds up to cache_size + 3 entries while it is being updated
+  std::vector<unsigned int> cache, new_cache;
+  cache.reserve(cache_size + 3);
+  new_cache.reserve(cache_size + 3);
+
+  std::size_t cursor = 0;
+  while (result.size() < indices.size()) {
+    if (best < 0) {
+      // Nothing in the cache touches a live triangle.  Restart at the
+      // next unused one in input order rather than searching them all,
+      // which keeps the whole thing linear.
+      while (emitted[cursor]) ++cursor;
+      best = cursor;
+    }
+
+    emitted[best] = true;
+    new_cache.clear();
+    for (int k = 0; k < 3; ++k) {
+      unsigned int v = indices[3*best + k];
+      result.push_back(v);
+
+      // drop the triangle from v's live list
+      unsigned int* begin = &adjacency[offsets[v]];
+      unsigned int* end = begin + remaining[v];
+      unsigned int* it = std::find(begin, end, (unsigned int)best);
+      if (it != end) {
+        std::swap(*it, *(end - 1));
+        --remaining[v];
+      }
+
+      if (std::find(new_cache.begin(), new_cache.end(), v) == new_cache.end()) {
+        new_cache.push_back(v);
+      }
+    }
+    for (std::size_t i = 0; i < cache.size(); ++i) {
+      if (std::find(new_cache.begin(), new_cache.end(), cache[i]) == new_cache.end()) {
+        new_cache.push_back(cache[i]);
+      }
+    }
+
+    // Rescore everything that was or is in the cache, including the
+    // vertices that just fell out of it.
+    for (std::size_t i = 0; i < new_cache.size(); ++i) {
+      unsigned int v = new_cache[i];
+      cache_pos[v] = (i < cache_size ? (int)i : -1);
+      vscore[v] = vertex_score(cache_pos[v], remaining[v], cache_size);
+    }
+
+    best = -1;
+    float best_score = -1.0f;
+    for (std::size_t i = 0; i < new_cache.size(); ++i) {
+      unsigned int v = new_cache[i];
+      for (unsigned int j = offsets[v]; j < offsets[v] + remaining[v]; ++j) {
+        unsigned int t = adjacency[j];
+        tscore[t] = vscore[indices[3*t]] + vscore[indices[3*t + 1]] + vscore[indices[3*t + 2]];
+        if (tscore[t] > best_score) {
+          best_score = tscore[t];
+          best = t;
+        }
+      }
+    }
+
+    if (new_cache.size() > cache_size) new_cache.resize(cache_size);
+    cache.swap(new_cache);
+  }
+
+  data.indices.swap(result);
+}
+
+void reorder_vertices(MeshData& data)
+{
+  std::size_t count = data.vertexCount();
+  const unsigned int unused = ~0u;
+  std::vector<unsigned int> remap(count, unused);
+  std::vector<float> reordered;
+  reordered.reserve(data.vertices.size());
+
+  unsigned int next = 0;
+  for (std::size_t i = 0; i < data.indices.size(); ++i) {
+    unsigned int v = data.indices[i];
+    if (remap[v] == unused) {
+      remap[v] = next++;
+      reordered.insert(reordered.end(),
+                       data.vertices.begin() + v * MeshData::STRIDE,
+                       data.vertices.begin() + (v + 1) * MeshData::STRIDE);
+    }
+    data.indices[i] = remap[v];
+  }
+  data.vertices.swap(reordered);
+}
+
+float average_cache_miss_ratio(const MeshData& data, unsigned int cache_size)
+{
+  if (data.triangleCount() == 0) return 0.0f;
+
+  // stamp[v] is the miss count at which v entered the FIFO, 0 if never
+  std::vector<unsigned int> stamp(data.vertexCount(), 0);
+  unsigned int misses = 0;
+  for (std::size_t i = 0; i < data.indices.size(); ++i) {
+    unsigned int v = data.indices[i];
+    if (stamp[v] == 0 || misses - stamp[v] >= cache_size) {
+      ++misses;
+      stamp[v] = misses;
+    }
+  }
+  return (float)misses / data.triangleCount();
+}
@@ -0,0 +1,48 @@
+// Sh: A GPU metaprogramming language.
+//
+// Copyright 2003-2005 Serious Hack Inc.
+// 
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, 
+// MA  02110-1301, USA
+//////////////////////////////////////////////////////////////////////////////
+#ifndef MESHOPTIMIZE_HPP
+#define MESHOPTIMIZE_HPP
+
+#include "MeshBuffer.hpp"
+
+/** Merge vertices whose position, normal, texcoord and tangent are
+ * identical and point the indices at the survivors.
+ */
+void weld_vertices(MeshData& data);
+
+/** Reorder triangles for post-transform vertex cache locality.
+ * This is Tom Forsyth's linear-speed greedy algorithm, simulating an
+ * LRU cache of cache_size entries.
+ */
+void optimize_vertex_cache(MeshData& data, unsigned int cache_size = 32);
+
+/** Renumber vertices in the order the indices first use them, so
+ * vertex fetches walk the buffer front to back.  Unreferenced
+ * vertices are dropped.
+ */
+void reorder_vertices(MeshData& data);
+
+/** Average number of vertex shader invocations per triangle for a
+ * FIFO post-transform cache of cache_size entries.  Between 0.5 (best
+ * case for large regular meshes) and 3.0 (no reuse at all).
+ */
+float average_cache_miss_ratio(const MeshData& data, unsigned int cache_size = 24);
+
+#endif
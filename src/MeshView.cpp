@@ -0,0 +1,200 @@
+// Sh: A GPU metaprogramming language.
+//
+// Copyright 2003-2005 Serious Hack Inc.
+// 
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, 
+// MA  02110-1301, USA
+//////////////////////////////////////////////////////////////////////////////
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+#include "ShrikeGl.hpp"
+#include "MeshView.hpp"
+
+#define SHRIKE_BUFFER_OFFSET(floats) ((char*)0 + (floats)*sizeof(float))
+
+using namespace ShUtil;
+
+namespace {
+
+/// Layout of a drawVertexLines() vertex.
+enum {
+  LINE_POSITION = 0,
+  LINE_NORMAL = 3,
+  LINE_END = 6, // 0 or 1
+  LINE_TANGENT = 7,
+  LINE_STRIDE = 10
+};
+
+}
+
+ObjMeshSource::ObjMeshSource(const std::string& path, const std::string& text)
+  : m_path(path),
+    m_text(text),
+    m_mesh(0),
+    m_read(false)
+{
+}
+
+ObjMeshSource::~ObjMeshSource()
+{
+  delete m_mesh;
+}
+
+const ShObjMesh* ObjMeshSource::mesh()
+{
+  if (m_read) return m_mesh;
+  m_read = true;
+
+  try {
+    if (!m_text.empty()) {
+      std::istringstream in(m_text);
+      m_mesh = new ShObjMesh(in);
+    } else {
+      std::ifstream in(m_path.c_str());
+      if (in) {
+        m_mesh = new ShObjMesh(in);
+      } else {
+        m_error = "Unable to open " + m_path;
+      }
+    }
+  } catch (const SH::ShException& e) {
+    m_error = m_path + ": " + e.message();
+  }
+  return m_mesh;
+}
+
+bool ObjMeshSource::takeError(std::string& error)
+{
+  if (m_error.empty()) return false;
+  error.swap(m_error);
+  m_error.clear();
+  return true;
+}
+
+MeshView::MeshView()
+  : m_source(0),
+    m_triangles_dirty(true),
+    m_lines(0),
+    m_lines_dirty(true)
+{
+}
+
+MeshView::~MeshView()
+{
+  release();
+}
+
+void MeshView::assign(const MeshData& data)
+{
+  std::size_t count = data.vertexCount();
+  m_positions.resize(count * 3);
+  m_normals.resize(count * 3);
+  m_texcoords.resize(count * 2);
+  m_tangents.resize(count * 3);
+  for (std::size_t i = 0; i < count; ++i) {
+    const float* v = &data.vertices[i * MeshData::STRIDE];
+    std::copy(v + MeshData::POSITION, v + MeshData::POSITION + 3, &m_positions[i * 3]);
+    std::copy(v + MeshData::NORMAL, v + MeshData::NORMAL + 3, &m_normals[i * 3]);
+    std::copy(v + MeshData::TEXCOORD, v + MeshData::TEXCOORD + 2, &m_texcoords[i * 2]);
+    std::copy(v + MeshData::TANGENT, v + MeshData::TANGENT + 3, &m_tangents[i * 3]);
+  }
+  m_indices = data.indices;
+
+  m_triangles_dirty = true;
+  m_lines_dirty = true;
+}
+
+void MeshView::assign(const ShObjMesh& mesh)
+{
+  MeshData data;
+  data.flatten(mesh);
+  assign(data);
+}
+
+const ShObjMesh* MeshView::objMesh() const
+{
+  return m_source ? m_source->mesh() : 0;
+}
+
+void MeshView::drawTriangles() const
+{
+  if (m_triangles_dirty) {
+    MeshData data;
+    data.vertices.resize(vertexCount() * MeshData::STRIDE);
+    for (std::size_t i = 0; i < vertexCount(); ++i) {
+      float* v = &data.vertices[i * MeshData::STRIDE];
+      std::copy(&m_positions[i * 3], &m_positions[i * 3] + 3, v + MeshData::POSITION);
+      std::copy(&m_normals[i * 3], &m_normals[i * 3] + 3, v + MeshData::NORMAL);
+      std::copy(&m_texcoords[i * 2], &m_texcoords[i * 2] + 2, v + MeshData::TEXCOORD);
+      std::copy(&m_tangents[i * 3], &m_tangents[i * 3] + 3, v + MeshData::TANGENT);
+    }
+    data.indices = m_indices;
+    m_triangles.upload(data);
+    m_triangles_dirty = false;
+  }
+  m_triangles.draw();
+}
+
+void MeshView::drawVertexLines() const
+{
+  if (!vertexCount()) return;
+
+  if (!m_lines) glGenBuffersARB(1, &m_lines);
+  glBindBufferARB(GL_ARRAY_BUFFER_ARB, m_lines);
+  if (m_lines_dirty) {
+    std::vector<float> lines(vertexCount() * 2 * LINE_STRIDE);
+    for (std::size_t i = 0; i < vertexCount(); ++i) {
+      for (int end = 0; end < 2; ++end) {
+        float* v = &lines[(i * 2 + end) * LINE_STRIDE];
+        std::copy(&m_positions[i * 3], &m_positions[i * 3] + 3, v + LINE_POSITION);
+        std::copy(&m_normals[i * 3], &m_normals[i * 3] + 3, v + LINE_NORMAL);
+        v[LINE_END] = end;
+        std::copy(&m_tangents[i * 3], &m_tangents[i * 3] + 3, v + LINE_TANGENT);
+      }
+    }
+    glBufferDataARB(GL_ARRAY_BUFFER_ARB, lines.size() * sizeof(float), &lines[0],
+                    GL_STATIC_DRAW_ARB);
+    m_lines_dirty = false;
+  }
+
+  GLsizei stride = LINE_STRIDE * sizeof(float);
+
+  glPushClientAttrib(GL_CLIENT_VERTEX_ARRAY_BIT);
+  glEnableClientState(GL_VERTEX_ARRAY);
+  glVertexPointer(3, GL_FLOAT, stride, SHRIKE_BUFFER_OFFSET(LINE_POSITION));
+  glEnableClientState(GL_NORMAL_ARRAY);
+  glNormalPointer(GL_FLOAT, stride, SHRIKE_BUFFER_OFFSET(LINE_NORMAL));
+  glClientActiveTextureARB(GL_TEXTURE0);
+  glEnableClientState(GL_TEXTURE_COORD_ARRAY);
+  glTexCoordPointer(1, GL_FLOAT, stride, SHRIKE_BUFFER_OFFSET(LINE_END));
+  glClientActiveTextureARB(GL_TEXTURE0 + 1);
+  glEnableClientState(GL_TEXTURE_COORD_ARRAY);
+  glTexCoordPointer(3, GL_FLOAT, stride, SHRIKE_BUFFER_OFFSET(LINE_TANGENT));
+
+  glDrawArrays(GL_LINES, 0, vertexCount() * 2);
+
+  glBindBufferARB(GL_ARRAY_BUFFER_ARB, 0);
+  glPopClientAttrib();
+}
+
+void MeshView::release()
+{
+  m_triangles.release();
+  m_triangles_dirty = true;
+  if (m_lines) glDeleteBuffersARB(1, &m_lines);
+  m_lines = 0;
+  m_lines_dirty = true;
+}
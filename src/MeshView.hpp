@@ -0,0 +1,126 @@
+// Sh: A GPU metaprogramming language.
+//
+// Copyright 2003-2005 Serious Hack Inc.
+// 
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, 
+// MA  02110-1301, USA
+//////////////////////////////////////////////////////////////////////////////
+#ifndef MESHVIEW_HPP
+#define MESHVIEW_HPP
+
+#include <string>
+#include <vector>
+#include <shutil/ShObjMesh.hpp>
+#include "MeshBuffer.hpp"
+
+/** The half-edge ShObjMesh of a model, read from its OBJ the first
+ * time a shader asks for it rather than whenever a model is opened.
+ * Reading it is slow for big models, so shaders should only ask if
+ * they need the mesh's topology.
+ */
+class ObjMeshSource {
+public:
+  /// The OBJ at path, or if text isn't empty the OBJ text itself, in
+  /// which case path only names it.
+  ObjMeshSource(const std::string& path, const std::string& text = "");
+  ~ObjMeshSource();
+
+  /// The mesh, or null if it can't be read.  Only the first call
+  /// reads.
+  const ShUtil::ShObjMesh* mesh();
+
+  /// If mesh() failed since the last call, set error to why and
+  /// return true, so the failure is reported once.
+  bool takeError(std::string& error);
+
+private:
+  std::string m_path;
+  std::string m_text;
+  ShUtil::ShObjMesh* m_mesh;
+  bool m_read;
+  std::string m_error; // not taken yet
+
+  // NOT IMPLEMENTED
+  ObjMeshSource(const ObjMeshSource& other);
+  ObjMeshSource& operator=(const ObjMeshSource& other);
+};
+
+/** A mesh as Shader::render() gets it: flattened once when the model
+ * is loaded, with each attribute in an array of its own, and drawn
+ * from vertex buffers made the first time they're needed.
+ *
+ * Drawing needs a current GL context; nothing else does.
+ */
+class MeshView {
+public:
+  MeshView();
+  ~MeshView();
+
+  /// Replace the contents with data, which may have been welded and
+  /// reordered by MeshOptimize.
+  void assign(const MeshData& data);
+  /// Replace the contents with mesh, flattened as it is.
+  void assign(const ShUtil::ShObjMesh& mesh);
+
+  /// Where objMesh() reads the model from; not owned.
+  void objMeshSource(ObjMeshSource* source) { m_source = source; }
+  /// The whole model as a half-edge mesh, for shaders that need more
+  /// than the flat arrays.  Read the first time any view of the model
+  /// asks for it; null if there is no source or it can't be read.
+  const ShUtil::ShObjMesh* objMesh() const;
+
+  std::size_t vertexCount() const { return m_positions.size() / 3; }
+  std::size_t triangleCount() const { return m_indices.size() / 3; }
+
+  /// One entry per vertex: three floats for positions, normals and
+  /// tangents, two for texcoords.
+  const std::vector<float>& positions() const { return m_positions; }
+  const std::vector<float>& normals() const { return m_normals; }
+  const std::vector<float>& texcoords() const { return m_texcoords; }
+  const std::vector<float>& tangents() const { return m_tangents; }
+  /// Three per triangle.
+  const std::vector<unsigned int>& indices() const { return m_indices; }
+
+  /// Draw the triangles, with the bindings MeshBuffer uses.
+  void drawTriangles() const;
+
+  /// Draw a line at every vertex, both ends at its position, with the
+  /// normal as the normal and on texture unit 0 a texcoord of 0 at the
+  /// first end and 1 at the second, and the tangent on unit 1.  A
+  /// vertex program moves the second end along whichever it shows.
+  void drawVertexLines() const;
+
+  /// Delete the vertex buffers, which are made again by the next draw.
+  void release();
+
+private:
+  std::vector<float> m_positions;
+  std::vector<float> m_normals;
+  std::vector<float> m_texcoords;
+  std::vector<float> m_tangents;
+  std::vector<unsigned int> m_indices;
+  ObjMeshSource* m_source;
+
+  mutable MeshBuffer m_triangles;
+  mutable bool m_triangles_dirty;
+  mutable unsigned int m_lines; // vertex buffer for drawVertexLines()
+  mutable bool m_lines_dirty;
+
+  // NOT IMPLEMENTED
+  MeshView(const MeshView& other);
+  MeshView& operator=(const MeshView& other);
+};
+
+#endif
@@ -0,0 +1,525 @@
+// Sh: A GPU metaprogramming language.
+//
+// Copyright 2003-2005 Serious Hack Inc.
+// 
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, 
+// MA  02110-1301, USA
+//////////////////////////////////////////////////////////////////////////////
+#include <algorithm>
+#include <cmath>
+#include <sstream>
+#include <vector>
+#include "MappedFile.hpp"
+#include "ObjReader.hpp"
+#include "Parallel.hpp"
+
+namespace {
+
+const std::size_t chunk_size = 1 << 20; // bytes of text per chunk of work
+const std::size_t grain = 4096; // vertices per chunk of work
+const unsigned int none = ~0u;
+
+enum { POSITION, TEXCOORD, NORMAL }; // the indices of a corner
+
+/// An index written relative to the end of the list (negative), which
+/// can't be made absolute until the chunks before are counted.
+struct Fixup {
+  std::size_t slot; // in Chunk::corners
+  long local; // from the start of the chunk's list
+};
+
+/// What one run of lines holds.
+struct Chunk {
+  const char* begin;
+  const char* end;
+
+  std::vector<float> positions; // 3 each
+  std::vector<float> texcoords; // 2 each
+  std::vector<float> normals; // 3 each
+  std::vector<long> corners; // position, texcoord, normal, counting from 1, 0 for none
+  std::vector<unsigned int> faces; // corners in each
+  std::vector<Fixup> fixups;
+  const char* error; // start of the first line that couldn't be read
+};
+
+inline bool is_blank(char c)
+{
+  return c == ' ' || c == '\t' || c == '\r';
+}
+
+inline bool is_digit(char c)
+{
+  return c >= '0' && c <= '9';
+}
+
+inline const char* skip_blanks(const char* p, const char* end)
+{
+  while (p != end && is_blank(*p)) ++p;
+  return p;
+}
+
+double power_of_ten(int exponent)
+{
+  // exact up to 1e22
+  static const double exact[] = {
+    1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+  };
+  if (exponent <= 22) return exact[exponent];
+  return std::pow(10.0, exponent);
+}
+
+/// Read a number in C syntax (no hex, infinities or NaNs) at p.  Returns
+/// the end of it, or 0 if there isn't one.  Unlike strtod, the locale
+/// doesn't come into it, and the text needn't end in a null.
+const char* parse_float(const char* p, const char* end, float& value)
+{
+  bool negative = false;
+  if (p != end && (*p == '-' || *p == '+')) negative = (*p++ == '-');
+
+  // Up to 19 significant digits fit in the mantissa; beyond that the
+  // digits only scale it.
+  unsigned long long mantissa = 0;
+  int digits = 0;
+  int exponent = 0;
+  bool any = false;
+  for (; p != end && is_digit(*p); ++p) {
+    any = true;
+    if (digits < 19) {
+      mantissa = mantissa*10 + (*p - '0');
+      if (mantissa) ++digits;
+    } else {
+      ++exponent;
+    }
+  }
+  if (p != end && *p == '.') {
+    for (++p; p != end && is_digit(*p); ++p) {
+      any = true;
+      if (digits < 19) {
+        mantissa = mantissa*10 + (*p - '0');
+        if (mantissa) ++digits;
+        --exponent;
+      }
+    }
+  }
+  if (!any) return 0;
+
+  if (p != end && (*p == 'e' || *p == 'E')) {
+    const char* q = p + 1;
+    bool exponent_negative = false;
+    if (q != end && (*q == '-' || *q == '+')) exponent_negative = (*q++ == '-');
+    if (q != end && is_digit(*q)) {
+      int e = 0;
+      for (; q != end && is_digit(*q); ++q) {
+        if (e < 10000) e = e*10 + (*q - '0');
+      }
+      exponent += exponent_negative ? -e : e;
+      p = q;
+    }
+  }
+
+  double v = (double)mantissa;
+  if (mantissa) {
+    v = exponent < 0 ? v / power_of_ten(-exponent) : v * power_of_ten(exponent);
+  }
+  value = (float)(negative ? -v : v);
+  return p;
+}
+
+/// Read a decimal integer at p.  Returns the end of it, or 0.
+const char* parse_int(const char* p, const char* end, long& value)
+{
+  bool negative = false;
+  if (p != end && (*p == '-' || *p == '+')) negative = (*p++ == '-');
+  if (p == end || !is_digit(*p)) return 0;
+  long v = 0;
+  for (; p != end && is_digit(*p); ++p) {
+    if (v < 1000000000L) v = v*10 + (*p - '0');
+  }
+  value = negative ? -v : v;
+  return p;
+}
+
+/// Read count floats of a v, vt or vn line into values; count is how
+/// many are needed, the rest of up to total are 0 if they're missing.
+const char* parse_floats(const char* p, const char* end, int count, int total,
+                         std::vector<float>& values)
+{
+  for (int i = 0; i < total; ++i) {
+    p = skip_blanks(p, end);
+    float v = 0;
+    const char* q = parse_float(p, end, v);
+    if (!q) {
+      if (i < count) return 0;
+    } else {
+      p = q;
+    }
+    values.push_back(v);
+  }
+  return p;
+}
+
+struct ParseTask : public ParallelTask {
+  std::vector<Chunk>* chunks;
+
+  void run(std::size_t begin, std::size_t end)
+  {
+    for (std::size_t i = begin; i < end; ++i) parse((*chunks)[i]);
+  }
+
+  void parse(Chunk& chunk)
+  {
+    const char* end = chunk.end;
+    const char* p = chunk.begin;
+    while (p != end && !chunk.error) {
+      const char* line = p;
+      const char* eol = std::find(p, end, '\n');
+      if (!parse_line(chunk, skip_blanks(p, eol), eol)) chunk.error = line;
+      p = (eol == end ? end : eol + 1);
+    }
+  }
+
+  bool parse_line(Chunk& chunk, const char* p, const char* end)
+  {
+    const char* q = p;
+    while (q != end && !is_blank(*q)) ++q;
+    // no strings, which would be one allocation a line
+    if (q - p == 1 && p[0] == 'v') return parse_floats(q, end, 3, 3, chunk.positions) != 0;
+    if (q - p == 2 && p[0] == 'v' && p[1] == 't') {
+      return parse_floats(q, end, 1, 2, chunk.texcoords) != 0;
+    }
+    if (q - p == 2 && p[0] == 'v' && p[1] == 'n') {
+      return parse_floats(q, end, 3, 3, chunk.normals) != 0;
+    }
+    if (q - p == 1 && p[0] == 'f') return parse_face(chunk, q, end);
+    return true;
+  }
+
+  bool parse_face(Chunk& chunk, const char* p, const char* end)
+  {
+    std::size_t counts[3] = {
+      chunk.positions.size() / 3, chunk.texcoords.size() / 2, chunk.normals.size() / 3
+    };
+    unsigned int corners = 0;
+    for (p = skip_blanks(p, end); p != end && *p != '#'; p = skip_blanks(p, end)) {
+      long index[3] = {0, 0, 0};
+      if (!(p = parse_int(p, end, index[POSITION]))) return false;
+      if (p != end && *p == '/') {
+        ++p;
+        if (p != end && *p != '/' && !(p = parse_int(p, end, index[TEXCOORD]))) return false;
+        if (p != end && *p == '/' && !(p = parse_int(p + 1, end, index[NORMAL]))) return false;
+      }
+      if (p != end && !is_blank(*p)) return false;
+      if (index[POSITION] == 0) return false;
+
+      for (int a = 0; a < 3; ++a) {
+        if (index[a] < 0) {
+          Fixup fixup;
+          fixup.slot = chunk.corners.size();
+          fixup.local = (long)counts[a] + index[a];
+          chunk.fixups.push_back(fixup);
+          index[a] = 0;
+        }
+        chunk.corners.push_back(index[a]);
+      }
+      ++corners;
+    }
+    if (corners < 3) return false;
+    chunk.faces.push_back(corners);
+    return true;
+  }
+};
+
+/// Cut [begin, end) into chunks of whole lines.
+void split(const char* begin, const char* end, std::vector<Chunk>& chunks)
+{
+  while (begin != end) {
+    const char* stop = end;
+    if ((std::size_t)(end - begin) > chunk_size) {
+      stop = std::find(begin + chunk_size, end, '\n');
+      if (stop != end) ++stop;
+    }
+    chunks.push_back(Chunk());
+    chunks.back().begin = begin;
+    chunks.back().end = stop;
+    chunks.back().error = 0;
+    begin = stop;
+  }
+}
+
+inline void cross(const float* a, const float* b, float* c)
+{
+  c[0] = a[1]*b[2] - a[2]*b[1];
+  c[1] = a[2]*b[0] - a[0]*b[2];
+  c[2] = a[0]*b[1] - a[1]*b[0];
+}
+
+inline float dot(const float* a, const float* b)
+{
+  return a[0]*b[0] + a[1]*b[1] + a[2]*b[2];
+}
+
+inline void normalize(float* v)
+{
+  float length = std::sqrt(dot(v, v));
+  if (length > 0) {
+    v[0] /= length;
+    v[1] /= length;
+    v[2] /= length;
+  }
+}
+
+/// The vertices the corners make, keyed by their indices.
+class VertexTable {
+public:
+  VertexTable(std::size_t corners)
+  {
+    std::size_t size = 1;
+    while (size < 2*corners) size *= 2;
+    m_slots.assign(size, none);
+  }
+
+  /// The vertex for key, which is added if it's new.
+  unsigned int insert(const long* key)
+  {
+    std::size_t mask = m_slots.size() - 1;
+    std::size_t slot = hash(key) & mask;
+    for (;; slot = (slot + 1) & mask) {
+      unsigned int v = m_slots[slot];
+      if (v == none) break;
+      const long* k = &keys[v*3];
+      if (k[0] == key[0] && k[1] == key[1] && k[2] == key[2]) return v;
+    }
+    unsigned int v = keys.size() / 3;
+    m_slots[slot] = v;
+    keys.insert(keys.end(), key, key + 3);
+    return v;
+  }
+
+  std::vector<long> keys; // 3 per vertex
+
+private:
+  static std::size_t hash(const long* key)
+  {
+    unsigned long h = key[0]*73856093ul ^ key[1]*19349663ul ^ key[2]*83492791ul;
+    h ^= h >> 15;
+    h *= 0x2c1b3c6dul;
+    h ^= h >> 12;
+    return h;
+  }
+
+  std::vector<unsigned int> m_slots;
+};
+
+/// Normals, texcoords and tangents of the vertices, and the
+/// interleaved result.
+struct VertexTask : public ParallelTask {
+  const std::vector<long>* keys;
+  const std::vector<float>* positions;
+  const std::vector<float>* texcoords;
+  const std::vector<float>* normals;
+  const std::vector<float>* face_normals; // per position, for corners without one
+  const std::vector<float>* tangents; // summed per vertex
+  MeshData* data;
+
+  void run(std::size_t begin, std::size_t end)
+  {
+    for (std::size_t v = begin; v < end; ++v) {
+      const long* key = &(*keys)[v*3];
+      float* out = &data->vertices[v*MeshData::STRIDE];
+      const float* p = &(*positions)[(key[POSITION] - 1)*3];
+      std::copy(p, p + 3, out + MeshData::POSITION);
+
+      float* n = out + MeshData::NORMAL;
+      const float* source = (key[NORMAL] ? &(*normals)[(key[NORMAL] - 1)*3]
+                             : &(*face_normals)[(key[POSITION] - 1)*3]);
+      std::copy(source, source + 3, n);
+      normalize(n);
+
+      float* tc = out + MeshData::TEXCOORD;
+      if (key[TEXCOORD]) {
+        const float* t = &(*texcoords)[(key[TEXCOORD] - 1)*2];
+        tc[0] = t[0];
+        tc[1] = t[1];
+      } else {
+        spherical(p, tc);
+      }
+
+      // the summed tangent without its part along the normal, or any
+      // direction at right angles to the normal if nothing is left
+      float* t = out + MeshData::TANGENT;
+      std::copy(&(*tangents)[v*3], &(*tangents)[v*3] + 3, t);
+      float along = dot(t, n);
+      for (int i = 0; i < 3; ++i) t[i] -= along*n[i];
+      if (dot(t, t) <= 1e-12f * std::max(along*along, 1e-12f)) {
+        float axis[3] = {0, 0, 0};
+        axis[std::fabs(n[0]) < std::fabs(n[1]) ? (std::fabs(n[0]) < std::fabs(n[2]) ? 0 : 2)
+             : (std::fabs(n[1]) < std::fabs(n[2]) ? 1 : 2)] = 1;
+        cross(n, axis, t);
+      }
+      normalize(t);
+    }
+  }
+
+  static void spherical(const float* p, float* tc)
+  {
+    float r = std::sqrt(dot(p, p));
+    tc[0] = 0.5f + std::atan2(p[2], p[0]) / (2*M_PI);
+    tc[1] = r > 0 ? std::acos(std::max(-1.0f, std::min(1.0f, p[1]/r))) / M_PI : 0.5f;
+  }
+};
+
+/// Line number (from 1) of p in text starting at begin.
+std::size_t line_number(const char* begin, const char* p)
+{
+  return 1 + std::count(begin, p, '\n');
+}
+
+}
+
+bool read_obj(const std::string& path, MeshData& data, std::string& error)
+{
+  MappedFile file;
+  if (!file.open(path, false, error)) return false;
+  const char* text = reinterpret_cast<const char*>(file.data());
+  return parse_obj(text, text + file.size(), path, data, error);
+}
+
+bool parse_obj(const char* begin, const char* end, const std::string& name,
+               MeshData& data, std::string& error)
+{
+  std::vector<Chunk> chunks;
+  split(begin, end, chunks);
+  ParseTask parse_task;
+  parse_task.chunks = &chunks;
+  parallel_for(parse_task, chunks.size(), 1);
+
+  // Where each chunk's vertices start in the whole file's, and the
+  // whole file's
+  std::vector<float> lists[3];
+  std::size_t totals[3] = {0, 0, 0};
+  std::size_t corner_count = 0;
+  for (std::size_t c = 0; c < chunks.size(); ++c) {
+    Chunk& chunk = chunks[c];
+    if (chunk.error) {
+      std::ostringstream s;
+      s << name << ":" << line_number(begin, chunk.error) << ": can't read this line";
+      error = s.str();
+      return false;
+    }
+    for (std::size_t f = 0; f < chunk.fixups.size(); ++f) {
+      const Fixup& fixup = chunk.fixups[f];
+      chunk.corners[fixup.slot] = (long)totals[fixup.slot % 3] + fixup.local + 1;
+      if (chunk.corners[fixup.slot] <= 0) chunk.corners[fixup.slot] = -1; // caught below
+    }
+    totals[POSITION] += chunk.positions.size() / 3;
+    totals[TEXCOORD] += chunk.texcoords.size() / 2;
+    totals[NORMAL] += chunk.normals.size() / 3;
+    corner_count += chunk.corners.size() / 3;
+  }
+  for (std::size_t c = 0; c < chunks.size(); ++c) {
+    Chunk& chunk = chunks[c];
+    lists[POSITION].insert(lists[POSITION].end(), chunk.positions.begin(), chunk.positions.end());
+    lists[TEXCOORD].insert(lists[TEXCOORD].end(), chunk.texcoords.begin(), chunk.texcoords.end());
+    lists[NORMAL].insert(lists[NORMAL].end(), chunk.normals.begin(), chunk.normals.end());
+    std::vector<float>().swap(chunk.positions);
+    std::vector<float>().swap(chunk.texcoords);
+    std::vector<float>().swap(chunk.normals);
+  }
+  const std::vector<float>& positions = lists[POSITION];
+
+  // Corners to vertices, and faces to triangles
+  VertexTable table(corner_count);
+  data.clear();
+  bool missing_normals = false;
+  for (std::size_t c = 0; c < chunks.size(); ++c) {
+    const Chunk& chunk = chunks[c];
+    const long* corner = chunk.corners.empty() ? 0 : &chunk.corners[0];
+    for (std::size_t f = 0; f < chunk.faces.size(); ++f) {
+      unsigned int first = none, previous = none;
+      for (unsigned int i = 0; i < chunk.faces[f]; ++i, corner += 3) {
+        for (int a = 0; a < 3; ++a) {
+          if (corner[a] < 0 || corner[a] > (long)totals[a] || (a == POSITION && !corner[a])) {
+            error = name + ": a face names a vertex that isn't there";
+            return false;
+          }
+        }
+        if (!corner[NORMAL]) missing_normals = true;
+        unsigned int v = table.insert(corner);
+        if (i >= 2) {
+          data.indices.push_back(first);
+          data.indices.push_back(previous);
+          data.indices.push_back(v);
+        }
+        if (i == 0) first = v;
+        previous = v;
+      }
+    }
+  }
+  chunks.clear();
+  const std::vector<long>& keys = table.keys;
+  std::size_t count = keys.size() / 3;
+
+  // Face normals summed at each position, weighted by area, and
+  // texcoord tangents summed at each vertex
+  std::vector<float> face_normals(missing_normals ? positions.size() : 0);
+  std::vector<float> tangents(count*3);
+  for (std::size_t i = 0; i < data.indices.size(); i += 3) {
+    const unsigned int* tri = &data.indices[i];
+    const float* p[3];
+    for (int k = 0; k < 3; ++k) p[k] = &positions[(keys[tri[k]*3 + POSITION] - 1)*3];
+    float e1[3], e2[3];
+    for (int j = 0; j < 3; ++j) {
+      e1[j] = p[1][j] - p[0][j];
+      e2[j] = p[2][j] - p[0][j];
+    }
+    if (missing_normals) {
+      float n[3];
+      cross(e1, e2, n);
+      for (int k = 0; k < 3; ++k) {
+        float* sum = &face_normals[(keys[tri[k]*3 + POSITION] - 1)*3];
+        for (int j = 0; j < 3; ++j) sum[j] += n[j];
+      }
+    }
+
+    if (!keys[tri[0]*3 + TEXCOORD] || !keys[tri[1]*3 + TEXCOORD]
+        || !keys[tri[2]*3 + TEXCOORD]) {
+      continue;
+    }
+    const float* t[3];
+    for (int k = 0; k < 3; ++k) t[k] = &lists[TEXCOORD][(keys[tri[k]*3 + TEXCOORD] - 1)*2];
+    float du1 = t[1][0] - t[0][0], dv1 = t[1][1] - t[0][1];
+    float du2 = t[2][0] - t[0][0], dv2 = t[2][1] - t[0][1];
+    float det = du1*dv2 - du2*dv1;
+    if (det == 0) continue;
+    float sign = det > 0 ? 1.0f : -1.0f;
+    for (int k = 0; k < 3; ++k) {
+      float* sum = &tangents[tri[k]*3];
+      for (int j = 0; j < 3; ++j) sum[j] += sign*(e1[j]*dv2 - e2[j]*dv1);
+    }
+  }
+
+  data.vertices.resize(count*MeshData::STRIDE);
+  VertexTask vertex_task;
+  vertex_task.keys = &keys;
+  vertex_task.positions = &positions;
+  vertex_task.texcoords = &lists[TEXCOORD];
+  vertex_task.normals = &lists[NORMAL];
+  vertex_task.face_normals = &face_normals;
+  vertex_task.tangents = &tangents;
+  vertex_task.data = &data;
+  parallel_for(vertex_task, count, grain);
+  return true;
+}
@@ -0,0 +1,48 @@
+// Sh: A GPU metaprogramming language.
+//
+// Copyright 2003-2005 Serious Hack Inc.
+// 
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, 
+// MA  02110-1301, USA
+//////////////////////////////////////////////////////////////////////////////
+#ifndef OBJREADER_HPP
+#define OBJREADER_HPP
+
+#include <string>
+#include "MeshBuffer.hpp"
+
+/** Read the OBJ at path into data, with a vertex for each different
+ * position, texcoord and normal a face corner names.  Polygons are
+ * fanned into triangles, as MeshData::flatten does.
+ *
+ * The file is mapped and cut into chunks of whole lines, parsed on all
+ * processors with a number parser that doesn't care about the locale.
+ * Corners without a normal get the average of the faces around their
+ * position, corners without a texcoord one spherical about the
+ * origin.  Tangents follow the texcoords' first coordinate across the
+ * faces around each vertex, at right angles to its normal.
+ *
+ * Returns false, with the reason in error, if the file can't be read
+ * or a face names a vertex that isn't there.  Only v, vt, vn and f
+ * lines are used; groups, materials and smoothing are ignored.
+ */
+bool read_obj(const std::string& path, MeshData& data, std::string& error);
+
+/// Likewise for the OBJ text in [begin, end).  name is what error
+/// calls it.
+bool parse_obj(const char* begin, const char* end, const std::string& name,
+               MeshData& data, std::string& error);
+
+#endif
@@ -0,0 +1,77 @@
+// Sh: A GPU metaprogramming language.
+//
+// Copyright 2003-2005 Serious Hack Inc.
+// 
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, 
+// MA  02110-1301, USA
+//////////////////////////////////////////////////////////////////////////////
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+#include <vector>
+#include "ShrikeGl.hpp"
+#if defined(HAVE_OSMESA) && defined(HAVE_GL_OSMESA_H)
+# include <GL/osmesa.h>
+# define SHRIKE_HAVE_OSMESA 1
+#endif
+#include "OffscreenContext.hpp"
+
+struct OffscreenContext::Impl {
+#ifdef SHRIKE_HAVE_OSMESA
+  OSMesaContext context;
+  std::vector<unsigned char> buffer;
+#endif
+};
+
+OffscreenContext::OffscreenContext(int width, int height)
+  : m_impl(0)
+{
+#ifdef SHRIKE_HAVE_OSMESA
+  OSMesaContext context = OSMesaCreateContextExt(OSMESA_RGBA, 24, 0, 0, 0);
+  if (!context) return;
+
+  m_impl = new Impl();
+  m_impl->context = context;
+  m_impl->buffer.resize(width * height * 4);
+  if (!OSMesaMakeCurrent(context, &m_impl->buffer[0], GL_UNSIGNED_BYTE,
+                         width, height)) {
+    OSMesaDestroyContext(context);
+    delete m_impl;
+    m_impl = 0;
+  }
+#endif
+}
+
+OffscreenContext::~OffscreenContext()
+{
+#ifdef SHRIKE_HAVE_OSMESA
+  if (m_impl) OSMesaDestroyContext(m_impl->context);
+#endif
+  delete m_impl;
+}
+
+bool OffscreenContext::valid() const
+{
+  return m_impl != 0;
+}
+
+bool OffscreenContext::available()
+{
+#ifdef SHRIKE_HAVE_OSMESA
+  return true;
+#else
+  return false;
+#endif
+}
@@ -0,0 +1,46 @@
+// Sh: A GPU metaprogramming language.
+//
+// Copyright 2003-2005 Serious Hack Inc.
+// 
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, 
+// MA  02110-1301, USA
+//////////////////////////////////////////////////////////////////////////////
+#ifndef OFFSCREENCONTEXT_HPP
+#define OFFSCREENCONTEXT_HPP
+
+/** A GL context rendering into client memory, so no window system is
+ * needed.  Only available when shrike was configured with OSMesa.
+ * The context is current from construction until destruction.
+ */
+class OffscreenContext {
+public:
+  OffscreenContext(int width, int height);
+  ~OffscreenContext();
+
+  bool valid() const;
+
+  /// Whether shrike was built with OSMesa at all.
+  static bool available();
+
+private:
+  struct Impl;
+  Impl* m_impl;
+
+  // NOT IMPLEMENTED
+  OffscreenContext(const OffscreenContext& other);
+  OffscreenContext& operator=(const OffscreenContext& other);
+};
+
+#endif
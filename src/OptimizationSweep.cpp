@@ -0,0 +1,223 @@
+// Sh: A GPU metaprogramming language.
+//
+// Copyright 2003-2005 Serious Hack Inc.
+// 
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, 
+// MA  02110-1301, USA
+//////////////////////////////////////////////////////////////////////////////
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <sh/sh.hpp>
+#include "ShrikeGl.hpp"
+#include "Bench.hpp"
+#include "CompareView.hpp"
+#include "OptimizationSweep.hpp"
+#include "ProgramCache.hpp"
+#include "ProgramCost.hpp"
+#include "Shader.hpp"
+#include "Timer.hpp"
+
+using namespace SH;
+
+SweepResult::SweepResult()
+  : level(0), ok(false),
+    init_ms(0), compile_ms(0),
+    vertex_instructions(0), fragment_instructions(0),
+    frame_ms(0),
+    reference(false), max_difference(0), differing(0), matches(false)
+{
+}
+
+OptimizationSweep::OptimizationSweep(ViewportRenderer& renderer, int width, int height)
+  : m_renderer(renderer), m_width(width), m_height(height),
+    m_frames(20), m_tolerance(2)
+{
+  for (int level = 0; level <= 3; ++level) m_levels.push_back(level);
+}
+
+void OptimizationSweep::levels(const std::vector<int>& levels)
+{
+  m_levels = levels;
+}
+
+void OptimizationSweep::run(Shader* shader, SweepResultList& results)
+{
+  int original = ShContext::current()->optimization();
+  bool cache = ProgramCache::instance().enabled();
+  ProgramCache::instance().enabled(false);
+
+  m_reference.clear();
+  for (std::size_t i = 0; i < m_levels.size(); ++i) {
+    results.push_back(SweepResult());
+    results.back().name = shader->name();
+    results.back().level = m_levels[i];
+    run_level(shader, results.back());
+  }
+
+  ShContext::current()->optimization(original);
+  ProgramCache::instance().enabled(cache);
+  try {
+    shader->init();
+  } catch (...) {
+    // It worked before the sweep, so this is unlikely, but don't leave
+    // programs from the last level in place of the real ones.
+    shader->set_failed(true);
+  }
+  shader->release();
+}
+
+void OptimizationSweep::run_level(Shader* shader, SweepResult& result)
+{
+  ShContext::current()->optimization(result.level);
+  try {
+    // Sh optimizes when a program is defined, so init() has to run
+    // again for the level to take effect.
+    shader->release();
+    ShTimer start = ShTimer::now();
+    bool success = shader->init();
+    result.init_ms = (ShTimer::now() - start).value();
+    if (!success) {
+      result.error = "init failed";
+      return;
+    }
+
+    start = ShTimer::now();
+    shader->bind();
+    glFinish();
+    result.compile_ms = (ShTimer::now() - start).value();
+
+    ProgramCost cost;
+    if (cost.measure(GL_VERTEX_PROGRAM_ARB)) {
+      result.vertex_instructions = cost.used[ProgramCost::INSTRUCTIONS];
+    }
+    if (cost.measure(GL_FRAGMENT_PROGRAM_ARB)) {
+      result.fragment_instructions = cost.used[ProgramCost::INSTRUCTIONS];
+    }
+    Shader::unbind();
+
+    // The first frame is not timed, it's where drivers finish their
+    // own compiling.
+    std::vector<float> samples;
+    samples.reserve(m_frames);
+    for (int i = 0; i <= m_frames; ++i) {
+      start = ShTimer::now();
+      m_renderer.renderViewport(shader, m_width, m_height);
+      glFinish();
+      if (i > 0) samples.push_back((ShTimer::now() - start).value());
+    }
+    TimingStats stats;
+    stats.compute(samples);
+    result.frame_ms = stats.p50;
+    result.ok = true;
+  } catch (const ShException& e) {
+    result.error = e.message();
+  } catch (...) {
+    result.error = "unknown exception";
+  }
+  Shader::unbind();
+
+  if (result.ok) compare(result);
+}
+
+void OptimizationSweep::read_pixels(std::vector<unsigned char>& pixels) const
+{
+  pixels.resize(4*m_width*m_height);
+  glPixelStorei(GL_PACK_ALIGNMENT, 1);
+  glReadPixels(0, 0, m_width, m_height, GL_RGBA, GL_UNSIGNED_BYTE, &pixels[0]);
+}
+
+void OptimizationSweep::compare(SweepResult& result)
+{
+  if (m_reference.empty()) {
+    read_pixels(m_reference);
+    result.reference = true;
+    result.matches = true;
+    return;
+  }
+
+  read_pixels(m_pixels);
+  for (std::size_t i = 0; i < m_pixels.size(); i += 4) {
+    int worst = 0;
+    for (int c = 0; c < 4; ++c) {
+      int d = std::abs((int)m_pixels[i + c] - (int)m_reference[i + c]);
+      if (d > worst) worst = d;
+    }
+    if (worst > result.max_difference) result.max_difference = worst;
+    if (worst > m_tolerance) ++result.differing;
+  }
+  result.matches = result.differing == 0;
+}
+
+void write_sweep_table(std::ostream& out, const SweepResultList& results)
+{
+  std::size_t width = 6;
+  for (SweepResultList::const_iterator I = results.begin(); I != results.end(); ++I) {
+    if (I->name.size() > width) width = I->name.size();
+  }
+
+  char line[256];
+  std::sprintf(line, "%-*s  level  init ms  compile ms  vp instr  fp instr  frame ms  picture",
+               (int)width, "shader");
+  out << line << std::endl;
+  for (SweepResultList::const_iterator I = results.begin(); I != results.end(); ++I) {
+    // Each shader's name only on its first row
+    bool first = I == results.begin() || (I - 1)->name != I->name;
+    const char* name = first ? I->name.c_str() : "";
+    if (!I->ok) {
+      std::sprintf(line, "%-*s  %5d  failed: ", (int)width, name, I->level);
+      out << line << I->error << std::endl;
+      continue;
+    }
+
+    char picture[64];
+    if (I->reference) {
+      std::sprintf(picture, "reference");
+    } else if (I->matches) {
+      std::sprintf(picture, "same (max %d)", I->max_difference);
+    } else {
+      std::sprintf(picture, "DIFFERS: %lu pixels, max %d", I->differing, I->max_difference);
+    }
+    std::sprintf(line, "%-*s  %5d  %7.2f  %10.2f  %8d  %8d  %8.2f  %s",
+                 (int)width, name, I->level, I->init_ms, I->compile_ms,
+                 I->vertex_instructions, I->fragment_instructions,
+                 I->frame_ms, picture);
+    out << line << std::endl;
+  }
+}
+
+void write_sweep_csv(std::ostream& out, const SweepResultList& results)
+{
+  out << "shader,level,status,init_ms,compile_ms,vertex_instructions,"
+      << "fragment_instructions,frame_ms,max_difference,differing_pixels,matches,error"
+      << std::endl;
+  for (SweepResultList::const_iterator I = results.begin(); I != results.end(); ++I) {
+    out << csv_quote(I->name) << ','
+        << I->level << ','
+        << (I->ok ? "ok" : "failed") << ','
+        << I->init_ms << ','
+        << I->compile_ms << ','
+        << I->vertex_instructions << ','
+        << I->fragment_instructions << ','
+        << I->frame_ms << ','
+        << I->max_difference << ','
+        << I->differing << ','
+        << (I->matches ? "yes" : "no") << ','
+        << csv_quote(I->error) << std::endl;
+  }
+}
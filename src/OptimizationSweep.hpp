@@ -0,0 +1,106 @@
+// Sh: A GPU metaprogramming language.
+//
+// Copyright 2003-2005 Serious Hack Inc.
+// 
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, 
+// MA  02110-1301, USA
+//////////////////////////////////////////////////////////////////////////////
+#ifndef OPTIMIZATIONSWEEP_HPP
+#define OPTIMIZATIONSWEEP_HPP
+
+#include <string>
+#include <vector>
+#include <iosfwd>
+
+class Shader;
+class ViewportRenderer;
+
+/// How a shader did at one optimization level.
+struct SweepResult {
+  SweepResult();
+
+  std::string name;
+  int level;
+  bool ok;
+  std::string error;
+
+  float init_ms; // Shader::init, which is where Sh optimizes
+  float compile_ms; // Shader::compile and the first bind
+  int vertex_instructions; // native, see ProgramCost
+  int fragment_instructions;
+  float frame_ms; // median
+
+  bool reference; // the picture the other levels are compared with
+  int max_difference; // largest channel difference from it, 0 to 255
+  unsigned long differing; // pixels off by more than the tolerance
+  bool matches;
+};
+
+typedef std::vector<SweepResult> SweepResultList;
+
+/** Rebuilds a shader at each of several Sh optimization levels and
+ * says what each cost: init and compile time, instruction counts and
+ * frame time.  The picture drawn at each level is read back and
+ * compared with the first level's, since an optimization that changes
+ * what the shader draws is a bug and not a speedup.
+ *
+ * The program cache is turned off while sweeping, so every level is
+ * really compiled.  Needs the GL context of renderer to be current.
+ */
+class OptimizationSweep {
+public:
+  OptimizationSweep(ViewportRenderer& renderer, int width, int height);
+
+  /// Levels to try, in order.  Defaults to 0 to 3.
+  void levels(const std::vector<int>& levels);
+  const std::vector<int>& levels() const { return m_levels; }
+
+  /// Timed frames per level.  Defaults to 20.
+  void frames(int frames) { m_frames = frames; }
+
+  /// Largest difference in any channel, out of 255, that still counts
+  /// as the same picture.  Defaults to 2, for rounding.
+  void tolerance(int tolerance) { m_tolerance = tolerance; }
+
+  /// Sweep shader, which must have had firstTimeInit(), adding a
+  /// result per level.  Afterwards the shader is rebuilt at the level
+  /// that was set before, but not compiled.
+  void run(Shader* shader, SweepResultList& results);
+
+private:
+  void run_level(Shader* shader, SweepResult& result);
+  void read_pixels(std::vector<unsigned char>& pixels) const;
+  void compare(SweepResult& result);
+
+  ViewportRenderer& m_renderer;
+  int m_width, m_height;
+  std::vector<int> m_levels;
+  int m_frames;
+  int m_tolerance;
+
+  std::vector<unsigned char> m_reference;
+  std::vector<unsigned char> m_pixels;
+
+  // NOT IMPLEMENTED
+  OptimizationSweep(const OptimizationSweep& other);
+  OptimizationSweep& operator=(const OptimizationSweep& other);
+};
+
+/// Write results as a table lined up for reading.
+void write_sweep_table(std::ostream& out, const SweepResultList& results);
+
+void write_sweep_csv(std::ostream& out, const SweepResultList& results);
+
+#endif
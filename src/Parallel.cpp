@@ -0,0 +1,372 @@
+// Sh: A GPU metaprogramming language.
+//
+// Copyright 2003-2005 Serious Hack Inc.
+// 
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, 
+// MA  02110-1301, USA
+//////////////////////////////////////////////////////////////////////////////
+#include <algorithm>
+#include <climits>
+#include <deque>
+#include <vector>
+#ifdef WIN32
+#include <windows.h>
+#else
+#include <pthread.h>
+#include <unistd.h>
+#endif
+#include "Parallel.hpp"
+
+namespace {
+
+#ifdef WIN32
+inline long atomic_decrement(volatile long* value) { return InterlockedDecrement(value); }
+#else
+inline long atomic_decrement(volatile long* value) { return __sync_sub_and_fetch(value, 1); }
+#endif
+
+#ifdef WIN32
+inline void atomic_store(volatile long* value, long v) { InterlockedExchange(value, v); }
+inline long atomic_load(const volatile long* value) { return InterlockedCompareExchange(const_cast<volatile long*>(value), 0, 0); }
+#else
+inline void atomic_store(volatile long* value, long v) { __sync_synchronize(); *value = v; }
+inline long atomic_load(const volatile long* value) { return __sync_fetch_and_add(const_cast<volatile long*>(value), 0); }
+#endif
+
+class Lock {
+public:
+#ifdef WIN32
+  Lock() { InitializeCriticalSection(&m_lock); }
+  ~Lock() { DeleteCriticalSection(&m_lock); }
+  void acquire() { EnterCriticalSection(&m_lock); }
+  void release() { LeaveCriticalSection(&m_lock); }
+#else
+  Lock() { pthread_mutex_init(&m_lock, 0); }
+  ~Lock() { pthread_mutex_destroy(&m_lock); }
+  void acquire() { pthread_mutex_lock(&m_lock); }
+  void release() { pthread_mutex_unlock(&m_lock); }
+#endif
+
+private:
+#ifdef WIN32
+  CRITICAL_SECTION m_lock;
+#else
+  pthread_mutex_t m_lock;
+#endif
+
+  // NOT IMPLEMENTED
+  Lock(const Lock& other);
+  Lock& operator=(const Lock& other);
+};
+
+/// Counting semaphore.
+class Semaphore {
+public:
+#ifdef WIN32
+  Semaphore() : m_semaphore(CreateSemaphore(0, 0, LONG_MAX, 0)) {}
+  ~Semaphore() { CloseHandle(m_semaphore); }
+  void post(int count) { ReleaseSemaphore(m_semaphore, count, 0); }
+  void wait() { WaitForSingleObject(m_semaphore, INFINITE); }
+#else
+  Semaphore() : m_count(0)
+  {
+    pthread_mutex_init(&m_lock, 0);
+    pthread_cond_init(&m_posted, 0);
+  }
+  ~Semaphore()
+  {
+    pthread_cond_destroy(&m_posted);
+    pthread_mutex_destroy(&m_lock);
+  }
+  void post(int count)
+  {
+    pthread_mutex_lock(&m_lock);
+    m_count += count;
+    pthread_cond_broadcast(&m_posted);
+    pthread_mutex_unlock(&m_lock);
+  }
+  void wait()
+  {
+    pthread_mutex_lock(&m_lock);
+    while (m_count == 0) pthread_cond_wait(&m_posted, &m_lock);
+    --m_count;
+    pthread_mutex_unlock(&m_lock);
+  }
+#endif
+
+private:
+#ifdef WIN32
+  HANDLE m_semaphore;
+#else
+  int m_count;
+  pthread_mutex_t m_lock;
+  pthread_cond_t m_posted;
+#endif
+
+  // NOT IMPLEMENTED
+  Semaphore(const Semaphore& other);
+  Semaphore& operator=(const Semaphore& other);
+};
+
+struct Chunk {
+  ParallelTask* task;
+  std::size_t begin;
+  std::size_t end;
+};
+
+/// A thread's chunks.  Its owner takes from the back, thieves from the
+/// front.
+struct Queue {
+  Lock lock;
+  std::deque<Chunk> chunks;
+};
+
+class Pool {
+public:
+  static Pool& instance();
+
+  void run(ParallelTask& task, std::size_t count, std::size_t grain);
+
+private:
+  Pool();
+
+  bool take(std::size_t self, Chunk& chunk);
+  void work(std::size_t self);
+
+  struct Start {
+    Pool* pool;
+    std::size_t self;
+  };
+#ifdef WIN32
+  static DWORD WINAPI thread(LPVOID start);
+#else
+  static void* thread(void* start);
+#endif
+
+  // m_queues[0] belongs to whoever called run()
+  std::vector<Queue*> m_queues;
+  Lock m_running; // held for the whole of run()
+  Semaphore m_wake; // posted once per pool thread for each run()
+  Semaphore m_done; // posted when the last chunk of a run() is done
+  volatile long m_remaining; // chunks not yet done
+
+  // NOT IMPLEMENTED
+  Pool(const Pool& other);
+  Pool& operator=(const Pool& other);
+};
+
+Pool& Pool::instance()
+{
+  // Never deleted: the threads wait on m_wake until the process exits.
+  static Pool* pool = new Pool();
+  return *pool;
+}
+
+Pool::Pool()
+  : m_remaining(0)
+{
+  m_queues.push_back(new Queue());
+  for (int i = 1; i < cpu_count(); ++i) {
+    m_queues.push_back(new Queue());
+    Start* start = new Start();
+    start->pool = this;
+    start->self = m_queues.size() - 1;
+#ifdef WIN32
+    HANDLE handle = CreateThread(0, 0, thread, start, 0, 0);
+    if (handle) {
+      CloseHandle(handle);
+      continue;
+    }
+#else
+    pthread_t handle;
+    if (pthread_create(&handle, 0, thread, start) == 0) {
+      pthread_detach(handle);
+      continue;
+    }
+#endif
+    delete start;
+    delete m_queues.back();
+    m_queues.pop_back();
+    break;
+  }
+}
+
+#ifdef WIN32
+DWORD WINAPI Pool::thread(LPVOID data)
+#else
+void* Pool::thread(void* data)
+#endif
+{
+  Start* start = static_cast<Start*>(data);
+  Pool* pool = start->pool;
+  std::size_t self = start->self;
+  delete start;
+
+  for (;;) {
+    pool->m_wake.wait();
+    pool->work(self);
+  }
+  return 0;
+}
+
+bool Pool::take(std::size_t self, Chunk& chunk)
+{
+  Queue* own = m_queues[self];
+  own->lock.acquire();
+  bool found = !own->chunks.empty();
+  if (found) {
+    chunk = own->chunks.back();
+    own->chunks.pop_back();
+  }
+  own->lock.release();
+  if (found) return true;
+
+  for (std::size_t i = 1; i < m_queues.size(); ++i) {
+    Queue* victim = m_queues[(self + i) % m_queues.size()];
+    victim->lock.acquire();
+    found = !victim->chunks.empty();
+    if (found) {
+      chunk = victim->chunks.front();
+      victim->chunks.pop_front();
+    }
+    victim->lock.release();
+    if (found) return true;
+  }
+  return false;
+}
+
+void Pool::work(std::size_t self)
+{
+  Chunk chunk;
+  while (take(self, chunk)) {
+    chunk.task->run(chunk.begin, chunk.end);
+    if (atomic_decrement(&m_remaining) == 0) m_done.post(1);
+  }
+}
+
+void Pool::run(ParallelTask& task, std::size_t count, std::size_t grain)
+{
+  std::size_t chunks = (count + grain - 1) / grain;
+
+  m_running.acquire();
+  m_remaining = chunks;
+
+  // Deal out contiguous runs of chunks, so neighbouring items stay on
+  // one thread unless they're stolen.
+  std::size_t threads = std::min(m_queues.size(), chunks);
+  for (std::size_t t = 0; t < threads; ++t) {
+    Queue* queue = m_queues[t];
+    queue->lock.acquire();
+    for (std::size_t c = chunks * t / threads; c < chunks * (t + 1) / threads; ++c) {
+      Chunk chunk;
+      chunk.task = &task;
+      chunk.begin = c * grain;
+      chunk.end = std::min(chunk.begin + grain, count);
+      queue->chunks.push_front(chunk);
+    }
+    queue->lock.release();
+  }
+  if (threads > 1) m_wake.post(threads - 1);
+
+  work(0);
+  m_done.wait();
+  m_running.release();
+}
+
+}
+
+int cpu_count()
+{
+#ifdef WIN32
+  SYSTEM_INFO info;
+  GetSystemInfo(&info);
+  return info.dwNumberOfProcessors;
+#else
+  long count = sysconf(_SC_NPROCESSORS_ONLN);
+  return count > 0 ? count : 1;
+#endif
+}
+
+void parallel_for(ParallelTask& task, std::size_t count, std::size_t grain)
+{
+  if (grain == 0) grain = 1;
+  if (count <= grain) {
+    if (count) task.run(0, count);
+    return;
+  }
+  Pool::instance().run(task, count, grain);
+}
+
+BackgroundTask::BackgroundTask()
+  : m_thread(0), m_done(0)
+{
+}
+
+BackgroundTask::~BackgroundTask()
+{
+  wait();
+}
+
+void BackgroundTask::wait()
+{
+  if (!m_thread) return;
+#ifdef WIN32
+  HANDLE handle = static_cast<HANDLE>(m_thread);
+  WaitForSingleObject(handle, INFINITE);
+  CloseHandle(handle);
+#else
+  pthread_t* handle = static_cast<pthread_t*>(m_thread);
+  pthread_join(*handle, 0);
+  delete handle;
+#endif
+  m_thread = 0;
+}
+
+void BackgroundTask::start()
+{
+#ifdef WIN32
+  HANDLE handle = CreateThread(0, 0, thread, this, 0, 0);
+  if (handle) {
+    m_thread = handle;
+    return;
+  }
+#else
+  pthread_t* handle = new pthread_t;
+  if (pthread_create(handle, 0, thread, this) == 0) {
+    m_thread = handle;
+    return;
+  }
+  delete handle;
+#endif
+  run();
+  atomic_store(&m_done, 1);
+}
+
+bool BackgroundTask::done() const
+{
+  return atomic_load(&m_done) != 0;
+}
+
+#ifdef WIN32
+unsigned long __stdcall BackgroundTask::thread(void* data)
+#else
+void* BackgroundTask::thread(void* data)
+#endif
+{
+  BackgroundTask* task = static_cast<BackgroundTask*>(data);
+  task->run();
+  atomic_store(&task->m_done, 1);
+  return 0;
+}
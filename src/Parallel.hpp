@@ -0,0 +1,92 @@
+// Sh: A GPU metaprogramming language.
+//
+// Copyright 2003-2005 Serious Hack Inc.
+// 
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, 
+// MA  02110-1301, USA
+//////////////////////////////////////////////////////////////////////////////
+#ifndef PARALLEL_HPP
+#define PARALLEL_HPP
+
+#include <cstddef>
+
+/** Work that parallel_for() splits into ranges between threads.
+ */
+class ParallelTask {
+public:
+  virtual ~ParallelTask() {}
+
+  /// Do items [begin, end).  Called from several threads at once, each
+  /// with its own range, so it mustn't touch anything another range
+  /// writes.
+  virtual void run(std::size_t begin, std::size_t end) = 0;
+};
+
+/// Return the number of processors, at least one.
+int cpu_count();
+
+/// Run task over [0, count), grain items at a time, on the calling
+/// thread and a pool of one more thread per processor.  Returns once
+/// every item has been done.
+///
+/// The chunks are dealt out evenly, each thread working through its
+/// own from the back and stealing from the front of another's once it
+/// runs out, so uneven chunks don't leave threads idle.  The threads
+/// are started by the first call and kept for the rest.  Calls from
+/// several threads take turns; a task mustn't call it itself.
+void parallel_for(ParallelTask& task, std::size_t count, std::size_t grain);
+
+/** Work run on a thread of its own, for a caller that polls done()
+ * between other things rather than waiting for it.
+ */
+class BackgroundTask {
+public:
+  BackgroundTask();
+  /// Waits for run() to return.  By then a subclass is already gone,
+  /// so subclasses whose run() uses their members call wait() in
+  /// their own destructors.
+  virtual ~BackgroundTask();
+
+  /// Start run() on a new thread.  If there's no thread to be had it
+  /// is run on this one instead.  Only call once.
+  void start();
+
+  /// Return whether run() has returned.  Never blocks.
+  bool done() const;
+
+  /// Block until run() has returned, if it was started.
+  void wait();
+
+protected:
+  /// The work.  Mustn't touch anything the starting thread uses until
+  /// done() says it has finished.
+  virtual void run() = 0;
+
+private:
+#ifdef WIN32
+  static unsigned long __stdcall thread(void* task);
+#else
+  static void* thread(void* task);
+#endif
+
+  void* m_thread; // the thread's handle, null if it isn't running
+  volatile long m_done;
+
+  // NOT IMPLEMENTED
+  BackgroundTask(const BackgroundTask& other);
+  BackgroundTask& operator=(const BackgroundTask& other);
+};
+
+#endif
@@ -0,0 +1,270 @@
+// Sh: A GPU metaprogramming language.
+//
+// Copyright 2003-2005 Serious Hack Inc.
+// 
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, 
+// MA  02110-1301, USA
+//////////////////////////////////////////////////////////////////////////////
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+#include <cstdio>
+#include <cstring>
+#ifdef HAVE_LIBPNG
+#include <png.h>
+#endif
+#include "PngReader.hpp"
+
+PngImage::PngImage()
+  : width(0), height(0), channels(0), bits(8)
+{
+}
+
+float PngImage::value(std::size_t i) const
+{
+  if (bits == 16) return reinterpret_cast<const unsigned short*>(&pixels[0])[i]/65535.0f;
+  return pixels[i]/255.0f;
+}
+
+#ifdef HAVE_LIBPNG
+
+namespace {
+
+void png_error_message(png_structp png, png_const_charp message)
+{
+  std::string* error = reinterpret_cast<std::string*>(png_get_error_ptr(png));
+  *error = message;
+  longjmp(png_jmpbuf(png), 1);
+}
+
+void png_warning_message(png_structp, png_const_charp)
+{
+}
+
+/// Ask for samples as PngImage holds them.
+void set_transforms(png_structp png, png_infop info)
+{
+  int type = png_get_color_type(png, info);
+  if (type == PNG_COLOR_TYPE_PALETTE) png_set_palette_to_rgb(png);
+  if (type == PNG_COLOR_TYPE_GRAY && png_get_bit_depth(png, info) < 8) {
+    png_set_expand_gray_1_2_4_to_8(png);
+  }
+  if (png_get_bit_depth(png, info) == 16) {
+    // PNG is big endian
+    unsigned short one = 1;
+    if (*reinterpret_cast<unsigned char*>(&one)) png_set_swap(png);
+  }
+}
+
+/// libpng may longjmp out of read_rows, so nothing that needs
+/// destroying can live on its stack.
+bool read_rows(std::FILE* file, PngImage& image, std::vector<unsigned char*>& rows,
+               std::string& error)
+{
+  png_structp png = png_create_read_struct(PNG_LIBPNG_VER_STRING, &error,
+                                           png_error_message, png_warning_message);
+  png_infop info = png ? png_create_info_struct(png) : 0;
+  if (!info) {
+    if (png) png_destroy_read_struct(&png, 0, 0);
+    error = "Could not set up libpng";
+    return false;
+  }
+  if (setjmp(png_jmpbuf(png))) {
+    png_destroy_read_struct(&png, &info, 0);
+    return false;
+  }
+
+  png_init_io(png, file);
+  png_read_info(png, info);
+  set_transforms(png, info);
+  png_set_interlace_handling(png);
+  png_read_update_info(png, info);
+
+  image.width = png_get_image_width(png, info);
+  image.height = png_get_image_height(png, info);
+  image.channels = png_get_channels(png, info);
+  image.bits = png_get_bit_depth(png, info);
+  std::size_t stride = png_get_rowbytes(png, info);
+  image.pixels.resize(stride*image.height);
+  rows.resize(image.height);
+  for (int y = 0; y < image.height; ++y) rows[y] = &image.pixels[y*stride];
+  png_read_image(png, &rows[0]);
+  png_read_end(png, 0);
+  png_destroy_read_struct(&png, &info, 0);
+  return true;
+}
+
+}
+
+bool read_png(const std::string& path, PngImage& image, std::string& error)
+{
+  std::FILE* file = std::fopen(path.c_str(), "rb");
+  if (!file) {
+    error = "Unable to open " + path;
+    return false;
+  }
+  std::vector<unsigned char*> rows;
+  bool ok = read_rows(file, image, rows, error);
+  std::fclose(file);
+  if (!ok) error = path + ": " + error;
+  return ok;
+}
+
+/// libpng's state between rows.
+struct PngRowReader::State {
+  State() : file(0), png(0), info(0), interlaced(false), row(0) {}
+
+  std::FILE* file;
+  png_structp png;
+  png_infop info;
+  std::string error; // filled in by png_error_message
+  bool interlaced;
+  PngImage whole; // an interlaced file, read on open
+  int row;
+};
+
+namespace {
+
+/// Read the header of file.  Nothing that needs destroying lives on
+/// the stack, as libpng may longjmp out.
+bool read_header(png_structp png, png_infop info, std::FILE* file)
+{
+  if (setjmp(png_jmpbuf(png))) return false;
+  png_init_io(png, file);
+  png_read_info(png, info);
+  set_transforms(png, info);
+  png_read_update_info(png, info);
+  return true;
+}
+
+bool read_next_row(png_structp png, unsigned char* row)
+{
+  if (setjmp(png_jmpbuf(png))) return false;
+  png_read_row(png, row, 0);
+  return true;
+}
+
+}
+
+PngRowReader::PngRowReader()
+  : m_width(0), m_height(0), m_channels(0), m_bits(8), m_state(0)
+{
+}
+
+PngRowReader::~PngRowReader()
+{
+  close();
+}
+
+bool PngRowReader::open(const std::string& path, std::string& error)
+{
+  close();
+  m_state = new State();
+  m_state->file = std::fopen(path.c_str(), "rb");
+  if (!m_state->file) {
+    error = "Unable to open " + path;
+    close();
+    return false;
+  }
+  m_state->png = png_create_read_struct(PNG_LIBPNG_VER_STRING, &m_state->error,
+                                        png_error_message, png_warning_message);
+  m_state->info = m_state->png ? png_create_info_struct(m_state->png) : 0;
+  if (!m_state->info) m_state->error = "Could not set up libpng";
+  if (!m_state->info || !read_header(m_state->png, m_state->info, m_state->file)) {
+    error = path + ": " + m_state->error;
+    close();
+    return false;
+  }
+  m_state->interlaced = png_get_interlace_type(m_state->png, m_state->info)
+    != PNG_INTERLACE_NONE;
+  m_width = png_get_image_width(m_state->png, m_state->info);
+  m_height = png_get_image_height(m_state->png, m_state->info);
+  m_channels = png_get_channels(m_state->png, m_state->info);
+  m_bits = png_get_bit_depth(m_state->png, m_state->info);
+
+  if (m_state->interlaced) {
+    // start again with read_png, which handles the passes
+    std::fclose(m_state->file);
+    m_state->file = 0;
+    if (!read_png(path, m_state->whole, error)) {
+      close();
+      return false;
+    }
+  }
+  return true;
+}
+
+bool PngRowReader::read_row(unsigned char* row, std::string& error)
+{
+  if (!m_state || m_state->row >= m_height) {
+    error = "Read past the end of the image";
+    return false;
+  }
+  if (m_state->interlaced) {
+    std::memcpy(row, &m_state->whole.pixels[m_state->row*row_size()], row_size());
+  } else if (!read_next_row(m_state->png, row)) {
+    error = m_state->error;
+    return false;
+  }
+  ++m_state->row;
+  return true;
+}
+
+void PngRowReader::close()
+{
+  if (!m_state) return;
+  if (m_state->png) png_destroy_read_struct(&m_state->png, m_state->info ? &m_state->info : 0, 0);
+  if (m_state->file) std::fclose(m_state->file);
+  delete m_state;
+  m_state = 0;
+}
+
+#else // !HAVE_LIBPNG
+
+bool read_png(const std::string& path, PngImage&, std::string& error)
+{
+  error = "Can't read " + path + ": shrike was built without libpng";
+  return false;
+}
+
+struct PngRowReader::State {
+};
+
+PngRowReader::PngRowReader()
+  : m_width(0), m_height(0), m_channels(0), m_bits(8), m_state(0)
+{
+}
+
+PngRowReader::~PngRowReader()
+{
+}
+
+bool PngRowReader::open(const std::string& path, std::string& error)
+{
+  error = "Can't read " + path + ": shrike was built without libpng";
+  return false;
+}
+
+bool PngRowReader::read_row(unsigned char*, std::string& error)
+{
+  error = "shrike was built without libpng";
+  return false;
+}
+
+void PngRowReader::close()
+{
+}
+
+#endif // HAVE_LIBPNG
@@ -0,0 +1,86 @@
+// Sh: A GPU metaprogramming language.
+//
+// Copyright 2003-2005 Serious Hack Inc.
+// 
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, 
+// MA  02110-1301, USA
+//////////////////////////////////////////////////////////////////////////////
+#ifndef PNGREADER_HPP
+#define PNGREADER_HPP
+
+#include <string>
+#include <vector>
+
+/** The samples of a PNG file as they are stored, before any conversion
+ * to floats.  Palettes are expanded to RGB and low bit depth gray to 8
+ * bits, as ShImage::loadPng does, so channels is 1 to 4 and bits 8 or
+ * 16.  Rows are top to bottom with no padding; 16 bit samples are in
+ * the machine's byte order.
+ */
+struct PngImage {
+  PngImage();
+
+  int width, height;
+  int channels;
+  int bits;
+  std::vector<unsigned char> pixels;
+
+  std::size_t samples() const { return (std::size_t)width*height*channels; }
+  /// Sample i, scaled to [0, 1].
+  float value(std::size_t i) const;
+};
+
+/** Read path into image.  Only uses libpng, so it can run on any
+ * thread.  Returns false, with the reason in error, if the file can't
+ * be read or shrike was configured without libpng.
+ */
+bool read_png(const std::string& path, PngImage& image, std::string& error);
+
+/** Reads a PNG a row at a time, for images too big to hold whole.
+ * Rows come out as read_png lays them out.  An interlaced file can't
+ * be read that way, so it is read whole on open().
+ */
+class PngRowReader {
+public:
+  PngRowReader();
+  ~PngRowReader();
+
+  /// Start reading path.  Returns false, with the reason in error, if
+  /// it can't be.
+  bool open(const std::string& path, std::string& error);
+
+  int width() const { return m_width; }
+  int height() const { return m_height; }
+  int channels() const { return m_channels; }
+  int bits() const { return m_bits; }
+  std::size_t row_size() const { return (std::size_t)m_width*m_channels*m_bits/8; }
+
+  /// Read the next row into row, which holds row_size() bytes.
+  bool read_row(unsigned char* row, std::string& error);
+
+private:
+  void close();
+
+  int m_width, m_height, m_channels, m_bits;
+
+  struct State;
+  State* m_state;
+
+  // NOT IMPLEMENTED
+  PngRowReader(const PngRowReader& other);
+  PngRowReader& operator=(const PngRowReader& other);
+};
+
+#endif
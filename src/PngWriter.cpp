@@ -0,0 +1,201 @@
+// Sh: A GPU metaprogramming language.
+//
+// Copyright 2003-2005 Serious Hack Inc.
+// 
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, 
+// MA  02110-1301, USA
+//////////////////////////////////////////////////////////////////////////////
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+#include <cstdio>
+#include <cstring>
+#ifdef HAVE_LIBPNG
+#include <png.h>
+#else
+#include <shutil/shutil.hpp>
+#endif
+#include "PngWriter.hpp"
+
+#ifdef HAVE_LIBPNG
+
+struct PngWriter::Impl {
+  Impl() : file(0), png(0), info(0) {}
+
+  std::FILE* file;
+  png_structp png;
+  png_infop info;
+  std::string message; // from the last libpng error
+};
+
+namespace {
+
+void png_error_message(png_structp png, png_const_charp message)
+{
+  std::string* error = reinterpret_cast<std::string*>(png_get_error_ptr(png));
+  *error = message;
+  longjmp(png_jmpbuf(png), 1);
+}
+
+void png_warning_message(png_structp, png_const_charp)
+{
+}
+
+}
+
+PngWriter::PngWriter(const std::string& filename, int width, int height, int bits)
+  : m_width(width), m_height(height), m_bits(bits), m_rows(0),
+    m_impl(new Impl())
+{
+  m_impl->file = std::fopen(filename.c_str(), "wb");
+  if (!m_impl->file) {
+    fail("Could not open " + filename + " for writing");
+    return;
+  }
+  m_impl->png = png_create_write_struct(PNG_LIBPNG_VER_STRING, &m_impl->message,
+                                        png_error_message, png_warning_message);
+  if (m_impl->png) m_impl->info = png_create_info_struct(m_impl->png);
+  if (!m_impl->info) {
+    fail("Could not set up libpng");
+    return;
+  }
+  if (setjmp(png_jmpbuf(m_impl->png))) {
+    fail(m_impl->message);
+    return;
+  }
+  png_init_io(m_impl->png, m_impl->file);
+  png_set_IHDR(m_impl->png, m_impl->info, width, height, bits,
+               PNG_COLOR_TYPE_RGB, PNG_INTERLACE_NONE,
+               PNG_COMPRESSION_TYPE_DEFAULT, PNG_FILTER_TYPE_DEFAULT);
+  // Big pictures are mostly time spent in zlib
+  png_set_compression_level(m_impl->png, 3);
+  png_write_info(m_impl->png, m_impl->info);
+
+  // Rows come in as RGBA in host order
+  png_set_filler(m_impl->png, 0, PNG_FILLER_AFTER);
+  unsigned short one = 1;
+  if (bits == 16 && *reinterpret_cast<unsigned char*>(&one) == 1) {
+    png_set_swap(m_impl->png);
+  }
+}
+
+PngWriter::~PngWriter()
+{
+  if (m_impl->png) png_destroy_write_struct(&m_impl->png, m_impl->info ? &m_impl->info : 0);
+  if (m_impl->file) std::fclose(m_impl->file);
+  delete m_impl;
+}
+
+void PngWriter::write_row(const void* row)
+{
+  if (!ok() || m_rows >= m_height) return;
+  if (setjmp(png_jmpbuf(m_impl->png))) {
+    fail(m_impl->message);
+    return;
+  }
+  png_write_row(m_impl->png, reinterpret_cast<png_bytep>(const_cast<void*>(row)));
+  ++m_rows;
+}
+
+bool PngWriter::finish()
+{
+  if (!ok()) return false;
+  if (m_rows != m_height) {
+    fail("Not all rows were written");
+    return false;
+  }
+  if (setjmp(png_jmpbuf(m_impl->png))) {
+    fail(m_impl->message);
+    return false;
+  }
+  png_write_end(m_impl->png, m_impl->info);
+  png_destroy_write_struct(&m_impl->png, &m_impl->info);
+  m_impl->png = 0;
+  m_impl->info = 0;
+  if (std::fclose(m_impl->file) != 0) fail("Could not finish writing the file");
+  m_impl->file = 0;
+  return ok();
+}
+
+#else // !HAVE_LIBPNG
+
+struct PngWriter::Impl {
+  Impl(const std::string& filename, int width, int height)
+    : filename(filename), image(width, height, 3)
+  {
+  }
+
+  std::string filename;
+  ShUtil::ShImage image;
+};
+
+PngWriter::PngWriter(const std::string& filename, int width, int height, int bits)
+  : m_width(width), m_height(height), m_bits(bits), m_rows(0),
+    m_impl(new Impl(filename, width, height))
+{
+}
+
+PngWriter::~PngWriter()
+{
+  delete m_impl;
+}
+
+void PngWriter::write_row(const void* row)
+{
+  if (!ok() || m_rows >= m_height) return;
+  float* out = m_impl->image.data() + m_rows * m_width * 3;
+  for (int x = 0; x < m_width; ++x) {
+    for (int c = 0; c < 3; ++c) {
+      if (m_bits == 16) {
+        out[x*3 + c] = reinterpret_cast<const unsigned short*>(row)[x*4 + c] / 65535.0f;
+      } else {
+        out[x*3 + c] = reinterpret_cast<const unsigned char*>(row)[x*4 + c] / 255.0f;
+      }
+    }
+  }
+  ++m_rows;
+}
+
+bool PngWriter::finish()
+{
+  if (!ok()) return false;
+  if (m_rows != m_height) {
+    fail("Not all rows were written");
+    return false;
+  }
+  if (m_bits == 16) {
+    ShUtil::save_PNG16(m_impl->image, m_impl->filename);
+  } else {
+    ShUtil::save_PNG(m_impl->image, m_impl->filename);
+  }
+  return true;
+}
+
+#endif // HAVE_LIBPNG
+
+bool PngWriter::ok() const
+{
+  return m_error.empty();
+}
+
+const std::string& PngWriter::error() const
+{
+  return m_error;
+}
+
+void PngWriter::fail(const std::string& message)
+{
+  if (m_error.empty()) m_error = message.empty() ? std::string("libpng error") : message;
+}
@@ -0,0 +1,69 @@
+// Sh: A GPU metaprogramming language.
+//
+// Copyright 2003-2005 Serious Hack Inc.
+// 
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, 
+// MA  02110-1301, USA
+//////////////////////////////////////////////////////////////////////////////
+#ifndef PNGWRITER_HPP
+#define PNGWRITER_HPP
+
+#include <string>
+
+/** Writes a PNG file a row at a time, so a large picture never has to
+ * be in memory all at once.  Rows are given top to bottom as RGBA,
+ * with 8 or 16 bits per channel in the machine's byte order; the alpha
+ * channel is dropped.
+ *
+ * Without libpng at configure time the rows are collected into an
+ * ShImage and saved by shutil in finish() instead.
+ */
+class PngWriter {
+public:
+  PngWriter(const std::string& filename, int width, int height, int bits = 8);
+  ~PngWriter();
+
+  /// Return false if the file couldn't be opened or a write failed.
+  bool ok() const;
+  const std::string& error() const;
+
+  int width() const { return m_width; }
+  int height() const { return m_height; }
+  int bits() const { return m_bits; }
+
+  /// Append the next row, width()*4 channels.
+  void write_row(const void* row);
+
+  /// Finish the file.  Returns ok().
+  bool finish();
+
+private:
+  struct Impl;
+  void fail(const std::string& message);
+
+  int m_width;
+  int m_height;
+  int m_bits;
+  int m_rows; // rows written so far
+  std::string m_error;
+
+  Impl* m_impl;
+
+  // NOT IMPLEMENTED
+  PngWriter(const PngWriter&);
+  PngWriter& operator=(const PngWriter&);
+};
+
+#endif
@@ -0,0 +1,262 @@
+// Sh: A GPU metaprogramming language.
+//
+// Copyright 2003-2005 Serious Hack Inc.
+// 
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, 
+// MA  02110-1301, USA
+//////////////////////////////////////////////////////////////////////////////
+#include <iostream>
+#include <sh/sh.hpp>
+#include <wx/glcanvas.h>
+#include "ShrikeGl.hpp"
+#include "OffscreenContext.hpp"
+#include "ProgramCache.hpp"
+#include "Shader.hpp"
+#include "LineReader.hpp"
+#include "Trace.hpp"
+#include "Precompile.hpp"
+
+using namespace SH;
+
+class PrecompileProcess : public wxProcess {
+public:
+  PrecompileProcess(PrecompilePool* pool)
+    : m_pool(pool), m_pid(0)
+  {
+    Redirect();
+  }
+
+  void OnTerminate(int pid, int status)
+  {
+    if (m_pool) m_pool->finished(this);
+    delete this;
+  }
+
+  /// Forget the pool, which is going away before this process.
+  void detach() { m_pool = 0; }
+
+  long pid() const { return m_pid; }
+  void pid(long pid) { m_pid = pid; }
+
+  LineReader& output() { return m_output; }
+
+private:
+  PrecompilePool* m_pool;
+  long m_pid;
+  LineReader m_output;
+};
+
+namespace {
+
+enum PrecompileResult {
+  PRECOMPILE_COMPILED,
+  PRECOMPILE_CACHED,
+  PRECOMPILE_UNCACHEABLE
+};
+
+PrecompileResult precompile(Shader* shader)
+{
+  SHRIKE_TRACE_ZONE("precompile");
+  ProgramCache& cache = ProgramCache::instance();
+  ProgramCache::Keys keys;
+
+  ShProgram vertex = shader->vertex();
+  ShProgram fragment = shader->fragment();
+  if (cache.contains(vertex, fragment, keys)) return PRECOMPILE_CACHED;
+
+  shCompile(vertex);
+  shCompile(fragment);
+  return cache.store(vertex, fragment, keys) ? PRECOMPILE_COMPILED : PRECOMPILE_UNCACHEABLE;
+}
+
+std::string one_line(std::string s)
+{
+  for (std::string::size_type i = 0; i < s.size(); ++i) {
+    if (s[i] == '\n' || s[i] == '\r' || s[i] == '\t') s[i] = ' ';
+  }
+  return s;
+}
+
+}
+
+int run_precompile_worker(int worker, int workers)
+{
+  // Sh's backends look at the GL's limits while generating code, so a
+  // context has to be current.
+  OffscreenContext offscreen(16, 16);
+  wxFrame* frame = 0;
+  if (!offscreen.valid()) {
+    frame = new wxFrame(0, -1, wxT("Shrike worker"), wxPoint(-100, -100),
+                        wxSize(16, 16), wxFRAME_NO_TASKBAR);
+    wxGLCanvas* canvas = new wxGLCanvas(frame, -1);
+    frame->Show();
+    wxTheApp->Yield();
+    canvas->SetCurrent();
+  }
+  shrikeGlInit();
+
+  int index = 0;
+  for (ShaderList::iterator I = GetShaders().begin(); I != GetShaders().end(); ++I, ++index) {
+    if (index % workers != worker) continue;
+
+    Shader* shader = *I;
+    std::string status;
+    try {
+      if (!shader->firstTimeInit()) {
+        status = "failed\t" + shader->name() + "\tinit failed";
+      } else {
+        switch (precompile(shader)) {
+        case PRECOMPILE_COMPILED: status = "compiled"; break;
+        case PRECOMPILE_CACHED: status = "cached"; break;
+        case PRECOMPILE_UNCACHEABLE: status = "uncacheable"; break;
+        }
+        status += "\t" + shader->name();
+      }
+    } catch (const ShException& e) {
+      status = "failed\t" + shader->name() + "\t" + one_line(e.message());
+    } catch (...) {
+      status = "failed\t" + shader->name() + "\tunknown exception";
+    }
+    std::cout << status << std::endl;
+  }
+
+  if (frame) frame->Destroy();
+  return 0;
+}
+
+BEGIN_EVENT_TABLE(PrecompilePool, wxEvtHandler)
+  EVT_TIMER(-1, PrecompilePool::on_timer)
+END_EVENT_TABLE()
+
+PrecompilePool::PrecompilePool(wxListBox* output)
+  : m_output(output),
+    m_timer(this),
+    m_compiled(0), m_cached(0), m_uncacheable(0), m_failed(0)
+{
+}
+
+PrecompilePool::~PrecompilePool()
+{
+  m_timer.Stop();
+  for (std::list<PrecompileProcess*>::iterator I = m_processes.begin();
+       I != m_processes.end(); ++I) {
+    (*I)->detach();
+    wxProcess::Kill((*I)->pid(), wxSIGKILL);
+  }
+}
+
+bool PrecompilePool::start(int workers)
+{
+  if (running()) return false;
+
+  if (workers <= 0) workers = wxThread::GetCPUCount();
+  if (workers <= 0) workers = 2;
+  if ((std::size_t)workers > GetShaders().size()) workers = GetShaders().size();
+
+  // Workers have to hash programs exactly like this process, so they
+  // get the same backend and optimization settings.
+  wxString options;
+  options << wxT(" --optimization=") << ShContext::current()->optimization();
+  for (const char** name = shrike_optimizations; *name; ++name) {
+    if (ShContext::current()->optimization_disabled(*name)) {
+      options << wxT(" \"--disable-optimization=") << wxString(*name, wxConvLibc) << wxT("\"");
+    }
+  }
+  options << wxT(" ") << wxString(ProgramCache::instance().backend().c_str(), wxConvLibc);
+
+  m_compiled = m_cached = m_uncacheable = m_failed = 0;
+  m_start = ShTimer::now();
+  for (int i = 0; i < workers; ++i) {
+    wxString command;
+    command << wxT("\"") << wxTheApp->argv[0] << wxT("\"")
+            << wxString::Format(wxT(" --precompile-worker=%d/%d"), i, workers)
+            << options;
+
+    PrecompileProcess* process = new PrecompileProcess(this);
+    long pid = wxExecute(command, wxEXEC_ASYNC, process);
+    if (!pid) {
+      delete process;
+      continue;
+    }
+    process->pid(pid);
+    m_processes.push_back(process);
+  }
+  if (!running()) {
+    message(wxT("Could not start any precompile workers"));
+    return false;
+  }
+
+  message(wxString::Format(wxT("Precompiling %lu shaders in %lu processes..."),
+                           (unsigned long)GetShaders().size(),
+                           (unsigned long)m_processes.size()));
+  m_timer.Start(100);
+  return true;
+}
+
+void PrecompilePool::on_timer(wxTimerEvent& event)
+{
+  for (std::list<PrecompileProcess*>::iterator I = m_processes.begin();
+       I != m_processes.end(); ++I) {
+    drain(*I);
+  }
+}
+
+void PrecompilePool::drain(PrecompileProcess* process, bool end)
+{
+  std::vector<wxString> lines;
+  process->output().read(process->GetInputStream(), lines, end);
+  for (std::size_t i = 0; i < lines.size(); ++i) report(lines[i]);
+  // Nobody reads stderr, but a full pipe would block the worker
+  while (process->IsErrorAvailable()) {
+    process->GetErrorStream()->GetC();
+  }
+}
+
+void PrecompilePool::report(const wxString& line)
+{
+  wxString status = line.BeforeFirst(wxT('\t'));
+  wxString rest = line.AfterFirst(wxT('\t'));
+  if (status == wxT("compiled")) {
+    ++m_compiled;
+  } else if (status == wxT("cached")) {
+    ++m_cached;
+  } else if (status == wxT("uncacheable")) {
+    ++m_uncacheable;
+  } else if (status == wxT("failed")) {
+    // The shader is still tried as usual when it's selected; the
+    // worker's GL may just lack something the real one has.
+    ++m_failed;
+    message(rest.BeforeFirst(wxT('\t')) + wxT(": precompile failed: ")
+            + rest.AfterFirst(wxT('\t')));
+  }
+}
+
+void PrecompilePool::finished(PrecompileProcess* process)
+{
+  drain(process, true);
+  m_processes.remove(process);
+  if (running()) return;
+
+  m_timer.Stop();
+  message(wxString::Format(wxT("Precompiled in %.1f s: %u compiled, %u already cached, ")
+                           wxT("%u can't be cached, %u failed"),
+                           (ShTimer::now() - m_start).value() / 1000.0,
+                           m_compiled, m_cached, m_uncacheable, m_failed));
+}
+
+void PrecompilePool::message(const wxString& text)
+{
+  m_output->Insert(text, m_output->GetCount());
+}
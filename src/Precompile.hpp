@@ -0,0 +1,75 @@
+// Sh: A GPU metaprogramming language.
+//
+// Copyright 2003-2005 Serious Hack Inc.
+// 
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, 
+// MA  02110-1301, USA
+//////////////////////////////////////////////////////////////////////////////
+#ifndef PRECOMPILE_HPP
+#define PRECOMPILE_HPP
+
+#include <list>
+#include <wx/wx.h>
+#include <wx/process.h>
+#include "Timer.hpp"
+
+class PrecompileProcess;
+
+/** Fills the ProgramCache for every shader using a pool of worker
+ * processes.  Sh's context isn't thread safe, so each worker is a
+ * separate "shrike --precompile-worker=I/N" that initializes and
+ * compiles every Nth shader of GetShaders() and reports one line per
+ * shader on stdout.  Once they are done, binding a shader in shrike
+ * only has to upload its code.
+ *
+ * Progress goes to the output list box.  Deleting the pool kills any
+ * workers that are still running.
+ */
+class PrecompilePool : public wxEvtHandler {
+public:
+  PrecompilePool(wxListBox* output);
+  ~PrecompilePool();
+
+  /// Start workers, one per CPU if workers is 0.  Returns false if
+  /// they're already running or none could be started.
+  bool start(int workers = 0);
+  bool running() const { return !m_processes.empty(); }
+
+private:
+  void on_timer(wxTimerEvent& event);
+  void drain(PrecompileProcess* process, bool end = false);
+  void report(const wxString& line);
+  void finished(PrecompileProcess* process);
+  void message(const wxString& text);
+
+  wxListBox* m_output;
+  wxTimer m_timer;
+  std::list<PrecompileProcess*> m_processes;
+
+  ShTimer m_start;
+  unsigned int m_compiled;
+  unsigned int m_cached;
+  unsigned int m_uncacheable;
+  unsigned int m_failed;
+
+  friend class PrecompileProcess;
+  DECLARE_EVENT_TABLE()
+};
+
+/// The worker side: precompile every shader whose index in
+/// GetShaders() is worker modulo workers.  Returns the exit status.
+int run_precompile_worker(int worker, int workers);
+
+#endif
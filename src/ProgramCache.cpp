@@ -0,0 +1,433 @@
+// Sh: A GPU metaprogramming language.
+//
+// Copyright 2003-2005 Serious Hack Inc.
+// 
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, 
+// MA  02110-1301, USA
+//////////////////////////////////////////////////////////////////////////////
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+#include <algorithm>
+#include <map>
+#ifdef WIN32
+#include <direct.h>
+#else
+#include <sys/stat.h>
+#include <sys/types.h>
+#endif
+#include "ShrikeGl.hpp"
+#include "Trace.hpp"
+#include "UniformBatch.hpp"
+#include "ProgramCache.hpp"
+
+using namespace SH;
+
+const char* shrike_optimizations[] = {
+  "uniform lifting", "propagation", "deadcode",
+  "forward substitution", "copy propagation", "straightening", 0
+};
+
+namespace {
+
+const char* CACHE_MAGIC = "shrike-program-cache 1";
+
+// 64-bit FNV-1a, as 16 hex digits
+std::string hash(const std::string& text)
+{
+  unsigned long long h = 14695981039346656037ULL;
+  for (std::string::size_type i = 0; i < text.size(); ++i) {
+    h ^= (unsigned char)text[i];
+    h *= 1099511628211ULL;
+  }
+  char buffer[17];
+  std::sprintf(buffer, "%08lx%08lx",
+               (unsigned long)(h >> 32), (unsigned long)(h & 0xffffffffUL));
+  return buffer;
+}
+
+bool identifier_start(char c)
+{
+  return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c == '_';
+}
+
+bool identifier_char(char c)
+{
+  return identifier_start(c) || (c >= '0' && c <= '9');
+}
+
+// Sh numbers the variables it names itself from a global counter, so
+// the same program prints differently depending on what was built
+// before it.  Renumber every identifier ending in a digit by order of
+// first appearance to get a text that only depends on the program.
+std::string canonical(const std::string& ir)
+{
+  std::map<std::string, std::string> names;
+  std::string result;
+  result.reserve(ir.size());
+
+  std::string::size_type i = 0;
+  while (i < ir.size()) {
+    if (!identifier_start(ir[i]) || (i > 0 && identifier_char(ir[i - 1]))) {
+      result += ir[i++];
+      continue;
+    }
+    std::string::size_type end = i;
+    while (end < ir.size() && identifier_char(ir[end])) ++end;
+    std::string name = ir.substr(i, end - i);
+    if (name[name.size() - 1] >= '0' && name[name.size() - 1] <= '9') {
+      std::map<std::string, std::string>::iterator I = names.find(name);
+      if (I == names.end()) {
+        std::ostringstream s;
+        s << "$" << names.size();
+        I = names.insert(std::make_pair(name, s.str())).first;
+      }
+      result += I->second;
+    } else {
+      result += name;
+    }
+    i = end;
+  }
+  return result;
+}
+
+bool make_directories(const std::string& path)
+{
+  for (std::string::size_type i = 1; i <= path.size(); ++i) {
+    if (i < path.size() && path[i] != '/' && path[i] != '\\') continue;
+    std::string prefix = path.substr(0, i);
+#ifdef WIN32
+    _mkdir(prefix.c_str());
+#else
+    mkdir(prefix.c_str(), 0755);
+#endif
+  }
+  std::ofstream probe((path + "/.probe").c_str());
+  bool ok = probe.good();
+  probe.close();
+  std::remove((path + "/.probe").c_str());
+  return ok;
+}
+
+GLenum gl_target(const std::string& target)
+{
+  std::string::size_type colon = target.find(':');
+  std::string kind = (colon == std::string::npos ? target : target.substr(colon + 1));
+  if (kind == "vertex") return GL_VERTEX_PROGRAM_ARB;
+  if (kind == "fragment") return GL_FRAGMENT_PROGRAM_ARB;
+  return 0;
+}
+
+}
+
+CachedProgram::CachedProgram(unsigned int target, const std::string& code)
+  : m_target(target), m_code(code), m_id(0)
+{
+}
+
+CachedProgram::~CachedProgram()
+{
+  if (m_id) glDeleteProgramsARB(1, &m_id);
+}
+
+bool CachedProgram::upload()
+{
+  glGetError();
+  glGenProgramsARB(1, &m_id);
+  glBindProgramARB(m_target, m_id);
+  glProgramStringARB(m_target, GL_PROGRAM_FORMAT_ASCII_ARB,
+                     m_code.size(), m_code.c_str());
+  GLint position = -1;
+  glGetIntegerv(GL_PROGRAM_ERROR_POSITION_ARB, &position);
+  return glGetError() == GL_NO_ERROR && position == -1;
+}
+
+void CachedProgram::bind()
+{
+  glEnable(m_target);
+  glBindProgramARB(m_target, m_id);
+  // Local parameters stay with the program, so only the ones that
+  // changed since the last bind have to be sent again.
+  for (LocalList::iterator I = m_locals.begin(); I != m_locals.end(); ++I) {
+    float v[4] = {0.0f, 0.0f, 0.0f, 0.0f};
+    const ShDataVariant<float, SH_HOST>* floats =
+      dynamic_cast<const ShDataVariant<float, SH_HOST>*>(I->uniform->getVariant().object());
+    if (floats) {
+      for (int i = 0; i < floats->size() && i < 4; ++i) v[i] = (*floats)[i];
+    } else {
+      ShPointer< ShDataVariant<float, SH_HOST> > values =
+        variant_convert<float, SH_HOST>(I->uniform->getVariant());
+      for (int i = 0; i < values->size() && i < 4; ++i) v[i] = (*values)[i];
+    }
+    if (I->uploaded && std::equal(v, v + 4, I->values)) continue;
+    glProgramLocalParameter4fvARB(m_target, I->index, v);
+    std::copy(v, v + 4, I->values);
+    I->uploaded = true;
+    UniformBatch::instance().upload();
+  }
+}
+
+void CachedProgram::local(const ShVariableNodePtr& uniform, int index)
+{
+  Local local;
+  local.uniform = uniform;
+  local.index = index;
+  local.uploaded = false;
+  m_locals.push_back(local);
+}
+
+CachedProgramSet::CachedProgramSet(CachedProgram* vertex, CachedProgram* fragment)
+  : m_vertex(vertex), m_fragment(fragment)
+{
+}
+
+CachedProgramSet::~CachedProgramSet()
+{
+  delete m_vertex;
+  delete m_fragment;
+}
+
+void CachedProgramSet::bind()
+{
+  m_vertex->bind();
+  m_fragment->bind();
+}
+
+void CachedProgramSet::unbind()
+{
+  glDisable(GL_VERTEX_PROGRAM_ARB);
+  glDisable(GL_FRAGMENT_PROGRAM_ARB);
+}
+
+ProgramCache& ProgramCache::instance()
+{
+  static ProgramCache cache;
+  return cache;
+}
+
+ProgramCache::ProgramCache()
+  : m_enabled(true), m_hits(0), m_misses(0)
+{
+  const char* base = std::getenv("XDG_CACHE_HOME");
+  if (base && *base) {
+    m_directory = std::string(base) + "/shrike";
+  } else {
+#ifdef WIN32
+    base = std::getenv("LOCALAPPDATA");
+    if (base) m_directory = std::string(base) + "\\shrike\\cache";
+#else
+    base = std::getenv("HOME");
+    if (base) m_directory = std::string(base) + "/.cache/shrike";
+#endif
+  }
+  // Nowhere to put it
+  if (m_directory.empty()) m_enabled = false;
+}
+
+void ProgramCache::backend(const std::string& name)
+{
+  m_backend = name;
+}
+
+const std::string& ProgramCache::backend() const
+{
+  return m_backend;
+}
+
+void ProgramCache::enabled(bool enabled)
+{
+  m_enabled = enabled && !m_directory.empty();
+}
+
+bool ProgramCache::enabled() const
+{
+  return m_enabled;
+}
+
+bool ProgramCache::usable() const
+{
+  return m_enabled && m_backend == "arb";
+}
+
+std::string ProgramCache::key(const ShProgram& program) const
+{
+  std::ostringstream s;
+  s << m_backend << '\n'
+    << program.node()->target() << '\n'
+    << ShContext::current()->optimization() << '\n';
+  for (const char** name = shrike_optimizations; *name; ++name) {
+    s << ShContext::current()->optimization_disabled(*name);
+  }
+  s << '\n';
+  program.node()->ctrlGraph->print(s, 0);
+  return hash(canonical(s.str()));
+}
+
+std::string ProgramCache::path(const std::string& key) const
+{
+  return m_directory + "/" + key + ".prog";
+}
+
+CachedProgramSet* ProgramCache::load(const ShProgram& vertex,
+                                     const ShProgram& fragment,
+                                     Keys& keys)
+{
+  if (!usable() || !vertex.node() || !fragment.node()) return 0;
+  SHRIKE_TRACE_ZONE("ProgramCache::load");
+
+  keys.vertex = key(vertex);
+  keys.fragment = key(fragment);
+
+  CachedProgram* v = load(vertex, keys.vertex);
+  CachedProgram* f = (v ? load(fragment, keys.fragment) : 0);
+  if (!v || !f) {
+    delete v;
+    ++m_misses;
+    return 0;
+  }
+
+  ++m_hits;
+  return new CachedProgramSet(v, f);
+}
+
+CachedProgram* ProgramCache::load(const ShProgram& program, const std::string& key)
+{
+  GLenum target = gl_target(program.node()->target());
+  if (!target) return 0;
+
+  std::ifstream in(path(key).c_str());
+  if (!in) return 0;
+
+  std::string line;
+  if (!std::getline(in, line) || line != CACHE_MAGIC) return 0;
+
+  std::vector<ShVariableNodePtr> uniforms(program.node()->uniforms.begin(),
+                                          program.node()->uniforms.end());
+  std::size_t count = 0;
+  if (!(in >> line >> count) || line != "uniforms" || count != uniforms.size()) return 0;
+
+  std::vector< std::pair<std::size_t, int> > locals;
+  while (in >> line && line == "local") {
+    std::size_t uniform;
+    int index;
+    if (!(in >> uniform >> index) || uniform >= uniforms.size()) return 0;
+    locals.push_back(std::make_pair(uniform, index));
+  }
+  if (line != "code") return 0;
+  std::getline(in, line);
+
+  std::ostringstream code;
+  code << in.rdbuf();
+
+  CachedProgram* result = new CachedProgram(target, code.str());
+  for (std::size_t i = 0; i < locals.size(); ++i) {
+    result->local(uniforms[locals[i].first], locals[i].second);
+  }
+  if (!result->upload()) {
+    // Written by a different driver or just broken; let it be replaced
+    delete result;
+    std::remove(path(key).c_str());
+    return 0;
+  }
+  return result;
+}
+
+bool ProgramCache::contains(const ShProgram& vertex,
+                            const ShProgram& fragment,
+                            Keys& keys)
+{
+  if (!usable() || !vertex.node() || !fragment.node()) return false;
+
+  keys.vertex = key(vertex);
+  keys.fragment = key(fragment);
+  return std::ifstream(path(keys.vertex).c_str()).good()
+    && std::ifstream(path(keys.fragment).c_str()).good();
+}
+
+bool ProgramCache::store(const ShProgram& vertex,
+                         const ShProgram& fragment,
+                         const Keys& keys)
+{
+  if (!usable() || keys.vertex.empty() || keys.fragment.empty()) return false;
+  SHRIKE_TRACE_ZONE("ProgramCache::store");
+
+  if (!make_directories(m_directory)) {
+    m_enabled = false;
+    return false;
+  }
+  bool stored = store(vertex, keys.vertex);
+  return store(fragment, keys.fragment) && stored;
+}
+
+bool ProgramCache::store(const ShProgram& program, const std::string& key)
+{
+  // Textures have to be set up by Sh, so those programs can't be
+  // bound without it.
+  if (!program.node()->code() || !program.node()->textures.empty()) return false;
+
+  std::ostringstream code;
+  program.node()->code()->print(code);
+
+  // Uniforms by name.  Names that occur twice can't be told apart and
+  // map to NONE.
+  const std::size_t NONE = (std::size_t)-1;
+  std::map<std::string, std::size_t> uniforms;
+  std::size_t count = 0;
+  for (ShProgramNode::VarList::const_iterator I = program.node()->uniforms.begin();
+       I != program.node()->uniforms.end(); ++I, ++count) {
+    if ((*I)->size() > 4) return false;
+    if (!uniforms.insert(std::make_pair((*I)->name(), count)).second) {
+      uniforms[(*I)->name()] = NONE;
+    }
+  }
+
+  // Find where each uniform went from the parameter declarations,
+  //   PARAM u3 = program.local[2]; # lightPos
+  // If one can't be traced back to its uniform the program is left
+  // out of the cache.
+  std::ostringstream locals;
+  std::istringstream lines(code.str());
+  std::string line;
+  while (std::getline(lines, line)) {
+    std::string::size_type local = line.find("program.local[");
+    if (local == std::string::npos) continue;
+    int slot = std::atoi(line.c_str() + local + 14);
+
+    std::string::size_type comment = line.find('#', local);
+    if (comment == std::string::npos) return false;
+    std::string name = line.substr(comment + 1);
+    name.erase(0, name.find_first_not_of(" \t"));
+    name.erase(name.find_last_not_of(" \t\r") + 1);
+
+    std::map<std::string, std::size_t>::const_iterator I = uniforms.find(name);
+    if (I == uniforms.end() || I->second == NONE) return false;
+    locals << "local " << I->second << ' ' << slot << '\n';
+  }
+
+  std::string filename = path(key);
+  std::string temporary = filename + ".tmp";
+  {
+    std::ofstream out(temporary.c_str());
+    out << CACHE_MAGIC << '\n'
+        << "uniforms " << count << '\n'
+        << locals.str()
+        << "code\n"
+        << code.str();
+    if (!out.good()) return false;
+  }
+  std::remove(filename.c_str());
+  return std::rename(temporary.c_str(), filename.c_str()) == 0;
+}
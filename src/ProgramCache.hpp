@@ -0,0 +1,153 @@
+// Sh: A GPU metaprogramming language.
+//
+// Copyright 2003-2005 Serious Hack Inc.
+// 
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, 
+// MA  02110-1301, USA
+//////////////////////////////////////////////////////////////////////////////
+#ifndef PROGRAMCACHE_HPP
+#define PROGRAMCACHE_HPP
+
+#include <string>
+#include <vector>
+#include <sh/sh.hpp>
+
+/** A program whose backend code came out of the ProgramCache.
+ * Uploaded and bound straight through GL instead of through Sh, which
+ * skips code generation.  Uniform values are read from their Sh
+ * variables and pushed on every bind.
+ */
+class CachedProgram {
+public:
+  CachedProgram(unsigned int target, const std::string& code);
+  ~CachedProgram();
+
+  /// Upload the code.  Returns false if the GL rejects it.
+  bool upload();
+  void bind();
+
+  /// Have uniform (an entry of the program's uniform list) go to
+  /// program.local[index].
+  void local(const SH::ShVariableNodePtr& uniform, int index);
+
+private:
+  unsigned int m_target;
+  std::string m_code;
+  unsigned int m_id;
+
+  struct Local {
+    SH::ShVariableNodePtr uniform;
+    int index;
+    bool uploaded; // whether the GL has values
+    float values[4]; // that went to the GL last
+  };
+  typedef std::vector<Local> LocalList;
+  LocalList m_locals;
+
+  // NOT IMPLEMENTED
+  CachedProgram(const CachedProgram& other);
+  CachedProgram& operator=(const CachedProgram& other);
+};
+
+/// The vertex and fragment halves of a Shader, from the cache.
+class CachedProgramSet {
+public:
+  CachedProgramSet(CachedProgram* vertex, CachedProgram* fragment);
+  ~CachedProgramSet();
+
+  void bind();
+
+  /// Disable whatever cached programs are bound.  shUnbind() doesn't
+  /// know about them.
+  static void unbind();
+
+private:
+  CachedProgram* m_vertex;
+  CachedProgram* m_fragment;
+
+  // NOT IMPLEMENTED
+  CachedProgramSet(const CachedProgramSet& other);
+  CachedProgramSet& operator=(const CachedProgramSet& other);
+};
+
+/** Compiled programs kept on disk between runs.
+ * Entries are keyed by a hash of a program's IR together with the
+ * backend, the target and the optimization settings.  They hold the
+ * code the backend generated and which program.local slot each
+ * uniform ended up in.  The cache lives in $XDG_CACHE_HOME/shrike,
+ * ~/.cache/shrike by default.
+ *
+ * Only the ARB backend can be fed from the cache at the moment; with
+ * any other backend lookups always fall through to Sh.
+ */
+class ProgramCache {
+public:
+  static ProgramCache& instance();
+
+  /// Name of the backend passed to shSetBackend().
+  void backend(const std::string& name);
+  const std::string& backend() const;
+
+  void enabled(bool enabled);
+  bool enabled() const;
+
+  struct Keys {
+    std::string vertex;
+    std::string fragment;
+  };
+
+  /// Look up both programs.  Returns null on a miss, in which case
+  /// keys is filled in for store().  Counts a hit or a miss.
+  CachedProgramSet* load(const SH::ShProgram& vertex,
+                         const SH::ShProgram& fragment,
+                         Keys& keys);
+
+  /// Whether both programs are in the cache, without loading them or
+  /// counting anything.  Fills in keys either way.
+  bool contains(const SH::ShProgram& vertex,
+                const SH::ShProgram& fragment,
+                Keys& keys);
+
+  /// Save the code of programs that missed once Sh has compiled them,
+  /// i.e. after they were first bound.  Returns false if either
+  /// couldn't be stored.
+  bool store(const SH::ShProgram& vertex,
+             const SH::ShProgram& fragment,
+             const Keys& keys);
+
+  unsigned long hits() const { return m_hits; }
+  unsigned long misses() const { return m_misses; }
+
+private:
+  ProgramCache();
+
+  bool usable() const;
+  std::string key(const SH::ShProgram& program) const;
+  std::string path(const std::string& key) const;
+  CachedProgram* load(const SH::ShProgram& program, const std::string& key);
+  bool store(const SH::ShProgram& program, const std::string& key);
+
+  std::string m_backend;
+  std::string m_directory;
+  bool m_enabled;
+  unsigned long m_hits;
+  unsigned long m_misses;
+};
+
+/// Names of the Sh optimizations shrike lets the user toggle, ending
+/// with a null.
+extern const char* shrike_optimizations[];
+
+#endif
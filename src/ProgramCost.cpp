@@ -0,0 +1,166 @@
+// Sh: A GPU metaprogramming language.
+//
+// Copyright 2003-2005 Serious Hack Inc.
+// 
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, 
+// MA  02110-1301, USA
+//////////////////////////////////////////////////////////////////////////////
+#include <algorithm>
+#include <cctype>
+#include <sstream>
+#include <vector>
+#include "ShrikeGl.hpp"
+#include "ProgramCost.hpp"
+
+namespace {
+
+std::string trim(const std::string& s)
+{
+  std::string::size_type begin = s.find_first_not_of(" \t\r\n");
+  if (begin == std::string::npos) return "";
+  return s.substr(begin, s.find_last_not_of(" \t\r\n") + 1 - begin);
+}
+
+/// The opcode without _SAT and the like.
+std::string opcode(const std::string& statement)
+{
+  std::string op = statement.substr(0, statement.find_first_of(" \t\r\n"));
+  op = op.substr(0, op.find('_'));
+  std::transform(op.begin(), op.end(), op.begin(), (int(*)(int))std::toupper);
+  return op;
+}
+
+int get_program(unsigned int target, GLenum name)
+{
+  GLint value = 0;
+  glGetProgramivARB(target, name, &value);
+  return value;
+}
+
+void native_count(unsigned int target, GLenum name, int& count)
+{
+  int value = get_program(target, name);
+  if (value > 0) count = value;
+}
+
+}
+
+ProgramCost::ProgramCost()
+  : valid(false), native(true),
+    uniforms(0), constants(0), branches(0), loops(0)
+{
+  for (int i = 0; i < COUNTER_COUNT; i++) used[i] = limit[i] = 0;
+}
+
+bool ProgramCost::near_limit(Counter counter) const
+{
+  return limit[counter] > 0 && used[counter]*10 >= limit[counter]*9;
+}
+
+void ProgramCost::parse(const std::string& source)
+{
+  // Drop comments, then go through the statements
+  std::ostringstream code;
+  std::istringstream lines(source);
+  std::string line;
+  while (std::getline(lines, line)) {
+    if (line.compare(0, 2, "!!") == 0) continue;
+    code << line.substr(0, line.find('#')) << '\n';
+  }
+
+  std::istringstream statements(code.str());
+  std::string statement;
+  while (std::getline(statements, statement, ';')) {
+    statement = trim(statement);
+    // Labels (NV_fragment_program2) come before the statement
+    std::string::size_type colon;
+    while ((colon = statement.find(':')) != std::string::npos
+           && statement.find_first_of(" \t\r\n") > colon) {
+      statement = trim(statement.substr(colon + 1));
+    }
+    if (statement.empty()) continue;
+
+    std::string op = opcode(statement);
+    if (op == "END" || op == "OPTION" || op == "OUTPUT" || op == "ALIAS") {
+      continue;
+    } else if (op == "TEMP" || op == "ADDRESS") {
+      if (op == "TEMP") {
+        used[TEMPORARIES] += 1 + std::count(statement.begin(), statement.end(), ',');
+      }
+    } else if (op == "ATTRIB") {
+      used[ATTRIBUTES]++;
+    } else if (op == "PARAM") {
+      if (statement.find("program.local") != std::string::npos
+          || statement.find("program.env") != std::string::npos
+          || statement.find("state.") != std::string::npos) {
+        uniforms++;
+      } else {
+        constants++;
+      }
+      used[PARAMETERS]++;
+    } else {
+      used[INSTRUCTIONS]++;
+      if (op == "TEX" || op == "TXP" || op == "TXB" || op == "TXD"
+          || op == "TXL" || op == "TXF" || op == "KIL") {
+        used[TEX_INSTRUCTIONS]++;
+      } else {
+        used[ALU_INSTRUCTIONS]++;
+      }
+      if (op == "BRA" || op == "CAL" || op == "IF") {
+        branches++;
+      } else if (op == "LOOP" || op == "REP") {
+        loops++;
+      }
+    }
+  }
+}
+
+bool ProgramCost::measure(unsigned int target)
+{
+  *this = ProgramCost();
+  if (!get_program(target, GL_PROGRAM_BINDING_ARB)) return false;
+
+  int length = get_program(target, GL_PROGRAM_LENGTH_ARB);
+  if (length > 0) {
+    std::vector<char> source(length + 1, '\0');
+    glGetProgramStringARB(target, GL_PROGRAM_STRING_ARB, &source[0]);
+    parse(&source[0]);
+  }
+
+  // What the GL knows beats counting, if it says anything
+  native_count(target, GL_PROGRAM_NATIVE_INSTRUCTIONS_ARB, used[INSTRUCTIONS]);
+  native_count(target, GL_PROGRAM_NATIVE_TEMPORARIES_ARB, used[TEMPORARIES]);
+  native_count(target, GL_PROGRAM_NATIVE_PARAMETERS_ARB, used[PARAMETERS]);
+  native_count(target, GL_PROGRAM_NATIVE_ATTRIBS_ARB, used[ATTRIBUTES]);
+  limit[INSTRUCTIONS] = get_program(target, GL_MAX_PROGRAM_NATIVE_INSTRUCTIONS_ARB);
+  limit[TEMPORARIES] = get_program(target, GL_MAX_PROGRAM_NATIVE_TEMPORARIES_ARB);
+  limit[PARAMETERS] = get_program(target, GL_MAX_PROGRAM_NATIVE_PARAMETERS_ARB);
+  limit[ATTRIBUTES] = get_program(target, GL_MAX_PROGRAM_NATIVE_ATTRIBS_ARB);
+  native = get_program(target, GL_PROGRAM_UNDER_NATIVE_LIMITS_ARB) != 0;
+
+  if (target == GL_FRAGMENT_PROGRAM_ARB) {
+    native_count(target, GL_PROGRAM_NATIVE_ALU_INSTRUCTIONS_ARB, used[ALU_INSTRUCTIONS]);
+    native_count(target, GL_PROGRAM_NATIVE_TEX_INSTRUCTIONS_ARB, used[TEX_INSTRUCTIONS]);
+    limit[ALU_INSTRUCTIONS] = get_program(target, GL_MAX_PROGRAM_NATIVE_ALU_INSTRUCTIONS_ARB);
+    limit[TEX_INSTRUCTIONS] = get_program(target, GL_MAX_PROGRAM_NATIVE_TEX_INSTRUCTIONS_ARB);
+  } else {
+    // Vertex programs only have the one instruction limit
+    used[ALU_INSTRUCTIONS] = std::max(used[INSTRUCTIONS] - used[TEX_INSTRUCTIONS], 0);
+    limit[ALU_INSTRUCTIONS] = limit[INSTRUCTIONS];
+  }
+
+  valid = true;
+  return true;
+}
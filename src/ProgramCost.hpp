@@ -0,0 +1,64 @@
+// Sh: A GPU metaprogramming language.
+//
+// Copyright 2003-2005 Serious Hack Inc.
+// 
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, 
+// MA  02110-1301, USA
+//////////////////////////////////////////////////////////////////////////////
+#ifndef PROGRAMCOST_HPP
+#define PROGRAMCOST_HPP
+
+#include <string>
+
+/** What an ARB vertex or fragment program costs.  The native counts
+ * and limits come from the GL, which knows what the program turned
+ * into on the card; the rest is read off the program source.
+ */
+struct ProgramCost {
+  ProgramCost();
+
+  /// Measure the program bound to target (GL_VERTEX_PROGRAM_ARB or
+  /// GL_FRAGMENT_PROGRAM_ARB) in the current context.  Returns false,
+  /// and leaves valid false, if there is none.
+  bool measure(unsigned int target);
+
+  /// Count what can be counted from source alone.
+  void parse(const std::string& source);
+
+  enum Counter {
+    INSTRUCTIONS,
+    ALU_INSTRUCTIONS,
+    TEX_INSTRUCTIONS,
+    TEMPORARIES,
+    PARAMETERS,
+    ATTRIBUTES,
+    COUNTER_COUNT
+  };
+
+  /// Whether used is at least 90% of a known limit.
+  bool near_limit(Counter counter) const;
+
+  bool valid;
+  int used[COUNTER_COUNT];
+  int limit[COUNTER_COUNT]; // 0 if the GL doesn't say
+  bool native; // whether the GL says it fits the hardware
+
+  int uniforms; // parameters bound to program.local, .env or state
+  int constants; // other parameters
+  int branches;
+  int loops;
+};
+
+#endif
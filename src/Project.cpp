@@ -1,4 +1,5 @@
 #include "Project.hpp"
+#include "Trace.hpp"
 #include <wx/fileconf.h>
 #include <wx/wfstream.h>
 #include <wx/tokenzr.h>
@@ -21,6 +22,7 @@ Project::~Project()
 
 void Project::load_shaders()
 {
+  SHRIKE_TRACE_ZONE("Project::load_shaders");
   unload_shaders();
   
   wxFileName path(workspace(), target()+wxDynamicLibrary::GetDllExt());
@@ -0,0 +1,298 @@
+// Sh: A GPU metaprogramming language.
+//
+// Copyright 2003-2005 Serious Hack Inc.
+// 
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, 
+// MA  02110-1301, USA
+//////////////////////////////////////////////////////////////////////////////
+#include <algorithm>
+#include <cstring>
+#include <vector>
+#include "ShrikeGl.hpp"
+#include "PngWriter.hpp"
+#include "Trace.hpp"
+#include "Screenshot.hpp"
+
+namespace {
+
+/// Reads tiles into their place in a band of the picture, through a
+/// ring of pixel buffer objects if there are any.  The band holds
+/// width pixels per row, bottom row first like GL.
+class TileReadback {
+public:
+  TileReadback(int tile_w, int tile_h, GLenum type, std::size_t pixel,
+               unsigned char* band, int width);
+  ~TileReadback();
+
+  /// Start reading the w by h pixels at the lower left of the read
+  /// buffer into the band at column x.
+  void read(int x, int w, int h);
+
+  /// Finish all reads that were started.
+  void flush();
+
+private:
+  void complete(int slot);
+
+  enum { RING = 3 };
+
+  struct Pending {
+    bool busy;
+    int x, w, h;
+  };
+
+  GLenum m_type;
+  std::size_t m_pixel; // bytes
+  unsigned char* m_band;
+  int m_width;
+
+  bool m_pbo;
+  GLuint m_buffers[RING];
+  Pending m_pending[RING];
+  int m_next;
+};
+
+TileReadback::TileReadback(int tile_w, int tile_h, GLenum type, std::size_t pixel,
+                           unsigned char* band, int width)
+  : m_type(type), m_pixel(pixel), m_band(band), m_width(width),
+    m_pbo(false), m_next(0)
+{
+  for (int i = 0; i < RING; ++i) {
+    m_buffers[i] = 0;
+    m_pending[i].busy = false;
+  }
+#ifdef GL_ARB_pixel_buffer_object
+  m_pbo = shrikeGlHasExtension("GL_ARB_pixel_buffer_object")
+    || shrikeGlHasExtension("GL_EXT_pixel_buffer_object");
+  if (m_pbo) {
+    glGenBuffersARB(RING, m_buffers);
+    for (int i = 0; i < RING; ++i) {
+      glBindBufferARB(GL_PIXEL_PACK_BUFFER_ARB, m_buffers[i]);
+      glBufferDataARB(GL_PIXEL_PACK_BUFFER_ARB, tile_w * tile_h * pixel, 0, GL_STREAM_READ_ARB);
+    }
+    glBindBufferARB(GL_PIXEL_PACK_BUFFER_ARB, 0);
+  }
+#endif
+}
+
+TileReadback::~TileReadback()
+{
+#ifdef GL_ARB_pixel_buffer_object
+  if (m_pbo) glDeleteBuffersARB(RING, m_buffers);
+#endif
+}
+
+void TileReadback::read(int x, int w, int h)
+{
+  if (!m_pbo) {
+    // Straight into the band
+    glPixelStorei(GL_PACK_ROW_LENGTH, m_width);
+    glReadPixels(0, 0, w, h, GL_RGBA, m_type, m_band + x * m_pixel);
+    glPixelStorei(GL_PACK_ROW_LENGTH, 0);
+    return;
+  }
+#ifdef GL_ARB_pixel_buffer_object
+  if (m_pending[m_next].busy) complete(m_next);
+  glBindBufferARB(GL_PIXEL_PACK_BUFFER_ARB, m_buffers[m_next]);
+  glReadPixels(0, 0, w, h, GL_RGBA, m_type, 0);
+  glBindBufferARB(GL_PIXEL_PACK_BUFFER_ARB, 0);
+
+  Pending& pending = m_pending[m_next];
+  pending.busy = true;
+  pending.x = x;
+  pending.w = w;
+  pending.h = h;
+  m_next = (m_next + 1) % RING;
+#endif
+}
+
+void TileReadback::flush()
+{
+  // Oldest first
+  for (int i = 0; i < RING; ++i) {
+    int slot = (m_next + i) % RING;
+    if (m_pending[slot].busy) complete(slot);
+  }
+}
+
+void TileReadback::complete(int slot)
+{
+  SHRIKE_TRACE_ZONE("TileReadback::complete");
+  Pending& pending = m_pending[slot];
+  pending.busy = false;
+#ifdef GL_ARB_pixel_buffer_object
+  glBindBufferARB(GL_PIXEL_PACK_BUFFER_ARB, m_buffers[slot]);
+  const unsigned char* pixels =
+    reinterpret_cast<const unsigned char*>(glMapBufferARB(GL_PIXEL_PACK_BUFFER_ARB, GL_READ_ONLY_ARB));
+  if (pixels) {
+    std::size_t row = pending.w * m_pixel;
+    for (int y = 0; y < pending.h; ++y) {
+      std::memcpy(m_band + (y * m_width + pending.x) * m_pixel, pixels + y * row, row);
+    }
+    glUnmapBufferARB(GL_PIXEL_PACK_BUFFER_ARB);
+  }
+  glBindBufferARB(GL_PIXEL_PACK_BUFFER_ARB, 0);
+#endif
+}
+
+}
+
+Screenshot::Screenshot(int width, int height, int bits)
+  : m_width(width), m_height(height), m_bits(bits == 16 ? 16 : 8),
+    m_tile_size(1024),
+    m_framebuffer(0), m_color(0), m_depth(0)
+{
+}
+
+Screenshot::~Screenshot()
+{
+  release_framebuffer();
+}
+
+void Screenshot::tile_size(int size)
+{
+  m_tile_size = std::max(size, 1);
+}
+
+const std::string& Screenshot::error() const
+{
+  return m_error;
+}
+
+bool Screenshot::save(const std::string& filename, TileRenderer& renderer,
+                      int window_width, int window_height)
+{
+  SHRIKE_TRACE_ZONE("Screenshot::save");
+  m_error = "";
+  if (m_width <= 0 || m_height <= 0) {
+    m_error = "The picture has no pixels";
+    return false;
+  }
+
+  PngWriter png(filename, m_width, m_height, m_bits);
+  if (!png.ok()) {
+    m_error = png.error();
+    return false;
+  }
+
+  glPushAttrib(GL_VIEWPORT_BIT | GL_PIXEL_MODE_BIT);
+  glPushClientAttrib(GL_CLIENT_PIXEL_STORE_BIT);
+  glPixelStorei(GL_PACK_ALIGNMENT, 1);
+
+  int tile_w, tile_h;
+  if (!setup_framebuffer(tile_w, tile_h)) {
+    tile_w = std::min(window_width, m_width);
+    tile_h = std::min(window_height, m_height);
+    glReadBuffer(GL_BACK);
+  }
+
+  std::size_t pixel = (m_bits == 16 ? 8 : 4);
+  std::size_t band_row = m_width * pixel;
+  std::vector<unsigned char> band(band_row * tile_h);
+  {
+    TileReadback readback(tile_w, tile_h, m_bits == 16 ? GL_UNSIGNED_SHORT : GL_UNSIGNED_BYTE,
+                          pixel, &band[0], m_width);
+
+    // Bands from the top, since that's the order PNG rows go in
+    for (int top = m_height; top > 0 && png.ok(); top -= tile_h) {
+      int y = std::max(top - tile_h, 0);
+      int h = top - y;
+      for (int x = 0; x < m_width; x += tile_w) {
+        int w = std::min(tile_w, m_width - x);
+        glViewport(0, 0, w, h);
+        renderer.renderTile(x, y, w, h, m_width, m_height);
+        readback.read(x, w, h);
+      }
+      readback.flush();
+      for (int row = h - 1; row >= 0; --row) {
+        png.write_row(&band[row * band_row]);
+      }
+    }
+  }
+
+  release_framebuffer();
+  glPopClientAttrib();
+  glPopAttrib();
+
+  if (!png.finish()) {
+    m_error = png.error();
+    return false;
+  }
+  return true;
+}
+
+bool Screenshot::setup_framebuffer(int& tile_w, int& tile_h)
+{
+#ifdef GL_EXT_framebuffer_object
+  if (!shrikeGlHasExtension("GL_EXT_framebuffer_object")) return false;
+
+  GLint max_size = 0;
+  GLint max_viewport[2] = { 0, 0 };
+  glGetIntegerv(GL_MAX_RENDERBUFFER_SIZE_EXT, &max_size);
+  glGetIntegerv(GL_MAX_VIEWPORT_DIMS, max_viewport);
+  int size = std::min(m_tile_size, (int)std::min(max_size, std::min(max_viewport[0], max_viewport[1])));
+  if (size <= 0) return false;
+  tile_w = std::min(size, m_width);
+  tile_h = std::min(size, m_height);
+
+  glGenFramebuffersEXT(1, &m_framebuffer);
+  glBindFramebufferEXT(GL_FRAMEBUFFER_EXT, m_framebuffer);
+
+  glGenRenderbuffersEXT(1, &m_depth);
+  glBindRenderbufferEXT(GL_RENDERBUFFER_EXT, m_depth);
+  glRenderbufferStorageEXT(GL_RENDERBUFFER_EXT, GL_DEPTH_COMPONENT24, tile_w, tile_h);
+  glFramebufferRenderbufferEXT(GL_FRAMEBUFFER_EXT, GL_DEPTH_ATTACHMENT_EXT,
+                               GL_RENDERBUFFER_EXT, m_depth);
+
+  // Not everything can draw to 16 bit colour; 8 bits read back as 16
+  // still beats giving up.
+  GLenum formats[] = { GL_RGBA16, GL_RGBA8 };
+  GLenum status = 0;
+  for (int i = (m_bits == 16 ? 0 : 1); i < 2; ++i) {
+    if (m_color) glDeleteRenderbuffersEXT(1, &m_color);
+    glGenRenderbuffersEXT(1, &m_color);
+    glBindRenderbufferEXT(GL_RENDERBUFFER_EXT, m_color);
+    glRenderbufferStorageEXT(GL_RENDERBUFFER_EXT, formats[i], tile_w, tile_h);
+    glFramebufferRenderbufferEXT(GL_FRAMEBUFFER_EXT, GL_COLOR_ATTACHMENT0_EXT,
+                                 GL_RENDERBUFFER_EXT, m_color);
+    status = glCheckFramebufferStatusEXT(GL_FRAMEBUFFER_EXT);
+    if (status == GL_FRAMEBUFFER_COMPLETE_EXT) break;
+  }
+  glBindRenderbufferEXT(GL_RENDERBUFFER_EXT, 0);
+  if (status != GL_FRAMEBUFFER_COMPLETE_EXT) {
+    release_framebuffer();
+    return false;
+  }
+  glDrawBuffer(GL_COLOR_ATTACHMENT0_EXT);
+  glReadBuffer(GL_COLOR_ATTACHMENT0_EXT);
+  return true;
+#else
+  return false;
+#endif
+}
+
+void Screenshot::release_framebuffer()
+{
+#ifdef GL_EXT_framebuffer_object
+  if (!m_framebuffer) return;
+  glBindFramebufferEXT(GL_FRAMEBUFFER_EXT, 0);
+  glDeleteRenderbuffersEXT(1, &m_color);
+  glDeleteRenderbuffersEXT(1, &m_depth);
+  glDeleteFramebuffersEXT(1, &m_framebuffer);
+  m_framebuffer = m_color = m_depth = 0;
+  glDrawBuffer(GL_BACK);
+  glReadBuffer(GL_BACK);
+#endif
+}
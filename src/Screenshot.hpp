@@ -0,0 +1,82 @@
+// Sh: A GPU metaprogramming language.
+//
+// Copyright 2003-2005 Serious Hack Inc.
+// 
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, 
+// MA  02110-1301, USA
+//////////////////////////////////////////////////////////////////////////////
+#ifndef SCREENSHOT_HPP
+#define SCREENSHOT_HPP
+
+#include <string>
+
+/// Something that can draw part of a picture for a Screenshot.
+class TileRenderer {
+public:
+  virtual ~TileRenderer() {}
+
+  /// Draw the w by h tile whose lower left corner is at x, y in a
+  /// width by height picture, into the lower left of the current
+  /// framebuffer.
+  virtual void renderTile(int x, int y, int w, int h,
+                          int width, int height) = 0;
+};
+
+/** Saves a picture of any size as PNG by drawing it in tiles.
+ *
+ * Tiles go to an offscreen framebuffer object when
+ * EXT_framebuffer_object is there, otherwise to the back buffer of
+ * the window, window_width by window_height at a time.  Each tile is
+ * read into one of a ring of pixel buffer objects, so drawing the next
+ * tiles overlaps the transfer, and GL converts to 8 or 16 bit integers
+ * on the way.  Once a band of tiles is complete its rows are handed to
+ * a PngWriter, so only one band is ever held in memory.
+ *
+ * Needs the GL context to be current.
+ */
+class Screenshot {
+public:
+  Screenshot(int width, int height, int bits = 8);
+  ~Screenshot();
+
+  /// Largest tile to draw in one go (1024 by default).
+  void tile_size(int size);
+
+  bool save(const std::string& filename, TileRenderer& renderer,
+            int window_width, int window_height);
+
+  /// Why the last save() failed.
+  const std::string& error() const;
+
+private:
+  bool setup_framebuffer(int& tile_w, int& tile_h);
+  void release_framebuffer();
+
+  int m_width;
+  int m_height;
+  int m_bits;
+  int m_tile_size;
+  std::string m_error;
+
+  unsigned int m_framebuffer;
+  unsigned int m_color;
+  unsigned int m_depth;
+
+  // NOT IMPLEMENTED
+  Screenshot(const Screenshot&);
+  Screenshot& operator=(const Screenshot&);
+};
+
+#endif
@@ -0,0 +1,273 @@
+// Sh: A GPU metaprogramming language.
+//
+// Copyright 2003-2005 Serious Hack Inc.
+// 
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, 
+// MA  02110-1301, USA
+//////////////////////////////////////////////////////////////////////////////
+#include <iostream>
+#include <string>
+#include <vector>
+#include <cstdlib>
+#include <sys/stat.h>
+#ifdef WIN32
+#include <windows.h>
+#else
+#include <dirent.h>
+#endif
+#include "PngReader.hpp"
+#include "TextureFile.hpp"
+#include "TiledTexture.hpp"
+
+// shtexconv turns shmedia's PNGs into texture files, which shrike maps
+// instead of decoding (see TextureCache), and images too big for that
+// into tiled textures for a VirtualTexture.
+
+namespace {
+
+const char* cube_faces[6] = {"left", "right", "top", "bottom", "back", "front"};
+
+struct Options {
+  Options() : half(false), mipmaps(true), force(false), tile_size(128) {}
+
+  bool half; // store half floats instead of the PNG's own samples
+  bool mipmaps;
+  bool force; // convert files whose texture file is up to date too
+  int tile_size; // for --tiles
+};
+
+int converted = 0, skipped = 0, failed = 0;
+
+bool exists(const std::string& path, time_t* modified = 0)
+{
+  struct stat status;
+  if (stat(path.c_str(), &status) != 0) return false;
+  if (modified) *modified = status.st_mtime;
+  return true;
+}
+
+/// Whether output needs making again from inputs.
+bool stale(const std::string& output, const std::vector<std::string>& inputs,
+           const Options& options)
+{
+  time_t made;
+  if (options.force || !exists(output, &made)) return true;
+  for (std::size_t i = 0; i < inputs.size(); ++i) {
+    time_t modified;
+    if (exists(inputs[i], &modified) && modified > made) return true;
+  }
+  return false;
+}
+
+/// Read inputs and write them to output as one texture file.
+void convert(const std::vector<std::string>& inputs, const std::string& output,
+             const Options& options)
+{
+  if (!stale(output, inputs, options)) {
+    ++skipped;
+    return;
+  }
+
+  std::vector<PngImage> images(inputs.size());
+  std::vector<const PngImage*> faces;
+  std::string error;
+  for (std::size_t i = 0; i < inputs.size(); ++i) {
+    if (!read_png(inputs[i], images[i], error)) {
+      std::cerr << error << std::endl;
+      ++failed;
+      return;
+    }
+    faces.push_back(&images[i]);
+  }
+
+  TextureFile::Format format = TextureFile::UBYTE;
+  if (images[0].bits == 16) format = TextureFile::USHORT;
+  if (options.half) format = TextureFile::HALF;
+  if (!TextureFile::write(output, format, faces, options.mipmaps, error)) {
+    std::cerr << error << std::endl;
+    ++failed;
+    return;
+  }
+  std::cout << output << std::endl;
+  ++converted;
+}
+
+void convert_png(const std::string& path, const Options& options)
+{
+  std::string output = path;
+  if (output.size() > 4 && output.compare(output.size() - 4, 4, ".png") == 0) {
+    output.erase(output.size() - 4);
+  }
+  convert(std::vector<std::string>(1, path), output + ".shtex", options);
+}
+
+void convert_cube(const std::string& directory, const Options& options)
+{
+  std::vector<std::string> inputs;
+  for (int i = 0; i < 6; ++i) inputs.push_back(directory + "/" + cube_faces[i] + ".png");
+  convert(inputs, directory + "/cube.shtex", options);
+}
+
+/// Tile path, foo.png, into foo.shvt.
+void convert_tiles(const std::string& path, const Options& options)
+{
+  std::string output = path;
+  if (output.size() > 4 && output.compare(output.size() - 4, 4, ".png") == 0) {
+    output.erase(output.size() - 4);
+  }
+  output += ".shvt";
+  if (!stale(output, std::vector<std::string>(1, path), options)) {
+    ++skipped;
+    return;
+  }
+  std::string error;
+  if (!TiledTexture::write(path, output, options.tile_size, error)) {
+    std::cerr << error << std::endl;
+    ++failed;
+    return;
+  }
+  std::cout << output << std::endl;
+  ++converted;
+}
+
+/// The names in directory, files and subdirectories apart.
+bool list_directory(const std::string& directory, std::vector<std::string>& files,
+                    std::vector<std::string>& directories)
+{
+#ifdef WIN32
+  WIN32_FIND_DATAA entry;
+  HANDLE find = FindFirstFileA((directory + "\\*").c_str(), &entry);
+  if (find == INVALID_HANDLE_VALUE) return false;
+  do {
+    std::string name = entry.cFileName;
+    if (name == "." || name == "..") continue;
+    if (entry.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) {
+      directories.push_back(name);
+    } else {
+      files.push_back(name);
+    }
+  } while (FindNextFileA(find, &entry));
+  FindClose(find);
+#else
+  DIR* dir = opendir(directory.c_str());
+  if (!dir) return false;
+  while (struct dirent* entry = readdir(dir)) {
+    std::string name = entry->d_name;
+    if (name == "." || name == "..") continue;
+    struct stat status;
+    if (stat((directory + "/" + name).c_str(), &status) != 0) continue;
+    if (S_ISDIR(status.st_mode)) {
+      directories.push_back(name);
+    } else {
+      files.push_back(name);
+    }
+  }
+  closedir(dir);
+#endif
+  return true;
+}
+
+/// Convert every PNG under directory.  A directory holding all six
+/// faces of a cube map gets a cube.shtex in place of one for each face.
+void convert_tree(const std::string& directory, const Options& options)
+{
+  std::vector<std::string> files, directories;
+  if (!list_directory(directory, files, directories)) {
+    std::cerr << "Unable to read " << directory << std::endl;
+    ++failed;
+    return;
+  }
+
+  bool cube = true;
+  for (int i = 0; i < 6; ++i) {
+    cube = cube && exists(directory + "/" + cube_faces[i] + ".png");
+  }
+  if (cube) convert_cube(directory, options);
+
+  for (std::size_t i = 0; i < files.size(); ++i) {
+    const std::string& name = files[i];
+    if (name.size() <= 4 || name.compare(name.size() - 4, 4, ".png") != 0) continue;
+    bool face = false;
+    for (int j = 0; j < 6; ++j) face = face || name == std::string(cube_faces[j]) + ".png";
+    if (cube && face) continue;
+    convert_png(directory + "/" + name, options);
+  }
+  for (std::size_t i = 0; i < directories.size(); ++i) {
+    convert_tree(directory + "/" + directories[i], options);
+  }
+}
+
+void usage()
+{
+  std::cout << "Usage:" << std::endl;
+  std::cout << std::endl;
+  std::cout << " shtexconv [options] <png file>... : Make foo.shtex from each foo.png" << std::endl;
+  std::cout << " shtexconv [options] --cube <directory>... : Make cube.shtex from the six faces in each directory" << std::endl;
+  std::cout << " shtexconv [options] --tree <directory> : Convert every PNG under directory, cube maps as cube maps" << std::endl;
+  std::cout << " shtexconv [options] --tiles <png file>... : Make a tiled foo.shvt from each foo.png, for virtual texturing" << std::endl;
+  std::cout << std::endl;
+  std::cout << " --half : Store half floats instead of 8 or 16 bit samples" << std::endl;
+  std::cout << " --no-mipmaps : Only store the full size image" << std::endl;
+  std::cout << " --force : Convert files whose texture file is newer too" << std::endl;
+  std::cout << " --tile-size=N : Texels on a side of a tile for --tiles (default 128)" << std::endl;
+}
+
+}
+
+int main(int argc, char** argv)
+{
+  Options options;
+  enum { PNGS, CUBES, TREE, TILES } mode = PNGS;
+  std::vector<std::string> paths;
+  for (int i = 1; i < argc; ++i) {
+    std::string arg(argv[i]);
+    if (arg == "--half") {
+      options.half = true;
+    } else if (arg == "--no-mipmaps") {
+      options.mipmaps = false;
+    } else if (arg == "--force") {
+      options.force = true;
+    } else if (arg == "--cube") {
+      mode = CUBES;
+    } else if (arg == "--tree") {
+      mode = TREE;
+    } else if (arg == "--tiles") {
+      mode = TILES;
+    } else if (arg.compare(0, 12, "--tile-size=") == 0) {
+      options.tile_size = std::atoi(arg.c_str() + 12);
+    } else if (arg.size() > 1 && arg[0] == '-') {
+      usage();
+      return 1;
+    } else {
+      paths.push_back(arg);
+    }
+  }
+  if (paths.empty()) {
+    usage();
+    return 1;
+  }
+
+  for (std::size_t i = 0; i < paths.size(); ++i) {
+    switch (mode) {
+    case PNGS: convert_png(paths[i], options); break;
+    case CUBES: convert_cube(paths[i], options); break;
+    case TREE: convert_tree(paths[i], options); break;
+    case TILES: convert_tiles(paths[i], options); break;
+    }
+  }
+  std::cout << converted << " converted, " << skipped << " up to date, "
+            << failed << " failed" << std::endl;
+  return failed ? 1 : 0;
+}
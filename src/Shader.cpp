@@ -18,6 +18,8 @@
 // MA  02110-1301, USA
 //////////////////////////////////////////////////////////////////////////////
 #include "Shader.hpp"
+#include "Trace.hpp"
+#include "ProgramCache.hpp"
 //#include "ShrikeCanvas.hpp"
 
 Shader::Shader(const std::string& name, const Globals &globals)
@@ -25,13 +27,15 @@ Shader::Shader(const std::string& name, const Globals &globals)
     m_name(name),
     m_has_been_init(false),
     m_failed(false),
-    m_shaders(0)
+    m_shaders(0),
+    m_cached(0)
 {
 }
 
 Shader::~Shader()
 {
   delete m_shaders;
+  delete m_cached;
 }
 
 void Shader::set_failed(bool failed)
@@ -47,16 +51,60 @@ bool Shader::failed() const
 bool Shader::firstTimeInit()
 {
   if (m_has_been_init) return true;
+  SHRIKE_TRACE_ZONE("Shader::firstTimeInit");
   bool success = init();
   m_has_been_init = true;
   return success;
 }
 
+bool Shader::initialized() const
+{
+  return m_has_been_init;
+}
+
+void Shader::compile()
+{
+  if (m_cached || m_shaders) return;
+  SHRIKE_TRACE_ZONE("Shader::compile");
+  ProgramCache::Keys keys;
+  m_cached = ProgramCache::instance().load(vertex(), fragment(), keys);
+  if (m_cached) return;
+
+  SH::ShProgram vsh = vertex();
+  SH::ShProgram fsh = fragment();
+  SH::shCompile(vsh);
+  SH::shCompile(fsh);
+  ProgramCache::instance().store(vsh, fsh, keys);
+  m_shaders = new SH::ShProgramSet(vsh, fsh);
+}
+
+bool Shader::compiled() const
+{
+  return m_cached || m_shaders;
+}
+
+void Shader::release()
+{
+  delete m_shaders;
+  m_shaders = 0;
+  delete m_cached;
+  m_cached = 0;
+}
+
 void Shader::bind() {
-  if (!m_shaders) {
-    m_shaders = new SH::ShProgramSet(vertex(), fragment());
+  SHRIKE_TRACE_ZONE("Shader::bind");
+  compile();
+  if (m_cached) {
+    m_cached->bind();
+  } else {
+    SH::shBind(*m_shaders);
   }
-  SH::shBind(*m_shaders);
+}
+
+void Shader::unbind()
+{
+  SH::shUnbind();
+  CachedProgramSet::unbind();
 }
 
 const std::string& Shader::name() const
@@ -69,7 +117,7 @@ std::size_t Shader::paramCount() const
   return m_stringParams.size();
 }
 
-bool Shader::render(const ShUtil::ShObjMesh& mesh)
+bool Shader::render(const MeshView& mesh)
 {
   return false;
 }
@@ -83,6 +131,25 @@ Shader::StringParamList::iterator Shader::endStringParams()
 {
   return m_stringParams.end();
 }
+
+Shader::VarList::const_iterator Shader::beginHostUniforms() const
+{
+  return m_hostUniforms.begin();
+}
+
+Shader::VarList::const_iterator Shader::endHostUniforms() const
+{
+  return m_hostUniforms.end();
+}
+
+void Shader::textures(std::vector<std::string>&) const
+{
+}
+
+bool Shader::animating() const
+{
+  return false;
+}
 /*
 Shader::iterator Shader::begin()
 {
@@ -109,6 +176,11 @@ void Shader::setStringParam(const std::string& name,
 {
   m_stringParams.push_back(StringParam(name, param));
 }
+
+void Shader::setHostUniform(const SH::ShVariable& var)
+{
+  m_hostUniforms.push_back(var.node());
+}
 /*
 void Shader::append(Shader* shader)
 {
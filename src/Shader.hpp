@@ -22,10 +22,13 @@
 
 #include <string>
 #include <list>
+#include <vector>
 #include <sh/sh.hpp>
 #include <shutil/shutil.hpp>
 
 struct Globals;
+class CachedProgramSet;
+class MeshView;
 
 class Shader {
 public:
@@ -41,12 +44,37 @@ public:
   virtual bool init() = 0;
   virtual void bind(); // binds vertex() and fragment()
 
+  /// Generate code for vertex() and fragment(), or fetch it from the
+  /// ProgramCache, without binding it.  bind() does this itself if
+  /// it hasn't been done yet; it's here so it can be done ahead.
+  void compile();
+  /// Return whether compile() has been done since the last release().
+  bool compiled() const;
+
+  /// Forget what compile() made, so the next compile() or bind()
+  /// makes it again from vertex() and fragment().  Call this after
+  /// init() has rebuilt them, or they'll never be seen.
+  void release();
+
+  /// Undo bind() of any shader.  Use this rather than shUnbind(),
+  /// which doesn't know about programs from the ProgramCache.
+  static void unbind();
+
   virtual SH::ShProgram fragment() = 0;
   virtual SH::ShProgram vertex() = 0;
   
-  virtual bool render(const ShUtil::ShObjMesh&);
+  /// Draw the model under the bound programs, or something else, and
+  /// return true; or return false to have the model drawn as it is.
+  virtual bool render(const MeshView& mesh);
 
   bool firstTimeInit();
+  /// Return whether firstTimeInit() has been run.
+  bool initialized() const;
+
+  /// Add the PNGs init() reads through the TextureCache to paths, so
+  /// they can be decoded before it runs.  Cube maps go in through
+  /// TextureCache::cube_faces().  None by default.
+  virtual void textures(std::vector<std::string>& paths) const;
   
   const std::string& name() const;
 
@@ -67,6 +95,18 @@ public:
 
   StringParamList::iterator beginStringParams();
   StringParamList::iterator endStringParams();
+
+  typedef std::list<SH::ShVariableNodePtr> VarList;
+
+  /// Uniforms render() reads on the host rather than in a program.
+  /// The uniform panel lists them with the programs' own.
+  VarList::const_iterator beginHostUniforms() const;
+  VarList::const_iterator endHostUniforms() const;
+
+  /// Return whether render() has more to show with nothing else
+  /// changing, like a simulation that hasn't come to rest.  The canvas
+  /// keeps drawing frames while it does.
+  virtual bool animating() const;
 /* 
   typedef std::list<Shader*> list;
   typedef list::iterator iterator;
@@ -79,6 +119,7 @@ public:
 protected:
   void setStringParam(const std::string& name,
                       std::string& param);
+  void setHostUniform(const SH::ShVariable& var);
   
   const Globals &m_globals;
 private:
@@ -89,8 +130,10 @@ private:
   bool m_failed;
 
   StringParamList m_stringParams;
+  VarList m_hostUniforms;
 
   SH::ShProgramSet* m_shaders;
+  CachedProgramSet* m_cached; // used instead of m_shaders if set
 /*
   static list* getList();
   
@@ -0,0 +1,215 @@
+// Sh: A GPU metaprogramming language.
+//
+// Copyright 2003-2005 Serious Hack Inc.
+// 
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, 
+// MA  02110-1301, USA
+//////////////////////////////////////////////////////////////////////////////
+#include <vector>
+#include <wx/glcanvas.h>
+#include "Shader.hpp"
+#include "ShrikeFrame.hpp"
+#include "ProgramCache.hpp"
+#include "TextureCache.hpp"
+#include "Trace.hpp"
+#include "ShaderSwitcher.hpp"
+
+BEGIN_EVENT_TABLE(ShaderSwitcher, wxEvtHandler)
+  EVT_TIMER(-1, ShaderSwitcher::on_timer)
+END_EVENT_TABLE()
+
+ShaderSwitcher::ShaderSwitcher(ShrikeFrame* frame, wxTreeCtrl* tree, wxGLCanvas* canvas)
+  : m_frame(frame),
+    m_tree(tree),
+    m_canvas(canvas),
+    m_timer(this),
+    m_state(IDLE),
+    m_shader(0),
+    m_decoding(false)
+{
+}
+
+ShaderSwitcher::~ShaderSwitcher()
+{
+  m_timer.Stop();
+}
+
+void ShaderSwitcher::request(const wxTreeItemId& item)
+{
+  Shader* shader = shader_of(item);
+  if (!shader) return;
+
+  cancel();
+  m_item = item;
+  m_shader = shader;
+  m_label = m_tree->GetItemText(item);
+  m_prefetch.remove(item);
+
+  if (shader->failed()) {
+    // set_shader() turns it down again, without the wait
+    set_state(SWAP);
+  } else if (!shader->initialized()) {
+    std::vector<std::string> paths;
+    shader->textures(paths);
+    TextureCache::instance().start_preload(paths);
+    set_state(LOAD);
+  } else {
+    set_state(COMPILE);
+  }
+  schedule();
+}
+
+void ShaderSwitcher::cancel()
+{
+  if (m_state == IDLE) return;
+  set_state(IDLE);
+  m_shader = 0;
+}
+
+void ShaderSwitcher::set_state(State state)
+{
+  m_state = state;
+  switch (state) {
+  case LOAD:
+    m_tree->SetItemText(m_item, m_label + wxT(" (loading textures...)"));
+    break;
+  case INIT:
+    m_tree->SetItemText(m_item, m_label + wxT(" (initializing...)"));
+    break;
+  case COMPILE:
+    m_tree->SetItemText(m_item, m_label + wxT(" (compiling...)"));
+    break;
+  default:
+    m_tree->SetItemText(m_item, m_label);
+    break;
+  }
+}
+
+void ShaderSwitcher::schedule()
+{
+  if (m_state == LOAD || (m_state == IDLE && m_prefetch.empty() && m_decoding)) {
+    // Nothing to do but poll the decoding threads
+    m_timer.Start(10, wxTIMER_ONE_SHOT);
+  } else if (m_state != IDLE || !m_prefetch.empty()) {
+    // Going through the event loop lets it draw and handle input
+    // before the next stage.
+    m_timer.Start(1, wxTIMER_ONE_SHOT);
+  }
+}
+
+void ShaderSwitcher::on_timer(wxTimerEvent& event)
+{
+  if (m_state != IDLE) {
+    step();
+  } else {
+    prefetch_step();
+  }
+  schedule();
+}
+
+void ShaderSwitcher::step()
+{
+  Shader* shader = m_shader;
+  bool ok = true;
+  switch (m_state) {
+  case LOAD:
+    if (TextureCache::instance().finish_preload()) {
+      m_decoding = false;
+      set_state(INIT);
+    }
+    break;
+  case INIT:
+    ok = m_frame->shader_step(shader, ShrikeFrame::SHADER_INIT);
+    if (ok) set_state(COMPILE);
+    break;
+  case COMPILE:
+    ok = m_frame->shader_step(shader, ShrikeFrame::SHADER_COMPILE);
+    if (ok) set_state(SWAP);
+    break;
+  case SWAP:
+    {
+      wxTreeItemId item = m_item;
+      cancel(); // set_shader() would cancel this anyway
+      ok = m_frame->set_shader(shader);
+      if (ok) prefetch_neighbours(item);
+    }
+    break;
+  case IDLE:
+    break;
+  }
+  if (!ok) {
+    failed(m_item);
+    cancel();
+  }
+}
+
+void ShaderSwitcher::failed(const wxTreeItemId& item)
+{
+  m_tree->SetItemTextColour(item, *wxRED);
+}
+
+void ShaderSwitcher::prefetch_neighbours(const wxTreeItemId& item)
+{
+  m_prefetch.clear();
+  wxTreeItemId prev = m_tree->GetPrevSibling(item);
+  wxTreeItemId next = m_tree->GetNextSibling(item);
+  // Stepping forward through the tree is the common case.
+  if (shader_of(next)) m_prefetch.push_back(next);
+  if (shader_of(prev)) m_prefetch.push_back(prev);
+}
+
+void ShaderSwitcher::prefetch_step()
+{
+  if (m_prefetch.empty()) {
+    // Make the ShImages of whatever has been decoded since
+    if (m_decoding) m_decoding = !TextureCache::instance().finish_preload();
+    return;
+  }
+  wxTreeItemId item = m_prefetch.front();
+  m_prefetch.pop_front();
+  Shader* shader = shader_of(item);
+  if (!shader || shader->failed()) return;
+
+  // Nothing here may hold up the GUI thread: init() and a compile
+  // the ProgramCache can't answer are left for when it's picked.
+  SHRIKE_TRACE_ZONE("ShaderSwitcher::prefetch");
+  if (!shader->initialized()) {
+    std::vector<std::string> paths;
+    shader->textures(paths);
+    TextureCache::instance().start_preload(paths);
+    m_decoding = true;
+    return;
+  }
+  if (shader->compiled()) return;
+  try {
+    ProgramCache::Keys keys;
+    if (!ProgramCache::instance().contains(shader->vertex(), shader->fragment(), keys)) return;
+    m_canvas->SetCurrent();
+    shader->compile();
+  } catch (const SH::ShException& e) {
+    shader->set_failed(true);
+    failed(item);
+    m_frame->output()->Insert(m_tree->GetItemText(item) + wxT(": ")
+                              + wxString(e.message().c_str(), wxConvLibc),
+                              m_frame->output()->GetCount());
+  }
+}
+
+Shader* ShaderSwitcher::shader_of(const wxTreeItemId& item) const
+{
+  if (!item.IsOk()) return 0;
+  ShaderTreeData* data = dynamic_cast<ShaderTreeData*>(m_tree->GetItemData(item));
+  return data ? data->shader : 0;
+}
@@ -0,0 +1,117 @@
+// Sh: A GPU metaprogramming language.
+//
+// Copyright 2003-2005 Serious Hack Inc.
+// 
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, 
+// MA  02110-1301, USA
+//////////////////////////////////////////////////////////////////////////////
+#ifndef SHADERSWITCHER_HPP
+#define SHADERSWITCHER_HPP
+
+#include <list>
+#include <wx/wx.h>
+#include <wx/treectrl.h>
+
+class Shader;
+class ShrikeFrame;
+class wxGLCanvas;
+
+/// The data attached to shader items in the frame's shader tree.
+struct ShaderTreeData : public wxTreeItemData {
+  ShaderTreeData(Shader* shader)
+    : shader(shader)
+  {
+  }
+  
+  Shader* shader;
+};
+
+/** Makes the shader picked in the shader tree current without
+ * freezing the window.  Activating a shader goes through
+ *
+ *   LOAD     decoding the PNGs of Shader::textures() on a thread of
+ *            their own, polled until TextureCache::finish_preload()
+ *            has made their ShImages
+ *   INIT     firstTimeInit(), which builds the programs and finds its
+ *            textures already in the cache
+ *   COMPILE  Shader::compile(), or a ProgramCache lookup
+ *   SWAP     ShrikeFrame::set_shader(), which only has to bind
+ *
+ * with one stage per timer tick, so the window keeps drawing the
+ * previous shader and handling input in between.  The tree item shows
+ * which stage it is in, and turns red if one fails.  Picking another
+ * item while a switch is under way abandons it (whatever was done so
+ * far is kept by the shader).
+ *
+ * Sh's context isn't thread safe, so INIT and COMPILE run on the GUI
+ * thread.  Once nothing is pending, the items on either side of the
+ * current one only get what doesn't hold it up: the decoding of their
+ * textures, and a compile() of programs the ProgramCache has.
+ */
+class ShaderSwitcher : public wxEvtHandler {
+public:
+  ShaderSwitcher(ShrikeFrame* frame, wxTreeCtrl* tree, wxGLCanvas* canvas);
+  ~ShaderSwitcher();
+
+  /// Start switching to the shader of item.  Items that have no
+  /// shader are ignored.
+  void request(const wxTreeItemId& item);
+
+  /// Abandon any switch that is under way.  Prefetching carries on.
+  void cancel();
+
+  /// Return whether a switch is under way.
+  bool busy() const { return m_state != IDLE; }
+
+private:
+  enum State {
+    IDLE,
+    LOAD,
+    INIT,
+    COMPILE,
+    SWAP
+  };
+
+  void on_timer(wxTimerEvent& event);
+  void step();
+  void prefetch_step();
+  void prefetch_neighbours(const wxTreeItemId& item);
+  void set_state(State state);
+  void schedule();
+  void failed(const wxTreeItemId& item);
+
+  Shader* shader_of(const wxTreeItemId& item) const;
+
+  ShrikeFrame* m_frame;
+  wxTreeCtrl* m_tree;
+  wxGLCanvas* m_canvas;
+  wxTimer m_timer;
+
+  State m_state;
+  wxTreeItemId m_item; // the item being switched to
+  Shader* m_shader; // and its shader
+  wxString m_label; // the item's text before it showed progress
+
+  std::list<wxTreeItemId> m_prefetch;
+  bool m_decoding; // textures of prefetched shaders still decoding
+
+  // NOT IMPLEMENTED
+  ShaderSwitcher(const ShaderSwitcher&);
+  ShaderSwitcher& operator=(const ShaderSwitcher&);
+
+  DECLARE_EVENT_TABLE()
+};
+
+#endif
@@ -19,8 +19,15 @@
 //////////////////////////////////////////////////////////////////////////////
 #include "ShrikeApp.hpp"
 #include "ShrikeFrame.hpp"
+#include "ShrikeCanvas.hpp"
 #include "Globals.hpp"
+#include "Precompile.hpp"
 #include "Project.hpp"
+#include "ProgramCache.hpp"
+#include "Trace.hpp"
+#include <cstdio>
+#include <cstdlib>
+#include <sstream>
 #include <sh/sh.hpp>
 #include <wx/dir.h>
 #include <wx/dynlib.h>
@@ -55,9 +62,23 @@ struct LibraryTraverser : public wxDirTraverser
   }
 };
 
+// Match --name=value, storing value.
+static bool parse_option(const std::string& arg, const std::string& name,
+                         std::string& value)
+{
+  std::string prefix = name + "=";
+  if (arg.compare(0, prefix.size(), prefix) != 0) return false;
+  value = arg.substr(prefix.size());
+  return true;
+}
+
 IMPLEMENT_APP(ShrikeApp)
 
 ShrikeApp::ShrikeApp()
+  : m_bench(false), m_sweep(false),
+    m_precompile(false),
+    m_worker(0), m_workers(0),
+    m_frame_budget(0)
 {
 }
   
@@ -65,11 +86,62 @@ bool ShrikeApp::OnInit()
 {
   std::string backend_name = "arb";
 
-  if (argc > 1) {
-    backend_name = wxConvLibc.cWX2MB(argv[1]);
+  for (int i = 1; i < argc; ++i) {
+    std::string arg = (const char*)wxConvLibc.cWX2MB(argv[i]);
+    std::string value;
+    if (arg == "--bench") {
+      m_bench = true;
+    } else if (parse_option(arg, "--bench-frames", value)) {
+      m_bench_options.frames = std::atoi(value.c_str());
+    } else if (parse_option(arg, "--bench-warmup", value)) {
+      m_bench_options.warmup = std::atoi(value.c_str());
+    } else if (parse_option(arg, "--bench-size", value)) {
+      std::sscanf(value.c_str(), "%dx%d", &m_bench_options.width, &m_bench_options.height);
+    } else if (parse_option(arg, "--bench-model", value)) {
+      m_bench_options.model = value;
+    } else if (parse_option(arg, "--bench-filter", value)) {
+      m_bench_options.filter = value;
+    } else if (parse_option(arg, "--bench-output", value)) {
+      m_bench_options.output = value;
+    } else if (parse_option(arg, "--bench-baseline", value)) {
+      m_bench_options.baseline = value;
+    } else if (parse_option(arg, "--bench-tolerance", value)) {
+      m_bench_options.tolerance = std::atof(value.c_str())/100.0f;
+    } else if (arg == "--optimization-sweep") {
+      m_sweep = true;
+    } else if (parse_option(arg, "--sweep-levels", value)) {
+      m_bench_options.sweep_levels.clear();
+      std::istringstream levels(value);
+      std::string level;
+      while (std::getline(levels, level, ',')) {
+        m_bench_options.sweep_levels.push_back(std::atoi(level.c_str()));
+      }
+    } else if (parse_option(arg, "--sweep-output", value)) {
+      m_bench_options.sweep_output = value;
+    } else if (parse_option(arg, "--sweep-tolerance", value)) {
+      m_bench_options.sweep_tolerance = std::atoi(value.c_str());
+    } else if (arg == "--precompile") {
+      m_precompile = true;
+    } else if (parse_option(arg, "--precompile-worker", value)) {
+      std::sscanf(value.c_str(), "%d/%d", &m_worker, &m_workers);
+    } else if (parse_option(arg, "--optimization", value)) {
+      SH::ShContext::current()->optimization(std::atoi(value.c_str()));
+    } else if (parse_option(arg, "--disable-optimization", value)) {
+      SH::ShContext::current()->disable_optimization(value);
+    } else if (parse_option(arg, "--frame-budget", value)) {
+      m_frame_budget = std::atoi(value.c_str());
+    } else if (arg == "--no-program-cache") {
+      ProgramCache::instance().enabled(false);
+    } else if (parse_option(arg, "--trace", value)) {
+      m_trace = value;
+      trace_enable(true);
+    } else {
+      backend_name = arg;
+    }
   }
   
   SH::shSetBackend(backend_name);
+  ProgramCache::instance().backend(backend_name);
 
   GetGlobals().lightPos = SH::ShPoint3f(0.0, 10.0, 10.0);
   GetGlobals().lightDirW = SH::ShVector3f(0.0, 1.0, 1.0);
@@ -93,9 +165,29 @@ bool ShrikeApp::OnInit()
     libDir.Traverse(t);
   }
 
+  if (m_bench || m_sweep || m_workers > 0) return true;
+
   ShrikeFrame* frame = new ShrikeFrame();
   frame->Show(true);
+  ShrikeCanvas::instance()->setFrameBudget(m_frame_budget);
+  if (m_precompile) frame->precompile();
   
   return true;
 }
 
+int ShrikeApp::OnRun()
+{
+  if (m_bench) return run_benchmark(m_bench_options);
+  if (m_sweep) return run_optimization_sweep(m_bench_options);
+  if (m_workers > 0) return run_precompile_worker(m_worker, m_workers);
+  return wxApp::OnRun();
+}
+
+int ShrikeApp::OnExit()
+{
+  if (!m_trace.empty() && !trace_save(m_trace)) {
+    std::cerr << "Could not write trace to " << m_trace << std::endl;
+  }
+  return wxApp::OnExit();
+}
+
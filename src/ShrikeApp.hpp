@@ -21,6 +21,7 @@
 #define SHRIKEAPP_HPP
 
 #include <wx/wx.h>
+#include "Bench.hpp"
 #include "Shader.hpp"
 
 class ShrikeApp : public wxApp {
@@ -28,6 +29,17 @@ public:
   ShrikeApp();
   
   bool OnInit();
+  int OnRun();
+  int OnExit();
+
+private:
+  bool m_bench; // run headless benchmarks instead of the GUI
+  bool m_sweep; // run the optimization level sweep instead
+  BenchOptions m_bench_options; // for either
+  std::string m_trace; // file to save zones to on exit, if any
+  bool m_precompile; // fill the program cache in the background
+  int m_worker, m_workers; // slice to precompile, if a worker
+  int m_frame_budget; // minimum ms between frames
 };
 
 #endif
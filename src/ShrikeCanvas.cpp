@@ -18,6 +18,9 @@
 // MA  02110-1301, USA
 //////////////////////////////////////////////////////////////////////////////
 #include <sstream>
+#include <algorithm>
+#include <cmath>
+#include <iostream>
 
 #include <sh/sh.hpp>
 #include <shutil/shutil.hpp>
@@ -28,6 +31,10 @@
 #include "Globals.hpp"
 #include "ShTrackball.hpp"
 #include "Timer.hpp"
+#include "Trace.hpp"
+#include "UniformBatch.hpp"
+#include "Animation.hpp"
+#include "CompareView.hpp"
 #include "shaders/LCDSmall.hpp"
 
 void shrikeGlCheckError(const char* desc, const char* file, int line) {
@@ -79,28 +86,93 @@ void shrikeGlCheckError(const char* desc, const char* file, int line) {
 using namespace SH;
 using namespace ShUtil;
 
+namespace {
+
+/// Row by row.
+void get_matrix(ShMatrix4x4f& m, float values[16])
+{
+  for (int i = 0; i < 16; i++) m[i/4](i%4).getValues(&values[i]);
+}
+
+/// Returns false, leaving inv alone, if m is singular.
+bool invert_matrix(const float m[16], float inv[16])
+{
+  float t[16];
+  t[0] = m[5]*m[10]*m[15] - m[5]*m[11]*m[14] - m[9]*m[6]*m[15]
+    + m[9]*m[7]*m[14] + m[13]*m[6]*m[11] - m[13]*m[7]*m[10];
+  t[4] = -m[4]*m[10]*m[15] + m[4]*m[11]*m[14] + m[8]*m[6]*m[15]
+    - m[8]*m[7]*m[14] - m[12]*m[6]*m[11] + m[12]*m[7]*m[10];
+  t[8] = m[4]*m[9]*m[15] - m[4]*m[11]*m[13] - m[8]*m[5]*m[15]
+    + m[8]*m[7]*m[13] + m[12]*m[5]*m[11] - m[12]*m[7]*m[9];
+  t[12] = -m[4]*m[9]*m[14] + m[4]*m[10]*m[13] + m[8]*m[5]*m[14]
+    - m[8]*m[6]*m[13] - m[12]*m[5]*m[10] + m[12]*m[6]*m[9];
+  t[1] = -m[1]*m[10]*m[15] + m[1]*m[11]*m[14] + m[9]*m[2]*m[15]
+    - m[9]*m[3]*m[14] - m[13]*m[2]*m[11] + m[13]*m[3]*m[10];
+  t[5] = m[0]*m[10]*m[15] - m[0]*m[11]*m[14] - m[8]*m[2]*m[15]
+    + m[8]*m[3]*m[14] + m[12]*m[2]*m[11] - m[12]*m[3]*m[10];
+  t[9] = -m[0]*m[9]*m[15] + m[0]*m[11]*m[13] + m[8]*m[1]*m[15]
+    - m[8]*m[3]*m[13] - m[12]*m[1]*m[11] + m[12]*m[3]*m[9];
+  t[13] = m[0]*m[9]*m[14] - m[0]*m[10]*m[13] - m[8]*m[1]*m[14]
+    + m[8]*m[2]*m[13] + m[12]*m[1]*m[10] - m[12]*m[2]*m[9];
+  t[2] = m[1]*m[6]*m[15] - m[1]*m[7]*m[14] - m[5]*m[2]*m[15]
+    + m[5]*m[3]*m[14] + m[13]*m[2]*m[7] - m[13]*m[3]*m[6];
+  t[6] = -m[0]*m[6]*m[15] + m[0]*m[7]*m[14] + m[4]*m[2]*m[15]
+    - m[4]*m[3]*m[14] - m[12]*m[2]*m[7] + m[12]*m[3]*m[6];
+  t[10] = m[0]*m[5]*m[15] - m[0]*m[7]*m[13] - m[4]*m[1]*m[15]
+    + m[4]*m[3]*m[13] + m[12]*m[1]*m[7] - m[12]*m[3]*m[5];
+  t[14] = -m[0]*m[5]*m[14] + m[0]*m[6]*m[13] + m[4]*m[1]*m[14]
+    - m[4]*m[2]*m[13] - m[12]*m[1]*m[6] + m[12]*m[2]*m[5];
+  t[3] = -m[1]*m[6]*m[11] + m[1]*m[7]*m[10] + m[5]*m[2]*m[11]
+    - m[5]*m[3]*m[10] - m[9]*m[2]*m[7] + m[9]*m[3]*m[6];
+  t[7] = m[0]*m[6]*m[11] - m[0]*m[7]*m[10] - m[4]*m[2]*m[11]
+    + m[4]*m[3]*m[10] + m[8]*m[2]*m[7] - m[8]*m[3]*m[6];
+  t[11] = -m[0]*m[5]*m[11] + m[0]*m[7]*m[9] + m[4]*m[1]*m[11]
+    - m[4]*m[3]*m[9] - m[8]*m[1]*m[7] + m[8]*m[3]*m[5];
+  t[15] = m[0]*m[5]*m[10] - m[0]*m[6]*m[9] - m[4]*m[1]*m[10]
+    + m[4]*m[2]*m[9] + m[8]*m[1]*m[6] - m[8]*m[2]*m[5];
+
+  float det = m[0]*t[0] + m[1]*t[4] + m[2]*t[8] + m[3]*t[12];
+  if (det == 0.0f) return false;
+  for (int i = 0; i < 16; i++) inv[i] = t[i] / det;
+  return true;
+}
+
+/// How far, in pixels, the level drawn may be from the full model.
+const float lod_pixels = 1.0f;
+
+}
+
 BEGIN_EVENT_TABLE(ShrikeCanvas, wxGLCanvas)
   EVT_PAINT(ShrikeCanvas::paint)
   EVT_SIZE(ShrikeCanvas::reshape)
   EVT_MOTION(ShrikeCanvas::motion)
+  EVT_IDLE(ShrikeCanvas::idle)
+  EVT_TIMER(-1, ShrikeCanvas::budgetExpired)
 END_EVENT_TABLE()
 
 ShrikeCanvas* ShrikeCanvas::m_instance = 0;
   
-ShrikeCanvas::ShrikeCanvas(wxWindow* parent, ShObjMesh* model)
+ShrikeCanvas::ShrikeCanvas(wxWindow* parent, MeshLod* lod, ObjMeshSource* model)
   : wxGLCanvas(parent, -1, wxDefaultPosition, wxDefaultSize),
     m_init(false),
-    m_model(model),
-    m_model_dirty(true),
-    m_model_list(0),
+    m_model(0),
+    m_pinned_level(-1),
+    m_level(0),
     m_shader(0),
     m_showLight(true),
     m_showFps(false),
     m_fps_shaders(0),
+    m_stat_shaders(0),
+    m_dirty(false),
+    m_budget(0),
+    m_budget_timer(this),
+    m_requested(0),
+    m_rendered(0),
     m_bg_r(0.2), m_bg_g(0.2), m_bg_b(0.2),
     m_bg(0.2, 0.2, 0.2)
 {
   m_instance = this;
+  setLevels(lod, model);
 
   GetGlobals().mv.internal(true);
   GetGlobals().mvp.internal(true);
@@ -119,6 +191,11 @@ ShrikeCanvas::ShrikeCanvas(wxWindow* parent, ShObjMesh* model)
   resetView();
 }
 
+ShrikeCanvas::~ShrikeCanvas()
+{
+  setLevels(0, 0);
+}
+
 ShrikeCanvas* ShrikeCanvas::instance()
 {
   return m_instance;
@@ -128,21 +205,154 @@ void ShrikeCanvas::paint(wxPaintEvent& event)
 {
   wxPaintDC dc(this);
   SHRIKE_GL_CHECK_CURRENT_ERROR;
+  // The window has to be drawn before the paint event returns.
+  ++m_requested;
+  render();
+}
+
+void ShrikeCanvas::invalidate()
+{
+  ++m_requested;
+  if (m_dirty) return;
+  m_dirty = true;
+  wxWakeUpIdle();
+}
+
+void ShrikeCanvas::idle(wxIdleEvent& event)
+{
+  if (!m_dirty) return;
+  float elapsed = (ShTimer::now() - m_last_frame).value();
+  if (elapsed < m_budget) {
+    // Come back when the budget is used up.
+    if (!m_budget_timer.IsRunning()) {
+      m_budget_timer.Start((int)(m_budget - elapsed) + 1, wxTIMER_ONE_SHOT);
+    }
+    return;
+  }
   render();
 }
 
-void ShrikeCanvas::setModel(ShObjMesh* model)
+void ShrikeCanvas::budgetExpired(wxTimerEvent& event)
+{
+  wxWakeUpIdle();
+}
+
+void ShrikeCanvas::setFrameBudget(int ms)
+{
+  m_budget = std::max(ms, 0);
+}
+
+int ShrikeCanvas::getFrameBudget() const
+{
+  return m_budget;
+}
+
+unsigned long ShrikeCanvas::requestedFrames() const
+{
+  return m_requested;
+}
+
+unsigned long ShrikeCanvas::renderedFrames() const
+{
+  return m_rendered;
+}
+
+void ShrikeCanvas::setModel(MeshLod* lod, ObjMeshSource* model)
+{
+  setLevels(lod, model);
+  if (GetContext()) {
+    SetCurrent();
+    setupView(); // picks the level
+  }
+  invalidate();
+}
+
+const ShObjMesh* ShrikeCanvas::getModel()
+{
+  const ShObjMesh* mesh = m_model ? m_model->mesh() : 0;
+  reportModelError();
+  return mesh;
+}
+
+void ShrikeCanvas::reportModelError()
+{
+  std::string error;
+  if (m_model && m_model->takeError(error)) {
+    ShrikeFrame::instance()->output()->Insert(
+      wxT("Could not read the model's half-edge mesh: ") + wxString(error.c_str(), wxConvLibc),
+      ShrikeFrame::instance()->output()->GetCount());
+  }
+}
+
+void ShrikeCanvas::setLevels(MeshLod* lod, ObjMeshSource* model)
 {
-  if (m_model == model) return;
   delete m_model;
   m_model = model;
-  m_model_dirty = true;
-  SHRIKE_GL_CHECK_CURRENT_ERROR;
-  render();
+  for (std::size_t i = 0; i < m_levels.size(); ++i) delete m_levels[i];
+  m_levels.clear();
+  m_level_errors.clear();
+  m_center[0] = m_center[1] = m_center[2] = 0;
+  m_radius = 0;
+  m_level = 0;
+
+  if (lod && lod->levels()) {
+    for (std::size_t i = 0; i < lod->levels(); ++i) {
+      m_levels.push_back(new MeshView());
+      m_levels.back()->assign(lod->level(i));
+      m_levels.back()->objMeshSource(m_model);
+      m_level_errors.push_back(lod->error(i));
+    }
+    std::copy(lod->center(), lod->center() + 3, m_center);
+    m_radius = lod->radius();
+  }
+  delete lod;
 }
 
-const ShObjMesh* ShrikeCanvas::getModel() const {
-  return m_model;
+void ShrikeCanvas::setLevel(int level)
+{
+  m_pinned_level = level;
+  if (GetContext()) {
+    SetCurrent();
+    setupView();
+  }
+  invalidate();
+}
+
+int ShrikeCanvas::getLevel() const
+{
+  return m_pinned_level;
+}
+
+std::size_t ShrikeCanvas::levelCount() const
+{
+  return m_levels.size();
+}
+
+std::size_t ShrikeCanvas::levelTriangles(std::size_t level) const
+{
+  return m_levels[level]->triangleCount();
+}
+
+void ShrikeCanvas::selectLevel(const float mv[16], int height)
+{
+  if (m_levels.empty()) return;
+  std::size_t last = m_levels.size() - 1;
+  if (m_pinned_level >= 0) {
+    m_level = std::min((std::size_t)m_pinned_level, last);
+    return;
+  }
+
+  // The nearest the model gets to the eye, in front of the near plane
+  float z = mv[11];
+  for (int c = 0; c < 3; c++) z += mv[8 + c] * m_center[c];
+  float distance = std::max(-z - m_radius, 1.0f);
+  float tan_half_fov = std::tan(m_camera.fov() * (M_PI / 360));
+  float pixels = height / (2 * distance * tan_half_fov); // per model unit
+
+  m_level = 0;
+  while (m_level < last && m_level_errors[m_level + 1] * pixels < lod_pixels) {
+    ++m_level;
+  }
 }
 
 
@@ -153,10 +363,11 @@ void ShrikeCanvas::setShader(Shader* shader)
   if (shader) {
     shader->bind();
   } else {
-    shUnbind();
+    Shader::unbind();
   }
   SHRIKE_GL_CHECK_CURRENT_ERROR;
   m_shader = shader;
+  m_frame_timer.reset();
 }
 
 void ShrikeCanvas::motion(wxMouseEvent& event)
@@ -197,7 +408,7 @@ void ShrikeCanvas::motion(wxMouseEvent& event)
   }
   
   setupView();
-  render();
+  invalidate();
   m_last_x = event.GetX();
   m_last_y = event.GetY();
 }
@@ -205,27 +416,78 @@ void ShrikeCanvas::motion(wxMouseEvent& event)
 void ShrikeCanvas::render()
 {
   if (!GetContext()) return;
+  SHRIKE_TRACE_ZONE("ShrikeCanvas::render");
   
-  ShTimer start;
-  if(m_showFps) {
-    start = ShTimer::now();
-  }
-
   SetCurrent();
   SHRIKE_GL_CHECK_CURRENT_ERROR;
   init();
 
   SHRIKE_GL_CHECK_CURRENT_ERROR;
-  
+
+  m_dirty = false;
+  m_last_frame = ShTimer::now();
+  ++m_rendered;
+
+  // All animated uniforms move together, once per drawn frame.
+  Animator::instance()->write();
+
+  if (m_compare.active()) {
+    // Each viewport has its own timer, and timer queries don't nest,
+    // so there is no frame timing.
+    int w = GetClientSize().GetWidth();
+    int h = GetClientSize().GetHeight();
+    m_compare.render(*this, w, h);
+    UniformBatch::instance().end_frame();
+
+    GetGlobals().width = 1.0f*w;
+    GetGlobals().height = 1.0f*h;
+    SHRIKE_GL_CHECK_ERROR(glViewport(0, 0, w, h));
+    setupView();
+    renderCompareStats();
+    SHRIKE_GL_CHECK_ERROR(glFinish());
+    SwapBuffers();
+    SHRIKE_GL_CHECK_CURRENT_ERROR;
+    return;
+  }
+
+  // Timing replaces the glFinish below, so that CPU and GPU can
+  // overlap as they would without the overlay.
+  bool timed = m_showFps && m_shader;
+  if (timed) {
+    m_frame_timer.begin();
+  }
+
+  renderScene(m_shader);
+  UniformBatch::instance().end_frame();
+
+  if (timed) {
+    m_frame_timer.end();
+    renderStats();
+  } else if (m_shader) {
+    SHRIKE_GL_CHECK_ERROR(glFinish());
+  }
+  SHRIKE_GL_CHECK_CURRENT_ERROR;
+  SwapBuffers();
+  SHRIKE_GL_CHECK_CURRENT_ERROR;
+
+  if (m_shader && m_shader->animating()) invalidate();
+}
+
+/// Everything but the overlays, into the current framebuffer.
+void ShrikeCanvas::renderScene(Shader* shader)
+{
+  UniformBatch::instance().flush();
+
   SHRIKE_GL_CHECK_ERROR(glClear(GL_COLOR_BUFFER_BIT + GL_DEPTH_BUFFER_BIT));
 
-  if (m_shader) {
-    m_shader->bind();
-    if (!m_shader->render(*m_model))
+  if (shader && !m_levels.empty()) {
+    shader->bind();
+    if (!shader->render(*m_levels[m_level]))
       renderObject();
+    reportModelError();
   }
 
-  shUnbind();
+  Shader::unbind();
 
   ShPoint3f lp = GetGlobals().lightDirW * GetGlobals().lightLenW;
   float pos[3];
@@ -237,105 +499,140 @@ void ShrikeCanvas::render()
     glColor3f(1.0, 0.0, 1.0);
     glVertex3fv(pos);
   } SHRIKE_GL_IGNORE_ERROR(glEnd()); // On ATI we get spurious errors here
+}
 
-  if (m_shader) {
-    SHRIKE_GL_CHECK_ERROR(glFinish());
+void ShrikeCanvas::renderStats()
+{
+  const TimingStats& cpu = m_frame_timer.cpu();
+  const TimingStats& gpu = m_frame_timer.gpu();
+
+  // The slower of the two sides bounds the frame rate
+  float frame_ms = std::max(cpu.mean, gpu.mean);
+  float fps = (frame_ms > 0.0f ? 1000.0f / frame_ms : 0.0f);
+  m_fps = fps;
+
+  SHRIKE_GL_CHECK_ERROR(glDisable(GL_DEPTH_TEST));
+  shBind(*m_fps_shaders);
+  renderOverlayQuad(0, 0, 80, 40);
+
+  // One row per timer above the fps: mean, min, max and p99
+  shBind(*m_stat_shaders);
+  const TimingStats* rows[] = { &cpu, &gpu };
+  for (int r = 0; r < 2; ++r) {
+    if (!rows[r]->count) continue;
+    float values[] = { rows[r]->mean, rows[r]->min, rows[r]->max, rows[r]->p99 };
+    for (int c = 0; c < 4; ++c) {
+      m_stat = values[c];
+      renderOverlayQuad(c * 60, 40 + r * 20, 60, 20);
+    }
   }
-  
-  if (m_showFps && m_shader) {
-    ShTimer end = ShTimer::now();
-    double elapsed = (end - start).value() / 1000.0; 
-
-    m_fps = 1.0 / elapsed;
-    SHRIKE_GL_CHECK_ERROR(glDisable(GL_DEPTH_TEST));
-    shBind(*m_fps_shaders);
-    double width = 160.0/GetClientSize().GetWidth();
-    double height = 80.0/GetClientSize().GetHeight(); 
-    glBegin(GL_QUADS); {
-      glTexCoord2f(0.0, 0.0);
-      glVertex2f(-1.0, -1.0);
-      glTexCoord2f(0.0, 1.0);
-      glVertex2f(-1.0, -1.0 + height);
-      glTexCoord2f(1.0, 1.0);
-      glVertex2f(-1.0 + width, -1.0 + height);
-      glTexCoord2f(1.0, 0.0);
-      glVertex2f(-1.0 + width, -1.0);
-    } SHRIKE_GL_IGNORE_ERROR(glEnd());
-    SHRIKE_GL_CHECK_ERROR(glEnable(GL_DEPTH_TEST));
+  shUnbind();
+  SHRIKE_GL_CHECK_ERROR(glEnable(GL_DEPTH_TEST));
+
+  wxString text = wxString::Format(wxT("%.0f fps  cpu %.2f/%.2f/%.2f/%.2f ms"),
+                                   fps, cpu.mean, cpu.min, cpu.max, cpu.p99);
+  if (m_frame_timer.gpuTimed()) {
+    text += wxString::Format(wxT("  gpu %.2f/%.2f/%.2f/%.2f ms"),
+                             gpu.mean, gpu.min, gpu.max, gpu.p99);
   }
-  SHRIKE_GL_CHECK_CURRENT_ERROR;
-  SwapBuffers();
-  SHRIKE_GL_CHECK_CURRENT_ERROR;
+  text += wxT(" (mean/min/max/p99)");
+  text += wxString::Format(wxT("  %lu of %lu frames drawn"), m_rendered, m_requested);
+  if (m_levels.size() > 1) {
+    text += wxString::Format(wxT("  level %lu of %lu (%lu triangles)"),
+                             (unsigned long)m_level, (unsigned long)m_levels.size(),
+                             (unsigned long)m_levels[m_level]->triangleCount());
+  }
+  const UniformBatch::Counters& uniforms = UniformBatch::instance().frame();
+  text += wxString::Format(wxT("  uniforms %lu set, %lu unchanged, %lu uploaded"),
+                           uniforms.assigned, uniforms.skipped, uniforms.uploads);
+  ShrikeFrame::instance()->SetStatusText(text, 1);
 }
 
-void ShrikeCanvas::renderObject()
+/// The GPU time of each viewport (CPU time if there are no timer
+/// queries) in its bottom left corner, and all of them in the status
+/// bar.
+void ShrikeCanvas::renderCompareStats()
 {
-  SHRIKE_GL_CHECK_CURRENT_ERROR;
-  if (m_model_list == 0) {
-    m_model_list = SHRIKE_GL_CHECK_ERROR(glGenLists(1));
+  const std::vector<Shader*>& shaders = m_compare.shaders();
+
+  SHRIKE_GL_CHECK_ERROR(glDisable(GL_DEPTH_TEST));
+  shBind(*m_stat_shaders);
+  wxString text;
+  for (std::size_t i = 0; i < shaders.size(); ++i) {
+    const FrameTimer& timer = m_compare.timer(i);
+    float ms = timer.gpuTimed() ? timer.gpu().mean : timer.cpu().mean;
+    int x, y, w, h;
+    m_compare.viewport(i, x, y, w, h);
+    m_stat = ms;
+    renderOverlayQuad(x, y, 60, 20);
+
+    if (i) text += wxT("  ");
+    text += wxString::Format(wxT("%s %.2f ms"),
+                             wxString(shaders[i]->name().c_str(), wxConvLibc).c_str(), ms);
   }
+  shUnbind();
+  SHRIKE_GL_CHECK_ERROR(glEnable(GL_DEPTH_TEST));
 
-  if (m_model_dirty) {
-    SHRIKE_GL_CHECK_ERROR(glNewList(m_model_list, GL_COMPILE_AND_EXECUTE));
-    float values[4];
-    glBegin(GL_TRIANGLES);
-    for(ShObjMesh::FaceSet::iterator I = m_model->faces.begin();
-        I != m_model->faces.end(); ++I) {
-      ShObjEdge *e = (*I)->edge;
-      do {
-        e->normal.getValues(values); 
-        glNormal3fv(values);
-
-        e->texcoord.getValues(values);
-#ifdef GL_ARB_multitexture
-        glMultiTexCoord2fvARB(GL_TEXTURE0, values);
-#else
-        glMultiTexCoord2fv(GL_TEXTURE0, values);
-#endif
-
-        e->tangent.getValues(values);
-#ifdef GL_ARB_multitexture
-        glMultiTexCoord3fvARB(GL_TEXTURE0 + 1, values);
-#else
-        glMultiTexCoord3fv(GL_TEXTURE0 + 1, values);
-#endif
-
-        e->start->pos.getValues(values);
-        glVertex3fv(values);
-        e = e->next;
-      } while(e != (*I)->edge);
-    }
-    SHRIKE_GL_IGNORE_ERROR(glEnd()); // Ignore spurious ATI errors
-    SHRIKE_GL_CHECK_ERROR(glEndList());
-    m_model_dirty = false;
-  } else {
-    SHRIKE_GL_CHECK_CURRENT_ERROR;
-    SHRIKE_GL_IGNORE_ERROR(glCallList(m_model_list)); // On ATI...
+  text += m_compare.timer(0).gpuTimed() ? wxT(" (gpu)") : wxT(" (cpu)");
+  ShrikeFrame::instance()->SetStatusText(text, 1);
+}
 
-  }
+/// Draws a quad over the given pixel rectangle, measured from the
+/// bottom left corner of the canvas.
+void ShrikeCanvas::renderOverlayQuad(int x, int y, int w, int h)
+{
+  double sx = 2.0/GetClientSize().GetWidth();
+  double sy = 2.0/GetClientSize().GetHeight();
+  double left = -1.0 + x*sx, right = left + w*sx;
+  double bottom = -1.0 + y*sy, top = bottom + h*sy;
+  glBegin(GL_QUADS); {
+    glTexCoord2f(0.0, 0.0);
+    glVertex2f(left, bottom);
+    glTexCoord2f(0.0, 1.0);
+    glVertex2f(left, top);
+    glTexCoord2f(1.0, 1.0);
+    glVertex2f(right, top);
+    glTexCoord2f(1.0, 0.0);
+    glVertex2f(right, bottom);
+  } SHRIKE_GL_IGNORE_ERROR(glEnd());
+}
+
+void ShrikeCanvas::renderObject()
+{
+  SHRIKE_GL_CHECK_CURRENT_ERROR;
+  if (m_levels.empty()) return;
+  SHRIKE_GL_IGNORE_ERROR(m_levels[m_level]->drawTriangles()); // On ATI...
   SHRIKE_GL_CHECK_CURRENT_ERROR;
 }
 
-void ShrikeCanvas::setupView(int nsplit, int x, int y)
+void ShrikeCanvas::setupView()
+{
+  int w = GetClientSize().GetWidth();
+  int h = GetClientSize().GetHeight();
+  setupView(0, 0, w, h, w, h);
+}
+
+void ShrikeCanvas::setupView(int x, int y, int w, int h, int width, int height)
 {
   SHRIKE_GL_CHECK_ERROR(glMatrixMode(GL_PROJECTION));
   SHRIKE_GL_CHECK_ERROR(glLoadIdentity());
 
   ShMatrix4x4f split;
   
-  if (nsplit > 1) {
-    split[0][0] = nsplit;
-    split[1][1] = nsplit;
+  if (w != width || h != height) {
+    // Scale the tile up to fill the viewport
+    split[0][0] = (float)width/w;
+    split[1][1] = (float)height/h;
     split[2][2] = 1.0;
     split[3][3] = 1.0;
-    split[0][3] = (float)(nsplit - 1 - x*2);
-    split[1][3] = (float)(nsplit - 1 - y*2);
+    split[0][3] = (float)(width - 2*x - w)/w;
+    split[1][3] = (float)(height - 2*y - h)/h;
     float values[16];
     for (int i = 0; i < 16; i++) split[i%4](i/4).getValues(&values[i]);
     SHRIKE_GL_CHECK_ERROR(glMultMatrixf(values));
   }
   
-  m_camera.glProjection((float)GetClientSize().GetWidth()/GetClientSize().GetHeight());
+  m_camera.glProjection((float)width/height);
   SHRIKE_GL_CHECK_CURRENT_ERROR;
 
   SHRIKE_GL_CHECK_ERROR(glMatrixMode(GL_MODELVIEW));
@@ -343,47 +640,92 @@ void ShrikeCanvas::setupView(int nsplit, int x, int y)
   m_camera.glModelView();
   SHRIKE_GL_CHECK_CURRENT_ERROR;
   
-  GetGlobals().mv = m_camera.shModelView();
-  GetGlobals().mv_inverse = inverse(GetGlobals().mv);
-  GetGlobals().mvp = m_camera.shModelViewProjection(split);
-  GetGlobals().lightPos = GetGlobals().mv | ShPoint3f(GetGlobals().lightDirW * GetGlobals().lightLenW);
+  // The uniforms are worked out on floats and go to Sh with the next
+  // frame, see UniformBatch.
+  ShMatrix4x4f mv_matrix = m_camera.shModelView();
+  ShMatrix4x4f mvp_matrix = m_camera.shModelViewProjection(split);
+  float mv[16], mv_inverse[16], mvp[16];
+  get_matrix(mv_matrix, mv);
+  get_matrix(mvp_matrix, mvp);
+  selectLevel(mv, height);
+
+  float dir[3], len;
+  GetGlobals().lightDirW.getValues(dir);
+  GetGlobals().lightLenW.getValues(&len);
+  float light[3];
+  for (int r = 0; r < 3; r++) {
+    light[r] = mv[r*4 + 3];
+    for (int c = 0; c < 3; c++) light[r] += mv[r*4 + c] * dir[c] * len;
+  }
+
+  UniformBatch& uniforms = UniformBatch::instance();
+  uniforms.set(GetGlobals().mv, mv);
+  if (invert_matrix(mv, mv_inverse)) uniforms.set(GetGlobals().mv_inverse, mv_inverse);
+  uniforms.set(GetGlobals().mvp, mvp);
+  uniforms.set(GetGlobals().lightPos, light);
 }
 
-void ShrikeCanvas::screenshot(const wxString& filename)
+bool ShrikeCanvas::screenshot(const wxString& filename, int width, int height, int bits)
 {
-  int mult = 4;
-  ShImage final(GetClientSize().GetWidth()*mult, GetClientSize().GetHeight()*mult, 3);
-  float* fd = final.data();
-  std::string stdfilename;
-    
-  for (int y = 0; y < mult; y++) for (int x = 0; x < mult; x++) {
-    ShImage img(GetClientSize().GetWidth(), GetClientSize().GetHeight(), 3);
-  
-    setupView(mult, x, y);
-    render();
-    
-    glReadPixels(0, 0, GetClientSize().GetWidth(), GetClientSize().GetHeight(), GL_RGB, GL_FLOAT, img.data());
-
-    const float* id = img.data();
-    for (int b = 0; b < GetClientSize().GetHeight(); b++) for (int a = 0; a < GetClientSize().GetWidth(); a++) {
-      int row = GetClientSize().GetHeight()*(mult - y) - b - 1;
-      int col = GetClientSize().GetWidth() * x + a;
-      for (int i = 0; i < 3; i++) {
-        fd[(row * GetClientSize().GetWidth() * mult + col)*3 + i ] = id[(b * GetClientSize().GetWidth() + a)*3 + i];
-      }
-    }
-#if 0
-     std::ostringstream s;
-     s << "_" << x << "_" << y;
-     img.save_PNG(filename + s.str());
-#endif
+  int window_w = GetClientSize().GetWidth();
+  int window_h = GetClientSize().GetHeight();
+  if (width <= 0 || height <= 0) {
+    width = window_w * 4;
+    height = window_h * 4;
   }
+
+  SetCurrent();
+  init();
+
+  Screenshot shot(width, height, bits);
   // Lame convertion from wxString to std::string:
+  std::string stdfilename;
   stdfilename = wxConvLibc.cWX2MB(filename);
-  ShUtil::save_PNG(final, stdfilename, 0);
+  bool saved = shot.save(stdfilename, *this, window_w, window_h);
 
+  GetGlobals().width = 1.0f*window_w;
+  GetGlobals().height = 1.0f*window_h;
+  SHRIKE_GL_CHECK_ERROR(glViewport(0, 0, window_w, window_h));
   setupView();
-  render();
+  invalidate();
+
+  if (!saved) {
+    ShrikeFrame::instance()->show_error(wxT("The screenshot could not be saved"), shot.error());
+  }
+  return saved;
+}
+
+void ShrikeCanvas::renderTile(int x, int y, int w, int h, int width, int height)
+{
+  GetGlobals().width = 1.0f*w;
+  GetGlobals().height = 1.0f*h;
+  setupView(x, y, w, h, width, height);
+  renderScene(m_shader);
+}
+
+void ShrikeCanvas::setCompare(const std::vector<Shader*>& shaders)
+{
+  m_compare.set_shaders(shaders);
+  invalidate();
+}
+
+bool ShrikeCanvas::comparing() const
+{
+  return m_compare.active();
+}
+
+void ShrikeCanvas::setShowDifference(bool show)
+{
+  m_compare.show_difference(show);
+  invalidate();
+}
+
+void ShrikeCanvas::renderViewport(Shader* shader, int w, int h)
+{
+  GetGlobals().width = 1.0f*w;
+  GetGlobals().height = 1.0f*h;
+  setupView(0, 0, w, h, w, h);
+  renderScene(shader);
 }
 
 void ShrikeCanvas::init()
@@ -413,6 +755,18 @@ void ShrikeCanvas::init()
   } SH_END;
 
   m_fps_shaders = new ShProgramSet(m_fpsVsh, m_fpsFsh);
+
+  ShConstColor3f white(1, 1, 1);
+  m_statFsh = SH_BEGIN_PROGRAM("gpu:fragment"); {
+    ShInputPosition4f SH_DECL(pos);
+    ShInputTexCoord2f SH_DECL(u);
+    ShOutputColor3f SH_DECL(result);
+    // 3 integer and 2 fractional digits of milliseconds
+    ShAttrib1f indigit = lcdSmall(u, m_stat, 3, 2, false, false, 0.17, 1.0, 0.026);
+    result = lerp(indigit, white, m_bg); 
+  } SH_END;
+
+  m_stat_shaders = new ShProgramSet(m_fpsVsh, m_statFsh);
   
   m_init = true;
   SHRIKE_GL_CHECK_CURRENT_ERROR;
@@ -444,7 +798,7 @@ void ShrikeCanvas::resetView()
     SetCurrent();
     SHRIKE_GL_CHECK_CURRENT_ERROR;
     setupView();
-    render();
+    invalidate();
   }
 }
 
@@ -459,13 +813,14 @@ void ShrikeCanvas::setBackground(unsigned char r, unsigned char g, unsigned char
 
   SHRIKE_GL_CHECK_ERROR(glClearColor(m_bg_r, m_bg_g, m_bg_b, 1.0));
   
-  SetCurrent();
-  render();
+  invalidate();
 }
 
 void ShrikeCanvas::setShowFps(bool fps) {
   m_showFps = fps;
-
-  SetCurrent();
-  render();
+  m_frame_timer.reset();
+  if (!m_showFps) {
+    ShrikeFrame::instance()->SetStatusText(wxT(""), 1);
+  }
+  invalidate();
 }
@@ -22,26 +22,79 @@
 
 #include <wx/wx.h>
 #include <wx/glcanvas.h>
-#include <shutil/ShObjMesh.hpp>
 #include "Camera.hpp"
+#include "CompareView.hpp"
+#include "FrameTimer.hpp"
+#include "MeshLod.hpp"
+#include "MeshView.hpp"
+#include "Screenshot.hpp"
 #include "Shader.hpp"
+#include "Timer.hpp"
 
-class ShrikeCanvas : public wxGLCanvas {
+class ShrikeCanvas : public wxGLCanvas, public TileRenderer,
+                     public ViewportRenderer {
 public:
-  ShrikeCanvas(wxWindow* parent,
-               ShUtil::ShObjMesh* model);
+  ShrikeCanvas(wxWindow* parent, MeshLod* lod, ObjMeshSource* model);
+  ~ShrikeCanvas();
   
+  /// Draw a frame right away.  Anything that just wants the canvas
+  /// redrawn should call invalidate() instead.
   void render();
   void renderObject();
+
+  /// Ask for a frame.  Requests are coalesced and drawn at most once
+  /// per idle tick, and no sooner than the frame budget after the
+  /// previous frame.
+  void invalidate();
+
+  /// Set the minimum time between frames, in milliseconds.  With 0
+  /// (the default) the rate is only limited by idle ticks and vsync.
+  void setFrameBudget(int ms);
+  int getFrameBudget() const;
+
+  /// Number of frames asked for (including paint events) and drawn.
+  unsigned long requestedFrames() const;
+  unsigned long renderedFrames() const;
   
-  void setModel(ShUtil::ShObjMesh* model);
-  const ShUtil::ShObjMesh* getModel() const;
+  /// Takes ownership of lod, the model's levels of detail, and model,
+  /// where its half-edge mesh is read from if a shader asks for one.
+  void setModel(MeshLod* lod, ObjMeshSource* model);
+  /// The model as a half-edge mesh, read the first time it is asked
+  /// for; shaders get the same from MeshView::objMesh().  Null, with
+  /// the reason in the output list, if it can't be read.
+  const ShUtil::ShObjMesh* getModel();
+
+  /// Draw level of detail level (0 is the full model) from now on, or
+  /// with -1 the coarsest one that is off by less than a pixel at the
+  /// model's size on screen.
+  void setLevel(int level);
+  int getLevel() const;
+  std::size_t levelCount() const;
+  std::size_t levelTriangles(std::size_t level) const;
   
   void paint(wxPaintEvent& event);
   void reshape(wxSizeEvent& event);
   void motion(wxMouseEvent& event);
+  void idle(wxIdleEvent& event);
+  void budgetExpired(wxTimerEvent& event);
+
+  /// Save a width by height picture of the view, four times the
+  /// canvas size if they're 0, with 8 or 16 bits per channel.  Shows
+  /// an error and returns false if it fails.
+  bool screenshot(const wxString& filename, int width = 0, int height = 0,
+                  int bits = 8);
+
+  void renderTile(int x, int y, int w, int h, int width, int height);
 
-  void screenshot(const wxString& filename);  
+  /// Draw the scene under each of shaders side by side instead of
+  /// under the current shader, with their timings on top.  Fewer than
+  /// two shaders goes back to normal.  They must be compiled already.
+  void setCompare(const std::vector<Shader*>& shaders);
+  bool comparing() const;
+  /// Also show the difference between the first two compared shaders.
+  void setShowDifference(bool show);
+
+  void renderViewport(Shader* shader, int w, int h);
 
   void resetView();
 
@@ -55,13 +108,28 @@ public:
   
 private:
   void init();
-  void setupView(int split = 1, int x = 0, int y = 0);
+  void setupView();
+  /// Set up the view for the w by h tile at x, y of a width by height
+  /// picture of what the canvas shows.
+  void setupView(int x, int y, int w, int h, int width, int height);
+  void renderScene(Shader* shader);
+  void renderStats();
+  void renderCompareStats();
+  void renderOverlayQuad(int x, int y, int w, int h);
+  void setLevels(MeshLod* lod, ObjMeshSource* model);
+  /// Put any error reading the half-edge mesh in the output list.
+  void reportModelError();
+  /// Pick the level to draw for the modelview matrix mv (row by row)
+  /// in a picture height pixels high.
+  void selectLevel(const float mv[16], int height);
   
   bool m_init;
-  ShUtil::ShObjMesh* m_model;
-  bool m_model_dirty; // whether to regenerate display list on next render
-  unsigned int m_model_list; // OpenGl display list
-
+  ObjMeshSource* m_model;
+  std::vector<MeshView*> m_levels; // the model as shaders see it, finest first
+  std::vector<float> m_level_errors; // see MeshLod::error
+  float m_center[3], m_radius; // bounding sphere
+  int m_pinned_level; // -1 if they're picked by size
+  std::size_t m_level; // the one being drawn
 
   Camera m_camera;
 
@@ -77,6 +145,20 @@ private:
   bool m_showFps;
   SH::ShProgramSet* m_fps_shaders;
 
+  FrameTimer m_frame_timer;
+  SH::ShAttrib1f m_stat; // one timing, in ms
+  SH::ShProgram m_statFsh;
+  SH::ShProgramSet* m_stat_shaders;
+
+  CompareView m_compare;
+
+  bool m_dirty; // whether a frame has been asked for
+  int m_budget; // in ms
+  ShTimer m_last_frame; // when the last frame was started
+  wxTimer m_budget_timer;
+  unsigned long m_requested;
+  unsigned long m_rendered;
+
   float m_bg_r;
   float m_bg_g;
   float m_bg_b;
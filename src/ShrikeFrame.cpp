@@ -17,23 +17,32 @@
 // Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, 
 // MA  02110-1301, USA
 //////////////////////////////////////////////////////////////////////////////
+#include <cstdio>
 #include <iostream>
-#include <fstream>
-#include <shutil/ShObjMesh.hpp>
+#include <sstream>
+#include <wx/choicdlg.h>
 #include <wx/colordlg.h>
 #include <wx/config.h>
 #include <wx/propdlg.h>
 #include <wx/splitter.h>
 #include <wx/treectrl.h>
-#include <wx/txtstrm.h>
 #include <wx/wfstream.h>
 #include "AboutDialog.hpp"
 #include "Build.hpp"
+#include "CostPanel.hpp"
 #include "Globals.hpp"
+#include "MeshLod.hpp"
+#include "MeshOptimize.hpp"
+#include "ObjReader.hpp"
+#include "OptimizationSweep.hpp"
+#include "Precompile.hpp"
+#include "ShaderSwitcher.hpp"
+#include "ProgramCache.hpp"
 #include "Project.hpp"
 #include "Shader.hpp"
 #include "ShrikeCanvas.hpp"
 #include "ShrikeFrame.hpp"
+#include "Timer.hpp"
 #ifdef HAVE_CONFIG_H
 #include "config.h"
 #endif
@@ -63,6 +72,9 @@ BEGIN_EVENT_TABLE(ShrikeFrame, wxFrame)
   EVT_MENU(SHRIKE_MENU_VIEW_FULLSCREEN, ShrikeFrame::on_fullscreen)
   EVT_MENU(SHRIKE_MENU_VIEW_WIREFRAME, ShrikeFrame::on_wireframe)
   EVT_MENU(SHRIKE_MENU_VIEW_FPS, ShrikeFrame::on_fps)
+  EVT_MENU_RANGE(SHRIKE_MENU_VIEW_LOD_AUTO, SHRIKE_MENU_VIEW_LOD_LAST, ShrikeFrame::on_lod)
+  EVT_MENU(SHRIKE_MENU_VIEW_COMPARE, ShrikeFrame::on_compare)
+  EVT_MENU(SHRIKE_MENU_VIEW_DIFFERENCE, ShrikeFrame::on_difference)
 
   EVT_MENU(SHRIKE_MENU_HELP_ABOUT, ShrikeFrame::on_about)
 
@@ -73,15 +85,6 @@ BEGIN_EVENT_TABLE(ShrikeFrame, wxFrame)
   EVT_TREE_ITEM_RIGHT_CLICK(SHRIKE_TREECTRL_SHADERS, ShrikeFrame::on_shader_item_right_click)
 END_EVENT_TABLE()
 
-struct ShaderTreeData : public wxTreeItemData {
-  ShaderTreeData(Shader* shader)
-    : shader(shader)
-  {
-  }
-  
-  Shader* shader;
-};
-
 class ProjectMenu : public wxMenu
 {
 public:
@@ -133,6 +136,9 @@ public:
     AppendSeparator();
     AppendCheckItem(SHRIKE_MENU_SHADER_OPTIMIZE, wxT("Turn on &optimizations"));
     Check(SHRIKE_MENU_SHADER_OPTIMIZE, true);
+    Append(SHRIKE_MENU_SHADER_PRECOMPILE, wxT("Pre&compile all shaders"));
+    Append(SHRIKE_MENU_SHADER_SWEEP, wxT("S&weep optimization levels"));
+    Append(SHRIKE_MENU_SHADER_SWEEP_ALL, wxT("Sweep optimization levels for a&ll shaders"));
 
     m_opts = new wxMenu();
     Append(SHRIKE_MENU_SHADER_OPTS, wxT("Optimizations"), m_opts);
@@ -160,6 +166,7 @@ private:
 
     try {
       shader->init();
+      shader->release();
     } catch (const ShException& e) {
       std::cerr << e.message() << std::endl;
       return;
@@ -200,11 +207,28 @@ private:
     }
   }
   
+  void on_precompile(wxCommandEvent& event)
+  {
+    m_frame->precompile();
+  }
+
+  void on_sweep(wxCommandEvent& event)
+  {
+    std::vector<Shader*> shaders;
+    if (event.GetId() == SHRIKE_MENU_SHADER_SWEEP_ALL) {
+      shaders.assign(GetShaders().begin(), GetShaders().end());
+    } else if (m_frame->get_shader()) {
+      shaders.push_back(m_frame->get_shader());
+    }
+    m_frame->sweep_optimizations(shaders);
+  }
+
   void on_reinit(wxCommandEvent& event)
   {
     if (!m_frame->get_shader()) return;
     try {
       m_frame->get_shader()->init();
+      m_frame->get_shader()->release();
     } catch (const ShException& e) {
       std::cerr << e.message() << std::endl;
       return;
@@ -264,6 +288,9 @@ BEGIN_EVENT_TABLE(ShaderMenu, wxMenu)
   EVT_MENU(SHRIKE_MENU_SHADER_SHOW_FSHIF, ShaderMenu::on_show_fsh_interface)
   EVT_MENU(SHRIKE_MENU_SHADER_REINIT, ShaderMenu::on_reinit)
   EVT_MENU(SHRIKE_MENU_SHADER_OPTIMIZE, ShaderMenu::on_optimize)
+  EVT_MENU(SHRIKE_MENU_SHADER_PRECOMPILE, ShaderMenu::on_precompile)
+  EVT_MENU(SHRIKE_MENU_SHADER_SWEEP, ShaderMenu::on_sweep)
+  EVT_MENU(SHRIKE_MENU_SHADER_SWEEP_ALL, ShaderMenu::on_sweep)
 
   EVT_MENU(SHRIKE_MENU_SHADER_OPTS_LIFTING, ShaderMenu::on_optimize_item)
   EVT_MENU(SHRIKE_MENU_SHADER_OPTS_PROPAGATION, ShaderMenu::on_optimize_item)
@@ -275,10 +302,11 @@ END_EVENT_TABLE()
 
 ShrikeFrame::ShrikeFrame()
   : wxFrame(0, -1, wxT("Shrike"), wxDefaultPosition, wxSize(600, 400)),
-    m_shader(0), m_project(0), m_fullscreen(false), m_fps(false)
+    m_cost(0), m_shader(0), m_project(0), m_fullscreen(false), m_fps(false),
+    m_precompile(0), m_build(0), m_switcher(0)
 {
   m_instance = this;
-  CreateStatusBar();
+  CreateStatusBar(2); // the second field shows frame timings
 
   GetStatusBar()->SetStatusText(wxT("Hold down shift to rotate the light instead of the camera."));
   
@@ -298,7 +326,16 @@ ShrikeFrame::ShrikeFrame()
   m_viewMenu->AppendCheckItem(SHRIKE_MENU_VIEW_FULLSCREEN,_( "&Fullscreen") );
   m_viewMenu->AppendCheckItem(SHRIKE_MENU_VIEW_WIREFRAME, wxT("&Wireframe") );
   m_viewMenu->AppendCheckItem(SHRIKE_MENU_VIEW_FPS, wxT("Show framera&te") );
+  m_lodMenu = new wxMenu();
+  m_lodMenu->AppendRadioItem(SHRIKE_MENU_VIEW_LOD_AUTO, wxT("&Automatic") );
+  for (int i = SHRIKE_MENU_VIEW_LOD_0; i <= SHRIKE_MENU_VIEW_LOD_LAST; ++i) {
+    m_lodMenu->AppendRadioItem(i, wxString::Format(wxT("Level %d"), i - SHRIKE_MENU_VIEW_LOD_0));
+  }
+  m_viewMenu->Append(-1, wxT("&Level of detail"), m_lodMenu);
   m_viewMenu->Append(SHRIKE_MENU_VIEW_SCREENSHOT, wxT("&Screenshot...") );
+  m_viewMenu->AppendSeparator();
+  m_viewMenu->Append(SHRIKE_MENU_VIEW_COMPARE, wxT("&Compare shaders...") );
+  m_viewMenu->AppendCheckItem(SHRIKE_MENU_VIEW_DIFFERENCE, wxT("Show &difference") );
 
   wxMenu* help = new wxMenu();
   help->Append(SHRIKE_MENU_HELP_ABOUT, wxT("&About") );
@@ -317,7 +354,9 @@ ShrikeFrame::ShrikeFrame()
   int width = 512 + 2; 
   int height = 512 + 2; 
   m_preview = new wxFrame(0, -1, "Shrike Preview", wxDefaultPosition, wxSize(width, height));
-  m_canvas = new ShrikeCanvas(m_preview, model);
+  ObjMeshSource* model;
+  MeshLod* lod = init_model(model);
+  m_canvas = new ShrikeCanvas(m_preview, lod, model);
   m_panel = new UniformPanel(m_hsplitter);
   m_hsplitter->SplitVertically(m_shaderList, m_panel, 150);
   m_preview->Show();
@@ -329,35 +368,43 @@ ShrikeFrame::ShrikeFrame()
   // | shaders | canvas  | props  |
   // |         |         |        |
   // |---------|         |        |
-  // |         |---------|        |
-  // | project |         |        |
-  // |         | output  |        |
+  // |         |---------|--------|
+  // | project |         | shader |
+  // |         | output  | cost   |
   // +---------+---------+--------+
   wxSplitterWindow* col1_col23 = new wxSplitterWindow(this, -1);
   wxSplitterWindow* shaders_projects = new wxSplitterWindow(col1_col23, -1);
   wxSplitterWindow* col2_col3 = new wxSplitterWindow(col1_col23, -1);
   wxSplitterWindow* canvas_output = new wxSplitterWindow(col2_col3, -1);
+  wxSplitterWindow* props_cost = new wxSplitterWindow(col2_col3, -1);
 
   m_shaderList = init_shader_list(shaders_projects);
   m_project_tree = init_project_tree(shaders_projects); 
-  m_panel = new UniformPanel(col2_col3);
+  m_panel = new UniformPanel(props_cost);
+  m_cost = new CostPanel(props_cost);
 
-  ShObjMesh* model = init_model();
-  m_canvas = new ShrikeCanvas(canvas_output, model);
   m_output = new wxListBox(canvas_output,-1);
+  ObjMeshSource* model;
+  MeshLod* lod = init_model(model);
+  m_canvas = new ShrikeCanvas(canvas_output, lod, model);
+  update_lod_menu();
   
   col1_col23->SplitVertically(shaders_projects, col2_col3);
-  col2_col3->SplitVertically(canvas_output, m_panel);
+  col2_col3->SplitVertically(canvas_output, props_cost);
   canvas_output->SplitHorizontally(m_canvas, m_output);
+  props_cost->SplitHorizontally(m_panel, m_cost);
   shaders_projects->SplitHorizontally(m_shaderList, m_project_tree);
+  m_switcher = new ShaderSwitcher(this, m_shaderList, m_canvas);
 
 #if wxMAJOR_VERSION==2 && wxMINOR_VERSION==6
     /*empty*/
 #else
   col2_col3->SetSashGravity(1.0);
   canvas_output->SetSashGravity(1.0);
+  props_cost->SetSashGravity(1.0);
 #endif
   canvas_output->SetMinimumPaneSize(40);
+  props_cost->SetMinimumPaneSize(40);
 //  m_right_window->SetMinimumPaneSize(40);
 
   col1_col23->SetSashPosition(200);
@@ -368,6 +415,20 @@ ShrikeFrame::ShrikeFrame()
 ShrikeFrame::~ShrikeFrame()
 {
   PopEventHandler();
+  delete m_precompile;
+  delete m_build;
+  delete m_switcher;
+}
+
+void ShrikeFrame::precompile()
+{
+  if (!ProgramCache::instance().enabled() || ProgramCache::instance().backend() != "arb") {
+    output()->Insert(wxT("Precompiling needs the program cache, which only works ")
+                     wxT("with the arb backend"), output()->GetCount());
+    return;
+  }
+  if (!m_precompile) m_precompile = new PrecompilePool(output());
+  m_precompile->start();
 }
 
 void ShrikeFrame::set_project(Project* project)
@@ -382,42 +443,128 @@ void ShrikeFrame::set_project(Project* project)
   }
 }
 
-ShObjMesh* ShrikeFrame::init_model()
+MeshLod* ShrikeFrame::init_model(ObjMeshSource*& model)
 {
-  ShObjMesh* model=0;
-  std::ifstream infile(SHMEDIA_DIR "/objs/plane1.obj");
-  if (infile) {
-    model = new ShObjMesh(infile);
+  std::string path = SHMEDIA_DIR "/objs/plane1.obj";
+  std::string error;
+  MeshLod* lod = load_model(path, wxT("Default model"), error);
+  if (lod) {
+    model = new ObjMeshSource(path);
+    return lod;
   }
-  else {
-    show_error(
-      wxT("The shmedia package was not found. This package contains models and textures \n"
-          "required by many shaders. You may still run Shrike but it is recommended \n"
-          "you install the shmedia package first.\n"
-          "\n"
-	        "The package can be found at http://libsh.org/ in the downloads section.\n"
-          "\n"
-	        "Shrike expected the package in "SHMEDIA_DIR),
-      "failed to open " SHMEDIA_DIR "/objs/plane1.obj"
-      );
-    model = new ShObjMesh();
-    model->clear();
-    std::ostringstream oss;
-    oss << "v 1.0 1.0 0.0" << std::endl;
-    oss << "v 1.0 -1.0 0.0" << std::endl;
-    oss << "v -1.0 -1.0 0.0" << std::endl;
-    oss << "v -1.0 1.0 0.0" << std::endl;
-    oss << "vt 1.0 0.0" << std::endl;
-    oss << "vt 1.0 1.0" << std::endl;
-    oss << "vt 0.0 1.0" << std::endl;
-    oss << "vt 0.0 0.0" << std::endl;
-    oss << "vn 0.0 0.0 1.0" << std::endl;
-    oss << "f 1/1/1 2/2/1 3/3/1" << std::endl;
-    oss << "f 1/1/1 3/3/1 4/4/1" << std::endl;
-    std::istringstream iss(oss.str());
-    model->readObj(iss);
-  }
-  return model;
+
+  show_error(
+    wxT("The shmedia package was not found. This package contains models and textures \n"
+        "required by many shaders. You may still run Shrike but it is recommended \n"
+        "you install the shmedia package first.\n"
+        "\n"
+        "The package can be found at http://libsh.org/ in the downloads section.\n"
+        "\n"
+        "Shrike expected the package in "SHMEDIA_DIR),
+    error
+    );
+  static const char quad[] =
+    "v 1.0 1.0 0.0\n"
+    "v 1.0 -1.0 0.0\n"
+    "v -1.0 -1.0 0.0\n"
+    "v -1.0 1.0 0.0\n"
+    "vt 1.0 0.0\n"
+    "vt 1.0 1.0\n"
+    "vt 0.0 1.0\n"
+    "vt 0.0 0.0\n"
+    "vn 0.0 0.0 1.0\n"
+    "f 1/1/1 2/2/1 3/3/1\n"
+    "f 1/1/1 3/3/1 4/4/1\n";
+  model = new ObjMeshSource("quad", quad);
+  MeshData data;
+  parse_obj(quad, quad + sizeof(quad) - 1, "quad", data, error);
+  return prepare_model(data, wxT("Default model"));
+}
+
+MeshLod* ShrikeFrame::load_model(const std::string& path, const wxString& name,
+                                 std::string& error)
+{
+  MeshLod* lod = new MeshLod();
+  std::string cache = MeshLod::cachePath(path);
+  wxString msg;
+  if (lod->read(cache, path, error)) {
+    msg.Printf(wxT("%s: %lu triangles, %lu levels of detail from %s"),
+               name.c_str(), (unsigned long)lod->level(0).triangleCount(),
+               (unsigned long)lod->levels(), wxString(cache.c_str(), *wxConvCurrent).c_str());
+    output()->Insert(msg, output()->GetCount());
+    return lod;
+  }
+  delete lod;
+
+  MeshData data;
+  ShTimer start = ShTimer::now();
+  if (!read_obj(path, data, error)) return 0;
+  msg.Printf(wxT("%s: read in %.2f s"), name.c_str(),
+             (ShTimer::now() - start).value() / 1000);
+  output()->Insert(msg, output()->GetCount());
+
+  lod = prepare_model(data, name);
+  if (!lod->write(cache, error)) {
+    output()->Insert(wxT("Levels of detail not kept: ") + wxString(error.c_str(), *wxConvCurrent),
+                     output()->GetCount());
+  }
+  return lod;
+}
+
+MeshLod* ShrikeFrame::prepare_model(MeshData& data, const wxString& name)
+{
+  std::size_t corners = data.vertexCount();
+  float raw_acmr = average_cache_miss_ratio(data);
+
+  weld_vertices(data);
+  float welded_acmr = average_cache_miss_ratio(data);
+
+  optimize_vertex_cache(data);
+  reorder_vertices(data);
+  float optimized_acmr = average_cache_miss_ratio(data);
+
+  wxString msg;
+  msg.Printf(wxT("%s: %lu triangles, %lu vertices (%lu before welding), ")
+             wxT("ACMR %.2f raw, %.2f welded, %.2f reordered"),
+             name.c_str(),
+             (unsigned long)data.triangleCount(),
+             (unsigned long)data.vertexCount(), (unsigned long)corners,
+             raw_acmr, welded_acmr, optimized_acmr);
+  output()->Insert(msg, output()->GetCount());
+
+  MeshLod* lod = new MeshLod();
+  ShTimer start = ShTimer::now();
+  lod->build(data);
+  if (lod->levels() > 1) {
+    const MeshData& coarsest = lod->level(lod->levels() - 1);
+    msg.Printf(wxT("%s: %lu levels of detail down to %lu triangles, made in %.1f s"),
+               name.c_str(), (unsigned long)lod->levels(),
+               (unsigned long)coarsest.triangleCount(),
+               (ShTimer::now() - start).value() / 1000);
+    output()->Insert(msg, output()->GetCount());
+  }
+  return lod;
+}
+
+void ShrikeFrame::update_lod_menu()
+{
+  std::size_t count = m_canvas->levelCount();
+  for (int i = SHRIKE_MENU_VIEW_LOD_0; i <= SHRIKE_MENU_VIEW_LOD_LAST; ++i) {
+    std::size_t level = i - SHRIKE_MENU_VIEW_LOD_0;
+    wxString label = wxString::Format(wxT("Level %lu"), (unsigned long)level);
+    if (level < count) {
+      label += wxString::Format(wxT(" (%lu triangles)"),
+                                (unsigned long)m_canvas->levelTriangles(level));
+    }
+    m_lodMenu->SetLabel(i, label);
+    m_lodMenu->Enable(i, level < count);
+  }
+  int pinned = m_canvas->getLevel();
+  if (pinned >= (int)count) {
+    m_canvas->setLevel(-1);
+    pinned = -1;
+  }
+  m_lodMenu->Check(pinned < 0 ? SHRIKE_MENU_VIEW_LOD_AUTO : SHRIKE_MENU_VIEW_LOD_0 + pinned, true);
 }
 
 void ShrikeFrame::on_open_model(wxCommandEvent& event)
@@ -427,16 +574,16 @@ void ShrikeFrame::on_open_model(wxCommandEvent& event)
                       wxT("OBJ Files (*.obj)|*.obj"), wxOPEN);
 
   if (dialog.ShowModal() == wxID_OK) {
-    std::ifstream infile(dialog.GetPath().fn_str());
-    if (infile) {
-      try {
-        ShObjMesh* model = new ShObjMesh(infile);
-        m_canvas->setModel(model);
-      }
-      catch (const ShException& e) {
-        show_error(wxT("The model ") + dialog.GetPath() + wxT(" failed to load"),
-                   e.message());
-      }
+    std::string path(dialog.GetPath().fn_str());
+    std::string error;
+    MeshLod* lod = load_model(path, dialog.GetFilename(), error);
+    if (lod) {
+      m_canvas->setModel(lod, new ObjMeshSource(path));
+      update_lod_menu();
+    }
+    else {
+      show_error(wxT("The model ") + dialog.GetPath() + wxT(" failed to load"),
+                 error);
     }
   }
 }
@@ -453,15 +600,7 @@ void ShrikeFrame::on_close(wxCloseEvent& event)
 
 void ShrikeFrame::on_shader_item_select(wxTreeEvent& event)
 {
-  wxTreeItemId item = event.GetItem();
-  
-  if (ShaderTreeData* data = dynamic_cast<ShaderTreeData*>(m_shaderList->GetItemData(item))) {
-    if (!data) return;
-    Shader* shader = data->shader;
-    if (!set_shader(shader)) {
-      m_shaderList->SetItemTextColour(item, *wxRED);
-    }
-  }
+  m_switcher->request(event.GetItem());
 }
 
 void ShrikeFrame::on_shader_item_right_click(wxTreeEvent& event)
@@ -477,10 +616,32 @@ bool ShrikeFrame::set_shader(Shader* shader)
     // shader? that would be cool.
     return false;
   }
+  m_switcher->cancel();
+  m_canvas->SetCurrent();
+  if (shader && !(shader_step(shader, SHADER_INIT)
+                  && shader_step(shader, SHADER_COMPILE)
+                  && shader_step(shader, SHADER_BIND))) {
+    return false;
+  }
+  m_canvas->setShader(shader);
+  m_canvas->invalidate();
+  m_panel->setShader(shader);
+  m_cost->setShader(shader); // while the shader is still bound
+  m_shader = shader;
+  return true;
+}
+
+bool ShrikeFrame::shader_step(Shader* shader, ShaderStep step)
+{
   m_canvas->SetCurrent();
+  unsigned long hits = ProgramCache::instance().hits();
+  unsigned long misses = ProgramCache::instance().misses();
   try {
-    if (shader) shader->firstTimeInit();
-    if (shader) shader->bind();
+    switch (step) {
+    case SHADER_INIT: shader->firstTimeInit(); break;
+    case SHADER_COMPILE: shader->compile(); break;
+    case SHADER_BIND: shader->bind(); break;
+    }
   } catch (const ShImageException& e) {
     shader->set_failed(true);
     show_error(wxT("An Image error occured trying to initialize or bind this program.\n")
@@ -509,10 +670,15 @@ bool ShrikeFrame::set_shader(Shader* shader)
               wxT("This probably indicates an error in the shader program.") );
     return false;
   }
-  m_canvas->setShader(shader);
-  m_canvas->render();
-  m_panel->setShader(shader);
-  m_shader = shader;
+  if (ProgramCache::instance().hits() != hits
+      || ProgramCache::instance().misses() != misses) {
+    wxString msg;
+    msg.Printf(wxT("%s: program cache %s (%lu hits, %lu misses)"),
+               wxString(shader->name().c_str(), wxConvLibc).c_str(),
+               ProgramCache::instance().hits() != hits ? wxT("hit") : wxT("miss"),
+               ProgramCache::instance().hits(), ProgramCache::instance().misses());
+    output()->Insert(msg, output()->GetCount());
+  }
   return true;
 }
 
@@ -628,7 +794,7 @@ void ShrikeFrame::on_wireframe(wxCommandEvent& event)
     glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
   }
 
-  m_canvas->Refresh(FALSE);
+  m_canvas->invalidate();
 }
 
 void ShrikeFrame::set_fullscreen(bool fs)
@@ -652,6 +818,15 @@ void ShrikeFrame::on_fps(wxCommandEvent& event)
   set_fps(event.IsChecked());
 }
 
+void ShrikeFrame::on_lod(wxCommandEvent& event)
+{
+  if (event.GetId() == SHRIKE_MENU_VIEW_LOD_AUTO) {
+    m_canvas->setLevel(-1);
+  } else {
+    m_canvas->setLevel(event.GetId() - SHRIKE_MENU_VIEW_LOD_0);
+  }
+}
+
 void ShrikeFrame::set_fps(bool fps)
 {
   m_fps = fps;
@@ -675,8 +850,130 @@ void ShrikeFrame::on_screenshot(wxCommandEvent& event)
                                           wxT("."), wxT(""),
                                           wxT("PNG Files (*.png)|*.png"), wxSAVE);
   if (dialog->ShowModal() == wxID_OK) {
-    m_canvas->screenshot(dialog->GetPath().c_str());
+    wxSize canvas = m_canvas->GetClientSize();
+    wxString size = wxGetTextFromUser(wxT("Size in pixels, as WIDTHxHEIGHT. Add :16 for\n")
+                                      wxT("16 bits per channel, e.g. 8192x8192:16."),
+                                      wxT("Screenshot Size"),
+                                      wxString::Format(wxT("%dx%d"), canvas.GetWidth()*4,
+                                                       canvas.GetHeight()*4),
+                                      this);
+    if (size.IsEmpty()) return;
+
+    int width = 0, height = 0, bits = 8;
+    std::string stdsize;
+    stdsize = wxConvLibc.cWX2MB(size);
+    if (std::sscanf(stdsize.c_str(), "%dx%d:%d", &width, &height, &bits) < 2
+        || width <= 0 || height <= 0) {
+      show_error(wxT("The screenshot size should look like 4096x4096"));
+      return;
+    }
+    wxBusyCursor busy;
+    m_canvas->screenshot(dialog->GetPath(), width, height, bits);
+  }
+}
+
+void ShrikeFrame::on_compare(wxCommandEvent& event)
+{
+  std::vector<Shader*> shaders;
+  wxArrayString names;
+  wxArrayInt selected;
+  for (ShaderList::iterator I = GetShaders().begin(); I != GetShaders().end(); ++I) {
+    if ((*I)->failed()) continue;
+    if (*I == m_shader) selected.Add(shaders.size());
+    shaders.push_back(*I);
+    names.Add(wxString((*I)->name().c_str(), wxConvLibc));
+  }
+
+  wxMultiChoiceDialog dialog(this,
+                             wxT("Pick up to 16 shaders to draw side by side,\n")
+                             wxT("or fewer than two to go back to one."),
+                             wxT("Compare Shaders"), names);
+  dialog.SetSelections(selected);
+  if (dialog.ShowModal() != wxID_OK) return;
+
+  selected = dialog.GetSelections();
+  if (selected.GetCount() > CompareView::MAX_SHADERS) {
+    show_error(wxT("At most 16 shaders can be compared at once"));
+    return;
   }
+  std::vector<Shader*> chosen;
+  for (std::size_t i = 0; i < selected.GetCount(); i++) {
+    chosen.push_back(shaders[selected[i]]);
+  }
+  compare(chosen);
+}
+
+void ShrikeFrame::compare(const std::vector<Shader*>& shaders)
+{
+  m_switcher->cancel();
+
+  std::vector<Shader*> compiled;
+  if (shaders.size() > 1) {
+    wxBusyCursor busy;
+    for (std::size_t i = 0; i < shaders.size(); i++) {
+      Shader* shader = shaders[i];
+      if (!shader->failed()
+          && shader_step(shader, SHADER_INIT)
+          && shader_step(shader, SHADER_COMPILE)) {
+        compiled.push_back(shader);
+      }
+    }
+  }
+  m_canvas->setCompare(compiled);
+
+  wxString msg;
+  if (m_canvas->comparing()) {
+    msg.Printf(wxT("Comparing %lu shaders"), (unsigned long)compiled.size());
+  } else {
+    if (shaders.size() > 1) msg = wxT("Too few of the shaders compiled to compare them");
+    SetStatusText(wxT(""), 1);
+  }
+  if (!msg.IsEmpty()) output()->Insert(msg, output()->GetCount());
+}
+
+void ShrikeFrame::sweep_optimizations(const std::vector<Shader*>& shaders)
+{
+  m_switcher->cancel();
+  m_canvas->SetCurrent();
+
+  SweepResultList results;
+  {
+    wxBusyCursor busy;
+    wxSize size = m_canvas->GetClientSize();
+    OptimizationSweep sweep(*m_canvas, size.GetWidth(), size.GetHeight());
+    for (std::size_t i = 0; i < shaders.size(); i++) {
+      Shader* shader = shaders[i];
+      if (shader->failed() || !shader_step(shader, SHADER_INIT)) continue;
+
+      wxString msg;
+      msg.Printf(wxT("Sweeping optimization levels for %s"),
+                 wxString(shader->name().c_str(), wxConvLibc).c_str());
+      output()->Insert(msg, output()->GetCount());
+      sweep.run(shader, results);
+    }
+  }
+  if (results.empty()) return;
+
+  // The sweep rebuilt the current shader, so its uniforms are new
+  set_shader(m_shader);
+
+  std::ostringstream table;
+  write_sweep_table(table, results);
+
+  wxFrame* frame = new wxFrame(0, -1, wxT("Optimization Sweep"),
+                               wxDefaultPosition, wxSize(800, 400));
+  wxTextCtrl* control = new wxTextCtrl(frame, -1, wxT(""),
+                                       wxDefaultPosition,
+                                       wxDefaultSize,
+                                       wxTE_MULTILINE | wxTE_READONLY | wxHSCROLL);
+  control->SetFont(wxFont(10, wxMODERN, wxNORMAL, wxNORMAL));
+  control->AppendText(wxString(table.str().c_str(), wxConvLibc));
+  frame->Show();
+}
+
+void ShrikeFrame::on_difference(wxCommandEvent& event)
+{
+  m_canvas->setShowDifference(event.IsChecked());
 }
 
 void ShrikeFrame::on_about(wxCommandEvent& event)
@@ -878,6 +1175,7 @@ void ShrikeFrame::on_project_close(wxCommandEvent& event)
   
   set_shader(0); 
 
+  if (m_build && m_build->project() == project) m_build->cancel();
   m_project_tree->remove();
 }
 
@@ -925,47 +1223,44 @@ void ShrikeFrame::on_project_build(wxCommandEvent& event)
   Project* project = m_project_tree->get_project(m_project_tree->GetSelection());
   if (!project) return;
 
+  if (!m_build) m_build = new ProjectBuild(output(), this);
+  if (m_build->running()) {
+    output()->Insert(wxT("Still building ")+m_build->project()->name(), output()->GetCount());
+    return;
+  }
   output()->Clear();
-  output()->Insert(wxT("Building ")+project->name()+wxT("..."),0);
-  BuildProcess* process = build_project(*project);
-  if (process->status() != 0) {
-    wxInputStream *in = process->GetErrorStream();
-    if (in) {
-      wxTextInputStream text(*in);
-      while (!in->Eof())
-        output()->Insert(text.ReadLine(), output()->GetCount());
+  m_build->start(project);
+}
+
+void ShrikeFrame::build_finished(Project* project, bool success)
+{
+  if (!success) return;
+
+  // see if the current shader belongs to the project just built
+  if (get_shader()) {
+    bool dirty = false;
+    std::string old_shader=get_shader()->name();
+    for (ShaderList::iterator I = project->begin_shaders(); I != project->end_shaders(); ++I) {
+      if (get_shader() == *I) {
+        dirty = true;
+        break;
+      }
     }
-    output()->Insert(wxT("Build failed"), output()->GetCount());
-  }
-  else {
-    // see if the current shader belongs to the project just built
-    if (get_shader()) {
-      bool dirty = false;
-      std::string old_shader=get_shader()->name();
+    project->load_shaders();
+    if (dirty) {
+      set_shader(0);
       for (ShaderList::iterator I = project->begin_shaders(); I != project->end_shaders(); ++I) {
-        if (get_shader() == *I) {
-          dirty = true;
+        if ((*I)->name() == old_shader) {
+          set_shader(*I);
           break;
         }
       }
-      project->load_shaders();
-      if (dirty) {
-        set_shader(0);
-        for (ShaderList::iterator I = project->begin_shaders(); I != project->end_shaders(); ++I) {
-          if ((*I)->name() == old_shader) {
-            set_shader(*I);
-            break;
-          }
-        }
-      }
-    }
-    else {
-      project->load_shaders();
     }
-    m_project_tree->update();
-    output()->Insert(wxT("Build successful"), output()->GetCount());
   }
-  delete process;
+  else {
+    project->load_shaders();
+  }
+  m_project_tree->update();
 }
 
 void ShrikeFrame::on_project_build_settings(wxCommandEvent& event)
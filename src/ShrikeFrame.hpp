@@ -20,10 +20,12 @@
 #ifndef SHRIKEFRAME_HPP
 #define SHRIKEFRAME_HPP
 
+#include <vector>
 #include <wx/wx.h>
 #include <wx/treectrl.h>
 #include <wx/minifram.h>
 
+#include "Build.hpp"
 #include "Project.hpp"
 #include "ProjectTree.hpp"
 #include "Shader.hpp"
@@ -65,6 +67,9 @@ enum ShrikeId {
   SHRIKE_MENU_SHADER_REINIT,
 
   SHRIKE_MENU_SHADER_OPTIMIZE,
+  SHRIKE_MENU_SHADER_PRECOMPILE,
+  SHRIKE_MENU_SHADER_SWEEP,
+  SHRIKE_MENU_SHADER_SWEEP_ALL,
 
   SHRIKE_MENU_VIEW_RESET,
   SHRIKE_MENU_VIEW_SCREENSHOT,
@@ -72,6 +77,11 @@ enum ShrikeId {
   SHRIKE_MENU_VIEW_FULLSCREEN,
   SHRIKE_MENU_VIEW_FPS,
   SHRIKE_MENU_VIEW_WIREFRAME,
+  SHRIKE_MENU_VIEW_COMPARE,
+  SHRIKE_MENU_VIEW_DIFFERENCE,
+  SHRIKE_MENU_VIEW_LOD_AUTO,
+  SHRIKE_MENU_VIEW_LOD_0,
+  SHRIKE_MENU_VIEW_LOD_LAST = SHRIKE_MENU_VIEW_LOD_0 + 7, // MeshLod::MAX_LEVELS
 
   SHRIKE_MENU_HELP_ABOUT,
 
@@ -81,15 +91,22 @@ enum ShrikeId {
 
 class ProjectMenu;
 class ShaderMenu;
-class ShUtil::ShObjMesh;
 class ShrikeCanvas;
+class PrecompilePool;
+class ShaderSwitcher;
+class CostPanel;
+struct MeshData;
+class MeshLod;
+class ObjMeshSource;
 class wxSplitterWindow;
 
-class ShrikeFrame : public wxFrame {
+class ShrikeFrame : public wxFrame, public BuildListener {
 public:
   ShrikeFrame();
   virtual ~ShrikeFrame();
 
+  /// Make shader current right away.  Selecting it in the shader
+  /// tree does the same through a ShaderSwitcher instead.
   bool set_shader(Shader* shader);
   Shader* get_shader() { return m_shader; }
 
@@ -105,9 +122,44 @@ public:
   Project* get_project() { return m_project; }
   void set_project(Project* project);
 
+  /// Fill the program cache for every shader in the background.
+  void precompile();
+
+  /// Load the shaders of a project that was just built.
+  void build_finished(Project* project, bool success);
+
+  /// Draw the model under each of shaders side by side, see
+  /// ShrikeCanvas::setCompare.  Shaders that fail to compile are left
+  /// out.
+  void compare(const std::vector<Shader*>& shaders);
+
+  /// Rebuild each of shaders at every optimization level, drawing on
+  /// the canvas, and show what each level cost in a window.  See
+  /// OptimizationSweep.
+  void sweep_optimizations(const std::vector<Shader*>& shaders);
+
+  /// The stages of making a shader current.
+  enum ShaderStep {
+    SHADER_INIT,
+    SHADER_COMPILE,
+    SHADER_BIND
+  };
+  /// Run one stage for shader.  If it fails the error is shown, the
+  /// shader marked as failed and false returned.
+  bool shader_step(Shader* shader, ShaderStep step);
+
   static ShrikeFrame* instance();
 private:
-  ShUtil::ShObjMesh* init_model();
+  /// Load the default model, falling back to a quad when shmedia
+  /// isn't installed.  model is set to where its half-edge mesh is.
+  MeshLod* init_model(ObjMeshSource*& model);
+  /// Open path from its level of detail cache, or read, optimize and
+  /// simplify the OBJ and keep the result there.  Returns 0 and sets
+  /// error if the model can't be read.
+  MeshLod* load_model(const std::string& path, const wxString& name,
+                      std::string& error);
+  MeshLod* prepare_model(MeshData& data, const wxString& name);
+  void update_lod_menu();
   ProjectTree* init_project_tree(wxWindow* parent);
   wxTreeCtrl* init_shader_list(wxWindow* parent);
 
@@ -123,7 +175,10 @@ private:
   void on_fullscreen(wxCommandEvent& event);
   void on_wireframe(wxCommandEvent& event);
   void on_screenshot(wxCommandEvent& event);
+  void on_compare(wxCommandEvent& event);
+  void on_difference(wxCommandEvent& event);
   void on_fps(wxCommandEvent& event);
+  void on_lod(wxCommandEvent& event);
 
   void on_about(wxCommandEvent& event);
 
@@ -144,6 +199,7 @@ private:
 
   ShrikeCanvas* m_canvas;
   UniformPanel* m_panel;
+  CostPanel* m_cost;
   wxFrame* m_preview;
   wxListBox* m_output;
 
@@ -154,12 +210,17 @@ private:
   ProjectMenu* m_project_menu;
   ShaderMenu* m_shader_menu;
   wxMenu* m_viewMenu;
+  wxMenu* m_lodMenu;
   
   Project* m_project;
 
   bool m_fullscreen;
   bool m_fps;
 
+  PrecompilePool* m_precompile;
+  ProjectBuild* m_build;
+  ShaderSwitcher* m_switcher;
+
   static ShrikeFrame* m_instance;
   DECLARE_EVENT_TABLE()
 };
@@ -17,6 +17,7 @@
 // Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, 
 // MA  02110-1301, USA
 //////////////////////////////////////////////////////////////////////////////
+#include <cstring>
 #include "ShrikeGl.hpp"
 
 #ifdef WIN32
@@ -52,9 +53,118 @@ void shrikeGlInit()
   if (!glMultiTexCoord4fvARB) {
     GET_WGL_PROCEDURE(glMultiTexCoord4fvARB, GLMULTITEXCOORD4FVARB);
   }
+  if (!glClientActiveTextureARB) {
+    GET_WGL_PROCEDURE(glClientActiveTextureARB, GLCLIENTACTIVETEXTUREARB);
+  }
+  if (!glActiveTextureARB) {
+    GET_WGL_PROCEDURE(glActiveTextureARB, GLACTIVETEXTUREARB);
+  }
+  if (!glBlendEquationEXT) {
+    GET_WGL_PROCEDURE(glBlendEquationEXT, GLBLENDEQUATIONEXT);
+  }
+  if (!glGenBuffersARB) {
+    GET_WGL_PROCEDURE(glGenBuffersARB, GLGENBUFFERSARB);
+  }
+  if (!glBindBufferARB) {
+    GET_WGL_PROCEDURE(glBindBufferARB, GLBINDBUFFERARB);
+  }
+  if (!glBufferDataARB) {
+    GET_WGL_PROCEDURE(glBufferDataARB, GLBUFFERDATAARB);
+  }
+  if (!glDeleteBuffersARB) {
+    GET_WGL_PROCEDURE(glDeleteBuffersARB, GLDELETEBUFFERSARB);
+  }
+  if (!glMapBufferARB) {
+    GET_WGL_PROCEDURE(glMapBufferARB, GLMAPBUFFERARB);
+  }
+  if (!glUnmapBufferARB) {
+    GET_WGL_PROCEDURE(glUnmapBufferARB, GLUNMAPBUFFERARB);
+  }
+  if (!glGenFramebuffersEXT) {
+    GET_WGL_PROCEDURE(glGenFramebuffersEXT, GLGENFRAMEBUFFERSEXT);
+  }
+  if (!glDeleteFramebuffersEXT) {
+    GET_WGL_PROCEDURE(glDeleteFramebuffersEXT, GLDELETEFRAMEBUFFERSEXT);
+  }
+  if (!glBindFramebufferEXT) {
+    GET_WGL_PROCEDURE(glBindFramebufferEXT, GLBINDFRAMEBUFFEREXT);
+  }
+  if (!glFramebufferRenderbufferEXT) {
+    GET_WGL_PROCEDURE(glFramebufferRenderbufferEXT, GLFRAMEBUFFERRENDERBUFFEREXT);
+  }
+  if (!glCheckFramebufferStatusEXT) {
+    GET_WGL_PROCEDURE(glCheckFramebufferStatusEXT, GLCHECKFRAMEBUFFERSTATUSEXT);
+  }
+  if (!glGenRenderbuffersEXT) {
+    GET_WGL_PROCEDURE(glGenRenderbuffersEXT, GLGENRENDERBUFFERSEXT);
+  }
+  if (!glDeleteRenderbuffersEXT) {
+    GET_WGL_PROCEDURE(glDeleteRenderbuffersEXT, GLDELETERENDERBUFFERSEXT);
+  }
+  if (!glBindRenderbufferEXT) {
+    GET_WGL_PROCEDURE(glBindRenderbufferEXT, GLBINDRENDERBUFFEREXT);
+  }
+  if (!glRenderbufferStorageEXT) {
+    GET_WGL_PROCEDURE(glRenderbufferStorageEXT, GLRENDERBUFFERSTORAGEEXT);
+  }
+  if (!glGenProgramsARB) {
+    GET_WGL_PROCEDURE(glGenProgramsARB, GLGENPROGRAMSARB);
+  }
+  if (!glDeleteProgramsARB) {
+    GET_WGL_PROCEDURE(glDeleteProgramsARB, GLDELETEPROGRAMSARB);
+  }
+  if (!glBindProgramARB) {
+    GET_WGL_PROCEDURE(glBindProgramARB, GLBINDPROGRAMARB);
+  }
+  if (!glProgramStringARB) {
+    GET_WGL_PROCEDURE(glProgramStringARB, GLPROGRAMSTRINGARB);
+  }
+  if (!glProgramLocalParameter4fvARB) {
+    GET_WGL_PROCEDURE(glProgramLocalParameter4fvARB, GLPROGRAMLOCALPARAMETER4FVARB);
+  }
+  if (!glGetProgramivARB) {
+    GET_WGL_PROCEDURE(glGetProgramivARB, GLGETPROGRAMIVARB);
+  }
+  if (!glGetProgramStringARB) {
+    GET_WGL_PROCEDURE(glGetProgramStringARB, GLGETPROGRAMSTRINGARB);
+  }
+  if (!glGenQueriesARB) {
+    GET_WGL_PROCEDURE(glGenQueriesARB, GLGENQUERIESARB);
+  }
+  if (!glDeleteQueriesARB) {
+    GET_WGL_PROCEDURE(glDeleteQueriesARB, GLDELETEQUERIESARB);
+  }
+  if (!glBeginQueryARB) {
+    GET_WGL_PROCEDURE(glBeginQueryARB, GLBEGINQUERYARB);
+  }
+  if (!glEndQueryARB) {
+    GET_WGL_PROCEDURE(glEndQueryARB, GLENDQUERYARB);
+  }
+  if (!glGetQueryObjectivARB) {
+    GET_WGL_PROCEDURE(glGetQueryObjectivARB, GLGETQUERYOBJECTIVARB);
+  }
+#ifdef GL_EXT_timer_query
+  if (!glGetQueryObjectui64vEXT) {
+    GET_WGL_PROCEDURE(glGetQueryObjectui64vEXT, GLGETQUERYOBJECTUI64VEXT);
+  }
+#endif
 #endif
 }
 
+bool shrikeGlHasExtension(const char* name)
+{
+  const char* extensions = reinterpret_cast<const char*>(glGetString(GL_EXTENSIONS));
+  if (!extensions) return false;
+
+  std::size_t length = std::strlen(name);
+  for (const char* p = std::strstr(extensions, name); p; p = std::strstr(p + length, name)) {
+    if ((p == extensions || p[-1] == ' ') && (p[length] == ' ' || p[length] == '\0')) {
+      return true;
+    }
+  }
+  return false;
+}
+
 #ifdef WIN32
 PFNGLMULTITEXCOORD1FARBPROC glMultiTexCoord1fARB = 0;
 PFNGLMULTITEXCOORD2FARBPROC glMultiTexCoord2fARB = 0;
@@ -64,4 +174,42 @@ PFNGLMULTITEXCOORD1FVARBPROC glMultiTexCoord1fvARB = 0;
 PFNGLMULTITEXCOORD2FVARBPROC glMultiTexCoord2fvARB = 0;
 PFNGLMULTITEXCOORD3FVARBPROC glMultiTexCoord3fvARB = 0;
 PFNGLMULTITEXCOORD4FVARBPROC glMultiTexCoord4fvARB = 0;
+PFNGLCLIENTACTIVETEXTUREARBPROC glClientActiveTextureARB = 0;
+PFNGLACTIVETEXTUREARBPROC glActiveTextureARB = 0;
+
+PFNGLBLENDEQUATIONEXTPROC glBlendEquationEXT = 0;
+
+PFNGLGENBUFFERSARBPROC glGenBuffersARB = 0;
+PFNGLBINDBUFFERARBPROC glBindBufferARB = 0;
+PFNGLBUFFERDATAARBPROC glBufferDataARB = 0;
+PFNGLDELETEBUFFERSARBPROC glDeleteBuffersARB = 0;
+PFNGLMAPBUFFERARBPROC glMapBufferARB = 0;
+PFNGLUNMAPBUFFERARBPROC glUnmapBufferARB = 0;
+
+PFNGLGENFRAMEBUFFERSEXTPROC glGenFramebuffersEXT = 0;
+PFNGLDELETEFRAMEBUFFERSEXTPROC glDeleteFramebuffersEXT = 0;
+PFNGLBINDFRAMEBUFFEREXTPROC glBindFramebufferEXT = 0;
+PFNGLFRAMEBUFFERRENDERBUFFEREXTPROC glFramebufferRenderbufferEXT = 0;
+PFNGLCHECKFRAMEBUFFERSTATUSEXTPROC glCheckFramebufferStatusEXT = 0;
+PFNGLGENRENDERBUFFERSEXTPROC glGenRenderbuffersEXT = 0;
+PFNGLDELETERENDERBUFFERSEXTPROC glDeleteRenderbuffersEXT = 0;
+PFNGLBINDRENDERBUFFEREXTPROC glBindRenderbufferEXT = 0;
+PFNGLRENDERBUFFERSTORAGEEXTPROC glRenderbufferStorageEXT = 0;
+
+PFNGLGENPROGRAMSARBPROC glGenProgramsARB = 0;
+PFNGLDELETEPROGRAMSARBPROC glDeleteProgramsARB = 0;
+PFNGLBINDPROGRAMARBPROC glBindProgramARB = 0;
+PFNGLPROGRAMSTRINGARBPROC glProgramStringARB = 0;
+PFNGLPROGRAMLOCALPARAMETER4FVARBPROC glProgramLocalParameter4fvARB = 0;
+PFNGLGETPROGRAMIVARBPROC glGetProgramivARB = 0;
+PFNGLGETPROGRAMSTRINGARBPROC glGetProgramStringARB = 0;
+
+PFNGLGENQUERIESARBPROC glGenQueriesARB = 0;
+PFNGLDELETEQUERIESARBPROC glDeleteQueriesARB = 0;
+PFNGLBEGINQUERYARBPROC glBeginQueryARB = 0;
+PFNGLENDQUERYARBPROC glEndQueryARB = 0;
+PFNGLGETQUERYOBJECTIVARBPROC glGetQueryObjectivARB = 0;
+#ifdef GL_EXT_timer_query
+PFNGLGETQUERYOBJECTUI64VEXTPROC glGetQueryObjectui64vEXT = 0;
+#endif
 #endif
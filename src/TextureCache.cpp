@@ -0,0 +1,400 @@
+// Sh: A GPU metaprogramming language.
+//
+// Copyright 2003-2005 Serious Hack Inc.
+// 
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, 
+// MA  02110-1301, USA
+//////////////////////////////////////////////////////////////////////////////
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <climits>
+#include <iostream>
+#include <sys/stat.h>
+#include <shutil/shutil.hpp>
+#include "TextureCache.hpp"
+#include "TextureFile.hpp"
+#include "Parallel.hpp"
+#include "PngReader.hpp"
+#include "Trace.hpp"
+
+using namespace SH;
+using namespace ShUtil;
+
+namespace {
+
+std::string canonical_path(const std::string& path)
+{
+#ifdef WIN32
+  char buffer[_MAX_PATH];
+  if (_fullpath(buffer, path.c_str(), _MAX_PATH)) return buffer;
+#else
+  char buffer[PATH_MAX];
+  if (realpath(path.c_str(), buffer)) return buffer;
+#endif
+  return path;
+}
+
+/// path with .png swapped for .shtex.
+std::string texture_file_path(const std::string& path)
+{
+  std::string::size_type n = path.size();
+  if (n > 4 && path.compare(n - 4, 4, ".png") == 0) return path.substr(0, n - 4) + ".shtex";
+  return path + ".shtex";
+}
+
+/// Whether file exists and none of sources is newer.  A source that
+/// doesn't exist doesn't count.
+bool up_to_date(const std::string& file, const std::vector<std::string>& sources)
+{
+  struct stat status;
+  if (stat(file.c_str(), &status) != 0) return false;
+  for (std::size_t i = 0; i < sources.size(); ++i) {
+    struct stat source;
+    if (stat(sources[i].c_str(), &source) == 0 && source.st_mtime > status.st_mtime) {
+      return false;
+    }
+  }
+  return true;
+}
+
+bool up_to_date(const std::string& file, const std::string& source)
+{
+  return up_to_date(file, std::vector<std::string>(1, source));
+}
+
+/// The PNGs of the cube map in directory, in ShCubeDirection order.
+void face_paths(const std::string& directory, std::vector<std::string>& paths)
+{
+  static const char* names[6] = {"left", "right", "top", "bottom", "back", "front"};
+  for (int i = 0; i < 6; ++i) paths.push_back(directory + "/" + names[i] + ".png");
+}
+
+#ifdef HAVE_LIBPNG
+
+/// One file for the pool to decode, and what came out.
+struct Decoded {
+  std::string path;
+  PngImage png;
+  std::vector<float> data; // as ShImage lays it out
+  std::string error;
+};
+
+/// Decode like ShImage::loadPng: palettes become RGB, gray stays one
+/// channel, values go to [0, 1].  16 bit files keep their precision.
+/// Touches nothing of Sh's, so it can run on any thread.
+bool decode_png(Decoded& d)
+{
+  if (!read_png(d.path, d.png, d.error)) return false;
+  d.data.resize(d.png.samples());
+  for (std::size_t i = 0; i < d.data.size(); ++i) d.data[i] = d.png.value(i);
+  std::vector<unsigned char>().swap(d.png.pixels);
+  return true;
+}
+
+/// Decodes a range of files; each is independent of the others.
+struct DecodeTask : public ParallelTask {
+  std::vector<Decoded>* files;
+
+  void run(std::size_t begin, std::size_t end)
+  {
+    SHRIKE_TRACE_ZONE("TextureCache decode");
+    for (std::size_t i = begin; i < end; ++i) decode_png((*files)[i]);
+  }
+};
+
+/// Decode files on every processor, one file at a time since they
+/// vary so much in size.
+void decode_all(std::vector<Decoded>& files)
+{
+  DecodeTask task;
+  task.files = &files;
+  parallel_for(task, files.size(), 1);
+}
+
+ShImage* make_image(const Decoded& d)
+{
+  ShImage* image = new ShImage(d.png.width, d.png.height, d.png.channels);
+  std::memcpy(image->data(), &d.data[0], d.data.size()*sizeof(float));
+  return image;
+}
+
+#endif // HAVE_LIBPNG
+
+}
+
+#ifdef HAVE_LIBPNG
+
+/// Decodes the files of a start_preload() while the Sh thread gets
+/// on with other things.
+class PreloadTask : public BackgroundTask {
+public:
+  ~PreloadTask() { wait(); }
+
+  std::vector<Decoded> files;
+
+protected:
+  void run() { decode_all(files); }
+};
+
+#endif
+
+TextureCache& TextureCache::instance()
+{
+  static TextureCache cache;
+  return cache;
+}
+
+TextureCache::TextureCache()
+{
+}
+
+TextureCache::~TextureCache()
+{
+#ifdef HAVE_LIBPNG
+  for (std::list<PreloadTask*>::iterator I = m_preloads.begin(); I != m_preloads.end(); ++I) {
+    delete *I;
+  }
+#endif
+  clear();
+  for (FileMap::iterator I = m_files.begin(); I != m_files.end(); ++I) {
+    delete I->second;
+  }
+}
+
+ShImage& TextureCache::image(const std::string& path)
+{
+  std::string key = canonical_path(path);
+  ImageMap::iterator I = m_images.find(key);
+  if (I != m_images.end()) return *I->second;
+
+  SHRIKE_TRACE_ZONE("TextureCache::image");
+#ifdef HAVE_LIBPNG
+  Decoded d;
+  d.path = key;
+  if (!decode_png(d)) shError(ShImageException(d.error));
+  ShImage* image = make_image(d);
+#else
+  ShImage* image = new ShImage();
+  try {
+    load_PNG(*image, key);
+  } catch (...) {
+    delete image;
+    throw;
+  }
+#endif
+  m_images[key] = image;
+  return *image;
+}
+
+const TextureImage& TextureCache::texture(const std::string& path)
+{
+  std::string key = canonical_path(path);
+  TextureMap::iterator I = m_textures.find(key);
+  if (I != m_textures.end()) return *I->second;
+
+  TextureImage* texture = new TextureImage();
+  std::string file_path = texture_file_path(key);
+  TextureFile* file = up_to_date(file_path, key) ? map_file(file_path, 1) : 0;
+  if (file) {
+    texture->m_width = file->width();
+    texture->m_height = file->height();
+    texture->m_depth = file->channels();
+    texture->m_memory.push_back(file->memory());
+  } else {
+    try {
+      ShImage& image = this->image(key);
+      texture->m_width = image.width();
+      texture->m_height = image.height();
+      texture->m_depth = image.depth();
+      texture->m_memory.push_back(image.memory());
+    } catch (...) {
+      delete texture;
+      throw;
+    }
+  }
+  m_textures[key] = texture;
+  return *texture;
+}
+
+#ifdef HAVE_LIBPNG
+
+void TextureCache::preload(const std::vector<std::string>& paths)
+{
+  std::vector<std::string> keys;
+  uncached(paths, keys);
+  if (keys.empty()) return;
+
+  SHRIKE_TRACE_ZONE("TextureCache::preload");
+  std::vector<Decoded> files(keys.size());
+  for (std::size_t i = 0; i < keys.size(); ++i) files[i].path = keys[i];
+  decode_all(files);
+  for (std::size_t i = 0; i < files.size(); ++i) {
+    if (!files[i].error.empty()) continue;
+    m_images[files[i].path] = make_image(files[i]);
+  }
+}
+
+void TextureCache::start_preload(const std::vector<std::string>& paths)
+{
+  std::vector<std::string> keys;
+  uncached(paths, keys);
+  if (keys.empty()) return;
+
+  PreloadTask* task = new PreloadTask();
+  task->files.resize(keys.size());
+  for (std::size_t i = 0; i < keys.size(); ++i) task->files[i].path = keys[i];
+  task->start();
+  m_preloads.push_back(task);
+}
+
+#else
+
+void TextureCache::preload(const std::vector<std::string>&)
+{
+}
+
+void TextureCache::start_preload(const std::vector<std::string>&)
+{
+}
+
+#endif
+
+void TextureCache::preload(const char* const paths[])
+{
+  std::vector<std::string> list;
+  for (int i = 0; paths[i]; ++i) list.push_back(normalize_path(paths[i]));
+  preload(list);
+}
+
+bool TextureCache::finish_preload()
+{
+#ifdef HAVE_LIBPNG
+  std::list<PreloadTask*>::iterator I = m_preloads.begin();
+  while (I != m_preloads.end()) {
+    PreloadTask* task = *I;
+    if (!task->done()) {
+      ++I;
+      continue;
+    }
+    // image(), preload() or an earlier task may have got to some of
+    // them meanwhile.
+    SHRIKE_TRACE_ZONE("TextureCache::finish_preload");
+    std::vector<Decoded>& files = task->files;
+    for (std::size_t i = 0; i < files.size(); ++i) {
+      if (!files[i].error.empty() || m_images.count(files[i].path)) continue;
+      m_images[files[i].path] = make_image(files[i]);
+    }
+    delete task;
+    I = m_preloads.erase(I);
+  }
+#endif
+  return m_preloads.empty();
+}
+
+void TextureCache::cube_faces(const std::string& directory, std::vector<std::string>& paths)
+{
+  std::string key = canonical_path(normalize_path(directory));
+  std::vector<std::string> faces;
+  face_paths(key, faces);
+  if (up_to_date(key + "/cube.shtex", faces)) return;
+  paths.insert(paths.end(), faces.begin(), faces.end());
+}
+
+const TextureImage& TextureCache::cube(const std::string& directory)
+{
+  std::string key = canonical_path(normalize_path(directory));
+  TextureMap::iterator I = m_textures.find(key);
+  if (I != m_textures.end()) return *I->second;
+
+  std::vector<std::string> paths;
+  face_paths(key, paths);
+  std::string file_path = key + "/cube.shtex";
+  TextureFile* file = up_to_date(file_path, paths) ? map_file(file_path, 6) : 0;
+
+  TextureImage* texture = new TextureImage();
+  if (file) {
+    texture->m_width = file->width();
+    texture->m_height = file->height();
+    texture->m_depth = file->channels();
+    for (int i = 0; i < 6; ++i) texture->m_memory.push_back(file->memory(i));
+  } else {
+    preload(paths);
+    try {
+      for (int i = 0; i < 6; ++i) {
+        ShImage& face = image(paths[i]);
+        texture->m_width = face.width();
+        texture->m_height = face.height();
+        texture->m_depth = face.depth();
+        texture->m_memory.push_back(face.memory());
+      }
+    } catch (...) {
+      delete texture;
+      throw;
+    }
+  }
+  m_textures[key] = texture;
+  return *texture;
+}
+
+void TextureCache::clear()
+{
+  for (ImageMap::iterator I = m_images.begin(); I != m_images.end(); ++I) {
+    delete I->second;
+  }
+  m_images.clear();
+  for (TextureMap::iterator I = m_textures.begin(); I != m_textures.end(); ++I) {
+    delete I->second;
+  }
+  m_textures.clear();
+}
+
+void TextureCache::uncached(const std::vector<std::string>& paths,
+                            std::vector<std::string>& files) const
+{
+  for (std::size_t i = 0; i < paths.size(); ++i) {
+    std::string key = canonical_path(paths[i]);
+    if (m_images.count(key) || up_to_date(texture_file_path(key), key)) continue;
+    if (std::find(files.begin(), files.end(), key) != files.end()) continue;
+    files.push_back(key);
+  }
+}
+
+TextureFile* TextureCache::map_file(const std::string& path, int faces)
+{
+  std::string key = canonical_path(path);
+  FileMap::iterator I = m_files.find(key);
+  if (I != m_files.end()) return I->second;
+
+  SHRIKE_TRACE_ZONE("TextureCache::map_file");
+  TextureFile* file = new TextureFile();
+  if (!file->open(key)) {
+    std::cerr << file->error() << ", using the PNG instead" << std::endl;
+    delete file;
+    return 0;
+  }
+  if (file->faces() != faces) {
+    std::cerr << key << " has " << file->faces() << " faces, not " << faces
+              << ", using the PNG instead" << std::endl;
+    delete file;
+    return 0;
+  }
+  m_files[key] = file;
+  return file;
+}
@@ -0,0 +1,146 @@
+// Sh: A GPU metaprogramming language.
+//
+// Copyright 2003-2005 Serious Hack Inc.
+// 
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, 
+// MA  02110-1301, USA
+//////////////////////////////////////////////////////////////////////////////
+#ifndef TEXTURECACHE_HPP
+#define TEXTURECACHE_HPP
+
+#include <list>
+#include <map>
+#include <string>
+#include <vector>
+#include <sh/sh.hpp>
+
+class PreloadTask;
+class TextureFile;
+
+/** What a shader needs to fill in a texture: its size and the memory
+ * for each face, one or six for a cube map in ShCubeDirection order.
+ * The memory is either a decoded ShImage's floats or the samples of a
+ * mapped texture file, whichever the cache found.
+ */
+class TextureImage {
+public:
+  int width() const { return m_width; }
+  int height() const { return m_height; }
+  int depth() const { return m_depth; }
+  int faces() const { return m_memory.size(); }
+  SH::ShMemoryPtr memory(int face = 0) const { return m_memory[face]; }
+
+private:
+  friend class TextureCache;
+  TextureImage() : m_width(0), m_height(0), m_depth(0) {}
+
+  int m_width, m_height, m_depth;
+  std::vector<SH::ShMemoryPtr> m_memory;
+};
+
+/** Images from shmedia, decoded once and shared by every shader.
+ * Several shaders load the same files (the aniroom cube map, the BRDF
+ * factor images), and decoding them again for each one is most of
+ * what their init() costs.  Entries are keyed by canonical path, so
+ * different spellings of a file find the same image.
+ *
+ * texture() and cube() look for a texture file made by shtexconv
+ * first: foo.shtex next to foo.png, or cube.shtex in a cube map's
+ * directory.  One that is at least as new as its PNGs is mapped and
+ * its samples given to Sh as they are, with no decoding at all.
+ * Otherwise the PNGs are decoded into ShImage's floats, one to four
+ * channels, so the path is all the key needs.
+ *
+ * Textures given an entry's memory share it with every other shader
+ * that loaded the same file, so nothing from the cache may be
+ * changed.  Texture files stay mapped for as long as the cache lives.
+ *
+ * preload() decodes files on a pool of threads, one per CPU.  The
+ * threads only run libpng; the ShImages are made afterwards on the
+ * calling thread, since Sh isn't thread safe.  start_preload() does
+ * the same without making the caller wait: the decoding runs behind a
+ * thread of its own, and finish_preload() makes the ShImages once it
+ * is done.  Without libpng images are loaded by shutil one at a time.
+ * Only call the cache from the thread that uses Sh.
+ */
+class TextureCache {
+public:
+  static TextureCache& instance();
+
+  /// The image in path, decoded.  Throws ShImageException if it can't
+  /// be read.
+  SH::ShImage& image(const std::string& path);
+
+  /// The texture for path, from its texture file if it has a current
+  /// one and from the PNG if not.  Throws ShImageException if neither
+  /// can be read.
+  const TextureImage& texture(const std::string& path);
+
+  /// Decode every one of paths that isn't in the cache yet and has no
+  /// texture file, in parallel.  Files that fail are left for image()
+  /// to complain about.
+  void preload(const std::vector<std::string>& paths);
+
+  /// Same for a null terminated list, each path going through
+  /// normalize_path first.
+  void preload(const char* const paths[]);
+
+  /// Start decoding paths as preload() would, on a thread of its own,
+  /// and return at once.
+  void start_preload(const std::vector<std::string>& paths);
+
+  /// Make the ShImages of every start_preload() whose files have been
+  /// decoded, and return whether none are left.  Never waits for the
+  /// decoding.
+  bool finish_preload();
+
+  /// Add the six faces of the cube map in directory to paths, as
+  /// cube() would read them, unless it has a current cube.shtex.
+  static void cube_faces(const std::string& directory, std::vector<std::string>& paths);
+
+  /// The six faces of a cube map in directory: cube.shtex, or else
+  /// left, right, top, bottom, back and front .png decoded together.
+  const TextureImage& cube(const std::string& directory);
+
+  /// Forget every image and texture.  Textures keep the memory they
+  /// were given, and texture files stay mapped.
+  void clear();
+
+private:
+  TextureCache();
+  ~TextureCache();
+
+  /// The texture file at path, mapped, or null if there isn't a usable
+  /// one.  faces is what it has to hold.
+  TextureFile* map_file(const std::string& path, int faces);
+
+  /// The files of paths that preload() would decode, by canonical
+  /// path.
+  void uncached(const std::vector<std::string>& paths, std::vector<std::string>& files) const;
+
+  typedef std::map<std::string, SH::ShImage*> ImageMap;
+  ImageMap m_images; // by canonical path
+  typedef std::map<std::string, TextureImage*> TextureMap;
+  TextureMap m_textures; // by canonical path of the PNG or directory
+  typedef std::map<std::string, TextureFile*> FileMap;
+  FileMap m_files; // by canonical path, never unmapped before exit
+  std::list<PreloadTask*> m_preloads; // from start_preload(), oldest first
+
+  // NOT IMPLEMENTED
+  TextureCache(const TextureCache& other);
+  TextureCache& operator=(const TextureCache& other);
+};
+
+#endif
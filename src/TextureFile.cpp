@@ -0,0 +1,331 @@
+// Sh: A GPU metaprogramming language.
+//
+// Copyright 2003-2005 Serious Hack Inc.
+// 
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, 
+// MA  02110-1301, USA
+//////////////////////////////////////////////////////////////////////////////
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include "TextureFile.hpp"
+#include "PngReader.hpp"
+
+using namespace SH;
+
+namespace {
+
+const char magic[8] = {'S', 'H', 'R', 'K', 'T', 'E', 'X', '1'};
+const unsigned int byte_order = 0x01020304;
+const unsigned int version = 1;
+const unsigned int alignment = 64;
+
+struct FileHeader {
+  char magic[8];
+  unsigned int byte_order;
+  unsigned int version;
+  unsigned int format;
+  unsigned int channels;
+  unsigned int faces;
+  unsigned int levels;
+};
+
+struct FileLevel {
+  unsigned int width, height;
+  unsigned int offset, size;
+};
+
+std::size_t sample_size(TextureFile::Format format)
+{
+  return format == TextureFile::UBYTE ? 1 : 2;
+}
+
+unsigned int align(unsigned int offset)
+{
+  return (offset + alignment - 1)/alignment*alignment;
+}
+
+unsigned short to_half(float value)
+{
+  union { float f; unsigned int u; } bits;
+  bits.f = value;
+  unsigned int sign = (bits.u >> 16) & 0x8000;
+  unsigned int mantissa = bits.u & 0x7fffff;
+  int exponent = (int)((bits.u >> 23) & 0xff) - 127 + 15;
+
+  if (((bits.u >> 23) & 0xff) == 0xff) return sign | 0x7c00 | (mantissa ? 0x200 : 0);
+  if (exponent >= 31) return sign | 0x7c00;
+  if (exponent <= 0) {
+    // denormal, or too small for a half
+    if (exponent < -10) return sign;
+    mantissa |= 0x800000;
+    int shift = 14 - exponent;
+    unsigned int half = mantissa >> shift;
+    if ((mantissa >> (shift - 1)) & 1) ++half;
+    return sign | half;
+  }
+  unsigned int half = sign | (exponent << 10) | (mantissa >> 13);
+  if (mantissa & 0x1000) ++half; // a carry into the exponent is still right
+  return half;
+}
+
+/// One face at one level, as floats while the mip chain is made.
+struct Plane {
+  int width, height;
+  std::vector<float> data;
+};
+
+/// Average 2x2 blocks of from into the next level down.  A side of
+/// odd length drops its last row or column, as glGenerateMipmap may.
+void halve(const Plane& from, int channels, Plane& to)
+{
+  to.width = std::max(1, from.width/2);
+  to.height = std::max(1, from.height/2);
+  to.data.resize((std::size_t)to.width*to.height*channels);
+  for (int y = 0; y < to.height; ++y) {
+    int y0 = std::min(2*y, from.height - 1), y1 = std::min(2*y + 1, from.height - 1);
+    for (int x = 0; x < to.width; ++x) {
+      int x0 = std::min(2*x, from.width - 1), x1 = std::min(2*x + 1, from.width - 1);
+      for (int c = 0; c < channels; ++c) {
+        float sum = from.data[((std::size_t)y0*from.width + x0)*channels + c]
+          + from.data[((std::size_t)y0*from.width + x1)*channels + c]
+          + from.data[((std::size_t)y1*from.width + x0)*channels + c]
+          + from.data[((std::size_t)y1*from.width + x1)*channels + c];
+        to.data[((std::size_t)y*to.width + x)*channels + c] = sum/4;
+      }
+    }
+  }
+}
+
+void store(const std::vector<float>& data, TextureFile::Format format,
+           std::vector<unsigned char>& out)
+{
+  out.resize(data.size()*sample_size(format));
+  for (std::size_t i = 0; i < data.size(); ++i) {
+    float v = data[i];
+    if (format == TextureFile::HALF) {
+      reinterpret_cast<unsigned short*>(&out[0])[i] = to_half(v);
+      continue;
+    }
+    v = std::max(0.0f, std::min(1.0f, v));
+    if (format == TextureFile::UBYTE) {
+      out[i] = (unsigned char)(v*255 + 0.5f);
+    } else {
+      reinterpret_cast<unsigned short*>(&out[0])[i] = (unsigned short)(v*65535 + 0.5f);
+    }
+  }
+}
+
+}
+
+TextureFile::TextureFile()
+  : m_format(UBYTE), m_channels(0), m_faces(0), m_levels(0)
+{
+}
+
+TextureFile::~TextureFile()
+{
+  close();
+}
+
+bool TextureFile::open(const std::string& path)
+{
+  close();
+  m_error.clear();
+
+  // Mapped copy on write, so the pointers can go to ShHostMemory,
+  // which wants them writable, without the file ever changing.
+  std::string error;
+  if (!m_file.open(path, true, error)) return fail(error);
+
+  FileHeader header;
+  if (m_file.size() < sizeof(header)) return fail(path + " is not a texture file");
+  std::memcpy(&header, m_file.data(), sizeof(header));
+  if (std::memcmp(header.magic, magic, sizeof(magic)) != 0) {
+    return fail(path + " is not a texture file");
+  }
+  if (header.byte_order != byte_order) {
+    return fail(path + " was written on a machine of the other byte order");
+  }
+  if (header.version != version) return fail(path + " is from another version of shrike");
+  if (header.format < UBYTE || header.format > HALF
+      || header.channels < 1 || header.channels > 4
+      || (header.faces != 1 && header.faces != 6)
+      || header.levels < 1 || header.levels > 32) {
+    return fail(path + " has a bad header");
+  }
+  m_format = static_cast<Format>(header.format);
+  m_channels = header.channels;
+  m_faces = header.faces;
+  m_levels = header.levels;
+
+  std::size_t count = m_faces*m_levels;
+  if (m_file.size() < sizeof(header) + count*sizeof(FileLevel)) {
+    return fail(path + " is truncated");
+  }
+  m_table.resize(count);
+  for (std::size_t i = 0; i < count; ++i) {
+    FileLevel entry;
+    std::memcpy(&entry, m_file.data() + sizeof(header) + i*sizeof(entry), sizeof(entry));
+    std::size_t size = (std::size_t)entry.width*entry.height*m_channels*sample_size(m_format);
+    if (entry.size != size || entry.offset + (std::size_t)entry.size > m_file.size()) {
+      return fail(path + " is truncated");
+    }
+    m_table[i].width = entry.width;
+    m_table[i].height = entry.height;
+    m_table[i].offset = entry.offset;
+    m_table[i].size = entry.size;
+  }
+  m_memory.resize(m_faces);
+  return true;
+}
+
+int TextureFile::width(int level) const
+{
+  return m_table[level].width;
+}
+
+int TextureFile::height(int level) const
+{
+  return m_table[level].height;
+}
+
+const void* TextureFile::data(int face, int level) const
+{
+  return m_file.data() + m_table[face*m_levels + level].offset;
+}
+
+ShMemoryPtr TextureFile::memory(int face)
+{
+  if (!m_memory[face].object()) {
+    static const ShValueType types[] = {SH_FUBYTE, SH_FUBYTE, SH_FUSHORT, SH_HALF};
+    const Level& level = m_table[face*m_levels];
+    m_memory[face] = new ShHostMemory(level.size, m_file.data() + level.offset,
+                                      types[m_format]);
+  }
+  return m_memory[face];
+}
+
+bool TextureFile::write(const std::string& path, Format format,
+                        const std::vector<const PngImage*>& faces, bool mipmaps,
+                        std::string& error)
+{
+  if (faces.size() != 1 && faces.size() != 6) {
+    error = path + ": a texture has one face, or six for a cube map";
+    return false;
+  }
+  const PngImage& first = *faces[0];
+  for (std::size_t f = 1; f < faces.size(); ++f) {
+    if (faces[f]->width != first.width || faces[f]->height != first.height
+        || faces[f]->channels != first.channels) {
+      error = path + ": the faces of a cube map must all be the same size";
+      return false;
+    }
+  }
+
+  FileHeader header;
+  std::memcpy(header.magic, magic, sizeof(magic));
+  header.byte_order = byte_order;
+  header.version = version;
+  header.format = format;
+  header.channels = first.channels;
+  header.faces = faces.size();
+  header.levels = 1;
+  if (mipmaps) {
+    for (int w = first.width, h = first.height; w > 1 || h > 1; w /= 2, h /= 2) {
+      ++header.levels;
+    }
+  }
+
+  std::vector<FileLevel> table(header.faces*header.levels);
+  std::size_t offset = align(sizeof(header) + table.size()*sizeof(FileLevel));
+  for (unsigned int f = 0; f < header.faces; ++f) {
+    int w = first.width, h = first.height;
+    for (unsigned int l = 0; l < header.levels; ++l) {
+      FileLevel& entry = table[f*header.levels + l];
+      entry.width = w;
+      entry.height = h;
+      entry.offset = offset;
+      std::size_t size = (std::size_t)w*h*header.channels*sample_size(format);
+      entry.size = size;
+      offset = align(offset + size);
+      if (offset > 0xffffffffu) {
+        error = path + ": too big for a texture file";
+        return false;
+      }
+      w = std::max(1, w/2);
+      h = std::max(1, h/2);
+    }
+  }
+
+  std::FILE* file = std::fopen(path.c_str(), "wb");
+  if (!file) {
+    error = "Unable to write " + path;
+    return false;
+  }
+  bool ok = std::fwrite(&header, sizeof(header), 1, file) == 1
+    && std::fwrite(&table[0], sizeof(FileLevel), table.size(), file) == table.size();
+
+  std::vector<unsigned char> bytes;
+  for (unsigned int f = 0; ok && f < header.faces; ++f) {
+    Plane plane;
+    plane.width = first.width;
+    plane.height = first.height;
+    plane.data.resize(faces[f]->samples());
+    for (std::size_t i = 0; i < plane.data.size(); ++i) plane.data[i] = faces[f]->value(i);
+
+    for (unsigned int l = 0; ok && l < header.levels; ++l) {
+      const FileLevel& entry = table[f*header.levels + l];
+      if (l > 0) {
+        Plane next;
+        halve(plane, header.channels, next);
+        std::swap(plane, next);
+      }
+      store(plane.data, format, bytes);
+      ok = std::fseek(file, entry.offset, SEEK_SET) == 0
+        && std::fwrite(&bytes[0], 1, bytes.size(), file) == bytes.size();
+    }
+  }
+  // pad the end out to the alignment too, so every level is whole
+  // when the file is mapped a page at a time
+  if (ok && std::ftell(file) < (long)offset) {
+    ok = std::fseek(file, offset - 1, SEEK_SET) == 0 && std::fputc(0, file) != EOF;
+  }
+  if (std::fclose(file) != 0) ok = false;
+  if (!ok) {
+    std::remove(path.c_str());
+    error = "Unable to write " + path;
+  }
+  return ok;
+}
+
+void TextureFile::close()
+{
+  // The memory objects point into the mapping; Sh textures that still
+  // hold them must be gone by now.
+  m_memory.clear();
+  m_table.clear();
+  m_file.close();
+}
+
+bool TextureFile::fail(const std::string& error)
+{
+  close();
+  m_error = error;
+  return false;
+}
@@ -0,0 +1,110 @@
+// Sh: A GPU metaprogramming language.
+//
+// Copyright 2003-2005 Serious Hack Inc.
+// 
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, 
+// MA  02110-1301, USA
+//////////////////////////////////////////////////////////////////////////////
+#ifndef TEXTUREFILE_HPP
+#define TEXTUREFILE_HPP
+
+#include <string>
+#include <vector>
+#include <sh/sh.hpp>
+#include "MappedFile.hpp"
+
+struct PngImage;
+
+/** A texture stored ready to use: samples in their own 8 or 16 bit
+ * format (or half floats), every mip level, and all six faces of a
+ * cube map in one file.  Opening one maps it into memory, and memory()
+ * hands the mapped pages to Sh as they are, so there is no decoding
+ * and no expansion to floats; pages that no texture has touched yet
+ * aren't even read.
+ *
+ * The layout is a header, a table of faces times levels entries, then
+ * the samples, each level starting on a 64 byte boundary.  Rows go top
+ * to bottom like ShImage's.  Numbers are in the byte order of the
+ * machine that wrote the file, which open() checks; files are cheap to
+ * make again with shtexconv.
+ *
+ * Sh takes a single level per texture, so memory() is always the full
+ * size one; the smaller levels are there for data().
+ */
+class TextureFile {
+public:
+  enum Format {
+    UBYTE = 1, // 0 to 255 for [0, 1]
+    USHORT = 2, // 0 to 65535 for [0, 1]
+    HALF = 3 // IEEE half floats
+  };
+
+  TextureFile();
+  ~TextureFile();
+
+  /// Map path.  Returns false, with error() saying why, if it can't be
+  /// read as a texture file on this machine.
+  bool open(const std::string& path);
+  const std::string& error() const { return m_error; }
+
+  Format format() const { return m_format; }
+  int channels() const { return m_channels; }
+  int faces() const { return m_faces; }
+  int levels() const { return m_levels; }
+  int width(int level = 0) const;
+  int height(int level = 0) const;
+
+  /// The samples of face at level, in the mapped file.
+  const void* data(int face = 0, int level = 0) const;
+
+  /// Sh memory for the full size level of face, backed by the mapped
+  /// file.  Only valid while the file is open.
+  SH::ShMemoryPtr memory(int face = 0);
+
+  /** Write faces (one, or six in ShCubeDirection order, all the same
+   * size and number of channels) to path in format.  With mipmaps,
+   * every level down to 1x1 is made by averaging 2x2 blocks.  Returns
+   * false, with the reason in error, if the faces don't fit together
+   * or the file can't be written.
+   */
+  static bool write(const std::string& path, Format format,
+                    const std::vector<const PngImage*>& faces, bool mipmaps,
+                    std::string& error);
+
+private:
+  void close();
+  bool fail(const std::string& error);
+
+  struct Level {
+    unsigned int width, height;
+    unsigned int offset, size; // in bytes, from the start of the file
+  };
+
+  std::string m_error;
+  Format m_format;
+  int m_channels;
+  int m_faces;
+  int m_levels;
+  std::vector<Level> m_table; // faces*levels, face by face
+  std::vector<SH::ShMemoryPtr> m_memory; // by face, made on demand
+
+  MappedFile m_file;
+
+  // NOT IMPLEMENTED
+  TextureFile(const TextureFile& other);
+  TextureFile& operator=(const TextureFile& other);
+};
+
+#endif
@@ -0,0 +1,414 @@
+// Sh: A GPU metaprogramming language.
+//
+// Copyright 2003-2005 Serious Hack Inc.
+// 
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, 
+// MA  02110-1301, USA
+//////////////////////////////////////////////////////////////////////////////
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <deque>
+#ifdef WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/types.h>
+#include <unistd.h>
+#endif
+#include "TiledTexture.hpp"
+#include "PngReader.hpp"
+
+namespace {
+
+const char magic[8] = {'S', 'H', 'R', 'K', 'V', 'T', 'X', '1'};
+const unsigned int byte_order = 0x01020304;
+const unsigned int version = 1;
+const unsigned int data_start = 64; // tiles start here, after the header
+const int tile_border = 1; // enough for bilinear filtering
+
+struct FileHeader {
+  char magic[8];
+  unsigned int byte_order;
+  unsigned int version;
+  unsigned int width, height;
+  unsigned int tile_size, border;
+  unsigned int levels;
+};
+
+int tiles_for(int texels, int tile_size)
+{
+  return (texels + tile_size - 1)/tile_size;
+}
+
+/// Tiles on one side of level, given level 0's.
+int tiles_at(int tiles, int level)
+{
+  return (tiles + (1 << level) - 1) >> level;
+}
+
+int level_count(int tiles_x, int tiles_y)
+{
+  int levels = 1;
+  for (; tiles_x > 1 || tiles_y > 1; ++levels) {
+    tiles_x = (tiles_x + 1)/2;
+    tiles_y = (tiles_y + 1)/2;
+  }
+  return levels;
+}
+
+bool seek(std::FILE* file, TileOffset offset)
+{
+#ifdef WIN32
+  return _fseeki64(file, offset, SEEK_SET) == 0;
+#else
+  return fseeko(file, offset, SEEK_SET) == 0;
+#endif
+}
+
+/** One mip level of a texture being tiled.  Rows come in at the top,
+ * padded out to a whole number of tiles; each time there are enough
+ * for a row of tiles, with the borders, those are written.  Pairs of
+ * rows are averaged down and passed on to the next level.  Only the
+ * rows still needed for a tile are kept.
+ */
+class LevelWriter {
+public:
+  LevelWriter(std::FILE* file, TileOffset start, int tiles_x, int tiles_y, int tile_size,
+              LevelWriter* next)
+    : m_file(file), m_start(start), m_tiles_x(tiles_x), m_tiles_y(tiles_y),
+      m_tile_size(tile_size), m_width(tiles_x*tile_size), m_first_row(0), m_received(0),
+      m_tile_row(0), m_has_pending(false), m_next(next)
+  {
+  }
+
+  bool push(const std::vector<unsigned char>& row)
+  {
+    m_rows.push_back(row);
+    ++m_received;
+    if (!write_ready(false)) return false;
+    if (!m_next) return true;
+    if (!m_has_pending) {
+      m_pending = row;
+      m_has_pending = true;
+      return true;
+    }
+    m_has_pending = false;
+    return m_next->push(halve(m_pending, row));
+  }
+
+  /// Write what's left, repeating the last row to fill the last tiles.
+  bool finish()
+  {
+    if (m_next && m_has_pending) {
+      m_has_pending = false;
+      if (!m_next->push(halve(m_pending, m_pending))) return false;
+    }
+    if (!write_ready(true)) return false;
+    return !m_next || m_next->finish();
+  }
+
+private:
+  int stored() const { return m_tile_size + 2*tile_border; }
+
+  const unsigned char* row(int y) const
+  {
+    y = std::max(0, std::min(y, m_received - 1));
+    return &m_rows[y - m_first_row][0];
+  }
+
+  bool write_ready(bool all)
+  {
+    std::size_t tile_bytes = (std::size_t)stored()*stored()*4;
+    std::vector<unsigned char> tiles(tile_bytes*m_tiles_x);
+    for (; m_tile_row < m_tiles_y; ++m_tile_row) {
+      int top = m_tile_row*m_tile_size - tile_border;
+      if (!all && m_received < top + stored()) break;
+
+      for (int x = 0; x < m_tiles_x; ++x) {
+        unsigned char* tile = &tiles[x*tile_bytes];
+        int left = x*m_tile_size - tile_border;
+        for (int j = 0; j < stored(); ++j) {
+          const unsigned char* in = row(top + j);
+          unsigned char* out = tile + (std::size_t)j*stored()*4;
+          for (int i = 0; i < stored(); ++i) {
+            int column = std::max(0, std::min(left + i, m_width - 1));
+            std::memcpy(out + 4*i, in + 4*column, 4);
+          }
+        }
+      }
+      TileOffset offset = m_start + (TileOffset)m_tile_row*m_tiles_x*tile_bytes;
+      if (!seek(m_file, offset)
+          || std::fwrite(&tiles[0], 1, tiles.size(), m_file) != tiles.size()) {
+        return false;
+      }
+
+      // keep from the next tile row's top border on, and always the
+      // last row, which fills in anything past the bottom
+      int keep = std::min((m_tile_row + 1)*m_tile_size - tile_border, m_received - 1);
+      while (m_first_row < keep) {
+        m_rows.pop_front();
+        ++m_first_row;
+      }
+    }
+    return true;
+  }
+
+  /// Average a pair of rows down to a row of the next level.
+  std::vector<unsigned char> halve(const std::vector<unsigned char>& a,
+                                   const std::vector<unsigned char>& b) const
+  {
+    int width = m_next->m_width;
+    std::vector<unsigned char> out(width*4);
+    for (int i = 0; i < width; ++i) {
+      int x0 = std::min(2*i, m_width - 1), x1 = std::min(2*i + 1, m_width - 1);
+      for (int c = 0; c < 4; ++c) {
+        int sum = a[4*x0 + c] + a[4*x1 + c] + b[4*x0 + c] + b[4*x1 + c];
+        out[4*i + c] = (sum + 2)/4;
+      }
+    }
+    return out;
+  }
+
+  std::FILE* m_file;
+  TileOffset m_start;
+  int m_tiles_x, m_tiles_y;
+  int m_tile_size;
+  int m_width; // texels in a row, padded to whole tiles
+  std::deque< std::vector<unsigned char> > m_rows;
+  int m_first_row; // which row m_rows.front() is
+  int m_received;
+  int m_tile_row; // the next to write
+  std::vector<unsigned char> m_pending; // waiting for its pair
+  bool m_has_pending;
+  LevelWriter* m_next;
+};
+
+/// A row from a PngRowReader as RGBA bytes, padded to width by
+/// repeating the last texel.
+void expand_row(const PngRowReader& reader, const unsigned char* in,
+                std::vector<unsigned char>& out, int width)
+{
+  int channels = reader.channels();
+  out.resize(width*4);
+  for (int x = 0; x < width; ++x) {
+    int from = std::min(x, reader.width() - 1);
+    unsigned char v[4];
+    for (int c = 0; c < channels; ++c) {
+      std::size_t i = (std::size_t)from*channels + c;
+      if (reader.bits() == 16) {
+        unsigned int wide = reinterpret_cast<const unsigned short*>(in)[i];
+        v[c] = (wide*255 + 32767)/65535;
+      } else {
+        v[c] = in[i];
+      }
+    }
+    unsigned char* texel = &out[4*x];
+    switch (channels) {
+    case 1: texel[0] = texel[1] = texel[2] = v[0]; texel[3] = 255; break;
+    case 2: texel[0] = texel[1] = texel[2] = v[0]; texel[3] = v[1]; break;
+    case 3: std::memcpy(texel, v, 3); texel[3] = 255; break;
+    default: std::memcpy(texel, v, 4); break;
+    }
+  }
+}
+
+}
+
+TiledTexture::TiledTexture()
+  : m_width(0), m_height(0), m_tile_size(0), m_border(0), m_levels(0),
+#ifdef WIN32
+    m_file(INVALID_HANDLE_VALUE)
+#else
+    m_file(-1)
+#endif
+{
+}
+
+TiledTexture::~TiledTexture()
+{
+  close();
+}
+
+bool TiledTexture::open(const std::string& path)
+{
+  close();
+  m_error.clear();
+#ifdef WIN32
+  m_file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, 0, OPEN_EXISTING,
+                       FILE_ATTRIBUTE_NORMAL | FILE_FLAG_RANDOM_ACCESS, 0);
+  if (m_file == INVALID_HANDLE_VALUE) return fail("Unable to open " + path);
+#else
+  m_file = ::open(path.c_str(), O_RDONLY);
+  if (m_file < 0) return fail("Unable to open " + path);
+#endif
+
+  FileHeader header;
+#ifdef WIN32
+  DWORD count = 0;
+  bool read = ReadFile(m_file, &header, sizeof(header), &count, 0) && count == sizeof(header);
+#else
+  bool read = ::read(m_file, &header, sizeof(header)) == (ssize_t)sizeof(header);
+#endif
+  if (!read || std::memcmp(header.magic, magic, sizeof(magic)) != 0) {
+    return fail(path + " is not a tiled texture");
+  }
+  if (header.byte_order != byte_order) {
+    return fail(path + " was written on a machine of the other byte order");
+  }
+  if (header.version != version) return fail(path + " is from another version of shrike");
+  if (header.width < 1 || header.height < 1 || header.tile_size < 8
+      || header.tile_size > 4096 || header.border >= header.tile_size/2) {
+    return fail(path + " has a bad header");
+  }
+  m_width = header.width;
+  m_height = header.height;
+  m_tile_size = header.tile_size;
+  m_border = header.border;
+  m_levels = level_count(tiles_x(0), tiles_y(0));
+  if ((int)header.levels != m_levels) return fail(path + " has a bad header");
+
+  TileOffset start = 0;
+  for (int l = 0; l < m_levels; ++l) {
+    m_level_start.push_back(start);
+    start += (TileOffset)tiles_x(l)*tiles_y(l);
+  }
+  return true;
+}
+
+int TiledTexture::tiles_x(int level) const
+{
+  return tiles_at(tiles_for(m_width, m_tile_size), level);
+}
+
+int TiledTexture::tiles_y(int level) const
+{
+  return tiles_at(tiles_for(m_height, m_tile_size), level);
+}
+
+TileOffset TiledTexture::offset(int level, int x, int y) const
+{
+  TileOffset tile = m_level_start[level] + (TileOffset)y*tiles_x(level) + x;
+  return data_start + tile*tile_bytes();
+}
+
+bool TiledTexture::read_tile(int level, int x, int y, unsigned char* texels) const
+{
+  TileOffset at = offset(level, x, y);
+  std::size_t size = tile_bytes();
+#ifdef WIN32
+  OVERLAPPED position;
+  std::memset(&position, 0, sizeof(position));
+  position.Offset = (DWORD)at;
+  position.OffsetHigh = (DWORD)(at >> 32);
+  DWORD count = 0;
+  return ReadFile(m_file, texels, size, &count, &position) && count == size;
+#else
+  while (size > 0) {
+    ssize_t count = pread(m_file, texels, size, at);
+    if (count <= 0) return false;
+    texels += count;
+    size -= count;
+    at += count;
+  }
+  return true;
+#endif
+}
+
+bool TiledTexture::write(const std::string& png, const std::string& path, int tile_size,
+                         std::string& error)
+{
+  if (tile_size < 8 || tile_size > 4096) {
+    error = "Tiles must be from 8 to 4096 texels on a side";
+    return false;
+  }
+  PngRowReader reader;
+  if (!reader.open(png, error)) return false;
+
+  FileHeader header;
+  std::memcpy(header.magic, magic, sizeof(magic));
+  header.byte_order = byte_order;
+  header.version = version;
+  header.width = reader.width();
+  header.height = reader.height();
+  header.tile_size = tile_size;
+  header.border = tile_border;
+  int tiles_x = tiles_for(reader.width(), tile_size);
+  int tiles_y = tiles_for(reader.height(), tile_size);
+  header.levels = level_count(tiles_x, tiles_y);
+
+  std::FILE* file = std::fopen(path.c_str(), "wb");
+  if (!file) {
+    error = "Unable to write " + path;
+    return false;
+  }
+
+  // the levels are built from the smallest up, so each can hand its
+  // rows down to the next
+  std::size_t stored = tile_size + 2*tile_border;
+  std::size_t tile_bytes = stored*stored*4;
+  std::vector<TileOffset> starts;
+  TileOffset start = data_start;
+  for (unsigned int l = 0; l < header.levels; ++l) {
+    starts.push_back(start);
+    start += (TileOffset)tiles_at(tiles_x, l)*tiles_at(tiles_y, l)*tile_bytes;
+  }
+  std::vector<LevelWriter*> levels(header.levels);
+  for (int l = header.levels - 1; l >= 0; --l) {
+    LevelWriter* next = l + 1 < (int)header.levels ? levels[l + 1] : 0;
+    levels[l] = new LevelWriter(file, starts[l], tiles_at(tiles_x, l), tiles_at(tiles_y, l),
+                                tile_size, next);
+  }
+
+  bool ok = std::fwrite(&header, sizeof(header), 1, file) == 1;
+  std::vector<unsigned char> in(reader.row_size()), row;
+  for (int y = 0; ok && y < reader.height(); ++y) {
+    ok = reader.read_row(&in[0], error);
+    if (!ok) break;
+    expand_row(reader, &in[0], row, tiles_x*tile_size);
+    ok = levels[0]->push(row);
+  }
+  ok = ok && levels[0]->finish();
+  for (std::size_t l = 0; l < levels.size(); ++l) delete levels[l];
+  if (std::fclose(file) != 0) ok = false;
+  if (!ok) {
+    std::remove(path.c_str());
+    if (error.empty()) error = "Unable to write " + path;
+    else error = png + ": " + error;
+  }
+  return ok;
+}
+
+void TiledTexture::close()
+{
+  m_level_start.clear();
+#ifdef WIN32
+  if (m_file != INVALID_HANDLE_VALUE) CloseHandle(m_file);
+  m_file = INVALID_HANDLE_VALUE;
+#else
+  if (m_file >= 0) ::close(m_file);
+  m_file = -1;
+#endif
+}
+
+bool TiledTexture::fail(const std::string& error)
+{
+  close();
+  m_error = error;
+  return false;
+}
@@ -0,0 +1,101 @@
+// Sh: A GPU metaprogramming language.
+//
+// Copyright 2003-2005 Serious Hack Inc.
+// 
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, 
+// MA  02110-1301, USA
+//////////////////////////////////////////////////////////////////////////////
+#ifndef TILEDTEXTURE_HPP
+#define TILEDTEXTURE_HPP
+
+#include <string>
+#include <vector>
+
+#ifdef WIN32
+typedef unsigned __int64 TileOffset;
+#else
+typedef unsigned long long TileOffset;
+#endif
+
+/** A texture too big to load, split into square tiles so a
+ * VirtualTexture can stream in just the ones a view needs.  Every mip
+ * level is kept, each as a grid of tiles, down to a level that fits in
+ * a single tile.  Tiles are RGBA, 8 bits a channel, and carry a border
+ * copied from their neighbours so they filter cleanly on their own.
+ *
+ * Level l has ceil(tiles_x(0)/2^l) by ceil(tiles_y(0)/2^l) tiles, and
+ * its texel coordinates are level 0's divided by 2^l; the right and
+ * bottom tiles are padded out by repeating the edge.  Tiles are stored
+ * level by level, row by row, all the same size, so a tile's place in
+ * the file follows from its coordinates.
+ */
+class TiledTexture {
+public:
+  TiledTexture();
+  ~TiledTexture();
+
+  /// Open path.  Returns false, with error() saying why, if it can't
+  /// be read as a tiled texture on this machine.
+  bool open(const std::string& path);
+  const std::string& error() const { return m_error; }
+
+  /// Size of level 0 in texels, without padding.
+  int width() const { return m_width; }
+  int height() const { return m_height; }
+  /// Texels on a side of a tile, without the border.
+  int tile_size() const { return m_tile_size; }
+  int border() const { return m_border; }
+  /// Texels on a side of a tile with its border on both sides.
+  int stored_size() const { return m_tile_size + 2*m_border; }
+  int levels() const { return m_levels; }
+  int tiles_x(int level) const;
+  int tiles_y(int level) const;
+
+  std::size_t tile_bytes() const { return (std::size_t)stored_size()*stored_size()*4; }
+
+  /// Read tile (x, y) of level into texels, tile_bytes() of them, rows
+  /// top to bottom.  Safe to call from several threads at once.
+  bool read_tile(int level, int x, int y, unsigned char* texels) const;
+
+  /** Tile path.png, streaming it a few rows at a time, so images much
+   * bigger than memory can be converted.  Returns false, with the
+   * reason in error, if it can't be read or path can't be written.
+   */
+  static bool write(const std::string& png, const std::string& path, int tile_size,
+                    std::string& error);
+
+private:
+  void close();
+  bool fail(const std::string& error);
+  TileOffset offset(int level, int x, int y) const;
+
+  std::string m_error;
+  int m_width, m_height;
+  int m_tile_size, m_border;
+  int m_levels;
+  std::vector<TileOffset> m_level_start; // first tile of each level
+
+#ifdef WIN32
+  void* m_file;
+#else
+  int m_file;
+#endif
+
+  // NOT IMPLEMENTED
+  TiledTexture(const TiledTexture& other);
+  TiledTexture& operator=(const TiledTexture& other);
+};
+
+#endif
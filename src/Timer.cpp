@@ -17,128 +17,101 @@
 // Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, 
 // MA  02110-1301, USA
 //////////////////////////////////////////////////////////////////////////////
+#include <algorithm>
+#include <cmath>
 #include "Timer.hpp"
 
-#ifdef WIN32
+#if defined(__APPLE__)
+#include <mach/mach_time.h>
+#elif !defined(WIN32)
+#include <time.h>
+#endif
+
 ShTimer::ShTimer(void)
+  : m_ns(0)
 {
-  t.QuadPart = 0;
 }
 
 ShTimer::~ShTimer(void)
 {
 }
 
-float ShTimer::value(void)
+float ShTimer::value(void) const
 {
-  LARGE_INTEGER freq;
-  QueryPerformanceFrequency(&freq);
-  return ((float)t.QuadPart)/((float)freq.QuadPart/1000.0);
+  return m_ns / 1.0e6;
 }
 
 ShTimer ShTimer::now(void)
 {
+  const ShTimerNs NS_PER_SEC = 1000000000;
   ShTimer ret;
-  QueryPerformanceCounter(&ret.t);
+#ifdef WIN32
+  LARGE_INTEGER count, freq;
+  QueryPerformanceCounter(&count);
+  QueryPerformanceFrequency(&freq);
+  // split to keep count * NS_PER_SEC from overflowing
+  ret.m_ns = (count.QuadPart / freq.QuadPart) * NS_PER_SEC
+    + (count.QuadPart % freq.QuadPart) * NS_PER_SEC / freq.QuadPart;
+#elif defined(__APPLE__)
+  static mach_timebase_info_data_t timebase;
+  if (!timebase.denom) mach_timebase_info(&timebase);
+  ShTimerNs ticks = mach_absolute_time();
+  ret.m_ns = (ticks / timebase.denom) * timebase.numer
+    + (ticks % timebase.denom) * timebase.numer / timebase.denom;
+#else
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  ret.m_ns = ts.tv_sec * NS_PER_SEC + ts.tv_nsec;
+#endif
   return ret;
 }
 
 ShTimer ShTimer::zero(void)
 {
-  ShTimer ret;
-  ret.t.QuadPart = 0;
-  return ret;
+  return ShTimer();
 }
 
 ShTimer operator-(const ShTimer& a, const ShTimer& b)
 {
   ShTimer ret;
-  ret.t.QuadPart = a.t.QuadPart + b.t.QuadPart;
+  ret.m_ns = a.m_ns - b.m_ns;
   return ret;
 }
 
 ShTimer operator+(const ShTimer& a, const ShTimer& b)
 {
   ShTimer ret;
-  ret.t.QuadPart = a.t.QuadPart - b.t.QuadPart;
+  ret.m_ns = a.m_ns + b.m_ns;
   return ret;
 }
 
-#else
-
-ShTimer::ShTimer(void)
+TimingStats::TimingStats()
+  : count(0), mean(0), min(0), max(0), p50(0), p95(0), p99(0)
 {
-  t.tv_sec = 0;
-  t.tv_usec = 0;
 }
 
-ShTimer::~ShTimer(void)
+namespace {
+float percentile(const std::vector<float>& sorted, float p)
 {
+  std::size_t rank = (std::size_t)std::ceil(p * sorted.size());
+  return sorted[rank > 0 ? rank - 1 : 0];
 }
-
-float ShTimer::value(void)
-{
-  float sec = (float)t.tv_sec*1000;
-  float msec = (float)t.tv_usec/1000;
-  return (sec + msec);
 }
 
-ShTimer ShTimer::now(void)
+void TimingStats::compute(std::vector<float> samples)
 {
-  ShTimer ret;
-  gettimeofday(&ret.t, 0);
-  return ret;
-}
-
-ShTimer ShTimer::zero(void)
-{
-  ShTimer ret;
-  ret.t.tv_sec = 0;
-  ret.t.tv_usec = 0;
-  return ret;
-}
-
-ShTimer operator-(const ShTimer& a, const ShTimer& b)
-{
-  ShTimer ret;
-  
-  ret.t.tv_sec = a.t.tv_sec - b.t.tv_sec;
-  ret.t.tv_usec = a.t.tv_usec - b.t.tv_usec;
-
-  // adjust microsecond if the value is out of range
-  if (ret.t.tv_usec < 0) {
-    ret.t.tv_sec -= 1;
-    ret.t.tv_usec += 1000000;
-  }
-
-  // adjust microsecond if the value is out of range
-  if (ret.t.tv_usec > 1000000) {
-    ret.t.tv_sec += 1;
-    ret.t.tv_usec -= 1000000;
-  }
-
-  return ret;
-}
-
-ShTimer operator+(const ShTimer& a, const ShTimer& b)
-{
-  ShTimer ret;
-  
-  ret.t.tv_sec = a.t.tv_sec + b.t.tv_sec;
-  ret.t.tv_usec = a.t.tv_usec + b.t.tv_usec;
-
-  // adjust microsecond if the value is out of range
-  if (ret.t.tv_usec < 0) {
-    ret.t.tv_sec -= 1;
-    ret.t.tv_usec += 1000000;
-  }
-  
-  // adjust microsecond if the value is out of range
-  if (ret.t.tv_usec > 1000000) {
-    ret.t.tv_sec += 1;
-    ret.t.tv_usec -= 1000000;
-  }
-  
-  return ret;
+  *this = TimingStats();
+  count = samples.size();
+  if (samples.empty()) return;
+
+  std::sort(samples.begin(), samples.end());
+  double sum = 0.0;
+  for (std::size_t i = 0; i < samples.size(); ++i) sum += samples[i];
+
+  mean = sum / samples.size();
+  min = samples.front();
+  max = samples.back();
+  p50 = percentile(samples, 0.50f);
+  p95 = percentile(samples, 0.95f);
+  p99 = percentile(samples, 0.99f);
 }
-#endif /* WIN32 */
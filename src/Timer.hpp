@@ -21,18 +21,29 @@
 #ifndef TIMER_H
 #define TIMER_H
 
+#include <vector>
 #ifdef WIN32
 #include <windows.h>
+#endif /* WIN32 */
+
+#ifdef WIN32
+typedef __int64 ShTimerNs;
 #else
-#include <sys/time.h>
+typedef long long ShTimerNs;
 #endif /* WIN32 */
 
+/// A point in time, or the difference between two, in nanoseconds.
+/// Points come from a monotonic clock, so they are only meaningful
+/// relative to each other.
 class ShTimer{
 public:
   ShTimer(void);
   ~ShTimer(void);
   
-  float value(void);
+  /// In milliseconds
+  float value(void) const;
+
+  ShTimerNs ns(void) const { return m_ns; }
   
   static ShTimer now(void);
   static ShTimer zero(void);
@@ -41,11 +52,23 @@ public:
   friend ShTimer operator+(const ShTimer& a, const ShTimer& b);
   
 private:
-#ifdef WIN32
-  LARGE_INTEGER t;
-#else
-  struct timeval t;
-#endif /* WIN32 */
+  ShTimerNs m_ns;
+};
+
+/// Summary of a set of timing samples, in whatever unit they were
+/// taken.  Percentiles use the nearest-rank method.
+struct TimingStats {
+  TimingStats();
+
+  void compute(std::vector<float> samples);
+
+  std::size_t count;
+  float mean;
+  float min;
+  float max;
+  float p50;
+  float p95;
+  float p99;
 };
 
 #endif /* TIMER_H */
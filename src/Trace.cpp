@@ -0,0 +1,170 @@
+// Sh: A GPU metaprogramming language.
+//
+// Copyright 2003-2005 Serious Hack Inc.
+// 
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, 
+// MA  02110-1301, USA
+//////////////////////////////////////////////////////////////////////////////
+#include <fstream>
+#include <iomanip>
+#include "Trace.hpp"
+
+#ifdef WIN32
+# define SHRIKE_THREAD_LOCAL __declspec(thread)
+#else
+# define SHRIKE_THREAD_LOCAL __thread
+#endif
+
+bool shrike_trace_on = false;
+
+namespace {
+
+struct TraceEvent {
+  const char* name;
+  ShTimerNs start;
+  ShTimerNs end;
+};
+
+/** Zones recorded by one thread.
+ * Only the owning thread writes.  It fills in an event before bumping
+ * count, so a reader that sees count can read every event below it.
+ * Once full, further zones are counted in dropped and forgotten.
+ */
+struct TraceBuffer {
+  enum { CAPACITY = 1 << 16 };
+
+  TraceEvent events[CAPACITY];
+  volatile long count;
+  long dropped;
+  long tid;
+  TraceBuffer* next;
+};
+
+// Every thread's buffer, newest first.  Buffers are never freed so
+// that zones of threads that have finished can still be saved.
+TraceBuffer* volatile s_buffers = 0;
+volatile long s_thread_count = 0;
+ShTimerNs s_epoch = 0;
+
+SHRIKE_THREAD_LOCAL TraceBuffer* t_buffer = 0;
+
+#ifdef WIN32
+inline void memory_barrier() { MemoryBarrier(); }
+inline long atomic_increment(volatile long* value) { return InterlockedIncrement(value); }
+inline bool atomic_swap(TraceBuffer* volatile* p, TraceBuffer* expected, TraceBuffer* desired)
+{
+  return InterlockedCompareExchangePointer(reinterpret_cast<PVOID volatile*>(p),
+                                           desired, expected) == expected;
+}
+#else
+inline void memory_barrier() { __sync_synchronize(); }
+inline long atomic_increment(volatile long* value) { return __sync_add_and_fetch(value, 1); }
+inline bool atomic_swap(TraceBuffer* volatile* p, TraceBuffer* expected, TraceBuffer* desired)
+{
+  return __sync_bool_compare_and_swap(p, expected, desired);
+}
+#endif
+
+TraceBuffer* thread_buffer()
+{
+  if (t_buffer) return t_buffer;
+
+  TraceBuffer* buffer = new TraceBuffer();
+  buffer->count = 0;
+  buffer->dropped = 0;
+  buffer->tid = atomic_increment(&s_thread_count);
+  do {
+    buffer->next = s_buffers;
+  } while (!atomic_swap(&s_buffers, buffer->next, buffer));
+
+  t_buffer = buffer;
+  return buffer;
+}
+
+void write_string(std::ostream& out, const char* s)
+{
+  out << '"';
+  for (; *s; ++s) {
+    if (*s == '"' || *s == '\\') out << '\\';
+    out << *s;
+  }
+  out << '"';
+}
+
+// microseconds since the epoch, as chrome://tracing wants them
+double trace_us(ShTimerNs ns)
+{
+  return (ns - s_epoch) / 1000.0;
+}
+
+}
+
+void trace_enable(bool enable)
+{
+  if (enable && !s_epoch) s_epoch = ShTimer::now().ns();
+  shrike_trace_on = enable;
+}
+
+bool trace_enabled()
+{
+  return shrike_trace_on;
+}
+
+void trace_record(const char* name, ShTimerNs start, ShTimerNs end)
+{
+  TraceBuffer* buffer = thread_buffer();
+  if (buffer->count >= TraceBuffer::CAPACITY) {
+    ++buffer->dropped;
+    return;
+  }
+
+  TraceEvent& event = buffer->events[buffer->count];
+  event.name = name;
+  event.start = start;
+  event.end = end;
+  memory_barrier();
+  buffer->count = buffer->count + 1;
+}
+
+bool trace_save(const std::string& filename)
+{
+  std::ofstream out(filename.c_str());
+  if (!out) return false;
+
+  out << std::fixed << std::setprecision(3);
+  out << "{\"traceEvents\":[";
+  bool first = true;
+  for (TraceBuffer* buffer = s_buffers; buffer; buffer = buffer->next) {
+    long count = buffer->count;
+    memory_barrier();
+    for (long i = 0; i < count; ++i) {
+      const TraceEvent& event = buffer->events[i];
+      out << (first ? "\n" : ",\n") << "{\"name\":";
+      write_string(out, event.name);
+      out << ",\"ph\":\"X\",\"pid\":1,\"tid\":" << buffer->tid
+          << ",\"ts\":" << trace_us(event.start)
+          << ",\"dur\":" << (event.end - event.start) / 1000.0 << "}";
+      first = false;
+    }
+    if (buffer->dropped) {
+      out << (first ? "\n" : ",\n") << "{\"name\":\"dropped zones\",\"ph\":\"C\",\"pid\":1"
+          << ",\"tid\":" << buffer->tid << ",\"ts\":0"
+          << ",\"args\":{\"count\":" << buffer->dropped << "}}";
+      first = false;
+    }
+  }
+  out << "\n],\"displayTimeUnit\":\"ms\"}\n";
+  return out.good();
+}
@@ -0,0 +1,83 @@
+// Sh: A GPU metaprogramming language.
+//
+// Copyright 2003-2005 Serious Hack Inc.
+// 
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, 
+// MA  02110-1301, USA
+//////////////////////////////////////////////////////////////////////////////
+#ifndef TRACE_HPP
+#define TRACE_HPP
+
+#include <string>
+#include "Timer.hpp"
+
+/** Scoped trace zone.
+ * Records the time between its construction and destruction under
+ * name, which must stay valid until the trace is saved (use a string
+ * literal).  Each thread records into a buffer of its own without
+ * taking any locks.  Nothing is recorded until trace_enable() is
+ * called, and until then a zone costs one test of a flag.
+ *
+ * Use it through SHRIKE_TRACE_ZONE:
+ *
+ *   void Project::load_shaders()
+ *   {
+ *     SHRIKE_TRACE_ZONE("Project::load_shaders");
+ *     ...
+ */
+class TraceZone {
+public:
+  explicit TraceZone(const char* name);
+  ~TraceZone();
+
+private:
+  const char* m_name;
+  ShTimerNs m_start; // -1 when not recording
+
+  // NOT IMPLEMENTED
+  TraceZone(const TraceZone& other);
+  TraceZone& operator=(const TraceZone& other);
+};
+
+#define SHRIKE_TRACE_CONCAT_(a, b) a ## b
+#define SHRIKE_TRACE_CONCAT(a, b) SHRIKE_TRACE_CONCAT_(a, b)
+#define SHRIKE_TRACE_ZONE(name) \
+  TraceZone SHRIKE_TRACE_CONCAT(shrike_trace_zone_, __LINE__)(name)
+
+/// Start or stop recording zones.
+void trace_enable(bool enable);
+bool trace_enabled();
+
+/// Write everything recorded so far in the Chrome trace event format,
+/// for chrome://tracing.  Returns false if the file can't be written.
+bool trace_save(const std::string& filename);
+
+/// Record a zone by hand.  Times are from ShTimer::now().
+void trace_record(const char* name, ShTimerNs start, ShTimerNs end);
+
+extern bool shrike_trace_on;
+
+inline TraceZone::TraceZone(const char* name)
+  : m_name(name),
+    m_start(shrike_trace_on ? ShTimer::now().ns() : -1)
+{
+}
+
+inline TraceZone::~TraceZone()
+{
+  if (m_start >= 0) trace_record(m_name, m_start, ShTimer::now().ns());
+}
+
+#endif
@@ -0,0 +1,78 @@
+// Sh: A GPU metaprogramming language.
+//
+// Copyright 2003-2005 Serious Hack Inc.
+// 
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, 
+// MA  02110-1301, USA
+//////////////////////////////////////////////////////////////////////////////
+#include <algorithm>
+#include "UniformBatch.hpp"
+
+UniformBatch::UniformBatch()
+{
+}
+
+UniformBatch& UniformBatch::instance()
+{
+  static UniformBatch batch;
+  return batch;
+}
+
+void UniformBatch::set(SH::ShMatrix4x4f& matrix, const float values[16])
+{
+  for (int r = 0; r < 4; ++r) set(matrix[r], values + r*4);
+}
+
+void UniformBatch::stage(void* var, int size, const float values[], AssignFunc assign)
+{
+  ++m_current.staged;
+
+  // There are only a handful, so a linear search beats anything smarter
+  std::vector<Entry>::iterator I;
+  for (I = m_entries.begin(); I != m_entries.end() && I->var != var; ++I) ;
+  if (I == m_entries.end()) {
+    Entry entry;
+    entry.var = var;
+    entry.size = std::min(size, 4);
+    entry.assign = assign;
+    entry.dirty = false;
+    entry.assigned = false;
+    I = m_entries.insert(m_entries.end(), entry);
+  }
+  std::copy(values, values + I->size, I->staged);
+  I->dirty = true;
+}
+
+void UniformBatch::flush()
+{
+  for (std::vector<Entry>::iterator I = m_entries.begin(); I != m_entries.end(); ++I) {
+    if (!I->dirty) continue;
+    I->dirty = false;
+    if (I->assigned && std::equal(I->staged, I->staged + I->size, I->flushed)) {
+      ++m_current.skipped;
+      continue;
+    }
+    I->assign(I->var, I->staged);
+    std::copy(I->staged, I->staged + I->size, I->flushed);
+    I->assigned = true;
+    ++m_current.assigned;
+  }
+}
+
+void UniformBatch::end_frame()
+{
+  m_frame = m_current;
+  m_current = Counters();
+}
@@ -0,0 +1,104 @@
+// Sh: A GPU metaprogramming language.
+//
+// Copyright 2003-2005 Serious Hack Inc.
+// 
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, 
+// MA  02110-1301, USA
+//////////////////////////////////////////////////////////////////////////////
+#ifndef UNIFORMBATCH_HPP
+#define UNIFORMBATCH_HPP
+
+#include <vector>
+#include <sh/sh.hpp>
+
+/** Collects the per-frame uniform changes (the view matrices and the
+ * light in Globals) and hands them to Sh once per frame.
+ *
+ * Every assignment to a uniform makes Sh update each bound program
+ * that uses it, and the view gets set up on every mouse event.  set()
+ * only copies the new values and marks the uniform dirty; flush(),
+ * called just before drawing, assigns the uniforms whose values
+ * actually changed since the last flush, one setValues() each.
+ *
+ * The batch also counts the uniform traffic of each frame, including
+ * local parameters uploaded for cached programs (see upload()).
+ */
+class UniformBatch {
+public:
+  static UniformBatch& instance();
+
+  /// Stage new values for var.  var has to outlive the batch.
+  template<int N>
+  void set(SH::ShGeneric<N, float>& var, const float values[])
+  {
+    stage(&var, N, values, &assign<N>);
+  }
+
+  /// Stage a 4x4 matrix, given row by row.
+  void set(SH::ShMatrix4x4f& matrix, const float values[16]);
+
+  /// Assign everything that changed.
+  void flush();
+
+  /// Count a uniform upload made some other way.
+  void upload() { ++m_current.uploads; }
+
+  struct Counters {
+    Counters() : staged(0), assigned(0), skipped(0), uploads(0) {}
+
+    unsigned long staged; // set() calls
+    unsigned long assigned; // uniforms assigned by flush()
+    unsigned long skipped; // dirty uniforms that hadn't changed
+    unsigned long uploads; // see upload()
+  };
+
+  /// Finish counting a frame.
+  void end_frame();
+  /// The counters of the last finished frame.
+  const Counters& frame() const { return m_frame; }
+
+private:
+  UniformBatch();
+
+  typedef void (*AssignFunc)(void* var, const float values[]);
+
+  template<int N>
+  static void assign(void* var, const float values[])
+  {
+    static_cast<SH::ShGeneric<N, float>*>(var)->setValues(values);
+  }
+
+  void stage(void* var, int size, const float values[], AssignFunc assign);
+
+  struct Entry {
+    void* var;
+    int size;
+    AssignFunc assign;
+    bool dirty;
+    bool assigned; // whether flushed holds anything yet
+    float staged[4];
+    float flushed[4];
+  };
+
+  std::vector<Entry> m_entries;
+  Counters m_current;
+  Counters m_frame;
+
+  // NOT IMPLEMENTED
+  UniformBatch(const UniformBatch&);
+  UniformBatch& operator=(const UniformBatch&);
+};
+
+#endif
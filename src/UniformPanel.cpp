@@ -28,6 +28,7 @@
 #include <wx/event.h>
 #include <wx/image.h>
 #include "ShrikeCanvas.hpp"
+#include "Animation.hpp"
 #include "ShrikeFrame.hpp"
 
 // Defined on apple
@@ -84,7 +85,10 @@ private:
   {
     T value = event.GetPosition()/m_scale;
     m_var->setVariant(new ShDataVariant<T, SH_HOST>(1, value),m_index);
-    ShrikeCanvas::instance()->render();
+    // An animation carries on from where the slider was dragged to.
+    AnimationTrack* track = Animator::instance()->find(m_var);
+    if (track) track->reload();
+    ShrikeCanvas::instance()->invalidate();
   }
   T m_scale;
   DECLARE_EVENT_TABLE()
@@ -115,144 +119,79 @@ BEGIN_TEMPLATE_EVENT_TABLE(FloatSlider, Slider)
   EVT_SCROLL(FloatSlider::on_scroll)
 END_EVENT_TABLE()
 
-class UniformTimer : public wxTimer {
+class AnimControl : public wxPanel, public AnimationObserver {
 public:
-  
-  static UniformTimer* instance();
-
-  void clear();
-  void add(const ShVariableNodePtr& var, float step,
-           Slider* slider);
-  void remove(const ShVariableNodePtr& var);
-
-  void Notify();
-
-  struct VarAnim {
-    VarAnim(const ShVariableNodePtr& var, float step,
-            Slider* slider)
-      : var(var), step(step), slider(slider)
-    {
-    }
-    ShVariableNodePtr var;
-    float step;
-    Slider* slider;
-  };
-  
-private:
-  static UniformTimer* m_instance;
-
-  typedef std::list<VarAnim> VarAnimList;
-  
-  VarAnimList m_vars;
-  
-  UniformTimer();
-  ~UniformTimer();
-
-  // NOT IMPLEMENTED
-  UniformTimer(const UniformTimer& other);
-  UniformTimer& operator=(const UniformTimer& other);
-};
-UniformTimer* UniformTimer::m_instance = 0;
-
-UniformTimer* UniformTimer::instance()
-{
-  if (!m_instance) m_instance = new UniformTimer();
-  return m_instance;
-}
-
-UniformTimer::UniformTimer()
-{
-}
-
-UniformTimer::~UniformTimer()
-{
-}
-
-void UniformTimer::clear()
-{
-  m_vars.clear();
-  Stop();
-}
-
-void UniformTimer::add(const ShVariableNodePtr& var,
-                       float step, Slider* slider)
-{
-  m_vars.push_back(VarAnim(var, step, slider));
-  if (m_vars.size() == 1) Start(50);
-}
+  AnimControl(wxWindow* parent,
+              const ShVariableNodePtr& node)
+    : wxPanel(parent, -1),
+      m_node(node),
+      m_slider(0)
+  {
+    m_check = new wxCheckBox(this, -1, wxConvLibc.cMB2WX(node->name().c_str()));
+    wxString modes[] = {wxT("Loop"), wxT("Ping-pong"), wxT("Once"), wxT("Keys")};
+    m_mode = new wxChoice(this, -1, wxDefaultPosition, wxDefaultSize, 4, modes);
+    m_mode->SetSelection(ANIMATION_LOOP);
+    m_key = new wxButton(this, -1, wxT("Key"), wxDefaultPosition, wxDefaultSize,
+                         wxBU_EXACTFIT);
+    m_key->SetToolTip(wxT("Add the current value as the next key"));
+    m_key->Enable(false);
+    m_clear = new wxButton(this, -1, wxT("Clear"), wxDefaultPosition, wxDefaultSize,
+                           wxBU_EXACTFIT);
+    m_clear->SetToolTip(wxT("Clear the keys"));
+    m_clear->Enable(false);
+
+    wxBoxSizer* sizer = new wxBoxSizer(wxHORIZONTAL);
+    sizer->Add(m_check, 1, wxALIGN_CENTER_VERTICAL);
+    sizer->Add(m_mode, 0, wxLEFT, 3);
+    sizer->Add(m_key, 0, wxLEFT, 3);
+    sizer->Add(m_clear, 0, wxLEFT, 3);
+    SetSizer(sizer);
+    sizer->SetSizeHints(this);
+
+    Animator::instance()->track(m_node)->observer(this);
+  }
 
-bool uniform_var_equal(UniformTimer::VarAnim va,
-                       ShVariableNodePtr var)
-{
-  return va.var == var;
-}
+  ~AnimControl()
+  {
+    AnimationTrack* track = Animator::instance()->find(m_node);
+    if (track) track->observer(0);
+  }
 
-void UniformTimer::remove(const ShVariableNodePtr& var)
-{
-  m_vars.remove_if(std::bind2nd(std::ptr_fun(uniform_var_equal), var));
-  if (m_vars.empty()) Stop();
-}
+  void slider(Slider* s) { m_slider = s; }
 
-void UniformTimer::Notify()
-{
-  for (VarAnimList::iterator I = m_vars.begin(); I != m_vars.end(); ++I) {
-    ShVariableNodePtr var = I->var;
-
-    Slider* slider = I->slider;
-    for (int i = 0; i < var->size(); i++) {
-      float val = (*variant_convert<float, SH_HOST>(var->getVariant()))[i];
-      float low = (*variant_convert<float, SH_HOST>(var->lowBoundVariant()))[i];
-      float high = (*variant_convert<float, SH_HOST>(var->highBoundVariant()))[i];
-      val = std::fmod((val + I->step) - low, high - low) + low; 
-      var->setVariant(new ShDataVariant<float, SH_HOST>(1, val), i);
-  
-      if (slider) {
-        slider->set_value();
-        slider = slider->next();
-      }
+  void animated()
+  {
+    for (Slider* slider = m_slider; slider; slider = slider->next()) {
+      slider->set_value();
     }
   }
 
-  wxStopWatch watch;
-  ShrikeCanvas::instance()->render();
-  long delta = watch.Time();
-  long interval = GetInterval();
-  if (delta > interval) {
-    Stop();
-    Start(delta + 10);
-  } else if (delta < interval - 50) {
-    Stop();
-    Start(std::min(delta, 50L));
-  }
-}
-
-class AnimCheckBox : public wxCheckBox {
-public:
-  AnimCheckBox(wxWindow* parent,
-               const ShVariableNodePtr& node)
-    : wxCheckBox(parent, -1, wxConvLibc.cMB2WX(node->name().c_str())),
-      m_node(node),
-      m_slider(0)
+  void check(wxCommandEvent& event)
   {
+    Animator::instance()->track(m_node)->enabled(event.IsChecked());
+    Animator::instance()->update();
   }
 
-  ~AnimCheckBox()
+  void choose(wxCommandEvent& event)
   {
+    AnimationMode mode = (AnimationMode)m_mode->GetSelection();
+    Animator::instance()->track(m_node)->mode(mode);
+    m_key->Enable(mode == ANIMATION_KEYFRAMES);
+    m_clear->Enable(mode == ANIMATION_KEYFRAMES);
   }
 
-  void slider(Slider* s) { m_slider = s; }
-  
-  void check(wxCommandEvent& event)
+  /// Add a key, or with the Clear button drop them all.
+  void key(wxCommandEvent& event)
   {
-    if (event.IsChecked()) {
-      float high = (*variant_convert<float, SH_HOST>(m_node->highBoundVariant()))[0];
-      float low = (*variant_convert<float, SH_HOST>(m_node->lowBoundVariant()))[0];
-      UniformTimer::instance()->add(m_node,
-                                    (high - low)/80.0f,
-                                    m_slider);
+    AnimationTrack* track = Animator::instance()->track(m_node);
+    if (event.GetEventObject() == m_clear) {
+      track->clear_keys();
+      m_key->SetLabel(wxT("Key"));
     } else {
-      UniformTimer::instance()->remove(m_node);
+      track->add_key();
+      m_key->SetLabel(wxString::Format(wxT("Key (%d)"), (int)track->key_count()));
     }
+    GetSizer()->Layout();
   }
 
 private:
@@ -261,10 +200,16 @@ private:
     
   ShVariableNodePtr m_node;
   Slider* m_slider;
+  wxCheckBox* m_check;
+  wxChoice* m_mode;
+  wxButton* m_key;
+  wxButton* m_clear;
 };
 
-BEGIN_EVENT_TABLE(AnimCheckBox, wxCheckBox)
-  EVT_CHECKBOX(-1, AnimCheckBox::check)
+BEGIN_EVENT_TABLE(AnimControl, wxPanel)
+  EVT_CHECKBOX(-1, AnimControl::check)
+  EVT_CHOICE(-1, AnimControl::choose)
+  EVT_BUTTON(-1, AnimControl::key)
 END_EVENT_TABLE()
 
 class TextureButton : public wxBitmapButton {
@@ -296,7 +241,7 @@ public:
         m_node->setTexSize(img.width(), img.height());
       }
       shUpdate();
-      ShrikeCanvas::instance()->render();
+      ShrikeCanvas::instance()->invalidate();
       relabel();
     }
   }
@@ -422,8 +367,11 @@ public:
       m_node->setVariant(new ShDataVariant<float, SH_HOST>(1, (float)c.Green()/255.0f), 1);
       m_node->setVariant(new ShDataVariant<float, SH_HOST>(1, (float)c.Blue()/255.0f), 2);
       set_colour(c);
+
+      AnimationTrack* track = Animator::instance()->find(m_node);
+      if (track) track->reload();
       
-      ShrikeCanvas::instance()->render();
+      ShrikeCanvas::instance()->invalidate();
     }
   }
   
@@ -507,10 +455,10 @@ END_EVENT_TABLE()
 
 void add_var(const ShVariableNodePtr& var, CollapsePanel* panel, CollapsePanel* anim)
 {
-  AnimCheckBox* cb = 0;
+  AnimControl* cb = 0;
   if (!var->evaluator()) {
-    cb = new AnimCheckBox(anim->window(), var);
-    anim->sizer()->Add(cb, 0);
+    cb = new AnimControl(anim->window(), var);
+    anim->sizer()->Add(cb, 0, wxEXPAND);
   }
 
   wxSizer* vsizer = new wxBoxSizer(wxVERTICAL);
@@ -526,7 +474,7 @@ void add_var(const ShVariableNodePtr& var, CollapsePanel* panel, CollapsePanel*
     else {
       continue;
     }
-    if (i == 0) cb->slider(slider);
+    if (i == 0 && cb) cb->slider(slider);
     vsizer->Add(slider, 0, wxEXPAND);
     if (last) last->next(slider);
     last = slider;
@@ -542,10 +490,10 @@ void add_dep(const ShVariableNodePtr& var, CollapsePanel* panel)
 
 void add_color(const ShVariableNodePtr& var, CollapsePanel* panel, CollapsePanel* anim)
 {
-  AnimCheckBox* cb = 0;
+  AnimControl* cb = 0;
   if (!var->evaluator()) {
-    cb = new AnimCheckBox(anim->window(), var);
-    anim->sizer()->Add(cb, 0);
+    cb = new AnimControl(anim->window(), var);
+    anim->sizer()->Add(cb, 0, wxEXPAND);
   }
 
   wxBoxSizer* hsizer = new wxBoxSizer(wxHORIZONTAL);
@@ -581,11 +529,11 @@ void add_texture(const ShTextureNodePtr& tex, CollapsePanel* panel)
 
 void UniformPanel::setShader(Shader* shader)
 {
+  Animator::instance()->clear();
+
   DestroyChildren();
   m_vars.clear();
 
-  UniformTimer::instance()->clear();
-
   wxBoxSizer* sizer = new wxBoxSizer(wxVERTICAL);
   wxBoxSizer* attrib_sizer = new wxBoxSizer(wxVERTICAL);
 
@@ -598,40 +546,10 @@ void UniformPanel::setShader(Shader* shader)
   CollapsePanel *anim_panel = 0;
 
   if (shader) {
+    std::list<ShVariableNodePtr> vars;
     int p = 0;
     for (ShProgram prg = shader->vertex(); p < 2; prg = shader->fragment(), p++) {
-
-      for (ShProgramNode::VarList::const_iterator I = prg.begin_all_parameters(); 
-           I != prg.end_all_parameters(); ++I) {
-
-        const ShVariableNodePtr& var = *I;
-
-        if (var->kind() != SH_TEMP) continue;
-        if (var->internal()) continue;
-        if (!var->has_name()) continue;
-
-        if (std::find(m_vars.begin(), m_vars.end(), var) != m_vars.end()) continue;
-        m_vars.push_back(var);
-
-        if (var->evaluator()) { 
-          if (!dep_panel) dep_panel = new CollapsePanel(this, wxT("Dependent Uniforms"));
-          add_dep(var, dep_panel);
-        }
-        else if (var->specialType() == SH_COLOR
-          && (*variant_convert<float, SH_HOST>(var->lowBoundVariant()))[0] == 0.0
-          && (*variant_convert<float, SH_HOST>(var->highBoundVariant()))[0] == 1.0) {
-
-          if (!col_panel) col_panel = new CollapsePanel(this, wxT("Colors"));
-          if (!anim_panel) anim_panel = new CollapsePanel(this, wxT("Animation")); 
-          add_color(var, col_panel, anim_panel);
-        }
-        else {
-          if (!anim_panel) anim_panel = new CollapsePanel(this, wxT("Animation")); 
-          CollapsePanel *panel = new CollapsePanel(this, wxConvLibc.cMB2WX(var->name().c_str()));
-          attrib_sizer->Add(panel, 0, wxEXPAND|wxBOTTOM, spacing);
-          add_var(var, panel, anim_panel);
-        }
-      }
+      vars.insert(vars.end(), prg.begin_all_parameters(), prg.end_all_parameters());
       for (ShProgramNode::PaletteList::const_iterator I = prg.begin_palettes(); I != prg.end_palettes(); ++I) {
         if (!pal_panel) pal_panel = new CollapsePanel(this, wxT("Palettes"));
         add_palette(*I, pal_panel);
@@ -665,6 +583,37 @@ void UniformPanel::setShader(Shader* shader)
         add_texture(*I, tex_panel);
       }
     }
+    vars.insert(vars.end(), shader->beginHostUniforms(), shader->endHostUniforms());
+
+    for (std::list<ShVariableNodePtr>::const_iterator I = vars.begin(); I != vars.end(); ++I) {
+      const ShVariableNodePtr& var = *I;
+
+      if (var->kind() != SH_TEMP) continue;
+      if (var->internal()) continue;
+      if (!var->has_name()) continue;
+
+      if (std::find(m_vars.begin(), m_vars.end(), var) != m_vars.end()) continue;
+      m_vars.push_back(var);
+
+      if (var->evaluator()) { 
+        if (!dep_panel) dep_panel = new CollapsePanel(this, wxT("Dependent Uniforms"));
+        add_dep(var, dep_panel);
+      }
+      else if (var->specialType() == SH_COLOR
+        && (*variant_convert<float, SH_HOST>(var->lowBoundVariant()))[0] == 0.0
+        && (*variant_convert<float, SH_HOST>(var->highBoundVariant()))[0] == 1.0) {
+
+        if (!col_panel) col_panel = new CollapsePanel(this, wxT("Colors"));
+        if (!anim_panel) anim_panel = new CollapsePanel(this, wxT("Animation")); 
+        add_color(var, col_panel, anim_panel);
+      }
+      else {
+        if (!anim_panel) anim_panel = new CollapsePanel(this, wxT("Animation")); 
+        CollapsePanel *panel = new CollapsePanel(this, wxConvLibc.cMB2WX(var->name().c_str()));
+        attrib_sizer->Add(panel, 0, wxEXPAND|wxBOTTOM, spacing);
+        add_var(var, panel, anim_panel);
+      }
+    }
   }
 
   sizer->Add(attrib_sizer, 0, wxEXPAND);
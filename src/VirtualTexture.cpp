@@ -0,0 +1,546 @@
+// Sh: A GPU metaprogramming language.
+//
+// Copyright 2003-2005 Serious Hack Inc.
+// 
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, 
+// MA  02110-1301, USA
+//////////////////////////////////////////////////////////////////////////////
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <deque>
+#include <set>
+#ifdef WIN32
+#include <windows.h>
+#else
+#include <pthread.h>
+#endif
+#include "VirtualTexture.hpp"
+#include "ShrikeGl.hpp"
+#include "Trace.hpp"
+
+using namespace SH;
+
+namespace {
+
+struct TileKey {
+  TileKey(int level, int x, int y) : level(level), x(x), y(y) {}
+
+  bool operator<(const TileKey& other) const
+  {
+    if (level != other.level) return level < other.level;
+    if (y != other.y) return y < other.y;
+    return x < other.x;
+  }
+
+  int level, x, y;
+};
+
+/// Coarse levels first: they stand in for everything under them.
+bool coarser(const TileKey& a, const TileKey& b)
+{
+  return b.level < a.level || (a.level == b.level && a < b);
+}
+
+struct LoadedTile {
+  LoadedTile(const TileKey& key) : key(key), ok(false) {}
+
+  TileKey key;
+  std::vector<unsigned char> texels;
+  bool ok;
+};
+
+const int loader_threads = 2; // the work is reading the file
+const int requests_per_frame = 64;
+const int max_cache_size = 4096; // texels on a side of the cache texture
+
+}
+
+/** Reads tiles on threads of its own.  The queue holds what the last
+ * feedback asked for; a new request replaces it, so tiles the view
+ * has moved away from are dropped unread.
+ */
+class TileLoader {
+public:
+  TileLoader(const TiledTexture& file)
+    : m_file(file), m_stop(false)
+  {
+#ifdef WIN32
+    InitializeCriticalSection(&m_lock);
+    m_wake = CreateEvent(0, FALSE, FALSE, 0);
+    for (int i = 0; i < loader_threads; ++i) {
+      HANDLE thread = CreateThread(0, 0, run, this, 0, 0);
+      if (thread) m_threads.push_back(thread);
+    }
+#else
+    pthread_mutex_init(&m_lock, 0);
+    pthread_cond_init(&m_wake, 0);
+    for (int i = 0; i < loader_threads; ++i) {
+      pthread_t thread;
+      if (pthread_create(&thread, 0, run, this) == 0) m_threads.push_back(thread);
+    }
+#endif
+  }
+
+  ~TileLoader()
+  {
+    lock();
+    m_stop = true;
+    m_queue.clear();
+    wake_all();
+    unlock();
+#ifdef WIN32
+    if (!m_threads.empty()) {
+      WaitForMultipleObjects(m_threads.size(), &m_threads[0], TRUE, INFINITE);
+    }
+    for (std::size_t i = 0; i < m_threads.size(); ++i) CloseHandle(m_threads[i]);
+    CloseHandle(m_wake);
+    DeleteCriticalSection(&m_lock);
+#else
+    for (std::size_t i = 0; i < m_threads.size(); ++i) pthread_join(m_threads[i], 0);
+    pthread_cond_destroy(&m_wake);
+    pthread_mutex_destroy(&m_lock);
+#endif
+    for (std::size_t i = 0; i < m_done.size(); ++i) delete m_done[i];
+  }
+
+  /// Queue keys in place of whatever was waiting.  Tiles being read or
+  /// read and not yet taken aren't asked for twice.
+  void request(const std::vector<TileKey>& keys)
+  {
+    lock();
+    m_queue.clear();
+    for (std::size_t i = 0; i < keys.size(); ++i) {
+      if (!m_busy.count(keys[i])) m_queue.push_back(keys[i]);
+    }
+    if (!m_queue.empty()) wake_all();
+    unlock();
+  }
+
+  /// Hand over the tiles read since the last take().
+  void take(std::vector<LoadedTile*>& tiles)
+  {
+    lock();
+    tiles.swap(m_done);
+    m_done.clear();
+    for (std::size_t i = 0; i < tiles.size(); ++i) m_busy.erase(tiles[i]->key);
+    unlock();
+  }
+
+private:
+  void work()
+  {
+    lock();
+    for (;;) {
+      while (!m_stop && m_queue.empty()) wait();
+      if (m_stop) break;
+      LoadedTile* tile = new LoadedTile(m_queue.front());
+      m_queue.pop_front();
+      m_busy.insert(tile->key);
+      unlock();
+
+      {
+        SHRIKE_TRACE_ZONE("TileLoader read");
+        tile->texels.resize(m_file.tile_bytes());
+        tile->ok = m_file.read_tile(tile->key.level, tile->key.x, tile->key.y,
+                                    &tile->texels[0]);
+      }
+
+      lock();
+      m_done.push_back(tile);
+    }
+    unlock();
+  }
+
+#ifdef WIN32
+  static DWORD WINAPI run(LPVOID loader)
+  {
+    static_cast<TileLoader*>(loader)->work();
+    return 0;
+  }
+  void lock() { EnterCriticalSection(&m_lock); }
+  void unlock() { LeaveCriticalSection(&m_lock); }
+  void wait()
+  {
+    // an auto reset event wakes one waiter; it passes the wake on if
+    // there is more to do
+    unlock();
+    WaitForSingleObject(m_wake, INFINITE);
+    lock();
+    if (m_stop || m_queue.size() > 1) SetEvent(m_wake);
+  }
+  void wake_all() { SetEvent(m_wake); }
+#else
+  static void* run(void* loader)
+  {
+    static_cast<TileLoader*>(loader)->work();
+    return 0;
+  }
+  void lock() { pthread_mutex_lock(&m_lock); }
+  void unlock() { pthread_mutex_unlock(&m_lock); }
+  void wait() { pthread_cond_wait(&m_wake, &m_lock); }
+  void wake_all() { pthread_cond_broadcast(&m_wake); }
+#endif
+
+  const TiledTexture& m_file;
+  bool m_stop;
+  std::deque<TileKey> m_queue;
+  std::set<TileKey> m_busy; // being read, or read and not taken
+  std::vector<LoadedTile*> m_done;
+
+#ifdef WIN32
+  CRITICAL_SECTION m_lock;
+  HANDLE m_wake;
+  std::vector<HANDLE> m_threads;
+#else
+  pthread_mutex_t m_lock;
+  pthread_cond_t m_wake;
+  std::vector<pthread_t> m_threads;
+#endif
+
+  // NOT IMPLEMENTED
+  TileLoader(const TileLoader& other);
+  TileLoader& operator=(const TileLoader& other);
+};
+
+VirtualTexture::VirtualTexture()
+  : m_loader(0), m_slots_x(0), m_slots_y(0), m_frame(0),
+    m_cache_dirty(false), m_pages_dirty(false), m_feedback_scale(8)
+{
+}
+
+VirtualTexture::~VirtualTexture()
+{
+  close();
+}
+
+bool VirtualTexture::open(const std::string& path, int cache_tiles, std::string& error)
+{
+  close();
+  if (!m_file.open(path)) {
+    error = m_file.error();
+    return false;
+  }
+
+  // The slots in a grid as near square as fits; at least two, so
+  // there is room for something besides the smallest level
+  int stored = m_file.stored_size();
+  int most = max_cache_size/stored;
+  m_slots_x = std::min(most, std::max(1, (int)std::ceil(std::sqrt((double)cache_tiles))));
+  m_slots_y = std::min(most, std::max(1, (cache_tiles + m_slots_x - 1)/m_slots_x));
+  if (m_slots_x*m_slots_y < 2) m_slots_x = 2;
+  m_slots.assign(m_slots_x*m_slots_y, Slot());
+
+  int levels = m_file.levels();
+  m_resident.resize(levels);
+  for (int l = 0; l < levels; ++l) {
+    m_resident[l].assign(m_file.tiles_x(l)*m_file.tiles_y(l), -1);
+  }
+  m_wanted.assign(m_file.tiles_x(0)*m_file.tiles_y(0), levels - 1);
+
+  int cache_width = m_slots_x*stored, cache_height = m_slots_y*stored;
+  m_cache_memory = new ShHostMemory((std::size_t)cache_width*cache_height*4, SH_FUBYTE);
+  std::memset(m_cache_memory->hostStorage()->data(), 0, (std::size_t)cache_width*cache_height*4);
+  m_cache.size(cache_width, cache_height);
+  m_cache.memory(m_cache_memory);
+
+  m_page_memory = new ShHostMemory(m_wanted.size()*4*sizeof(float), SH_FLOAT);
+  m_pages.size(m_file.tiles_x(0), m_file.tiles_y(0));
+  m_pages.memory(m_page_memory);
+
+  // The smallest level is read now, and never evicted
+  std::vector<unsigned char> texels(m_file.tile_bytes());
+  if (!m_file.read_tile(levels - 1, 0, 0, &texels[0])) {
+    error = "Unable to read " + path;
+    close();
+    return false;
+  }
+  load(levels - 1, 0, 0, &texels[0]);
+  update_pages(0, 0, m_file.tiles_x(0), m_file.tiles_y(0));
+  update();
+
+  m_loader = new TileLoader(m_file);
+  return true;
+}
+
+ShColor4f VirtualTexture::lookup(const ShTexCoord2f& uv)
+{
+  ShConstAttrib2f size(m_file.width(), m_file.height());
+  ShConstAttrib2f tile_size(m_file.tile_size(), m_file.tile_size());
+  ShConstAttrib2f last_page(m_file.tiles_x(0) - 1, m_file.tiles_y(0) - 1);
+
+  ShAttrib2f texel = frac(uv)*size;
+  ShAttrib2f page = min(floor(texel/tile_size), last_page);
+  // where the tile's origin at its level is in the cache, and the
+  // scale from level 0 down to it
+  ShAttrib4f entry = m_pages[page + 0.5];
+  return m_cache[entry(0, 1) + texel*entry(2)];
+}
+
+ShColor3f VirtualTexture::feedback(const ShTexCoord2f& uv)
+{
+  // 12 bits for each of u and v: u's top 8, u's bottom 4 with v's top
+  // 4, v's bottom 8
+  ShAttrib2f q = floor(frac(uv)*4095.0 + 0.5);
+  ShAttrib2f high = floor(q/16.0);
+  ShAttrib2f low = q - high*16.0;
+  ShColor3f result;
+  result(0) = high(0)/255.0;
+  result(1) = (low(0)*16.0 + floor(q(1)/256.0))/255.0;
+  result(2) = (q(1) - floor(q(1)/256.0)*256.0)/255.0;
+  return result;
+}
+
+void VirtualTexture::begin_feedback()
+{
+  glPushAttrib(GL_VIEWPORT_BIT | GL_SCISSOR_BIT | GL_COLOR_BUFFER_BIT
+               | GL_DEPTH_BUFFER_BIT);
+  glGetIntegerv(GL_VIEWPORT, m_feedback_viewport);
+  int* v = m_feedback_viewport;
+  v[2] = std::max(1, v[2]/m_feedback_scale);
+  v[3] = std::max(1, v[3]/m_feedback_scale);
+  glViewport(v[0], v[1], v[2], v[3]);
+  glScissor(v[0], v[1], v[2], v[3]);
+  glEnable(GL_SCISSOR_TEST);
+  glDisable(GL_BLEND);
+  glEnable(GL_DEPTH_TEST);
+  glDepthMask(GL_TRUE);
+  glClearColor(0, 0, 0, 0);
+  glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+}
+
+void VirtualTexture::end_feedback()
+{
+  SHRIKE_TRACE_ZONE("VirtualTexture::end_feedback");
+  const int* v = m_feedback_viewport;
+  int w = v[2], h = v[3];
+  std::vector<unsigned char> colors(w*h*3);
+  std::vector<float> depths(w*h);
+  glPushClientAttrib(GL_CLIENT_PIXEL_STORE_BIT);
+  glPixelStorei(GL_PACK_ALIGNMENT, 1);
+  glReadPixels(v[0], v[1], w, h, GL_RGB, GL_UNSIGNED_BYTE, &colors[0]);
+  glReadPixels(v[0], v[1], w, h, GL_DEPTH_COMPONENT, GL_FLOAT, &depths[0]);
+  glPopClientAttrib();
+  glPopAttrib();
+
+  // put back what the corner had: the clear colour and depth
+  glPushAttrib(GL_SCISSOR_BIT);
+  glScissor(v[0], v[1], w, h);
+  glEnable(GL_SCISSOR_TEST);
+  glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+  glPopAttrib();
+
+  ++m_frame;
+  int levels = m_file.levels();
+  int pages_x = m_file.tiles_x(0), pages_y = m_file.tiles_y(0);
+  float width = m_file.width(), height = m_file.height();
+  // a level 0 texel per screen pixel wants level 0; the feedback's
+  // pixels each cover feedback_scale of them across
+  float bias = std::log((float)m_feedback_scale)/std::log(2.0f);
+
+  std::set<TileKey> seen;
+  int changed_x0 = pages_x, changed_y0 = pages_y, changed_x1 = 0, changed_y1 = 0;
+  std::vector<unsigned char> wanted(m_wanted.size(), levels);
+  for (int y = 0; y < h; ++y) {
+    for (int x = 0; x < w; ++x) {
+      int i = y*w + x;
+      if (depths[i] >= 1.0f) continue;
+      const unsigned char* c = &colors[3*i];
+      float u = ((c[0] << 4) | (c[1] >> 4))/4095.0f;
+      float t = (((c[1] & 15) << 8) | c[2])/4095.0f;
+
+      // texels of level 0 between here and the pixels around it
+      float footprint = -1;
+      static const int dx[4] = {1, -1, 0, 0}, dy[4] = {0, 0, 1, -1};
+      for (int n = 0; n < 4; ++n) {
+        int nx = x + dx[n], ny = y + dy[n];
+        if (nx < 0 || nx >= w || ny < 0 || ny >= h || depths[ny*w + nx] >= 1.0f) continue;
+        const unsigned char* d = &colors[3*(ny*w + nx)];
+        float du = ((d[0] << 4) | (d[1] >> 4))/4095.0f - u;
+        float dt = (((d[1] & 15) << 8) | d[2])/4095.0f - t;
+        // the short way round, where the texture repeats
+        du = (du - std::floor(du + 0.5f))*width;
+        dt = (dt - std::floor(dt + 0.5f))*height;
+        footprint = std::max(footprint, du*du + dt*dt);
+      }
+      // a pixel on its own says nothing about the level; the smallest
+      // one covers it
+      if (footprint < 0) continue;
+      int level = 0;
+      if (footprint > 0) {
+        level = (int)std::floor(0.5f*std::log(footprint)/std::log(2.0f) - bias);
+        level = std::max(0, std::min(level, levels - 1));
+      }
+
+      int px = std::min((int)(u*width/m_file.tile_size()), pages_x - 1);
+      int py = std::min((int)(t*height/m_file.tile_size()), pages_y - 1);
+      unsigned char& page = wanted[py*pages_x + px];
+      if (level < page) page = level;
+      seen.insert(TileKey(level, px >> level, py >> level));
+    }
+  }
+
+  for (int py = 0; py < pages_y; ++py) {
+    for (int px = 0; px < pages_x; ++px) {
+      int i = py*pages_x + px;
+      if (wanted[i] == levels || wanted[i] == m_wanted[i]) continue;
+      m_wanted[i] = wanted[i];
+      changed_x0 = std::min(changed_x0, px);
+      changed_y0 = std::min(changed_y0, py);
+      changed_x1 = std::max(changed_x1, px + 1);
+      changed_y1 = std::max(changed_y1, py + 1);
+    }
+  }
+  if (changed_x0 < changed_x1) update_pages(changed_x0, changed_y0, changed_x1, changed_y1);
+
+  // Keep what's in view, and the levels above it that stand in for
+  // it, from being evicted; ask for the rest
+  std::vector<TileKey> missing;
+  for (std::set<TileKey>::const_iterator I = seen.begin(); I != seen.end(); ++I) {
+    for (int l = I->level; l < levels; ++l) {
+      touch(l, I->x >> (l - I->level), I->y >> (l - I->level));
+    }
+    if (resident(I->level, I->x, I->y) < 0) missing.push_back(*I);
+  }
+  std::sort(missing.begin(), missing.end(), coarser);
+  if ((int)missing.size() > requests_per_frame) missing.erase(missing.begin() + requests_per_frame, missing.end());
+  m_loader->request(missing);
+}
+
+void VirtualTexture::update()
+{
+  SHRIKE_TRACE_ZONE("VirtualTexture::update");
+  if (m_loader) {
+    std::vector<LoadedTile*> tiles;
+    m_loader->take(tiles);
+    for (std::size_t i = 0; i < tiles.size(); ++i) {
+      const TileKey& key = tiles[i]->key;
+      if (tiles[i]->ok && resident(key.level, key.x, key.y) < 0) {
+        load(key.level, key.x, key.y, &tiles[i]->texels[0]);
+      }
+      delete tiles[i];
+    }
+  }
+
+  if (m_cache_dirty) m_cache_memory->hostStorage()->dirty();
+  if (m_pages_dirty) m_page_memory->hostStorage()->dirty();
+  m_cache_dirty = m_pages_dirty = false;
+}
+
+int VirtualTexture::resident_tiles() const
+{
+  int count = 0;
+  for (std::size_t i = 0; i < m_slots.size(); ++i) count += m_slots[i].level >= 0;
+  return count;
+}
+
+void VirtualTexture::close()
+{
+  delete m_loader;
+  m_loader = 0;
+  m_slots.clear();
+  m_resident.clear();
+  m_wanted.clear();
+  m_frame = 0;
+}
+
+int& VirtualTexture::resident(int level, int x, int y)
+{
+  return m_resident[level][y*m_file.tiles_x(level) + x];
+}
+
+void VirtualTexture::load(int level, int x, int y, const unsigned char* texels)
+{
+  // an empty slot, or else the one seen longest ago; never one in
+  // view now, or the smallest level
+  int slot = -1;
+  for (std::size_t i = 0; i < m_slots.size(); ++i) {
+    const Slot& s = m_slots[i];
+    if (s.level < 0) {
+      slot = i;
+      break;
+    }
+    if (s.level == m_file.levels() - 1 || s.used == m_frame) continue;
+    if (slot < 0 || s.used < m_slots[slot].used) slot = i;
+  }
+  if (slot < 0) return; // asked for again if it's still wanted
+  if (m_slots[slot].level >= 0) evict(slot);
+
+  int stored = m_file.stored_size();
+  int cache_width = m_slots_x*stored;
+  unsigned char* cache = static_cast<unsigned char*>(m_cache_memory->hostStorage()->data());
+  int left = (slot % m_slots_x)*stored, top = (slot/m_slots_x)*stored;
+  for (int j = 0; j < stored; ++j) {
+    std::memcpy(cache + ((std::size_t)(top + j)*cache_width + left)*4,
+                texels + (std::size_t)j*stored*4, stored*4);
+  }
+  m_cache_dirty = true;
+
+  Slot& s = m_slots[slot];
+  s.level = level;
+  s.x = x;
+  s.y = y;
+  s.used = m_frame;
+  resident(level, x, y) = slot;
+  update_footprint(level, x, y);
+}
+
+void VirtualTexture::evict(int slot)
+{
+  Slot& s = m_slots[slot];
+  resident(s.level, s.x, s.y) = -1;
+  update_footprint(s.level, s.x, s.y);
+  s.level = -1;
+}
+
+void VirtualTexture::touch(int level, int x, int y)
+{
+  int slot = resident(level, x, y);
+  if (slot >= 0) m_slots[slot].used = m_frame;
+}
+
+void VirtualTexture::update_footprint(int level, int x, int y)
+{
+  int pages_x = m_file.tiles_x(0), pages_y = m_file.tiles_y(0);
+  update_pages(std::min(x << level, pages_x), std::min(y << level, pages_y),
+               std::min((x + 1) << level, pages_x), std::min((y + 1) << level, pages_y));
+}
+
+void VirtualTexture::update_pages(int x0, int y0, int x1, int y1)
+{
+  int pages_x = m_file.tiles_x(0);
+  int stored = m_file.stored_size(), size = m_file.tile_size(), border = m_file.border();
+  float* pages = static_cast<float*>(m_page_memory->hostStorage()->data());
+  for (int py = y0; py < y1; ++py) {
+    for (int px = x0; px < x1; ++px) {
+      // the tile at the level this page is seen at, or failing that
+      // the nearest level above it that's loaded
+      int l = m_wanted[py*pages_x + px], slot = -1;
+      for (; l < m_file.levels(); ++l) {
+        slot = resident(l, px >> l, py >> l);
+        if (slot >= 0) break;
+      }
+      if (slot < 0) continue;
+      // A level 0 texel coordinate times entry[2] plus entry[0, 1] is
+      // the cache texel coordinate
+      float* entry = pages + 4*(py*pages_x + px);
+      entry[0] = (slot % m_slots_x)*stored + border - (px >> l)*size;
+      entry[1] = (slot/m_slots_x)*stored + border - (py >> l)*size;
+      entry[2] = 1.0f/(1 << l);
+      entry[3] = l;
+    }
+  }
+  m_pages_dirty = true;
+}
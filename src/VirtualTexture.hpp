@@ -0,0 +1,124 @@
+// Sh: A GPU metaprogramming language.
+//
+// Copyright 2003-2005 Serious Hack Inc.
+// 
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, 
+// MA  02110-1301, USA
+//////////////////////////////////////////////////////////////////////////////
+#ifndef VIRTUALTEXTURE_HPP
+#define VIRTUALTEXTURE_HPP
+
+#include <string>
+#include <vector>
+#include <sh/sh.hpp>
+#include "TiledTexture.hpp"
+
+class TileLoader;
+
+/** A texture far bigger than GPU memory, streamed a tile at a time
+ * from a TiledTexture.  Only the tiles a view needs are resident, in a
+ * cache texture of a fixed number of slots; a page table texture, one
+ * texel for each tile of level 0, says where in the cache to look for
+ * each part of the texture and at which level.  The smallest level,
+ * one tile for the whole texture, is always there, so anything not
+ * loaded yet shows at lower resolution rather than not at all.
+ *
+ * To find out which tiles a view needs, a shader renders a feedback
+ * pass each frame: a small copy of the view, between begin_feedback()
+ * and end_feedback(), with a fragment program writing feedback() of
+ * its texture coordinates.  end_feedback() reads it back, works out
+ * the level each part is seen at, and queues what's missing for the
+ * loader threads.  update() then puts what they have read into the
+ * cache, evicting the least recently seen tiles to make room.
+ *
+ * Sh isn't thread safe, so only the loader threads' file reads are off
+ * the calling thread; everything else, and every call, is on it.
+ */
+class VirtualTexture {
+public:
+  VirtualTexture();
+  ~VirtualTexture();
+
+  /// Open path, made by shtexconv --tiles, with room for cache_tiles
+  /// tiles on the GPU.  Returns false, with the reason in error, if
+  /// it can't be read.
+  bool open(const std::string& path, int cache_tiles, std::string& error);
+  bool is_open() const { return m_loader != 0; }
+
+  /// The texture at uv, repeating outside [0, 1].  For use inside a
+  /// fragment program.
+  SH::ShColor4f lookup(const SH::ShTexCoord2f& uv);
+
+  /// What the feedback pass's fragment program writes for uv.
+  SH::ShColor3f feedback(const SH::ShTexCoord2f& uv);
+
+  /// Draw the feedback pass, with the programs bound, between these.
+  /// It goes in a corner of the viewport 1/feedback_scale the size,
+  /// which end_feedback() clears again.
+  void begin_feedback();
+  void end_feedback();
+
+  /// Move tiles the loader has read into the cache and update the page
+  /// table.  Call once a frame, before binding the programs.
+  void update();
+
+  int feedback_scale() const { return m_feedback_scale; }
+  void feedback_scale(int scale) { m_feedback_scale = scale; }
+
+  int cache_tiles() const { return m_slots.size(); }
+  int resident_tiles() const;
+
+private:
+  struct Slot {
+    Slot() : level(-1), x(0), y(0), used(0) {}
+
+    int level, x, y; // level -1 if empty
+    unsigned long used; // frame last seen in the feedback
+  };
+
+  void close();
+  int& resident(int level, int x, int y);
+  void load(int level, int x, int y, const unsigned char* texels);
+  void evict(int slot);
+  void touch(int level, int x, int y);
+  /// Point pages [x0, x1) x [y0, y1) of level 0 at the best tiles
+  /// they have.
+  void update_pages(int x0, int y0, int x1, int y1);
+  void update_footprint(int level, int x, int y);
+
+  TiledTexture m_file;
+  TileLoader* m_loader;
+
+  int m_slots_x, m_slots_y;
+  std::vector<Slot> m_slots;
+  std::vector< std::vector<int> > m_resident; // slot of each tile, by level, or -1
+  std::vector<unsigned char> m_wanted; // level each page of level 0 is seen at
+  unsigned long m_frame;
+
+  SH::ShHostMemoryPtr m_cache_memory;
+  SH::ShHostMemoryPtr m_page_memory;
+  SH::ShTextureRect<SH::ShColor4fub> m_cache;
+  SH::ShTableRect<SH::ShAttrib4f> m_pages;
+  bool m_cache_dirty, m_pages_dirty;
+
+  int m_feedback_scale;
+  int m_feedback_viewport[4];
+
+  // NOT IMPLEMENTED
+  VirtualTexture(const VirtualTexture& other);
+  VirtualTexture& operator=(const VirtualTexture& other);
+};
+
+#endif
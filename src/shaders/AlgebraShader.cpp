@@ -23,6 +23,7 @@
 #include <list>
 #include "Shader.hpp"
 #include "Globals.hpp"
+#include "TextureCache.hpp"
 
 using namespace SH;
 using namespace ShUtil;
@@ -43,7 +44,8 @@ public:
     : Shader(name, globals), lightidx(lightidx), surfmapidx(surfmapidx), surfidx(surfidx), postidx(postidx) {}
 
   bool init(); 
-  bool render(const ShObjMesh&);
+  bool render(const MeshView&);
+  void textures(std::vector<std::string>& paths) const;
 
   ShProgram vertex() { return vsh;}
   ShProgram fragment() { return fsh;}
@@ -135,7 +137,24 @@ bool AlgebraWrapper::init() {
   return true;
 }
 
-bool AlgebraWrapper::render(const ShObjMesh&) {
+// init_all() reads every texture of every combination at once
+void AlgebraWrapper::textures(std::vector<std::string>& paths) const {
+  if (AlgebraShaders::doneInit) return;
+  const char* files[] = {
+    SHMEDIA_DIR "/brdfs/satin/satinp.png",
+    SHMEDIA_DIR "/brdfs/satin/satinq.png",
+    SHMEDIA_DIR "/textures/ks.png",
+    SHMEDIA_DIR "/mats/inv_oriental038.png",
+    SHMEDIA_DIR "/bumpmaps/bumps_normals.png",
+    SHMEDIA_DIR "/textures/rustkd.png",
+    SHMEDIA_DIR "/textures/rustks.png",
+    SHMEDIA_DIR "/textures/halftone.png",
+    0
+  };
+  for (int i = 0; files[i]; ++i) paths.push_back(normalize_path(files[i]));
+}
+
+bool AlgebraWrapper::render(const MeshView&) {
   lightDir = -normalize(m_globals.mv | m_globals.lightDirW); 
   ShVector3f horiz = cross(lightDir, ShConstVector3f(0.0f, 1.0f, 0.0f));
   lightUp = cross(horiz, lightDir);
@@ -209,27 +228,27 @@ ShProgram worleySurface() {
 }
 
 ShProgram satinSurface() {
-  ShImage image;
+  const TextureImage* image;
 
   // TODO: should have array of available BRDFs with correction
   // factor for each, hidden uniforms (don't want user to play with
   // alpha, really), pulldown menu to select BRDFs from list,
   // settings for extra specularities, etc. etc.
-  load_PNG(image, normalize_path(SHMEDIA_DIR "/brdfs/satin/satinp.png"));
-  ShTable2D<ShColor3fub> ptex(image.width(), image.height());
+  image = &TextureCache::instance().texture(normalize_path(SHMEDIA_DIR "/brdfs/satin/satinp.png"));
+  ShTable2D<ShColor3fub> ptex(image->width(), image->height());
   ptex.internal(true);
-  ptex.memory(image.memory());
+  ptex.memory(image->memory());
 
-  load_PNG(image, normalize_path(SHMEDIA_DIR "/brdfs/satin/satinq.png"));
-  ShTable2D<ShColor3fub> qtex(image.width(), image.height());
+  image = &TextureCache::instance().texture(normalize_path(SHMEDIA_DIR "/brdfs/satin/satinq.png"));
+  ShTable2D<ShColor3fub> qtex(image->width(), image->height());
   qtex.internal(true);
-  qtex.memory(image.memory());
+  qtex.memory(image->memory());
 
   // HACK, satin doesn't have specular part, turned off by default
-  load_PNG(image, normalize_path(SHMEDIA_DIR "/textures/ks.png"));
-  ShTable2D<ShColor3fub> stex(image.width(), image.height());
+  image = &TextureCache::instance().texture(normalize_path(SHMEDIA_DIR "/textures/ks.png"));
+  ShTable2D<ShColor3fub> stex(image->width(), image->height());
   stex.name("Satin Texture");
-  stex.memory(image.memory());
+  stex.memory(image->memory());
 
   // these scale factors are specific to satin
   ShColor3f SH_DECL(alpha) = ShColor3f(0.762367,0.762367,0.762367);
@@ -378,7 +397,7 @@ bool AlgebraShaders::init_all()
   int i;
   doneInit = true;
 
-  ShImage image;
+  const TextureImage* image;
 
   // useful globals
   ShColor3f SH_NAMEDECL(lightColor, "Light Colour") = ShConstColor3f(1.0f, 1.0f, 1.0f);
@@ -403,9 +422,9 @@ bool AlgebraShaders::init_all()
 
   ShAttrib1f SH_NAMEDECL(texLightScale, "Mask Scaling Factor") = ShConstAttrib1f(5.0f);
   texLightScale.range(1.0f, 10.0f);
-  load_PNG(image, normalize_path(SHMEDIA_DIR "/mats/inv_oriental038.png"));
-  ShTable2D<ShColor3fub> lighttex(image.width(), image.height());
-  lighttex.memory(image.memory());
+  image = &TextureCache::instance().texture(normalize_path(SHMEDIA_DIR "/mats/inv_oriental038.png"));
+  ShTable2D<ShColor3fub> lighttex(image->width(), image->height());
+  lighttex.memory(image->memory());
   lightsh[i++] = ShKernelLight::texLight2D(lighttex) << texLightScale << lightAngle << lightDir << lightUp;
 
   //lightsh[1] = ShKernelLight::spotLight(ShColor3f>() << lightColor << falloff << lightAngle << lightDir;
@@ -415,10 +434,10 @@ bool AlgebraShaders::init_all()
   i = 0;
   surfmapsh[i++] = keep<ShNormal3f>("normal"); 
 
-  load_PNG(image, normalize_path(SHMEDIA_DIR "/bumpmaps/bumps_normals.png"));
-  ShTable2D<ShColor3fub> normaltex(image.width(), image.height());
+  image = &TextureCache::instance().texture(normalize_path(SHMEDIA_DIR "/bumpmaps/bumps_normals.png"));
+  ShTable2D<ShColor3fub> normaltex(image->width(), image->height());
   normaltex.name("Bumpmap Normals");
-  normaltex.memory(image.memory());
+  normaltex.memory(image->memory());
 
   ShAttrib1f SH_NAMEDECL(bumpScale, "Bump Scaling Factor") = ShConstAttrib1f(1.0f);
   bumpScale.range(0.0f, 10.0f);
@@ -440,15 +459,15 @@ bool AlgebraShaders::init_all()
   //surfsh[i++] = ShKernelSurface::specular<ShColor3f>() << ks << specExp;
   //surfsh[i++] = ShKernelSurface::phong<ShColor3f>() << kd << ks << specExp;
 
-  load_PNG(image, normalize_path(SHMEDIA_DIR "/textures/rustkd.png"));
-  ShTable2D<ShColor3fub> difftex(image.width(), image.height());
+  image = &TextureCache::instance().texture(normalize_path(SHMEDIA_DIR "/textures/rustkd.png"));
+  ShTable2D<ShColor3fub> difftex(image->width(), image->height());
   difftex.name("Diffuse texture");
-  difftex.memory(image.memory());
+  difftex.memory(image->memory());
 
-  load_PNG(image, normalize_path(SHMEDIA_DIR "/textures/rustks.png"));
-  ShTable2D<ShColor3fub> spectex(image.width(), image.height());
+  image = &TextureCache::instance().texture(normalize_path(SHMEDIA_DIR "/textures/rustks.png"));
+  ShTable2D<ShColor3fub> spectex(image->width(), image->height());
   spectex.name("Specular texture");
-  spectex.memory(image.memory());
+  spectex.memory(image->memory());
 
   surfsh[i] = ShKernelSurface::phong<ShColor3f>() << ( shAccess(difftex) & shAccess(spectex) );
   surfsh[i] = surfsh[i] << shExtract("specExp") << specExp;
@@ -465,10 +484,10 @@ bool AlgebraShaders::init_all()
 
   // ******************* Make postprocessing shaders
   i = 0;
-  load_PNG(image, normalize_path(SHMEDIA_DIR "/textures/halftone.png"));
-  ShTable2D<ShColor3fub> halftoneTex(image.width(), image.height());
+  image = &TextureCache::instance().texture(normalize_path(SHMEDIA_DIR "/textures/halftone.png"));
+  ShTable2D<ShColor3fub> halftoneTex(image->width(), image->height());
   halftoneTex.name("Halftoning texture");
-  halftoneTex.memory(image.memory());
+  halftoneTex.memory(image->memory());
 
 
   postsh[i++] = keep<ShColor3f>("result"); 
@@ -22,6 +22,7 @@
 #include <iostream>
 #include "Shader.hpp"
 #include "Globals.hpp"
+#include "TextureCache.hpp"
 
 using namespace SH;
 using namespace ShUtil;
@@ -34,6 +35,7 @@ public:
   ~BumpMapShader();
     
   bool init();
+  void textures(std::vector<std::string>& paths) const;
     
   ShProgram vertex() { return vsh; }
   ShProgram fragment() { return fsh; }
@@ -52,6 +54,11 @@ BumpMapShader::~BumpMapShader()
 {
 }
 
+void BumpMapShader::textures(std::vector<std::string>& paths) const
+{
+  paths.push_back(normalize_path(SHMEDIA_DIR "/bumpmaps/bumps_normals.png"));
+}
+
 bool BumpMapShader::init()
 {
   std::cerr << "Initializing " << name() << std::endl;
@@ -63,10 +70,9 @@ bool BumpMapShader::init()
   vsh = vsh << shExtract("lightPos") << m_globals.lightPos;
   vsh = (shSwizzle("texcoord", "normal", "tangent", "lightVec", "posh") << vsh);
 
-  ShImage image;
-  load_PNG(image, normalize_path(SHMEDIA_DIR "/bumpmaps/bumps_normals.png"));
-  ShTable2D<ShVector3fub> bump(image.width(),image.height());
-  bump.memory(image.memory());
+  const TextureImage* image = &TextureCache::instance().texture(normalize_path(SHMEDIA_DIR "/bumpmaps/bumps_normals.png"));
+  ShTable2D<ShVector3fub> bump(image->width(),image->height());
+  bump.memory(image->memory());
 
   ShAttrib1f SH_DECL(scale) = ShAttrib1f(1.0);
   scale.range(0.0f, 10.0f);
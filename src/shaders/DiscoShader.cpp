@@ -22,6 +22,7 @@
 #include <iostream>
 #include "Shader.hpp"
 #include "Globals.hpp"
+#include "TextureCache.hpp"
 
 using namespace SH;
 using namespace ShUtil;
@@ -32,6 +33,7 @@ public:
   ~DiscoShader();
 
   bool init();
+  void textures(std::vector<std::string>& paths) const;
 
   ShProgram vertex() { return vsh;}
   ShProgram fragment() { return fsh;}
@@ -48,21 +50,20 @@ DiscoShader::~DiscoShader()
 {
 }
 
+void DiscoShader::textures(std::vector<std::string>& paths) const
+{
+  TextureCache::cube_faces(SHMEDIA_DIR "/envmaps/aniroom", paths);
+}
+
 bool DiscoShader::init()
 {
   std::cerr << "Initializing " << name() << std::endl;
 
-  std::string imageNames[6] = {"left", "right", "top", "bottom", "back", "front"};
-  ShImage test_image;
-  load_PNG(test_image, normalize_path(std::string(SHMEDIA_DIR "/envmaps/aniroom/") + imageNames[0] + ".png"));
-
-  ShTableCube<ShColor4fub> cubemap(test_image.width(), test_image.height());
-  {
-    for (int i = 0; i < 6; i++) {
-      ShImage image;
-      load_PNG(image, normalize_path(std::string(SHMEDIA_DIR "/envmaps/aniroom/") + imageNames[i] + ".png"));
-      cubemap.memory(image.memory(), static_cast<ShCubeDirection>(i));
-    }
+  const TextureImage& faces = TextureCache::instance().cube(SHMEDIA_DIR "/envmaps/aniroom");
+
+  ShTableCube<ShColor4fub> cubemap(faces.width(), faces.height());
+  for (int i = 0; i < 6; i++) {
+    cubemap.memory(faces.memory(i), static_cast<ShCubeDirection>(i));
   }
 
   vsh = ShKernelLib::shVsh( m_globals.mv, m_globals.mvp );
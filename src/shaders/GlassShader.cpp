@@ -22,6 +22,7 @@
 #include <iostream>
 #include "Shader.hpp"
 #include "Globals.hpp"
+#include "TextureCache.hpp"
 
 using namespace SH;
 using namespace ShUtil;
@@ -36,6 +37,7 @@ public:
   ~GlassShader();
 
   bool init();
+  void textures(std::vector<std::string>& paths) const;
 
   ShProgram vertex() { return vsh;}
   ShProgram fragment() { return fsh;}
@@ -50,22 +52,21 @@ GlassShader::~GlassShader()
 {
 }
 
+void GlassShader::textures(std::vector<std::string>& paths) const
+{
+  TextureCache::cube_faces(SHMEDIA_DIR "/envmaps/aniroom", paths);
+}
+
 bool GlassShader::init()
 {
   std::cerr << "Initializing " << name() << std::endl;
 
-  std::string imageNames[6] = {"left", "right", "top", "bottom", "back", "front"};
-  ShImage test_image;
-  load_PNG(test_image, normalize_path(std::string(SHMEDIA_DIR "/envmaps/aniroom/") + imageNames[0] + ".png"));
+  const TextureImage& faces = TextureCache::instance().cube(SHMEDIA_DIR "/envmaps/aniroom");
 
-  ShTableCube<ShColor4fub> cubemap(test_image.width(), test_image.height());
+  ShTableCube<ShColor4fub> cubemap(faces.width(), faces.height());
   cubemap.name("cubemap");
-  {
-    for (int i = 0; i < 6; i++) {
-      ShImage image;
-      load_PNG(image, normalize_path(std::string(SHMEDIA_DIR "/envmaps/aniroom/") + imageNames[i] + ".png"));
-      cubemap.memory(image.memory(), static_cast<ShCubeDirection>(i));
-    }
+  for (int i = 0; i < 6; i++) {
+    cubemap.memory(faces.memory(i), static_cast<ShCubeDirection>(i));
   }
 
   ShAttrib1f SH_DECL(eta) = ShAttrib1f(1.3f);
@@ -19,7 +19,8 @@
 //////////////////////////////////////////////////////////////////////////////
 #include <iostream>
 #include <fstream>
-#include <list>
+#include <algorithm>
+#include <cstring>
 #include <cmath>
 #include <sh/sh.hpp>
 #include <shutil/shutil.hpp>
@@ -27,6 +28,8 @@
 #include "Shader.hpp"
 #include "Globals.hpp"
 #include "Text.hpp"
+#include "HairStrands.hpp"
+#include "HairSimulation.hpp"
 #ifdef HAVE_CONFIG_H
 #include "config.h"
 #endif
@@ -36,7 +39,6 @@ using namespace ShUtil;
 
 #include "util.hpp"
 
-#define USE_DISPLAY_LIST 1
 #define RENDER_HEAD 1
 #define RENDER_HAIR 1
 #define RENDER_FIRST_HIGHLIGHT 1
@@ -50,7 +52,7 @@ public:
 
   bool init();
   virtual void initHair() {}
-  virtual bool render(const ShObjMesh&) { return false; }
+  virtual bool render(const MeshView&) { return false; }
   ShAttrib1f N2(ShAttrib1f eta, ShAttrib1f cosGammai, ShAttrib1f sigmaa);
   
   ShProgram vertex() { return vsh;}
@@ -225,7 +227,7 @@ class HairShader: public Hair {
 public:
   HairShader(const Globals& globals): Hair("Hair Shader", globals) {};
   
-  bool render(const ShObjMesh& mesh)
+  bool render(const MeshView& mesh)
   {
     return Shader::render(mesh);
   }
@@ -260,33 +262,71 @@ public:
   }
 };
 
-struct hair
-{
-  float size;
-  float root[3];
-  float tangent[3];
-  float surface[3];
-};
-
-
-
 class HairPhysics: public Hair {
 public:
-  HairPhysics(const Globals& globals)
-    : Hair("Hair with physics", globals), display_list(0) {};
+  HairPhysics(const Globals& globals);
   
   ShProgram vsh_head;
   ShProgram fsh_head;
 
-  bool render(const ShObjMesh&);
+  bool render(const MeshView&);
+  bool animating() const;
   void initHair();
 
 private:
-  std::list<hair> hairs;
-  GLuint display_list;
+  HairForces forces() const;
+
+  ShVector3f m_gravity;
+  ShVector3f m_wind_force;
+  ShAttrib1f m_wind_time;
+  ShPoint3f m_center;
+  ShAttrib1f m_radius;
+  ShAttrib1f m_hair_count;
+
+  HairStrands m_strands;
+  HairSimulation m_simulation;
+  HairBuffer m_buffer;
+  HairForces m_forces; // as of the last step
+  bool m_at_rest;
 };
 
-bool HairPhysics::render(const ShObjMesh &)
+namespace {
+const unsigned int hair_seed = 13;
+const std::size_t max_hairs = 1000000;
+const std::size_t min_hairs = 4096; // the least generated at once
+
+// A step a frame, so the hair moves slower when frames are slow
+// rather than blowing up when they're very slow.
+const float time_step = 1.0f / 60;
+const float force_scale = 20; // from the sliders to units per second squared
+const float rest_distance = 1e-4f; // moved by a step of hair at rest
+}
+
+HairPhysics::HairPhysics(const Globals& globals)
+  : Hair("Hair with physics", globals),
+    m_at_rest(false)
+{
+  std::memset(&m_forces, 0, sizeof(m_forces));
+}
+
+HairForces HairPhysics::forces() const
+{
+  float wind_time;
+  m_wind_time.getValues(&wind_time);
+
+  HairForces forces;
+  m_gravity.getValues(forces.gravity);
+  m_wind_force.getValues(forces.wind);
+  m_center.getValues(forces.center);
+  m_radius.getValues(&forces.radius);
+  for (int i = 0; i < 3; ++i) {
+    forces.gravity[i] *= force_scale;
+    forces.wind[i] *= force_scale * std::sin(M_PI * wind_time);
+  }
+  return forces;
+}
+
+bool HairPhysics::render(const MeshView&)
 {
 #if (RENDER_HEAD) // render a sphere for the head
   shBind(vsh_head);
@@ -310,84 +350,86 @@ bool HairPhysics::render(const ShObjMesh &)
     glEnd();
   }
 #endif  
-  shBind(vsh);
-  shBind(fsh);
-  // render the hair
-#if (USE_DISPLAY_LIST)
-  display_list = glGenLists(1);
-  glNewList(display_list, GL_COMPILE);
-  glNormal3f(0.0,0.0,1.0);
-  for(std::list<hair>::iterator i = hairs.begin() ; i!=hairs.end() ; i++) {
-    glBegin(GL_LINE_STRIP);
-    for(float y=0 ; y<i->size ; y=y+0.1) { // the length of the hair
-#ifdef GL_ARB_multitexture
-      glMultiTexCoord3fARB(GL_TEXTURE0, i->tangent[0], i->tangent[1], i->tangent[2]);
-      glMultiTexCoord4fARB(GL_TEXTURE0+1, y, i->surface[0], i->surface[1], i->surface[2]);
-#else
-      glMultiTexCoord3f(GL_TEXTURE0, i->tangent[0], i->tangent[1], i->tangent[2]);
-      glMultiTexCoord4f(GL_TEXTURE0+1, y, i->surface[0], i->surface[1], i->surface[2]);
-#endif
-      glVertex3f(i->root[0],i->root[1],i->root[2]);
+
+  HairForces forces = this->forces();
+
+  // Strands are generated by doubling, so dragging the slider up
+  // doesn't generate them all again every frame.
+  float count;
+  m_hair_count.getValues(&count);
+  std::size_t wanted = std::min(max_hairs, (std::size_t)std::max(count, 0.0f));
+  if (m_strands.size() < wanted) {
+    std::size_t size = std::max(m_strands.size(), min_hairs);
+    while (size < wanted) size *= 2;
+    m_strands.generate(std::min(size, max_hairs), hair_seed);
+  }
+  if (m_simulation.size() != wanted) {
+    m_simulation.resize(m_strands, wanted, forces);
+    m_at_rest = false;
+  }
+  if (std::memcmp(&forces, &m_forces, sizeof(forces)) != 0) {
+    m_forces = forces;
+    m_at_rest = false;
+  }
+
+  // Once the hair has settled, nothing is simulated or uploaded until
+  // something changes.
+  if (!m_at_rest) {
+    m_at_rest = m_simulation.step(time_step, forces) < rest_distance;
+    if (!m_buffer.upload(m_simulation)) {
+      // Try again next frame; meanwhile the model is drawn plain.
+      m_at_rest = false;
+      return false;
     }
-    glEnd();
   }
-  glEndList();
+
+  shBind(vsh);
+  shBind(fsh);
+#if (RENDER_HAIR)
+  m_buffer.draw();
 #endif
-  glCallList(display_list);
 
   return true;
 }
 
-void HairPhysics::initHair()
+bool HairPhysics::animating() const
 {
-#ifdef WIN32
-  srand(13);
-#else
-  srand(time(NULL));
-#endif
-  for(int i=0 ; i<50 ; i++) {
-    for(int j=0 ; j<50 ; j++) {
-      float x = sin(j*M_PI/200)*cos(i*M_PI/25);
-      float y = cos(j*M_PI/200);
-      float z = sin(j*M_PI/200)*sin(i*M_PI/25);
-      hair newHair;
-      newHair.size = (int)(3.0*rand()/(RAND_MAX+1.0));
-      newHair.root[0] = x;
-      newHair.root[1] = y;
-      newHair.root[2] = z;
-      newHair.surface[0] = x*0.5*(float)(rand())/(RAND_MAX+1.0);
-      newHair.surface[1] = y*0.5*(float)(rand())/(RAND_MAX+1.0);
-      newHair.surface[2] = z*0.5*(float)(rand())/(RAND_MAX+1.0);
-      newHair.tangent[0] = -newHair.surface[2];
-      newHair.tangent[1] = 0.0;
-      newHair.tangent[2] = newHair.surface[0];
-      hairs.push_back(newHair);
-    }
-  }
-  
-  ShVector3f SH_DECL(gravity) = ShVector3f(0.0,-0.5,0.0);
-  gravity.range(-1.0,1.0);
+  return !m_at_rest;
+}
 
-  ShVector3f SH_DECL(windForce) = ShVector3f(0.0,0.0,0.0);
-  windForce.range(-1.0,1.0);
-  ShAttrib1f SH_DECL(windTime) = ShAttrib1f(0.0); 
-  windTime.range(0.0,1.0);
+void HairPhysics::initHair()
+{
+  m_hair_count = ShAttrib1f(2500);
+  m_hair_count.name("hair count");
+  m_hair_count.range(1.0, max_hairs);
+  setHostUniform(m_hair_count);
+
+  m_gravity = ShVector3f(0.0,-0.5,0.0);
+  m_gravity.name("gravity");
+  m_gravity.range(-1.0,1.0);
+  setHostUniform(m_gravity);
+
+  m_wind_force = ShVector3f(0.0,0.0,0.0);
+  m_wind_force.name("windForce");
+  m_wind_force.range(-1.0,1.0);
+  setHostUniform(m_wind_force);
+
+  m_wind_time = ShAttrib1f(0.0); 
+  m_wind_time.name("windTime");
+  m_wind_time.range(0.0,1.0);
+  setHostUniform(m_wind_time);
     
-  ShPoint3f SH_DECL(center) = ShPoint3f(0.0,0.0,0.0);
-  center.range(-3.0,3.0);
-  center.name("head position");
+  m_center = ShPoint3f(0.0,0.0,0.0);
+  m_center.range(-3.0,3.0);
+  m_center.name("head position");
 
-  ShAttrib1f SH_DECL(radius) = ShAttrib1f(1.0);
-  radius.range(0.1,3.0);
-  radius.name("head size");
+  m_radius = ShAttrib1f(1.0);
+  m_radius.range(0.1,3.0);
+  m_radius.name("head size");
   
   vsh = SH_BEGIN_PROGRAM("gpu:vertex") {
     ShInputPosition3f ipos;
-    ShInputNormal3f inorm;
-    ShInputVector3f itan;
-    ShInputAttrib4f tV; // time + initial direction of the hair
-    ShVector3f V = tV(1,2,3);
-    ShAttrib1f t = tV(0); 
+    ShInputVector3f isurf; // along the hair
     
     ShOutputPosition3f opos; // Position in NDC
     ShOutputNormal3f onorm;
@@ -397,17 +439,8 @@ void HairPhysics::initHair()
     ShOutputVector3f eyev;
     ShOutputVector3f halfv;
 
-    // add simple physics
-    ShVector3f accel = gravity + windForce * sin(M_PI*windTime); // add the effect of the wind
-    ipos += 0.5*accel*t*t + V*t; // compute the position relative to the length
-    ShVector3f isurf = V + accel*t; // surface vector = velocity
-    inorm = cross(itan,isurf); // compute the normal according to the velocity
-  
-    // collision with the face
-    ShVector3f PosC = ipos-center;
-    ShVector3f N = normalize(PosC);
-    ShAttrib1f inside = sqrt(PosC|PosC)<radius;
-    ipos = inside * (center+radius*N) + (1.0-inside)*ipos; // put the hair on the surface of the sphere when there is a collision
+    ShVector3f itan = cross(isurf, ipos - m_center); // around the head
+    ShVector3f inorm = cross(itan,isurf);
     
     opos = m_globals.mvp | ipos; // Compute NDC position
     onorm = m_globals.mv | inorm; // Compute view-space normal
@@ -432,8 +465,8 @@ void HairPhysics::initHair()
     ShOutputVector3f lightv;
 
     // change the sphere to fit with the parameters used on the hair vertex shader
-    ipos *= 0.95*radius;
-    ipos += center;
+    ipos *= 0.95*m_radius;
+    ipos += m_center;
     
     opos = m_globals.mvp | ipos; // Compute NDC position
     onorm = m_globals.mv | inorm; // Compute view-space normal
@@ -22,6 +22,7 @@
 #include <iostream>
 #include "Shader.hpp"
 #include "Globals.hpp"
+#include "TextureCache.hpp"
 
 using namespace SH;
 using namespace ShUtil;
@@ -34,6 +35,7 @@ public:
   ~HomomorphicShader();
 
   bool init();
+  void textures(std::vector<std::string>& paths) const;
 
   ShProgram vertex() { return vsh;}
   ShProgram fragment() { return fsh;}
@@ -50,6 +52,18 @@ HomomorphicShader::~HomomorphicShader()
 {
 }
 
+static const char* const texture_files[] = {
+  SHMEDIA_DIR "/brdfs/garnetred/garnetred64_0.png",
+  SHMEDIA_DIR "/brdfs/garnetred/garnetred64_1.png",
+  SHMEDIA_DIR "/brdfs/specular.png",
+  0
+};
+
+void HomomorphicShader::textures(std::vector<std::string>& paths) const
+{
+  for (int i = 0; texture_files[i]; ++i) paths.push_back(normalize_path(texture_files[i]));
+}
+
 bool HomomorphicShader::init()
 {
   vsh = SH_BEGIN_PROGRAM("gpu:vertex") {
@@ -86,25 +100,26 @@ bool HomomorphicShader::init()
     light(2) = (n|lightv);  // if positive, is irradiance scale
   } SH_END;
 
-  ShImage image;
+  TextureCache::instance().preload(texture_files);
+  const TextureImage* image;
 
   // TODO: should have array of available BRDFs with correction
   // factor for each, hidden uniforms (don't want user to play with
   // alpha, really), pulldown menu to select BRDFs from list,
   // settings for extra specularities, etc. etc.
-  load_PNG(image, normalize_path(SHMEDIA_DIR "/brdfs/garnetred/garnetred64_0.png"));
-  ShTable2D<ShColor3fub> ptex(image.width(), image.height());
-  //CubicBSplineInterp<ShTexture2D<ShColor3fub> > ptex(image.width(), image.height());
-  ptex.memory(image.memory());
-
-  load_PNG(image, normalize_path(SHMEDIA_DIR "/brdfs/garnetred/garnetred64_1.png"));
-  ShTable2D<ShColor3fub>qtex(image.width(), image.height());
-  //CubicBSplineInterp<ShTexture2D<ShColor3fub> > qtex(image.width(), image.height());
-  qtex.memory(image.memory());
-
-  load_PNG(image, normalize_path(SHMEDIA_DIR "/brdfs/specular.png"));
-  ShTable2D<ShColor3fub> stex(image.width(), image.height());
-  stex.memory(image.memory());
+  image = &TextureCache::instance().texture(normalize_path(SHMEDIA_DIR "/brdfs/garnetred/garnetred64_0.png"));
+  ShTable2D<ShColor3fub> ptex(image->width(), image->height());
+  //CubicBSplineInterp<ShTexture2D<ShColor3fub> > ptex(image->width(), image->height());
+  ptex.memory(image->memory());
+
+  image = &TextureCache::instance().texture(normalize_path(SHMEDIA_DIR "/brdfs/garnetred/garnetred64_1.png"));
+  ShTable2D<ShColor3fub>qtex(image->width(), image->height());
+  //CubicBSplineInterp<ShTexture2D<ShColor3fub> > qtex(image->width(), image->height());
+  qtex.memory(image->memory());
+
+  image = &TextureCache::instance().texture(normalize_path(SHMEDIA_DIR "/brdfs/specular.png"));
+  ShTable2D<ShColor3fub> stex(image->width(), image->height());
+  stex.memory(image->memory());
 
   // these scale factors are specific to garnet red
   ShColor3f SH_DECL(alpha) = ShColor3f(0.0410592,0.0992037,0.0787714);
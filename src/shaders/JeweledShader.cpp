@@ -23,6 +23,7 @@
 #include <iostream>
 #include "Shader.hpp"
 #include "Globals.hpp"
+#include "TextureCache.hpp"
 
 using namespace SH;
 using namespace ShUtil;
@@ -35,6 +36,7 @@ public:
   ~JeweledShader();
 
   bool init();
+  void textures(std::vector<std::string>& paths) const;
 
   ShProgram vertex() { return vsh;}
   ShProgram fragment() { return fsh;}
@@ -51,6 +53,24 @@ JeweledShader::~JeweledShader()
 {
 }
 
+static const char* const texture_files[] = {
+  SHMEDIA_DIR "/brdfs/mystique/mystique64_0.png",
+  SHMEDIA_DIR "/brdfs/mystique/mystique64_1.png",
+  SHMEDIA_DIR "/brdfs/satin/satinp.png",
+  SHMEDIA_DIR "/brdfs/satin/satinq.png",
+  SHMEDIA_DIR "/brdfs/garnetred/garnetred64_0.png",
+  SHMEDIA_DIR "/brdfs/garnetred/garnetred64_1.png",
+  SHMEDIA_DIR "/brdfs/specular.png",
+  SHMEDIA_DIR "/textures/halftone.png",
+  0
+};
+
+void JeweledShader::textures(std::vector<std::string>& paths) const
+{
+  for (int i = 0; texture_files[i]; ++i) paths.push_back(normalize_path(texture_files[i]));
+  TextureCache::cube_faces(SHMEDIA_DIR "/envmaps/aniroom", paths);
+}
+
 bool JeweledShader::init()
 {
   ShAttrib2f texture_scale(1.0,1.0);
@@ -110,7 +130,9 @@ bool JeweledShader::init()
     light(2) = (n|lightv);  // if positive, is irradiance scale
   } SH_END;
 
-  ShImage image;
+  // Decode the lot at once
+  TextureCache::instance().preload(texture_files);
+  const TextureImage* image;
 
 #define NMATS 3
 #define LMAT 0
@@ -118,61 +140,56 @@ bool JeweledShader::init()
   ShTable2D<ShColor3fub> ptex[NMATS];
   ShTable2D<ShColor3fub> qtex[NMATS];
 
-  load_PNG(image, normalize_path(SHMEDIA_DIR "/brdfs/mystique/mystique64_0.png"));
-  ptex[0].size(image.width(), image.height());
-  ptex[0].memory(image.memory());
+  image = &TextureCache::instance().texture(normalize_path(SHMEDIA_DIR "/brdfs/mystique/mystique64_0.png"));
+  ptex[0].size(image->width(), image->height());
+  ptex[0].memory(image->memory());
   ptex[0].name("Mystique p texture");
 
-  load_PNG(image, normalize_path(SHMEDIA_DIR "/brdfs/mystique/mystique64_1.png"));
-  qtex[0].size(image.width(), image.height());
-  qtex[0].memory(image.memory());
+  image = &TextureCache::instance().texture(normalize_path(SHMEDIA_DIR "/brdfs/mystique/mystique64_1.png"));
+  qtex[0].size(image->width(), image->height());
+  qtex[0].memory(image->memory());
   qtex[0].name("Mystique q texture");
 
-  load_PNG(image, normalize_path(SHMEDIA_DIR "/brdfs/satin/satinp.png"));
-  ptex[1].size(image.width(), image.height());
-  ptex[1].memory(image.memory());
+  image = &TextureCache::instance().texture(normalize_path(SHMEDIA_DIR "/brdfs/satin/satinp.png"));
+  ptex[1].size(image->width(), image->height());
+  ptex[1].memory(image->memory());
   ptex[1].name("Satin p texture");
 
-  load_PNG(image, normalize_path(SHMEDIA_DIR "/brdfs/satin/satinq.png"));
-  qtex[1].size(image.width(), image.height());
-  qtex[1].memory(image.memory());
+  image = &TextureCache::instance().texture(normalize_path(SHMEDIA_DIR "/brdfs/satin/satinq.png"));
+  qtex[1].size(image->width(), image->height());
+  qtex[1].memory(image->memory());
   qtex[1].name("Satin q texture");
 
-  load_PNG(image, normalize_path(SHMEDIA_DIR "/brdfs/garnetred/garnetred64_0.png"));
-  ptex[2].size(image.width(), image.height());
-  ptex[2].memory(image.memory());
+  image = &TextureCache::instance().texture(normalize_path(SHMEDIA_DIR "/brdfs/garnetred/garnetred64_0.png"));
+  ptex[2].size(image->width(), image->height());
+  ptex[2].memory(image->memory());
   ptex[2].name("Garnet red p texture");
 
-  load_PNG(image, normalize_path(SHMEDIA_DIR "/brdfs/garnetred/garnetred64_1.png"));
-  qtex[2].size(image.width(), image.height());
-  qtex[2].memory(image.memory());
+  image = &TextureCache::instance().texture(normalize_path(SHMEDIA_DIR "/brdfs/garnetred/garnetred64_1.png"));
+  qtex[2].size(image->width(), image->height());
+  qtex[2].memory(image->memory());
   qtex[2].name("Garnet red q texture");
 
   // Specular highlight (to be added when needed...)
-  load_PNG(image, normalize_path(SHMEDIA_DIR "/brdfs/specular.png"));
-  ShTable2D<ShColor3fub> stex(image.width(), image.height());
-  stex.memory(image.memory());
+  image = &TextureCache::instance().texture(normalize_path(SHMEDIA_DIR "/brdfs/specular.png"));
+  ShTable2D<ShColor3fub> stex(image->width(), image->height());
+  stex.memory(image->memory());
   stex.name("Specular highlight texture");
   
   // Cube map for mirror reflection
-  std::string imageNames[6] = {"left", "right", "top", "bottom", "back", "front"};
-  ShTableCube<ShColor4fub> env;
+  const TextureImage& faces = TextureCache::instance().cube(SHMEDIA_DIR "/envmaps/aniroom");
+  ShTableCube<ShColor4fub> env(faces.width(), faces.height());
   env.name("Environment map");
-  {
-    for (int i = 0; i < 6; i++) {
-      ShImage image;
-      load_PNG(image, normalize_path(std::string(SHMEDIA_DIR "/envmaps/aniroom/") + imageNames[i] + ".png"));
-      env.size(image.width(), image.height());
-      env.memory(image.memory(), static_cast<ShCubeDirection>(i));
-    }
+  for (int i = 0; i < 6; i++) {
+    env.memory(faces.memory(i), static_cast<ShCubeDirection>(i));
   }
   
   ShWrapRepeat< ShTable2D<ShColor3fub> > mat;
 
   // Material map (threshold based...)
-  load_PNG(image, normalize_path(SHMEDIA_DIR "/textures/halftone.png"));
-  mat.size(image.width(), image.height());
-  mat.memory(image.memory());
+  image = &TextureCache::instance().texture(normalize_path(SHMEDIA_DIR "/textures/halftone.png"));
+  mat.size(image->width(), image->height());
+  mat.memory(image->memory());
   mat.name("Filgiree distance map");
   
   // Scale factors
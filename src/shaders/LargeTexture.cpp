@@ -17,80 +17,123 @@
 // Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, 
 // MA  02110-1301, USA
 //////////////////////////////////////////////////////////////////////////////
+#include <cstdlib>
 #include <sh/sh.hpp>
-#include <sh/shutil.hpp>
+#include <shutil/shutil.hpp>
 #include <iostream>
 #include "Shader.hpp"
 #include "Globals.hpp"
-#include "LargeTexture.hpp"
-#include "HDRInterp.hpp"
+#include "MeshView.hpp"
+#include "VirtualTexture.hpp"
 
 using namespace SH;
 using namespace ShUtil;
 
+/** Shows textures far too big to load, like whole planet maps, by
+ * streaming in just the tiles in view (see VirtualTexture).  The image
+ * has to be tiled first with shtexconv --tiles, which turns foo.png
+ * into foo.shvt; "Image Name" is either, under shmedia's
+ * largetextures, or an absolute path.
+ */
 class LargeTextureShader : public Shader {
 public:
-  LargeTextureShader();
+  LargeTextureShader(const Globals&);
   ~LargeTextureShader();
 
   bool init();
-  
+  bool render(const MeshView& mesh);
+
   ShProgram vertex() { return vsh;}
   ShProgram fragment() { return fsh;}
 
   ShProgram vsh, fsh;
 
-  std::string fname;
+private:
+  std::string m_name;
+  std::string m_cache_tiles;
 
-  static LargeTextureShader instance;
+  VirtualTexture m_texture;
+  ShProgramSet* m_feedback;
 };
 
-LargeTextureShader::LargeTextureShader()
-  : Shader("Textures: Large Texture"), fname("earth.png")
+LargeTextureShader::LargeTextureShader(const Globals& globals)
+  : Shader("Textures: Large Texture", globals), m_name("earth.png"),
+    m_cache_tiles("256"), m_feedback(0)
 {
-  setStringParam("Image Name", fname);
+  setStringParam("Image Name", m_name);
+  setStringParam("Cache Tiles", m_cache_tiles);
 }
 
 LargeTextureShader::~LargeTextureShader()
 {
+  delete m_feedback;
 }
 
 bool LargeTextureShader::init()
 {
-  ShImage image;
-  std::string filename = SHMEDIA_DIR "/largetextures/" + fname;
-  image.loadPng(normalize_path(filename.c_str()));
-  LinInterp<LargeTexture<ShTableRect<ShColor4f>, 4, 2> > Img(image.width(), image.height());
-  Img.internal(true);
-  Img.memory(image.memory());
-
-  vsh = SH_BEGIN_PROGRAM("gpu:vertex") {
-    ShInputPosition4f ipos;
-    ShInputNormal3f inorm;
-    ShOutputPosition4f opos; // Position in NDC
-    ShInOutTexCoord2f tc; // pass through tex coords
-    ShOutputNormal3f onorm;
-    
-    opos = Globals::mvp | ipos; // Compute NDC position
-    onorm = Globals::mv | inorm; // Compute view-space normal
-
-    ShPoint3f posv = (Globals::mv | ipos)(0,1,2); // Compute view-space position
-} SH_END;
-
-  ShAttrib2f SH_DECL(scale) = ShAttrib2f(1.0,1.0);
-  scale.range(0.1,2.0);
-
-  ShAttrib2f SH_DECL(translation) = ShAttrib2f(0.0,0.0);
-  
-  fsh = SH_BEGIN_PROGRAM("gpu:fragment") {
-    ShInputPosition4f posh;
+  std::cerr << "Initializing " << name() << std::endl;
+  std::string path = m_name;
+  if (path.empty() || (path[0] != '/' && path.find(':') == std::string::npos)) {
+    path = SHMEDIA_DIR "/largetextures/" + path;
+  }
+  if (path.size() > 4 && path.compare(path.size() - 4, 4, ".png") == 0) {
+    path.replace(path.size() - 4, 4, ".shvt");
+  }
+  std::string error;
+  if (!m_texture.open(normalize_path(path), std::atoi(m_cache_tiles.c_str()), error)) {
+    std::cerr << error << std::endl;
+    std::cerr << "Make it from the PNG with shtexconv --tiles" << std::endl;
+    return false;
+  }
+
+  vsh = ShKernelLib::shVsh(m_globals.mv, m_globals.mvp);
+  vsh = shSwizzle("texcoord", "posh") << vsh;
+
+  ShAttrib2f SH_DECL(scale) = ShAttrib2f(1.0, 1.0);
+  scale.range(0.1, 64.0);
+  ShAttrib2f SH_DECL(translation) = ShAttrib2f(0.0, 0.0);
+
+  fsh = SH_BEGIN_FRAGMENT_PROGRAM {
     ShInputTexCoord2f tc;
-    ShInputNormal3f normal;
- 
-    ShOutputColor3f result = Img(tc*scale + translation)(0,1,2);
-    
-  } SH_END;
+    ShOutputColor3f result = m_texture.lookup(tc*scale + translation)(0,1,2);
+  } SH_END_PROGRAM;
+
+  ShProgram feedback = SH_BEGIN_FRAGMENT_PROGRAM {
+    ShInputTexCoord2f tc;
+    ShOutputColor3f result = m_texture.feedback(tc*scale + translation);
+  } SH_END_PROGRAM;
+  delete m_feedback;
+  m_feedback = new ShProgramSet(vsh, feedback);
   return true;
 }
 
-LargeTextureShader LargeTextureShader::instance = LargeTextureShader();
+bool LargeTextureShader::render(const MeshView& mesh)
+{
+  if (!m_texture.is_open()) return false;
+
+  // Tiles read since the last frame go in before anything is drawn;
+  // then a small copy of the view says what to read next
+  m_texture.update();
+  shBind(*m_feedback);
+  m_texture.begin_feedback();
+  mesh.drawTriangles();
+  m_texture.end_feedback();
+  Shader::unbind();
+
+  bind();
+  mesh.drawTriangles();
+  return true;
+}
+
+#ifdef SHRIKE_LIBRARY_SHADER
+extern "C" {
+  ShaderList shrike_library_create(const Globals &globals) {
+    ShaderList list;
+    list.push_back(new LargeTextureShader(globals));
+    return list;
+  }
+}
+#else
+static StaticLinkedShader<LargeTextureShader> instance = 
+       StaticLinkedShader<LargeTextureShader>();
+#endif
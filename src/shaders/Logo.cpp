@@ -25,6 +25,7 @@
 #include "Shader.hpp"
 #include "Globals.hpp"
 #include "Text.hpp"
+#include "MeshView.hpp"
 #ifdef HAVE_CONFIG_H
 #include "config.h"
 #endif
@@ -42,7 +43,7 @@ public:
 
   void bind();
   
-  bool render(const ShObjMesh&);
+  bool render(const MeshView&);
   
   ShProgram vertex() { return vsh;}
   ShProgram fragment() { return fsh_h;}
@@ -54,7 +55,7 @@ private:
 
   ShPoint3f saw, sbw;
 
-  ShObjMesh* m_model;
+  MeshView m_logo;
 
   ShProgramSet* m_shadow_set;
   ShProgramSet* m_object_set;
@@ -83,7 +84,7 @@ void Logo::bind()
 {
 }
 
-bool Logo::render(const ShObjMesh&)
+bool Logo::render(const MeshView&)
 {
   shBind(*m_shadow_set);
 
@@ -102,36 +103,7 @@ bool Logo::render(const ShObjMesh&)
   } glEnd();
 
   shBind(*m_object_set);
-  
-  float values[4];
-  glBegin(GL_TRIANGLES);
-  for(ShObjMesh::FaceSet::iterator I = m_model->faces.begin();
-      I != m_model->faces.end(); ++I) {
-    ShObjEdge *e = (*I)->edge;
-    do {
-      e->normal.getValues(values); 
-      glNormal3fv(values);
-
-      e->texcoord.getValues(values);
-#ifdef GL_ARB_multitexture
-      glMultiTexCoord2fvARB(GL_TEXTURE0, values);
-#else
-      glMultiTexCoord2fv(GL_TEXTURE0, values);
-#endif
-
-      e->tangent.getValues(values);
-#ifdef GL_ARB_multitexture
-      glMultiTexCoord2fvARB(GL_TEXTURE0 + 1, values);
-#else
-      glMultiTexCoord2fv(GL_TEXTURE0 + 1, values);
-#endif
-
-      e->start->pos.getValues(values);
-      glVertex3fv(values);
-      e = e->next;
-    } while(e != (*I)->edge);
-  }
-  glEnd();
+  m_logo.drawTriangles();
 
   return true;
 }
@@ -143,7 +115,8 @@ bool Logo::init()
 
   std::ifstream infile(SHMEDIA_DIR "/objs/s.obj");
   if (infile) {
-    m_model = new ShObjMesh(infile);
+    ShObjMesh model(infile);
+    m_logo.assign(model);
   } else {
     throw ShException("failed to open "SHMEDIA_DIR "/objs/s.obj");
   }
@@ -22,6 +22,7 @@
 #include <iostream>
 #include "Shader.hpp"
 #include "Globals.hpp"
+#include "TextureCache.hpp"
 
 using namespace SH;
 using namespace ShUtil;
@@ -36,6 +37,7 @@ public:
   ~LuciteShader();
 
   bool init();
+  void textures(std::vector<std::string>& paths) const;
 
   ShProgram vertex() { return vsh;}
   ShProgram fragment() { return fsh;}
@@ -50,22 +52,21 @@ LuciteShader::~LuciteShader()
 {
 }
 
+void LuciteShader::textures(std::vector<std::string>& paths) const
+{
+  TextureCache::cube_faces(SHMEDIA_DIR "/envmaps/aniroom", paths);
+}
+
 bool LuciteShader::init()
 {
   std::cerr << "Initializing " << name() << std::endl;
 
-  std::string imageNames[6] = {"left", "right", "top", "bottom", "back", "front"};
-  ShImage test_image;
-  load_PNG(test_image, normalize_path(std::string(SHMEDIA_DIR "/envmaps/aniroom/") + imageNames[0] + ".png"));
+  const TextureImage& faces = TextureCache::instance().cube(SHMEDIA_DIR "/envmaps/aniroom");
 
   ShTableCube<ShColor4fub> SH_DECL(cubemap) =
-    ShTableCube<ShColor4fub>(test_image.width(), test_image.height());
-  {
-    for (int i = 0; i < 6; i++) {
-      ShImage image;
-      load_PNG(image, normalize_path(std::string(SHMEDIA_DIR "/envmaps/aniroom/") + imageNames[i] + ".png"));
-      cubemap.memory(image.memory(), static_cast<ShCubeDirection>(i));
-    }
+    ShTableCube<ShColor4fub>(faces.width(), faces.height());
+  for (int i = 0; i < 6; i++) {
+    cubemap.memory(faces.memory(i), static_cast<ShCubeDirection>(i));
   }
 
   ShAttrib3f SH_DECL(eta) = ShAttrib3f(1.32f,1.3f,1.28f);
@@ -22,6 +22,7 @@
 #include <iostream>
 #include "Shader.hpp"
 #include "Globals.hpp"
+#include "TextureCache.hpp"
 
 using namespace SH;
 using namespace ShUtil;
@@ -32,6 +33,7 @@ public:
   ~PhongShader();
 
   bool init();
+  void textures(std::vector<std::string>& paths) const;
 
   ShProgram vertex() { return vsh;}
   ShProgram fragment() { return fsh;}
@@ -48,6 +50,12 @@ PhongShader::~PhongShader()
 {
 }
 
+void PhongShader::textures(std::vector<std::string>& paths) const
+{
+  paths.push_back(normalize_path(SHMEDIA_DIR "/textures/rustkd.png"));
+  paths.push_back(normalize_path(SHMEDIA_DIR "/textures/rustks.png"));
+}
+
 bool PhongShader::init()
 {
   vsh = ShKernelLib::shVsh( m_globals.mv, m_globals.mvp );
@@ -59,13 +67,12 @@ bool PhongShader::init()
   ShAttrib1f SH_DECL(exponent) = ShAttrib1f(35.0);
   exponent.range(5.0f, 500.0f);
 
-  ShImage image;
-  load_PNG(image, normalize_path(SHMEDIA_DIR "/textures/rustkd.png"));
-  ShTable2D<ShColor3fub> difftex(image.width(), image.height());
-  difftex.memory(image.memory());
-  load_PNG(image, normalize_path(SHMEDIA_DIR "/textures/rustks.png"));
-  ShTable2D<ShColor3fub> spectex(image.width(), image.height());
-  spectex.memory(image.memory());
+  const TextureImage* image = &TextureCache::instance().texture(normalize_path(SHMEDIA_DIR "/textures/rustkd.png"));
+  ShTable2D<ShColor3fub> difftex(image->width(), image->height());
+  difftex.memory(image->memory());
+  image = &TextureCache::instance().texture(normalize_path(SHMEDIA_DIR "/textures/rustks.png"));
+  ShTable2D<ShColor3fub> spectex(image->width(), image->height());
+  spectex.memory(image->memory());
   
   ShConstColor3f lightColor(1.0f, 1.0f, 1.0f);
   fsh = ShKernelSurface::phong<ShColor3f>();
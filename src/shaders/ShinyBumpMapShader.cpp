@@ -22,6 +22,7 @@
 #include <iostream>
 #include "Shader.hpp"
 #include "Globals.hpp"
+#include "TextureCache.hpp"
 
 using namespace SH;
 using namespace ShUtil;
@@ -34,6 +35,7 @@ public:
   ~ShinyBumpMapShader();
 
   bool init();
+  void textures(std::vector<std::string>& paths) const;
 
   ShProgram vertex() { return vsh;}
   ShProgram fragment() { return fsh;}
@@ -48,21 +50,21 @@ ShinyBumpMapShader::~ShinyBumpMapShader()
 {
 }
 
+void ShinyBumpMapShader::textures(std::vector<std::string>& paths) const
+{
+  TextureCache::cube_faces(SHMEDIA_DIR "/envmaps/aniroom", paths);
+  paths.push_back(normalize_path(SHMEDIA_DIR "/bumpmaps/bumps_normals.png"));
+}
+
 bool ShinyBumpMapShader::init()
 {
   std::cerr << "Initializing " << name() << std::endl;
 
-  std::string imageNames[6] = {"left", "right", "top", "bottom", "back", "front"};
-  ShImage test_image;
-  load_PNG(test_image, normalize_path(std::string(SHMEDIA_DIR "/envmaps/aniroom/") + imageNames[0] + ".png"));
-
-  ShTableCube<ShColor4fub> cubemap(test_image.width(), test_image.height());
-  {
-    for (int i = 0; i < 6; i++) {
-      ShImage image;
-      load_PNG(image, normalize_path(std::string(SHMEDIA_DIR "/envmaps/aniroom/") + imageNames[i] + ".png"));
-      cubemap.memory(image.memory(), static_cast<ShCubeDirection>(i));
-    }
+  const TextureImage& faces = TextureCache::instance().cube(SHMEDIA_DIR "/envmaps/aniroom");
+
+  ShTableCube<ShColor4fub> cubemap(faces.width(), faces.height());
+  for (int i = 0; i < 6; i++) {
+    cubemap.memory(faces.memory(i), static_cast<ShCubeDirection>(i));
   }
 
   vsh = SH_BEGIN_PROGRAM("gpu:vertex") {
@@ -83,10 +85,9 @@ bool ShinyBumpMapShader::init()
     viewv = -ShVector3f(posv); // Compute view vector
   } SH_END;
 
-  ShImage image;
-  load_PNG(image, normalize_path(SHMEDIA_DIR "/bumpmaps/bumps_normals.png"));
-  ShTable2D<ShVector3fub> bump(image.width(),image.height());
-  bump.memory(image.memory());
+  const TextureImage* image = &TextureCache::instance().texture(normalize_path(SHMEDIA_DIR "/bumpmaps/bumps_normals.png"));
+  ShTable2D<ShVector3fub> bump(image->width(),image->height());
+  bump.memory(image->memory());
 
   ShAttrib3f SH_DECL(scale) = ShAttrib3f(2.0,2.0,1.0);
   scale.range(0.0f,10.0f);
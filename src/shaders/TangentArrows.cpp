@@ -24,6 +24,7 @@
 #include <iostream>
 #include "Shader.hpp"
 #include "Globals.hpp"
+#include "MeshView.hpp"
 
 using namespace SH;
 using namespace ShUtil;
@@ -38,7 +39,7 @@ public:
 
   bool init();
 
-  bool render(const ShObjMesh&);
+  bool render(const MeshView& mesh);
   
   ShProgram vertex() { return vsh;}
   ShProgram fragment() { return fsh;}
@@ -46,43 +47,11 @@ public:
   ShProgram vsh, fsh;
 };
 
-bool TangentArrows::render(const ShObjMesh& mesh)
+bool TangentArrows::render(const MeshView& mesh)
 {
-
   glPushAttrib(GL_LINE_BIT);
-
   glLineWidth(2.0);
-  
-  float vs[4];
-  glBegin(GL_LINES);
-  for(ShObjMesh::FaceSet::const_iterator I = mesh.faces.begin();
-      I != mesh.faces.end(); ++I) {
-    ShObjMesh::Edge* e = (*I)->edge;
-    do {
-      
-      for (int i = 0; i < 2; i++) {
-        e->normal.getValues(vs); glNormal3fv(vs);
-
-        float f = (i ? 1.0 : 0.0);
-#ifdef GL_ARB_multitexture
-        glMultiTexCoord1fvARB(GL_TEXTURE0, &f);        
-#else
-        glMultiTexCoord1fv(GL_TEXTURE0, &f);
-#endif
-      
-        e->tangent.getValues(vs);
-#ifdef GL_ARB_multitexture
-        glMultiTexCoord3fvARB(GL_TEXTURE0 + 1, vs);
-#else
-        glMultiTexCoord3fv(GL_TEXTURE0 + 1, vs);
-#endif
-
-        e->start->pos.getValues(vs); glVertex3fv(vs); 
-      }
-      e = e->next;
-    } while( e != (*I)->edge);
-  }
-  glEnd();
+  mesh.drawVertexLines();
   glPopAttrib();
 
   return true;
@@ -127,7 +96,7 @@ public:
 
   bool init();
 
-  bool render(const ShObjMesh&);
+  bool render(const MeshView& mesh);
   
   ShProgram vertex() { return vsh;}
   ShProgram fragment() { return fsh;}
@@ -135,43 +104,11 @@ public:
   ShProgram vsh, fsh;
 };
 
-bool NormalArrows::render(const ShObjMesh& mesh)
+bool NormalArrows::render(const MeshView& mesh)
 {
-
   glPushAttrib(GL_LINE_BIT);
-
   glLineWidth(2.0);
-  
-  float vs[4];
-  glBegin(GL_LINES);
-  for(ShObjMesh::FaceSet::const_iterator I = mesh.faces.begin();
-      I != mesh.faces.end(); ++I) {
-    ShObjMesh::Edge* e = (*I)->edge;
-    do {
-      
-      for (int i = 0; i < 2; i++) {
-        e->normal.getValues(vs); glNormal3fv(vs);
-
-        float f = (i ? 1.0 : 0.0);
-#ifdef GL_ARB_multitexture
-        glMultiTexCoord1fvARB(GL_TEXTURE0, &f);
-#else
-        glMultiTexCoord1fv(GL_TEXTURE0, &f);
-#endif
-      
-        e->tangent.getValues(vs);
-#ifdef GL_ARB_multitexture
-	    glMultiTexCoord3fvARB(GL_TEXTURE0 + 1, vs);
-#else
-	    glMultiTexCoord3fv(GL_TEXTURE0 + 1, vs);
-#endif
-        
-        e->start->pos.getValues(vs); glVertex3fv(vs); 
-      }
-      e = e->next;
-    } while( e != (*I)->edge);
-  }
-  glEnd();
+  mesh.drawVertexLines();
   glPopAttrib();
 
   return true;
@@ -33,7 +33,7 @@ public:
 
   bool init();
 
-  bool render(const ShObjMesh&);
+  bool render(const MeshView&);
   
   ShProgram vertex() { return vsh;}
   ShProgram fragment() { return fsh;}
@@ -53,7 +53,7 @@ VertexBranching::~VertexBranching()
 {
 }
 
-bool VertexBranching::render(const ShObjMesh&)
+bool VertexBranching::render(const MeshView&)
 {
   int divs = 500;
 
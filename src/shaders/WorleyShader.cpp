@@ -22,6 +22,7 @@
 #include <iostream>
 #include "Shader.hpp"
 #include "Globals.hpp"
+#include "TextureCache.hpp"
 
 using namespace SH;
 using namespace ShUtil;
@@ -475,7 +476,7 @@ public:
     vsh = namedAlign(vsh, fsh);
   }
 
-  bool render(const ShObjMesh&)
+  bool render(const MeshView&)
   {
     if((m_enable != m_old).getValue(0) > 0.5f) {
       m_time += m_speed;
@@ -645,6 +646,11 @@ public:
   MosaicWorley(bool useTexture, const Globals& globals)
     : WorleyShader("Mosaic", useTexture, globals) {}
 
+  void textures(std::vector<std::string>& paths) const
+  {
+    TextureCache::cube_faces(SHMEDIA_DIR "/envmaps/aniroom", paths);
+  }
+
   void initfsh()
   {
     ShColor3f specularColor(0.5, 0.5, 0.5);
@@ -655,17 +661,11 @@ public:
     mosaicTex.name("Mosaic Texture");
     mosaicTex.memory(image.memory());
 
-    std::string imageNames[6] = {"left", "right", "top", "bottom", "back", "front"};
-    ShImage test_image;
-    load_PNG(test_image, normalize_path(std::string(SHMEDIA_DIR "/envmaps/aniroom/") + imageNames[0] + ".png"));
+    const TextureImage& faces = TextureCache::instance().cube(SHMEDIA_DIR "/envmaps/aniroom");
 
-    ShTableCube<ShColor4fub> cubemap(test_image.width(), test_image.height());
-    {
-      for (int i = 0; i < 6; i++) {
-	ShImage image2;
-	load_PNG(image2, normalize_path(std::string(SHMEDIA_DIR "/envmaps/aniroom/") + imageNames[i] + ".png"));
-	cubemap.memory(image2.memory(), static_cast<ShCubeDirection>(i));
-      }
+    ShTableCube<ShColor4fub> cubemap(faces.width(), faces.height());
+    for (int i = 0; i < 6; i++) {
+      cubemap.memory(faces.memory(i), static_cast<ShCubeDirection>(i));
     }
 
     ShAttrib1f SH_DECL(texScale) = ShConstAttrib1f(32.0);